@@ -1,446 +1,400 @@
-/**
-*	@file Auto.c
-*	@brief this is the main c file that controls the robot. 
-*	@author Yuxiang Chen
-*	@date 4/12/2015
-*/ 
-
-
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include "open_interface.h"
-#include "util.h"
-#include "movement.h"
-
-#include "music.h"
-
-///structure for recording the characteristics of each object seen
-struct objects{
-	int degrees;		//the degree the object was seen at 
-	int dwidth;		//the width of the object in degrees
-	double sonar;		//distance from robot measured useing sonar pulse
-	int index;		//how many objects were seen before it 
-	double width;		//width in centimeters
-	double ir;		//distance from robot measured with IR sensor
-};
-	
-double IR_dist;			//distance measured using IR sensor
-volatile int rise;		//rising edge of received sonar pulse
-volatile int fall;		//falling edge of received sonar pulse 
-volatile int delta;		//difference in between rising and falling edge of received sonar pulse
-volatile double distance;	//stores measured sonar distances in centimeters
-volatile double time;		//stores time between rising and falling edge of received sonar pulse 
-volatile int overflow;		//stores the overflow
-volatile char finish = 0;	//is set to 1 when sonar is done measuring 
-struct objects myObject[10];	//array that contaings the data for each object 
-int index = 0;			//variable to keep track of the current index 
-	
-
-
-
-
-///interrupt occurs when the rising edge of a pulse on the IC pin is detected
-ISR (TIMER1_CAPT_vect){
-	if ((TCCR1B & 0x40))
-	{
-		rise = ICR1;
-		TCCR1B = 0x82;
-		} else{
-		fall = ICR1;
-		TCCR1B = 0xC2;
-		delta = fall - rise;			//calculate clock ticks
-		time = 0.0005 * delta;			//calculate time
-		distance = 34 * time / 2-30;		//calculate distance 
-		finish = 1;				
-	}
-}
-
-
-///This interrupt occurs when an overflow is detected 
-ISR(TIMER1_OVF_vect){
-	overflow++;
-}
-
-
-/**
- *	This function uses the servo to sweep from 0 to 180
- *	degrees and measure the distance seen by the IR and 
- *	Sonar sensors for each degree. 
- *	@author Yuixiang Chen
- *	@date 4/12/2015  
- */
-
-void sweep()
-{
-
-	//initializations 
-	USART_Init(34);
-	servo_init();
-	sonar_init();
-	IR_init();
-	move_servo(0);
-	wait_ms(1000);
-	
-
-	double lastDistance = 0;		//distance measured at the previous degree
-	double currentDistance = 0;		//distance measured at the current degree
-	int startDegree = 0;			//degree when object is first detected
-	int endDegree = 0;			//the last degree that the object was detected
-	double distances[90];			//array that holds distance data for each degree 
-	index = 0;
-	
-	char s[] = "Degrees\t\tIR Distance (cm)\t\tSonar Distance (cm)\n\r";
-	for(int i = 0; i < strlen(s) ; i++){
-		USART_Transmit(s[i]);
-	}
-	
-	//loop through each degree
-	for (int i = 0; i <= 180; i++)
-	{
-		move_servo(i);
-		IR_dist = IR_read();		
-		unsigned char output[30];
-		send_pulse();
-		while(!finish);
-		sprintf(output, "%d\t\t%.2f\t\t\t\t%.2f\n\r", i, IR_dist, distance);
-		//lprintf("%d\n%.2f\n%.3f\n", i, IR_dist,distance);
-		for (int j = 0; j < strlen(output); j++)
-		{
-			USART_Transmit(output[j]);
-		}
-		
-		lastDistance = currentDistance;
-		currentDistance = IR_dist;
-		distances[i/2] = currentDistance;
-		
-		//first detect the object
-		if ((lastDistance < 5 || lastDistance > 50) && currentDistance < 50 && currentDistance > 5)
-		{
-			startDegree = i;
-		}
-
-		//detect end of object
-		if (lastDistance > 5 && lastDistance < 50 && (currentDistance > 50 || currentDistance < 5))
-		{
-			//fill myObject with the objects data
-			endDegree = i;
-			myObject[index].degrees = (endDegree + startDegree)/2;
-			myObject[index].sonar = distance;
-			myObject[index].ir = distances[myObject[index].degrees/2];
-			myObject[index].index = index;
-			myObject[index].dwidth = endDegree - startDegree;
-			myObject[index].width = (double) (2 * myObject[index].sonar * tan((double)myObject[index].dwidth / 360.0 * 3.1415926));
-			index++;
-		}
-	}
-	
-	//transmit data obtained from the sweep
-	for (int i = 0; i < index; i++)
-	{
-		char output[100];
-		sprintf(output, "Index: %d\n\rDegree: %d\n\rWidth: %.2f\n\rSonar Distance: %.2f\n\rIR distance: %.2f\n\r\n\r",myObject[i].index,myObject[i].degrees,myObject[i].width, myObject[i].sonar, myObject[i].ir);
-		for (int j = 0; j < strlen(output); j++)
-		{
-			USART_Transmit(output[j]);
-		}
-	}
-}
-
-/**
- *	This function updates and transmits the current state of all robot sensors.
- *	@author Yuixiang Chen
- *	@date 4/12/2015
- *	@param sensor_data 	memory space for the sensor data to be held 
- */
-
-void read(oi_t *sensor_data){
-	oi_update(sensor_data);
-	char status[250];
-
-	sprintf(status, "Bump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor_data->bumper_left, sensor_data->bumper_right, sensor_data->cliff_left, sensor_data->cliff_frontleft, sensor_data->cliff_frontright, sensor_data->cliff_right, sensor_data->cliff_left_signal, sensor_data->cliff_frontleft_signal, sensor_data->cliff_frontright_signal, sensor_data->cliff_right_signal);
-
-	for (int i = 0; i < strlen(status); i++)
-	{
-		USART_Transmit(status[i]);
-	}
-}
-
-/**
- *	This is the main functiom. It calls functions and allows us 
- *	to communicate with the robot
- *	@author Yuixiang Chen 
- *	@date 4/12/2015
- */
-
-int main(void)
-{
-	//initializations
-	USART_Init(34);
-
-	char status[250];	//array that temporarily hold sensor data before being transmitted
-	
-    while(1)
-    {
-		oi_t *sensor_data = oi_alloc();
-		oi_init(sensor_data);
-		
-		sprintf(status, "Bump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor_data->bumper_left, sensor_data->bumper_right, sensor_data->cliff_left, sensor_data->cliff_frontleft, sensor_data->cliff_frontright, sensor_data->cliff_right, sensor_data->cliff_left_signal, sensor_data->cliff_frontleft_signal, sensor_data->cliff_frontright_signal, sensor_data->cliff_right_signal);
-		
-		//transmitting current state of all robot sensors
-		for (int i = 0; i < strlen(status); i++)
-		{
-			USART_Transmit(status[i]);
-		}
-		
-		unsigned char comm = USART_Receive();		//character that represents a remote control command 
-
-		//move forward slowly
-		if (comm == 'q')
-		{
-			move_forward(sensor_data, 100);
-			if (sensor_data->cliff_left_signal > 500 && sensor_data->cliff_left_signal < 650)
-			{
-				turn_counterclockwise(sensor_data, 55);
-				int sum = 0;
-				oi_set_wheels(100, 100); // move forward; full speed
-				while (sum < 150) {
-					oi_update(sensor_data);
-					sum += sensor_data->distance;
-				}
-				oi_set_wheels(0, 0); // stop
-				play_song();
-				break;
-			} else if (sensor_data->cliff_right_signal > 800 && sensor_data->cliff_right_signal < 950)
-			{
-				turn_clockwise(sensor_data, 55);
-				int sum = 0;
-				oi_set_wheels(100, 100); // move forward; full speed
-				while (sum < 150) {
-					oi_update(sensor_data);
-					sum += sensor_data->distance;
-				}
-				oi_set_wheels(0, 0); // stop
-				play_song();
-				break;
-			} else if (sensor_data->cliff_frontleft_signal > 1000 && sensor_data->cliff_frontleft_signal < 1420)
-			{
-				turn_counterclockwise(sensor_data, 20);
-				int sum = 0;
-				oi_set_wheels(100, 100); // move forward; full speed
-				while (sum < 150) {
-					oi_update(sensor_data);
-					sum += sensor_data->distance;
-				}
-				oi_set_wheels(0, 0); // stop
-				play_song();
-				break;
-			} else if (sensor_data->cliff_frontright_signal > 300 && sensor_data->cliff_frontleft_signal < 400)
-			{
-				turn_clockwise(sensor_data, 20);
-				int sum = 0;
-				oi_set_wheels(100, 100); // move forward; full speed
-				while (sum < 150) {
-					oi_update(sensor_data);
-					sum += sensor_data->distance;
-				}
-				oi_set_wheels(0, 0); // stop
-				play_song();
-				break;
-			}
-		} 
-
-		//move forward 
-		else if (comm == 'w')
-		{
-			move_forward(sensor_data, 200);
-
-			//check for tape
-			if (sensor_data->cliff_left_signal > 500 && sensor_data->cliff_left_signal < 650)
-			{
-				turn_counterclockwise(sensor_data, 55);
-				int sum = 0;
-				oi_set_wheels(100, 100); // move forward; full speed
-				while (sum < 150) {
-					oi_update(sensor_data);
-					sum += sensor_data->distance;
-				}
-				oi_set_wheels(0, 0); // stop
-				play_song();
-				break;
-			} else if (sensor_data->cliff_right_signal > 800 && sensor_data->cliff_right_signal < 950)
-			{
-				turn_clockwise(sensor_data, 55);
-				int sum = 0;
-				oi_set_wheels(100, 100); // move forward; full speed
-				while (sum < 150) {
-					oi_update(sensor_data);
-					sum += sensor_data->distance;
-				}
-				oi_set_wheels(0, 0); // stop
-				play_song();
-				break;
-			} else if (sensor_data->cliff_frontleft_signal > 1000 && sensor_data->cliff_frontleft_signal < 1420)
-			{
-				turn_counterclockwise(sensor_data, 20);
-				int sum = 0;
-				oi_set_wheels(100, 100); // move forward; full speed
-				while (sum < 150) {
-					oi_update(sensor_data);
-					sum += sensor_data->distance;
-				}
-				oi_set_wheels(0, 0); // stop
-				play_song();
-				break;
-			} else if (sensor_data->cliff_frontright_signal > 300 && sensor_data->cliff_frontleft_signal < 400)
-			{
-				turn_clockwise(sensor_data, 20);
-				int sum = 0;
-				oi_set_wheels(100, 100); // move forward; full speed
-				while (sum < 150) {
-					oi_update(sensor_data);
-					sum += sensor_data->distance;
-				}
-				oi_set_wheels(0, 0); // stop
-				play_song();
-				break;
-			}
-		}
-	       
-		//move forward fast
-		else if (comm == 'e')
-		{
-			move_forward(sensor_data, 300);
-
-			//check for tape
-			if (sensor_data->cliff_left_signal > 500 && sensor_data->cliff_left_signal < 650)
-			{
-				turn_counterclockwise(sensor_data, 55);
-				int sum = 0;
-				oi_set_wheels(100, 100); // move forward; full speed
-				while (sum < 150) {
-					oi_update(sensor_data);
-					sum += sensor_data->distance;
-				}
-				oi_set_wheels(0, 0); // stop
-				play_song();
-				break;
-			} else if (sensor_data->cliff_right_signal > 800 && sensor_data->cliff_right_signal < 950)
-			{
-				turn_clockwise(sensor_data, 55);
-				int sum = 0;
-				oi_set_wheels(100, 100); // move forward; full speed
-				while (sum < 150) {
-					oi_update(sensor_data);
-					sum += sensor_data->distance;
-				}
-				oi_set_wheels(0, 0); // stop
-				play_song();
-				break;
-			} else if (sensor_data->cliff_frontleft_signal > 1000 && sensor_data->cliff_frontleft_signal < 1420)
-			{
-				turn_counterclockwise(sensor_data, 20);
-				int sum = 0;
-				oi_set_wheels(100, 100); // move forward; full speed
-				while (sum < 150) {
-					oi_update(sensor_data);
-					sum += sensor_data->distance;
-				}
-				oi_set_wheels(0, 0); // stop
-				play_song();
-				break;
-			} else if (sensor_data->cliff_frontright_signal > 300 && sensor_data->cliff_frontleft_signal < 400)
-			{
-				turn_clockwise(sensor_data, 20);
-				int sum = 0;
-				oi_set_wheels(100, 100); // move forward; full speed
-				while (sum < 150) {
-					oi_update(sensor_data);
-					sum += sensor_data->distance;
-				}
-				oi_set_wheels(0, 0); // stop
-				play_song();
-				break;
-			}
-
-		}
-		//move backward
-		else if (comm == 's')
-		{
-			move_backward(sensor_data, 100);
-		}
-		//turn counterclockwise
-	       	else if (comm == 'a')
-		{
-			turn_counterclockwise(sensor_data, 10);
-		}
-		//turn clockwise
-		else if (comm == 'd')
-		{
-			turn_clockwise(sensor_data, 10);
-		}
-		//turn counterclockwise
-	       	else if (comm == 'x')
-		{
-			turn_counterclockwise(sensor_data, 180);
-		}
-		//sweep measurement
-	       	else if (comm == 'g')
-		{
-			sweep();
-		}
-		//transmit current state of all robot sensors
-	       	else if (comm == 'r')
-		{
-			read(sensor_data);
-		}
-		//menuever around bumper counterclockwise
-	       	else if (comm == '1')
-		{
-			int con = 0;
-			turn_counterclockwise(sensor_data, 90);
-			con = move_forward(sensor_data, 250);
-			if (!con)
-			{
-				turn_clockwise(sensor_data, 50);
-				con = move_forward(sensor_data, 250);
-				if (!con)
-				{
-					turn_clockwise(sensor_data, 40);
-					move_forward(sensor_data, 200);
-				}
-			}
-		}
-		//menuever around bumper clockwise
-		else if (comm == '2')
-		{
-			int con = 0;
-			turn_clockwise(sensor_data, 90);
-			con = move_forward(sensor_data, 250);
-			if (!con)
-			{
-				turn_counterclockwise(sensor_data, 50);
-				con = move_forward(sensor_data, 250);
-				if (!con)
-				{
-					turn_counterclockwise(sensor_data, 40);
-					move_forward(sensor_data, 200);
-				}
-			}
-		}
-	       //turn counterclockwise
-		else if (comm == 'z')
-		{
-			turn_counterclockwise(sensor_data, 5);
-		} 
-		//turn clockwise
-		else if (comm == 'c')
-		{
-			turn_clockwise(sensor_data, 5);
-		}
-		
-		//free the sensor data memory space 
-		oi_free(sensor_data);
-
-		wait_ms(100);
-    }
-}
+/**
+*	@file Auto.c
+*	@brief this is the main c file that controls the robot. 
+*	@author Yuxiang Chen
+*	@date 4/12/2015
+*/ 
+
+
+#include <stdint.h>
+#include "hal.h"
+#include "fixmath.h"
+#include "open_interface.h"
+#include "util.h"
+#include "movement.h"
+#include "detour.h"
+#include "destination.h"
+#include "calibrate.h"
+#include "timebase.h"
+
+#include "music.h"
+#include "recorder.h"
+#include "feed.h"
+#include "sweepblock.h"
+#include "thresholds.h"
+#include "params.h"
+#include "profile.h"
+
+HAL_LOCAL q16_t IR_dist;			//distance measured using IR sensor in centimeters
+HAL_LOCAL volatile int rise;		//rising edge of received sonar pulse
+HAL_LOCAL volatile int fall;		//falling edge of received sonar pulse 
+HAL_LOCAL volatile unsigned int delta;	//difference in between rising and falling edge of received sonar pulse
+HAL_LOCAL volatile q16_t distance;	//stores measured sonar distances in centimeters
+HAL_LOCAL volatile int overflow;		//stores the overflow
+HAL_LOCAL volatile char finish = 0;	//is set to 1 when sonar is done measuring 
+HAL_LOCAL struct objects myObject[MAX_OBJECTS];	//array that contaings the data for each object 
+HAL_LOCAL int index = 0;			//variable to keep track of the current index 
+HAL_LOCAL char binary_sweeps = 0;		//send the sweep table as blocks (sweepblock.h) instead of text
+	
+
+
+
+
+///interrupt occurs when the rising edge of a pulse on the IC pin is detected
+ISR (TIMER1_CAPT_vect){
+	if (hal_sonar_rising())
+	{
+		rise = hal_sonar_capture();
+		hal_sonar_edge(0);
+		} else{
+		fall = hal_sonar_capture();
+		hal_sonar_edge(1);
+		delta = (uint16_t) (fall - rise);	//calculate clock ticks; the 16-bit counter may wrap in between
+		//34 cm/ms * 0.0005 ms per tick / 2 - 30 = 0.0085 cm per tick - 30, 0.0085 being 557.056 in Q16; 30 is params.sonar_offset
+		distance = (int32_t) delta * 557 + (int32_t) delta * 7 / 125 - params.sonar_offset;
+		finish = 1;				
+	}
+}
+
+
+///This interrupt occurs when an overflow is detected 
+ISR(TIMER1_OVF_vect){
+	overflow++;
+}
+
+
+/**
+ *	This function uses the servo to sweep from 0 to 180
+ *	degrees and measure the distance seen by the IR and 
+ *	Sonar sensors for each degree. 
+ *	@author Yuixiang Chen
+ *	@date 4/12/2015  
+ */
+
+void sweep()
+{
+
+	//initializations 
+	USART_Init(34);
+	servo_init();
+	sonar_init();
+	IR_init();
+	move_servo(0);
+	wait_ms(1000);
+	
+
+	q16_t lastDistance = 0;			//distance measured at the previous degree
+	q16_t currentDistance = 0;		//distance measured at the current degree
+	int startDegree = 0;			//degree when object is first detected
+	int endDegree = 0;			//the last degree that the object was detected
+	q16_t distances[91];			//array that holds distance data for every other degree, 0 to 180
+	q16_t near = q16_from_int(thresholds.ir.lo);	//IR distances an object can be seen at
+	q16_t far = q16_from_int(thresholds.ir.hi);
+	index = 0;
+	struct sweep_block block;		//samples not sent yet, in binary
+	
+	if (binary_sweeps)
+	{
+		sweep_block_begin(&block, USART_Transmit);
+	}
+	else
+	{
+		uprintf("Degrees\t\tIR Distance (cm)\t\tSonar Distance (cm)\n\r");
+	}
+	
+	//loop through each degree
+	for (int i = 0; i <= 180 && !abort_requested(); i++)
+	{
+		servo_wait();
+		IR_dist = IR_read();		
+		finish = 0;
+		prof_enter(PROF_SONAR_ECHO);
+		send_pulse();
+		uint32_t sent = timebase_ms();
+		while(!finish && timebase_ms() - sent < (uint32_t) params.sonar_timeout_ms)	//an echo from 3 m takes 20 ms
+			hal_idle();
+		if (!finish)
+		{
+			hal_sonar_edge(1);	//no echo; wait for the next one to rise
+			delta = 0;
+			distance = SONAR_NO_ECHO;
+		}
+		prof_exit();
+		rec_sweep(i, q16_to_int(q16_mul(IR_dist, Q16(100))), delta);
+		if (i < 180)
+		{
+			move_servo(i + 1);	//turns while this degree is transmitted
+		}
+		if (binary_sweeps)
+		{
+			sweep_block_add(&block, i, q16_hundredths(IR_dist), q16_hundredths(distance));
+		}
+		else
+		{
+			uprintf("%d\t\t%q\t\t\t\t%q\n\r", i, IR_dist, distance);
+		}
+		
+		lastDistance = currentDistance;
+		currentDistance = IR_dist;
+		distances[i/2] = currentDistance;
+		
+		//first detect the object
+		if ((lastDistance < near || lastDistance > far) && currentDistance < far && currentDistance > near)
+		{
+			startDegree = i;
+		}
+
+		//detect end of object
+		if (lastDistance > near && lastDistance < far && (currentDistance > far || currentDistance < near) && index < MAX_OBJECTS)
+		{
+			//fill myObject with the objects data
+			endDegree = i;
+			myObject[index].degrees = (endDegree + startDegree)/2;
+			myObject[index].sonar = distance;
+			myObject[index].ir = distances[myObject[index].degrees/2];
+			myObject[index].index = index;
+			myObject[index].dwidth = endDegree - startDegree;
+			//without an echo the width is worked out at the IR distance
+			q16_t range = distance != SONAR_NO_ECHO ? distance : myObject[index].ir;
+			myObject[index].width = q16_mul(2 * range, q16_tan(q16_from_int(myObject[index].dwidth) / 2));
+			index++;
+		}
+	}
+	
+	if (binary_sweeps)
+	{
+		sweep_block_end(&block);
+	}
+
+	//remember where we were so the objects can be found again after moving
+	detour_mark_sweep();
+
+	//transmit data obtained from the sweep
+	for (int i = 0; i < index; i++)
+	{
+		uprintf("Index: %d\n\rDegree: %d\n\rWidth: %q\n\rSonar Distance: %q\n\rIR distance: %q\n\r\n\r",myObject[i].index,myObject[i].degrees,myObject[i].width, myObject[i].sonar, myObject[i].ir);
+	}
+}
+
+/**
+ *	This function updates and transmits the current state of all robot sensors.
+ *	@author Yuixiang Chen
+ *	@date 4/12/2015
+ *	@param sensor_data 	memory space for the sensor data to be held 
+ */
+
+void read_sensors(oi_t *sensor_data){
+	oi_update(sensor_data);
+
+	uprintf("Bump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor_data->bumper_left, sensor_data->bumper_right, sensor_data->cliff_left, sensor_data->cliff_frontleft, sensor_data->cliff_frontright, sensor_data->cliff_right, sensor_data->cliff_left_signal, sensor_data->cliff_frontleft_signal, sensor_data->cliff_frontright_signal, sensor_data->cliff_right_signal);
+}
+
+/**
+ *	This is the main functiom. It calls functions and allows us 
+ *	to communicate with the robot
+ *	@author Yuixiang Chen 
+ *	@date 4/12/2015
+ */
+
+int main(void)
+{
+	//initializations
+	params_load();
+	USART_Init(34);
+
+	
+    while(1)
+    {
+		oi_t *sensor_data = oi_alloc();
+		oi_init(sensor_data);
+		music_init();					//uploads the songs the first time only
+		
+		//the sensor feed, when it is on, says the same and more
+		if (!feed_on())
+		{
+			uprintf("Bump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor_data->bumper_left, sensor_data->bumper_right, sensor_data->cliff_left, sensor_data->cliff_frontleft, sensor_data->cliff_frontright, sensor_data->cliff_right, sensor_data->cliff_left_signal, sensor_data->cliff_frontleft_signal, sensor_data->cliff_frontright_signal, sensor_data->cliff_right_signal);
+		}
+		
+		abort_clear();					//report how quickly a stopped motion halted
+
+		//keep the sensor feed going while waiting for a command
+		while (feed_on() && !USART_Available())
+		{
+			USART_Poll();
+			oi_update(sensor_data);
+		}
+		unsigned char comm = USART_Receive();		//character that represents a remote control command 
+		prof_command_begin(comm);
+
+		//move forward slowly
+		if (comm == 'q')
+		{
+			move_forward(sensor_data, 100);
+
+			//check for the destination
+			int edge = destination_edge(sensor_data);
+			if (edge != DEST_NONE && approach_destination(sensor_data, edge))
+			{
+				break;
+			}
+		} 
+
+		//move forward 
+		else if (comm == 'w')
+		{
+			move_forward(sensor_data, 200);
+
+			//check for the destination
+			int edge = destination_edge(sensor_data);
+			if (edge != DEST_NONE && approach_destination(sensor_data, edge))
+			{
+				break;
+			}
+		}
+	       
+		//move forward fast
+		else if (comm == 'e')
+		{
+			move_forward(sensor_data, 300);
+
+			//check for the destination
+			int edge = destination_edge(sensor_data);
+			if (edge != DEST_NONE && approach_destination(sensor_data, edge))
+			{
+				break;
+			}
+		}
+		//find the destination on our own
+		else if (comm == 'f')
+		{
+			if (seek_destination(sensor_data) != DEST_NONE)
+			{
+				break;
+			}
+		}
+		//move backward
+		else if (comm == 's')
+		{
+			move_backward(sensor_data, 100);
+		}
+		//turn counterclockwise
+	       	else if (comm == 'a')
+		{
+			turn_counterclockwise(sensor_data, 10);
+		}
+		//turn clockwise
+		else if (comm == 'd')
+		{
+			turn_clockwise(sensor_data, 10);
+		}
+		//turn counterclockwise
+	       	else if (comm == 'x')
+		{
+			turn_counterclockwise(sensor_data, 180);
+		}
+		//sweep measurement
+	       	else if (comm == 'g')
+		{
+			sweep();
+		}
+		//transmit current state of all robot sensors
+	       	else if (comm == 'r')
+		{
+			read_sensors(sensor_data);
+		}
+		//calibrate moves and turns against odometry
+		else if (comm == 'k')
+		{
+			calibrate(sensor_data);
+		}
+		//forget the calibration and go back to the hand-tuned scaling
+		else if (comm == 'K')
+		{
+			calibrate_reset();
+		}
+		//menuever around the obstacle on its left (counterclockwise)
+	       	else if (comm == '1')
+		{
+			if (detour(sensor_data, myObject, index, DETOUR_LEFT) == DETOUR_NO_PATH)
+			{
+				uprintf("\n\rDetour failed: obstacle too wide to pass on its left\n\r");
+			}
+		}
+		//menuever around the obstacle on its right (clockwise)
+		else if (comm == '2')
+		{
+			if (detour(sensor_data, myObject, index, DETOUR_RIGHT) == DETOUR_NO_PATH)
+			{
+				uprintf("\n\rDetour failed: obstacle too wide to pass on its right\n\r");
+			}
+		}
+		//menuever around the obstacle on whichever side is shorter
+		else if (comm == '3')
+		{
+			if (detour(sensor_data, myObject, index, DETOUR_AUTO) == DETOUR_NO_PATH)
+			{
+				uprintf("\n\rDetour failed: obstacle too wide to pass on either side\n\r");
+			}
+		}
+	       //turn counterclockwise
+		else if (comm == 'z')
+		{
+			turn_counterclockwise(sensor_data, 5);
+		} 
+		//turn clockwise
+		else if (comm == 'c')
+		{
+			turn_clockwise(sensor_data, 5);
+		}
+		//send the flight recorder
+		else if (comm == 'p')
+		{
+			rec_dump();
+		}
+		//keep the flight recorder in EEPROM, where it outlives a reset
+		else if (comm == 'v')
+		{
+			rec_save();
+		}
+		//send the flight recorder kept in EEPROM
+		else if (comm == 'P')
+		{
+			rec_dump_saved();
+		}
+		//read, set or list the tunable parameters
+		else if (comm == '#')
+		{
+			params_command();
+		}
+		//send sweep tables in binary or in text
+		else if (comm == 'b')
+		{
+			binary_sweeps = !binary_sweeps;
+			uprintf("Sweeps in %s\n\r", binary_sweeps ? "binary" : "text");
+		}
+		//turn the sensor feed on or off
+		else if (comm == 't')
+		{
+			feed_toggle();
+			uprintf("Sensor feed %s\n\r", feed_on() ? "on" : "off");
+		}
+		//turn the profiler on or off
+		else if (comm == 'o')
+		{
+			prof_toggle();
+			uprintf("Profiler %s\n\r", prof_on() ? "on" : "off");
+		}
+		prof_command_end();
+		
+		//free the sensor data memory space 
+		oi_free(sensor_data);
+
+		wait_ms(100);
+    }
+
+	prof_command_end();		//of the command that reached the destination
+
+	//let the celebration finish before the program ends
+	music_wait();
+	return 0;
+}
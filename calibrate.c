@@ -0,0 +1,277 @@
+/**
+ *	@file calibrate.c
+ *	@brief this file contains the functions that measure how far the robot
+ *	really moves and turns and compensate the motion commands for it
+ *
+ *	The wheels keep going for a while after they are told to stop, and how far
+ *	depends on the speed, the direction, the floor and the battery. For each
+ *	motion and speed the calibration stops the wheels at two odometry targets,
+ *	keeps reading odometry until the robot has settled and fits the straight
+ *	line  moved = a * target + b. The table stores its inverse so that
+ *	target = gain * wanted / 1024 + offset ends the motion with the wanted
+ *	odometry.
+ *
+ *	The fit measures odometry against odometry, so it only sees the coasting
+ *	and cannot see how far the odometry itself is off: the lab Creates report
+ *	about 0.6 degree for every degree they turn. That scale was hand-tuned
+ *	and is still applied to the request before the table (CAL_TURN_SCALE);
+ *	correcting it needs a reference outside the robot.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include "hal.h"
+#include "open_interface.h"
+#include "util.h"
+#include "calibrate.h"
+
+/// marks a valid table in EEPROM; change it when the layout changes
+#define CAL_MAGIC	0xCA11
+
+/// short and long reference moves in millimeters
+#define CAL_DIST_SHORT	150
+#define CAL_DIST_LONG	450
+/// short and long reference turns in degrees
+#define CAL_ANGLE_SHORT	45
+#define CAL_ANGLE_LONG	135
+/// sensor updates read after stopping to catch the coasting
+#define CAL_SETTLE	4
+/// degrees of odometry per ten degrees turned, hand-tuned on the lab Creates
+#define CAL_TURN_SCALE	6
+
+/// one entry of a compensation table
+struct cal_entry{
+	int16_t gain;		//odometry target per requested unit, 1024 = 1.0
+	int16_t offset;		//added to the target, millimeters or degrees
+};
+
+/// compensation tables as stored in EEPROM
+struct cal_table{
+	uint16_t magic;
+	struct cal_entry entry[CAL_KINDS][CAL_SPEEDS];
+	uint8_t checksum;
+};
+
+/// wheel speeds of the table columns in mm/s
+static const int cal_speed[CAL_SPEEDS] = {100, 200, 300};
+
+static HAL_LOCAL struct cal_table EEMEM cal_eeprom;
+
+static HAL_LOCAL struct cal_table table;
+static HAL_LOCAL char loaded = 0;		//set once the EEPROM copy has been read
+static HAL_LOCAL char valid = 0;		//set when the table holds a calibration
+
+/**
+ *	This function computes the checksum of a table
+ */
+
+static uint8_t checksum(struct cal_table *t)
+{
+	uint8_t sum = 0;
+	uint8_t *p = (uint8_t *) t->entry;
+	for (unsigned int i = 0; i < sizeof(t->entry); i++)
+	{
+		sum = (sum << 1 | sum >> 7) ^ p[i];
+	}
+	return sum;
+}
+
+/**
+ *	This function reads the tables from EEPROM the first time they are needed
+ */
+
+static void load(void)
+{
+	if (loaded)
+	{
+		return;
+	}
+	hal_eeprom_read_block(&table, &cal_eeprom, sizeof(table));
+	valid = table.magic == CAL_MAGIC && table.checksum == checksum(&table);
+	loaded = 1;
+}
+
+/**
+ *	This function returns the table column closest to a wheel speed
+ */
+
+static int speed_index(int speed)
+{
+	int best = 0;
+	speed = abs(speed);
+	for (int i = 1; i < CAL_SPEEDS; i++)
+	{
+		if (abs(cal_speed[i] - speed) < abs(cal_speed[best] - speed))
+		{
+			best = i;
+		}
+	}
+	return best;
+}
+
+/**
+ *	This function converts a requested move or turn into the odometry target
+ *	@param kind	CAL_ code of the motion
+ *	@param speed	wheel speed in mm/s
+ *	@param amount	requested distance in millimeters or angle in degrees
+ *	@return odometry target in millimeters or degrees
+ */
+
+int motion_target(int kind, int speed, int amount)
+{
+	load();
+	if (!valid)
+	{
+		//hand-tuned scaling used before the robot could calibrate itself
+		if (kind == CAL_FORWARD)
+		{
+			return amount / 50 * 45;
+		}
+		else if (kind == CAL_BACKWARD)
+		{
+			return amount / 50 * 45 / 2;
+		}
+		else if (amount == 180)
+		{
+			return amount;
+		}
+		return (int) round((double) amount / 10 * CAL_TURN_SCALE);
+	}
+
+	//the table corrects for coasting only, so turns keep the hand-tuned scale
+	long wanted = kind <= CAL_BACKWARD ? amount : lround((double) amount / 10 * CAL_TURN_SCALE);
+	struct cal_entry *e = &table.entry[kind][speed_index(speed)];
+	long target = wanted * e->gain / 1024 + e->offset;
+	return target > 0 ? (int) target : 0;
+}
+
+/**
+ *	This function drives one reference motion with the wheels stopped at an
+ *	odometry target and returns how far the robot really went
+ *	@param sensor	structure that contains all the sensor data
+ *	@param kind	CAL_ code of the motion
+ *	@param speed	wheel speed in mm/s
+ *	@param target	odometry target in millimeters or degrees
+ *	@return distance or angle moved, including the coasting after the stop
+ */
+
+static int measure(oi_t *sensor, int kind, int speed, int target)
+{
+	int sum = 0;
+
+	if (kind == CAL_FORWARD)
+	{
+		oi_set_wheels(speed, speed);
+	}
+	else if (kind == CAL_BACKWARD)
+	{
+		oi_set_wheels(-speed, -speed);
+	}
+	else if (kind == CAL_CLOCKWISE)
+	{
+		oi_set_wheels(-speed, speed);
+	}
+	else
+	{
+		oi_set_wheels(speed, -speed);
+	}
+
+	oi_update(sensor);		//clear what moved before we started
+	while (abs(sum) < target && !abort_requested()) {
+		oi_update(sensor);
+		sum += kind <= CAL_BACKWARD ? sensor->distance : sensor->angle;
+	}
+	oi_set_wheels(0, 0); // stop
+
+	for (int i = 0; i < CAL_SETTLE; i++)
+	{
+		oi_update(sensor);
+		sum += kind <= CAL_BACKWARD ? sensor->distance : sensor->angle;
+	}
+	return abs(sum);
+}
+
+/**
+ *	This function runs the calibration and stores the tables in EEPROM
+ *	@param sensor	structure that contains all the sensor data
+ *	@return 1 if the new tables were stored, 0 if a fit failed or the operator stopped it
+ */
+
+int calibrate(oi_t *sensor)
+{
+	static const char *name[CAL_KINDS] = {"forward", "backward", "clockwise", "counterclockwise"};
+	struct cal_table fit;
+	int ok = 1;
+
+	for (int s = 0; s < CAL_SPEEDS; s++)
+	{
+		//every motion is followed by its opposite so the robot stays in place
+		for (int kind = 0; kind < CAL_KINDS; kind += 2)
+		{
+			int t1 = kind == CAL_FORWARD ? CAL_DIST_SHORT : CAL_ANGLE_SHORT;
+			int t2 = kind == CAL_FORWARD ? CAL_DIST_LONG : CAL_ANGLE_LONG;
+			int m1[2], m2[2];
+
+			for (int k = 0; k < 2; k++)
+			{
+				m1[k] = measure(sensor, kind + k, cal_speed[s], t1);
+			}
+			for (int k = 0; k < 2; k++)
+			{
+				m2[k] = measure(sensor, kind + k, cal_speed[s], t2);
+			}
+
+			if (abort_requested())
+			{
+				return 0;
+			}
+
+			for (int k = 0; k < 2; k++)
+			{
+				double a = (double) (m2[k] - m1[k]) / (t2 - t1);
+				double b = m1[k] - a * t1;
+				struct cal_entry *e = &fit.entry[kind + k][s];
+
+				if (a < 0.5 || a > 2.0)
+				{
+					ok = 0;
+					e->gain = 1024;
+					e->offset = 0;
+				}
+				else
+				{
+					e->gain = (int16_t) round(1024 / a);
+					e->offset = (int16_t) round(-b / a);
+				}
+				uprintf("Calibrate %s @%d: moved %d/%d and %d/%d -> gain %d offset %d\n\r",
+					name[kind + k], cal_speed[s], m1[k], t1, m2[k], t2, e->gain, e->offset);
+			}
+		}
+	}
+
+	if (!ok)
+	{
+		uprintf("Calibration failed, tables not changed\n\r");
+		return 0;
+	}
+
+	fit.magic = CAL_MAGIC;
+	fit.checksum = checksum(&fit);
+	hal_eeprom_update_block(&fit, &cal_eeprom, sizeof(fit));
+	table = fit;
+	loaded = 1;
+	valid = 1;
+	return 1;
+}
+
+/**
+ *	This function erases the stored tables
+ */
+
+void calibrate_reset(void)
+{
+	hal_eeprom_update_word(&cal_eeprom.magic, 0xFFFF);
+	loaded = 1;
+	valid = 0;
+}
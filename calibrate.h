@@ -0,0 +1,53 @@
+/**
+ *	@file calibrate.h
+ *	@brief this is the header file that contains the functions that
+ *	measure how far the robot really moves and turns and compensate
+ *	the motion commands for it
+ */
+
+#ifndef CALIBRATE_H
+#define CALIBRATE_H
+
+#include "open_interface.h"
+
+/// kinds of motion that are calibrated separately
+#define CAL_FORWARD		0
+#define CAL_BACKWARD		1
+#define CAL_CLOCKWISE		2
+#define CAL_COUNTERCLOCKWISE	3
+#define CAL_KINDS		4
+
+/// number of wheel speeds in the compensation tables
+#define CAL_SPEEDS		3
+
+/**
+ *	This function converts a requested move or turn into the odometry
+ *	target (millimeters or degrees) at which the wheels have to be stopped.
+ *	Without a stored calibration it uses the hand-tuned scaling the robot
+ *	has always used; with one, turns keep its hand-tuned odometry scale,
+ *	which the calibration cannot measure.
+ *	@param kind	CAL_ code of the motion
+ *	@param speed	wheel speed in mm/s
+ *	@param amount	requested distance in millimeters or angle in degrees
+ *	@return odometry target in millimeters or degrees
+ */
+
+int motion_target(int kind, int speed, int amount);
+
+/**
+ *	This function runs the calibration moves and turns at every table speed,
+ *	fits the compensation tables to the odometry and stores them in EEPROM.
+ *	The robot ends roughly where it started.
+ *	@param sensor	structure that contains all the sensor data
+ *	@return 1 if the new tables were stored, 0 if a fit failed or the operator stopped it
+ */
+
+int calibrate(oi_t *sensor);
+
+/**
+ *	This function erases the stored tables so the hand-tuned scaling is used again
+ */
+
+void calibrate_reset(void);
+
+#endif
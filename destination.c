@@ -0,0 +1,168 @@
+/**
+ *	@file destination.c
+ *	@brief this file contains the functions that recognise the destination
+ *	pad with the cliff sensors and drive onto it
+ */
+
+#include "open_interface.h"
+#include "util.h"
+#include "movement.h"
+#include "music.h"
+#include "destination.h"
+#include "thresholds.h"
+#include "params.h"
+
+/// total distance driven before the search gives up in mm
+#define SEEK_MAX_DIST	6000
+/// number of obstacles turned away from before the search gives up
+#define SEEK_MAX_TURNS	12
+/// degrees turned away from a bumper, cliff or tape
+#define SEEK_TURN	30
+/// distance driven onto the pad once it is lined up in mm
+#define DEST_ADVANCE	150
+
+/**
+ *	This function checks the cliff signals of the last sensor update
+ *	for the edge of the destination pad
+ *	@param sensor	structure that contains all the sensor data
+ *	@return the DEST_ code of the sensor that sees the pad, or DEST_NONE
+ */
+
+int destination_edge(oi_t *sensor)
+{
+	if (in_band(&thresholds.dest[SENSE_LEFT], sensor->cliff_left_signal))
+	{
+		return DEST_LEFT;
+	}
+	else if (in_band(&thresholds.dest[SENSE_RIGHT], sensor->cliff_right_signal))
+	{
+		return DEST_RIGHT;
+	}
+	else if (in_band(&thresholds.dest[SENSE_FRONTLEFT], sensor->cliff_frontleft_signal))
+	{
+		return DEST_FRONTLEFT;
+	}
+	else if (in_band(&thresholds.dest[SENSE_FRONTRIGHT], sensor->cliff_frontright_signal))
+	{
+		return DEST_FRONTRIGHT;
+	}
+	return DEST_NONE;
+}
+
+/**
+ *	This function lines the robot up with the destination pad, drives
+ *	150 mm onto it, stops and celebrates
+ *	@param sensor	structure that contains all the sensor data
+ *	@param edge	DEST_ code of the sensor that saw the pad
+ *	@return 1 once the robot is on the pad, 0 if the operator stopped it
+ */
+
+int approach_destination(oi_t *sensor, int edge)
+{
+
+	if (abort_requested())
+	{
+		return 0;
+	}
+
+	//turn toward the side that saw the pad
+	if (edge == DEST_LEFT)
+	{
+		turn_counterclockwise(sensor, 55);
+	}
+	else if (edge == DEST_RIGHT)
+	{
+		turn_clockwise(sensor, 55);
+	}
+	else if (edge == DEST_FRONTLEFT)
+	{
+		turn_counterclockwise(sensor, 20);
+	}
+	else if (edge == DEST_FRONTRIGHT)
+	{
+		turn_clockwise(sensor, 20);
+	}
+
+	int sum = 0;
+	oi_set_wheels(params.drive_speed, params.drive_speed); // move forward
+	while (sum < DEST_ADVANCE && !abort_requested()) {
+		oi_update(sensor);
+		sum += sensor->distance;
+		update_position(sensor);
+	}
+	oi_set_wheels(0, 0); // stop
+
+	if (abort_requested())
+	{
+		return 0;
+	}
+
+	uprintf("\n\rArrived at destination!\n\r");
+	play_song();
+	return 1;
+}
+
+/**
+ *	This function drives on its own until the destination pad is found.
+ *	@param sensor	structure that contains all the sensor data
+ *	@return the DEST_ code of the sensor that found the pad, or DEST_NONE if
+ *	the search gave up or the operator stopped it
+ */
+
+int seek_destination(oi_t *sensor)
+{
+	int driven = 0;
+
+	led_play(&led_searching);		//until the pad is found or the search ends
+	for (int turns = 0; turns <= SEEK_MAX_TURNS && driven < SEEK_MAX_DIST; turns++)
+	{
+		int condition = 0;
+
+		oi_set_wheels(params.seek_speed, params.seek_speed);
+		while (driven < SEEK_MAX_DIST) {
+			if (abort_requested())
+			{
+				oi_set_wheels(0, 0);
+				led_stop();
+				return DEST_NONE;
+			}
+			oi_update(sensor);
+			driven += sensor->distance;
+			update_position(sensor);
+
+			//look for the pad on every frame, before anything else can stop us
+			int edge = destination_edge(sensor);
+			if (edge != DEST_NONE)
+			{
+				oi_set_wheels(0, 0);
+				if (approach_destination(sensor, edge))
+				{
+					return edge;		//celebrating
+				}
+				led_stop();
+				return DEST_NONE;
+			}
+
+			condition = checkSensors(sensor);	//backs away from cliff, tape, bumper
+			if (condition)
+			{
+				break;
+			}
+		}
+		oi_set_wheels(0, 0);
+
+		//turn away from whatever stopped us and keep looking
+		if (condition == CONDITION_LEFT)
+		{
+			turn_clockwise(sensor, SEEK_TURN);
+		}
+		else if (condition == CONDITION_RIGHT)
+		{
+			turn_counterclockwise(sensor, SEEK_TURN);
+		}
+	}
+
+	uprintf("\n\rDestination not found\n\r");
+	led_stop();
+	return DEST_NONE;
+}
@@ -0,0 +1,54 @@
+/**
+ *	@file destination.h
+ *	@brief this is the header file that contains the functions that
+ *	recognise the destination pad with the cliff sensors and drive onto it
+ */
+
+#ifndef DESTINATION_H
+#define DESTINATION_H
+
+#include "open_interface.h"
+
+/// no cliff sensor sees the destination pad
+#define DEST_NONE		0
+/// the left cliff sensor sees the destination pad
+#define DEST_LEFT		1
+/// the right cliff sensor sees the destination pad
+#define DEST_RIGHT		2
+/// the front left cliff sensor sees the destination pad
+#define DEST_FRONTLEFT		3
+/// the front right cliff sensor sees the destination pad
+#define DEST_FRONTRIGHT		4
+
+/**
+ *	This function checks the cliff signals of the last sensor update
+ *	for the edge of the destination pad
+ *	@param sensor	structure that contains all the sensor data
+ *	@return the DEST_ code of the sensor that sees the pad, or DEST_NONE
+ */
+
+int destination_edge(oi_t *sensor);
+
+/**
+ *	This function lines the robot up with the destination pad, drives
+ *	150 mm onto it, stops and celebrates
+ *	@param sensor	structure that contains all the sensor data
+ *	@param edge	DEST_ code of the sensor that saw the pad
+ *	@return 1 once the robot is on the pad, 0 if the operator stopped it
+ */
+
+int approach_destination(oi_t *sensor, int edge);
+
+/**
+ *	This function drives on its own until the destination pad is found.
+ *	The cliff signals are checked on every sensor update while moving; when a
+ *	bumper, cliff or tape stops the robot it backs off, turns away from that
+ *	side and keeps looking.
+ *	@param sensor	structure that contains all the sensor data
+ *	@return the DEST_ code of the sensor that found the pad, or DEST_NONE if
+ *	the search gave up or the operator stopped it
+ */
+
+int seek_destination(oi_t *sensor);
+
+#endif
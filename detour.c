@@ -0,0 +1,299 @@
+/**
+ *	@file detour.c
+ *	@brief this file contains the functions that plan and drive a path
+ *	around an obstacle found by the last sweep
+ *
+ *	The servo points straight ahead at 90 degrees, to the right at 0 and to
+ *	the left at 180. Objects are moved from the frame of the sweep into the
+ *	current robot frame (x forward, y to the left, centimeters) using the
+ *	odometry kept in movement.c.
+ */
+
+#include <math.h>
+#include "open_interface.h"
+#include "util.h"
+#include "movement.h"
+#include "trajectory.h"
+#include "detour.h"
+#include "params.h"
+
+#define PI 3.1415926
+
+/// radius of the Create in centimeters
+#define ROBOT_RADIUS	17.0
+/// extra room left between the robot and an obstacle in centimeters
+#define DETOUR_MARGIN	8.0
+/// objects further ahead than this (centimeters) are not in the way
+#define DETOUR_LOOKAHEAD	120.0
+/// distance backed off when the robot is too close to steer around (millimeters)
+#define DETOUR_BACKOFF	200
+/// steepest turn allowed for a leg of the detour in degrees
+#define DETOUR_MAX_TURN	80.0
+/// radius of the arc that rounds the corner beside the obstacle in centimeters
+#define DETOUR_ARC_RADIUS	15.0
+
+/// obstacle assumed right in front of the robot when the sweep has nothing better
+#define DEFAULT_RANGE	30.0
+#define DEFAULT_WIDTH	20.0
+
+/// robot pose when the last sweep was taken
+static HAL_LOCAL int sweep_x = 0;
+static HAL_LOCAL int sweep_y = 0;
+static HAL_LOCAL int sweep_angle = 0;
+
+/// one candidate path around an obstacle
+struct detour_path{
+	double turn;		//first turn in degrees, counterclockwise positive
+	double leg;		//length of each of the two legs in centimeters
+	double radius;		//radius of the arc that rounds the corner beside the obstacle
+	int blocked;		//set when another object lies on the path
+};
+
+/**
+ *	This function remembers the pose of the robot at the time of a sweep.
+ */
+
+void detour_mark_sweep(void)
+{
+	sweep_x = x;
+	sweep_y = y;
+	sweep_angle = movedangle;
+}
+
+/**
+ *	This function places an object of the last sweep in the current robot frame
+ *	@param obj	object seen by the sweep
+ *	@param fwd	distance ahead of the robot in centimeters
+ *	@param left	distance to the left of the robot in centimeters
+ */
+
+static void locate(struct objects *obj, double *fwd, double *left)
+{
+	//the sensors see the near face; the centre is half a width further on
+	double range = q16_to_double(obj->sonar > 0 ? obj->sonar : obj->ir) + q16_to_double(obj->width) / 2;
+	double bearing = (obj->degrees - 90) * PI / 180.0;
+	double heading = sweep_angle * PI / 180.0;
+
+	//object position in the world frame (centimeters)
+	double fs = range * cos(bearing);
+	double ls = range * sin(bearing);
+	double wx = sweep_x / 10.0 + fs * cos(heading) - ls * sin(heading);
+	double wy = sweep_y / 10.0 + fs * sin(heading) + ls * cos(heading);
+
+	//back into the frame of the robot as it is now
+	double dx = wx - x / 10.0;
+	double dy = wy - y / 10.0;
+	heading = movedangle * PI / 180.0;
+	*fwd = dx * cos(heading) + dy * sin(heading);
+	*left = -dx * sin(heading) + dy * cos(heading);
+}
+
+/**
+ *	This function returns the clearance needed between the robot's centre and
+ *	the centre of an object
+ *	@param obj	object seen by the sweep
+ */
+
+static double clearance(struct objects *obj)
+{
+	return q16_to_double(obj->width) / 2 + ROBOT_RADIUS + DETOUR_MARGIN;
+}
+
+/**
+ *	This function returns the distance from a point to a line segment
+ */
+
+static double segment_distance(double px, double py, double ax, double ay, double bx, double by)
+{
+	double dx = bx - ax;
+	double dy = by - ay;
+	double len = dx * dx + dy * dy;
+	double t = len > 0 ? ((px - ax) * dx + (py - ay) * dy) / len : 0;
+	if (t < 0) t = 0;
+	if (t > 1) t = 1;
+	return hypot(px - ax - t * dx, py - ay - t * dy);
+}
+
+/**
+ *	This function computes the tangent path around an obstacle on one side
+ *	and checks it against every other object of the sweep
+ *	@param fwd	distance ahead to the obstacle in centimeters
+ *	@param left	distance left to the obstacle in centimeters
+ *	@param clear	clearance needed around the obstacle in centimeters
+ *	@param dir	1 to pass on the left, -1 to pass on the right
+ *	@param obj	objects found by the last sweep
+ *	@param count	number of objects in obj
+ *	@param skip	index of the obstacle itself, or -1
+ *	@return the planned path; leg is 0 if no path exists on that side
+ */
+
+static struct detour_path plan(double fwd, double left, double clear, int dir,
+		struct objects *obj, int count, int skip)
+{
+	struct detour_path path = {0, 0, 0, 0};
+	double range = hypot(fwd, left);
+	double turn = 0;
+	double radius = DETOUR_ARC_RADIUS;
+	int fits = 0;
+
+	//the arc beside the obstacle cuts the corner, so aim that much wider;
+	//close to the obstacle that is too wide, so tighten the arc until it
+	//fits, down to a turn in place
+	while (!fits)
+	{
+		double extra = 0;
+		fits = 1;
+		for (int i = 0; i < 3 && fits; i++)
+		{
+			if (clear + extra >= range)
+			{
+				fits = 0;
+				break;
+			}
+			turn = atan2(left, fwd) + dir * asin((clear + extra) / range);
+			if (fabs(turn) * 180.0 / PI > DETOUR_MAX_TURN)
+			{
+				fits = 0;
+				break;
+			}
+			extra = radius * (1 / cos(turn) - 1);
+		}
+		if (!fits)
+		{
+			if (radius == 0)
+			{
+				return path;
+			}
+			radius = radius < 2 ? 0 : radius / 2;
+		}
+	}
+	path.turn = turn * 180.0 / PI;
+	path.leg = fwd / cos(turn);
+
+	//the arc can be no longer than the legs it joins
+	if (radius * fabs(tan(turn)) > path.leg)
+	{
+		radius = path.leg / fabs(tan(turn));
+	}
+	path.radius = radius;
+
+	//make sure the two legs do not run into anything else we have seen
+	double side = fwd * tan(turn);
+	for (int i = 0; i < count; i++)
+	{
+		double f, l;
+		if (i == skip)
+		{
+			continue;
+		}
+		locate(&obj[i], &f, &l);
+		if (segment_distance(f, l, 0, 0, fwd, side) < clearance(&obj[i]) ||
+				segment_distance(f, l, fwd, side, 2 * fwd, 0) < clearance(&obj[i]))
+		{
+			path.blocked = 1;
+		}
+	}
+	return path;
+}
+
+/**
+ *	This function drives around the obstacle closest to the robot's path.
+ *	@param sensor	structure that contains all the sensor data
+ *	@param obj	objects found by the last sweep
+ *	@param count	number of objects in obj
+ *	@param side	DETOUR_LEFT, DETOUR_RIGHT or DETOUR_AUTO
+ *	@return DETOUR_DONE, DETOUR_INTERRUPTED or DETOUR_NO_PATH
+ */
+
+int detour(oi_t *sensor, struct objects *obj, int count, int side)
+{
+	struct detour_path left, right, *path;
+	double fwd = 0, lat = 0, clear = 0;
+	int target = -1;
+
+	for (int tries = 0; tries < 3; tries++)
+	{
+		//find the closest object that is in the way
+		target = -1;
+		for (int i = 0; i < count; i++)
+		{
+			double f, l;
+			locate(&obj[i], &f, &l);
+			if (f > 0 && f < DETOUR_LOOKAHEAD && fabs(l) < clearance(&obj[i]) &&
+					(target < 0 || f < fwd))
+			{
+				target = i;
+				fwd = f;
+				lat = l;
+				clear = clearance(&obj[i]);
+			}
+		}
+		if (target < 0)
+		{
+			uprintf("\n\rDetour: no object of the last sweep is in the way, assuming one ahead\n\r");
+			fwd = DEFAULT_RANGE + ROBOT_RADIUS;
+			lat = 0;
+			clear = DEFAULT_WIDTH / 2 + ROBOT_RADIUS + DETOUR_MARGIN;
+			break;
+		}
+
+		//too close to steer around it; back away and look again
+		if (clear < hypot(fwd, lat) * sin(DETOUR_MAX_TURN * PI / 180.0))
+		{
+			break;
+		}
+		move_backward(sensor, DETOUR_BACKOFF);
+	}
+
+	left = plan(fwd, lat, clear, 1, obj, count, target);
+	right = plan(fwd, lat, clear, -1, obj, count, target);
+
+	if (side == DETOUR_LEFT)
+	{
+		path = &left;
+	}
+	else if (side == DETOUR_RIGHT)
+	{
+		path = &right;
+	}
+	else if (left.leg == 0 || (right.leg != 0 && (left.blocked > right.blocked ||
+			(left.blocked == right.blocked && right.leg < left.leg))))
+	{
+		path = &right;
+	}
+	else
+	{
+		path = &left;
+	}
+
+	if (path->leg == 0)
+	{
+		return DETOUR_NO_PATH;
+	}
+
+	uprintf("\n\rDetour: %s  turn %d  legs %d cm%s\n\r",
+		path == &left ? "left" : "right", (int) round(path->turn),
+		(int) round(path->leg), path->blocked ? "  (path crosses another object!)" : "");
+
+	//turn off the line, pass the obstacle, turn back and rejoin the original
+	//heading, all as one continuous motion
+	int turn = (int) round(path->turn);
+	int leg = (int) round((path->leg - path->radius * fabs(tan(path->turn * PI / 180.0))) * 10);
+	int arc = (int) round(path->radius * 10);
+	if (arc <= TRAJ_SPIN)
+	{
+		arc = TRAJ_SPIN;
+	}
+	struct segment route[] = {
+		SEG_TURN(turn),
+		SEG_LINE(leg),
+		SEG_ARC(arc, -2 * turn),
+		SEG_LINE(leg),
+		SEG_TURN(turn),
+	};
+	if (follow_trajectory(sensor, route, sizeof(route) / sizeof(route[0]), params.detour_speed))
+	{
+		return DETOUR_INTERRUPTED;
+	}
+	return DETOUR_DONE;
+}
@@ -0,0 +1,66 @@
+/**
+ *	@file detour.h
+ *	@brief this is the header file that contains the functions that
+ *	plan and drive a path around an obstacle found by the last sweep
+ */
+
+#ifndef DETOUR_H
+#define DETOUR_H
+
+#include "fixmath.h"
+#include "open_interface.h"
+
+/// maximum number of objects recorded by one sweep
+#define MAX_OBJECTS 10
+
+/// pass the obstacle on its left side (counterclockwise first)
+#define DETOUR_LEFT	1
+/// pass the obstacle on its right side (clockwise first)
+#define DETOUR_RIGHT	2
+/// pick whichever side gives the shorter clear path
+#define DETOUR_AUTO	0
+
+/// detour() drove the whole path
+#define DETOUR_DONE		0
+/// a cliff, tape, or bumper interrupted the detour
+#define DETOUR_INTERRUPTED	1
+/// no path clears the obstacle on the side asked for; the robot did not move
+#define DETOUR_NO_PATH		-1
+
+/// sonar distance of a sample whose echo never came back
+#define SONAR_NO_ECHO	0
+
+///structure for recording the characteristics of each object seen
+struct objects{
+	int degrees;		//the degree the object was seen at
+	int dwidth;		//the width of the object in degrees
+	q16_t sonar;		//distance from robot measured useing sonar pulse, SONAR_NO_ECHO if there was no echo
+	int index;		//how many objects were seen before it
+	q16_t width;		//width in centimeters
+	q16_t ir;		//distance from robot measured with IR sensor
+};
+
+/**
+ *	This function remembers the pose of the robot at the time of a sweep so
+ *	that the objects it found can be located again after the robot has moved.
+ */
+
+void detour_mark_sweep(void);
+
+/**
+ *	This function drives around the obstacle closest to the robot's path.
+ *	It places every object of the last sweep in the current robot frame,
+ *	computes the two tangent paths that keep the robot clear of the nearest
+ *	blocking object and drives the shorter (or the requested) one as a
+ *	turn, leg, arc, leg, turn trajectory that ends back on the original
+ *	heading without stopping in between.
+ *	@param sensor	structure that contains all the sensor data
+ *	@param obj	objects found by the last sweep
+ *	@param count	number of objects in obj
+ *	@param side	DETOUR_LEFT, DETOUR_RIGHT or DETOUR_AUTO
+ *	@return DETOUR_DONE, DETOUR_INTERRUPTED or DETOUR_NO_PATH
+ */
+
+int detour(oi_t *sensor, struct objects *obj, int count, int side);
+
+#endif
@@ -0,0 +1,81 @@
+/**
+ *	@file feed.c
+ *	@brief the sensor feed; see feed.h
+ */
+
+#include <string.h>
+#include "hal.h"
+#include "util.h"
+#include "timebase.h"
+#include "recorder.h"
+#include "link.h"
+#include "feed.h"
+
+static HAL_LOCAL char on;
+static HAL_LOCAL unsigned char last_frame[REC_FRAME_BYTES];
+static HAL_LOCAL unsigned char frames;		// frames since the last keyframe
+static HAL_LOCAL unsigned char seq;		// of the next frame
+static HAL_LOCAL uint32_t last_time;		// timebase_ms() of the last frame
+
+/**
+ *	Turns the feed on or off
+ */
+
+void feed_toggle(void)
+{
+	on = !on;
+	frames = FEED_KEY_EVERY;	//the next frame is a keyframe
+}
+
+/**
+ *	Tells whether the feed is on
+ */
+
+char feed_on(void)
+{
+	return on;
+}
+
+/**
+ *	Sends a sensor frame
+ */
+
+void feed_frame(const unsigned char *frame)
+{
+	static HAL_LOCAL unsigned char payload[4 + REC_CODED_MAX];
+	static const unsigned char zeros[REC_FRAME_BYTES];
+
+	if (!on)
+	{
+		return;
+	}
+	uint32_t now = timebase_ms();
+	unsigned char length = 0;
+	unsigned char type;
+	if (frames >= FEED_KEY_EVERY || now - last_time >= 0x10000)	//keeps the time of a delta frame to 3 bytes
+	{
+		type = LINK_KEYFRAME;
+		for (unsigned char i = 0; i < 4; i++)
+		{
+			payload[length++] = now >> (i * 8);	//low byte first
+		}
+		length += rec_encode_frame(zeros, frame, payload + length);
+		frames = 0;
+	}
+	else
+	{
+		type = LINK_SENSORS;
+		uint32_t dt = now - last_time;
+		while (dt >= 0x80)
+		{
+			payload[length++] = (dt & 0x7F) | 0x80;
+			dt >>= 7;
+		}
+		payload[length++] = dt;
+		length += rec_encode_frame(last_frame, frame, payload + length);
+		frames++;
+	}
+	memcpy(last_frame, frame, REC_FRAME_BYTES);
+	last_time = now;
+	link_send(USART_Transmit, type, seq++, payload, length);
+}
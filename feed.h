@@ -0,0 +1,50 @@
+/**
+ *	@file feed.h
+ *	@brief the sensor feed, which sends every sensor frame to the base
+ *	station as it comes from the Create, coded as its changes from the
+ *	frame before
+ *
+ *	The feed is off until feed_toggle() turns it on. Every frame oi_update()
+ *	reads then goes out as a link frame (see link.h):
+ *
+ *	LINK_KEYFRAME	absolute time in ms (4 bytes, low first), then the
+ *			sensor frame coded against a frame of zeros
+ *	LINK_SENSORS	milliseconds since the frame before, 7 bits per byte,
+ *			low bits first, the top bit set on every byte but the
+ *			last, then the sensor frame coded against the frame
+ *			before (see rec_encode_frame())
+ *
+ *	The seq of both counts the frames of the feed, so the base station
+ *	sees when one was lost; it then waits for the next keyframe, which
+ *	comes every FEED_KEY_EVERY frames, and when the feed is turned on.
+ *	While the robot drives a frame takes about 16 bytes with its framing,
+ *	against the 250 bytes of the text of read_sensors().
+ */
+
+#ifndef FEED_H
+#define FEED_H
+
+/// a keyframe after this many delta frames
+#define FEED_KEY_EVERY	32
+
+/**
+ *	This function turns the feed on or off; it starts with a keyframe
+ */
+
+void feed_toggle(void);
+
+/**
+ *	This function tells whether the feed is on
+ *	@return 1 if it is on, 0 if not
+ */
+
+char feed_on(void);
+
+/**
+ *	This function sends a sensor frame, if the feed is on
+ *	@param frame	the 52 bytes of packet group 6, as they came from the Create
+ */
+
+void feed_frame(const unsigned char *frame);
+
+#endif
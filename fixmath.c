@@ -0,0 +1,365 @@
+/**
+ *	@file fixmath.c
+ *	@brief fixed-point arithmetic for the rover
+ *
+ *	Products and quotients are formed in 64 bits and saturated back to 32.
+ *	The tables were generated from libm and rounded to the nearest Q16.16.
+ */
+
+#include "hal.h"
+#include "fixmath.h"
+
+/// sin(d) for d = 0 to 90 degrees
+static const int32_t sin_table[91] HAL_FLASH = {
+	0, 1144, 2287, 3430, 4572, 5712,
+	6850, 7987, 9121, 10252, 11380, 12505,
+	13626, 14742, 15855, 16962, 18064, 19161,
+	20252, 21336, 22415, 23486, 24550, 25607,
+	26656, 27697, 28729, 29753, 30767, 31772,
+	32768, 33754, 34729, 35693, 36647, 37590,
+	38521, 39441, 40348, 41243, 42126, 42995,
+	43852, 44695, 45525, 46341, 47143, 47930,
+	48703, 49461, 50203, 50931, 51643, 52339,
+	53020, 53684, 54332, 54963, 55578, 56175,
+	56756, 57319, 57865, 58393, 58903, 59396,
+	59870, 60326, 60764, 61183, 61584, 61966,
+	62328, 62672, 62997, 63303, 63589, 63856,
+	64104, 64332, 64540, 64729, 64898, 65048,
+	65177, 65287, 65376, 65446, 65496, 65526,
+	65536,
+};
+
+/// atan(k / 64) in degrees for k = 0 to 64
+static const int32_t atan_table[65] HAL_FLASH = {
+	0, 58666, 117304, 175884, 234379, 292760,
+	350999, 409070, 466945, 524598, 582003, 639135,
+	695970, 752484, 808654, 864460, 919879, 974893,
+	1029481, 1083627, 1137313, 1190524, 1243245, 1295461,
+	1347161, 1398332, 1448965, 1499049, 1548575, 1597536,
+	1645926, 1693738, 1740967, 1787610, 1833663, 1879123,
+	1923990, 1968261, 2011937, 2055018, 2097505, 2139399,
+	2180703, 2221419, 2261551, 2301101, 2340074, 2378474,
+	2416306, 2453574, 2490285, 2526443, 2562055, 2597126,
+	2631664, 2665673, 2699161, 2732134, 2764600, 2796564,
+	2828035, 2859019, 2889523, 2919554, 2949120,
+};
+
+/// log2(1 + k / 64) for k = 0 to 64
+static const int32_t log2_table[65] HAL_FLASH = {
+	0, 1466, 2909, 4331, 5732, 7112,
+	8473, 9814, 11136, 12440, 13727, 14996,
+	16248, 17484, 18704, 19909, 21098, 22272,
+	23433, 24579, 25711, 26830, 27936, 29029,
+	30109, 31178, 32234, 33279, 34312, 35334,
+	36346, 37346, 38336, 39316, 40286, 41246,
+	42196, 43137, 44068, 44990, 45904, 46809,
+	47705, 48593, 49472, 50344, 51207, 52063,
+	52911, 53751, 54584, 55410, 56229, 57040,
+	57845, 58643, 59434, 60219, 60997, 61769,
+	62534, 63294, 64047, 64794, 65536,
+};
+
+/// 2^(k / 64) for k = 0 to 64
+static const int32_t exp2_table[65] HAL_FLASH = {
+	65536, 66250, 66971, 67700, 68438, 69183,
+	69936, 70698, 71468, 72246, 73032, 73828,
+	74632, 75444, 76266, 77096, 77936, 78785,
+	79642, 80510, 81386, 82273, 83169, 84074,
+	84990, 85915, 86851, 87796, 88752, 89719,
+	90696, 91684, 92682, 93691, 94711, 95743,
+	96785, 97839, 98905, 99982, 101070, 102171,
+	103283, 104408, 105545, 106694, 107856, 109031,
+	110218, 111418, 112631, 113858, 115098, 116351,
+	117618, 118899, 120194, 121502, 122825, 124163,
+	125515, 126882, 128263, 129660, 131072,
+};
+
+/**
+ *	This function clamps a 64-bit result into a fixed-point number
+ */
+
+static q16_t saturate(int64_t v)
+{
+	if (v > Q16_MAX)
+	{
+		return Q16_MAX;
+	}
+	if (v < Q16_MIN)
+	{
+		return Q16_MIN;
+	}
+	return (q16_t) v;
+}
+
+/**
+ *	This function looks up a table at index i plus frac / 65536 of the way to
+ *	the next entry
+ */
+
+static q16_t lookup(const int32_t *table, uint16_t i, uint16_t frac)
+{
+	int32_t a = hal_flash_read_dword(&table[i]);
+	int32_t b = hal_flash_read_dword(&table[i + 1]);
+	return a + (q16_t) (((int64_t) (b - a) * frac + 0x8000) >> 16);
+}
+
+int32_t q16_to_int(q16_t a)
+{
+	if (a >= 0)
+	{
+		return (int32_t) (((int64_t) a + 0x8000) >> 16);
+	}
+	return -(int32_t) ((-(int64_t) a + 0x8000) >> 16);
+}
+
+q16_t q16_add(q16_t a, q16_t b)
+{
+	return saturate((int64_t) a + b);
+}
+
+q16_t q16_sub(q16_t a, q16_t b)
+{
+	return saturate((int64_t) a - b);
+}
+
+q16_t q16_mul(q16_t a, q16_t b)
+{
+	int64_t p = (int64_t) a * b;
+	//round to nearest, halves away from zero
+	p = p >= 0 ? (p + 0x8000) >> 16 : -((-p + 0x8000) >> 16);
+	return saturate(p);
+}
+
+q16_t q16_div(q16_t a, q16_t b)
+{
+	if (b == 0)
+	{
+		return a >= 0 ? Q16_MAX : Q16_MIN;
+	}
+	//divide the magnitudes, rounding to nearest, then put the sign back
+	uint64_t n = (uint64_t) (a >= 0 ? (int64_t) a : -(int64_t) a) << 16;
+	uint64_t d = (uint64_t) (b >= 0 ? (int64_t) b : -(int64_t) b);
+	int64_t q = (int64_t) ((n + d / 2) / d);
+	return saturate((a < 0) != (b < 0) ? -q : q);
+}
+
+q16_t q16_sin(q16_t deg)
+{
+	const int32_t full = 360L * Q16_ONE;
+	const int32_t quarter = 90L * Q16_ONE;
+	int32_t d = deg % full;
+	if (d < 0)
+	{
+		d += full;
+	}
+
+	uint8_t quadrant = (uint8_t) (d / quarter);
+	d -= quadrant * quarter;
+	if (quadrant & 1)
+	{
+		d = quarter - d;	// mirror the second and fourth quadrants
+	}
+
+	q16_t v = lookup(sin_table, (uint16_t) (d >> 16), (uint16_t) (d & 0xFFFF));
+	return quadrant >= 2 ? -v : v;
+}
+
+q16_t q16_cos(q16_t deg)
+{
+	//cos(d) = sin(d + 90), reduced first so the sum cannot overflow
+	return q16_sin(deg % (360L * Q16_ONE) + 90L * Q16_ONE);
+}
+
+q16_t q16_tan(q16_t deg)
+{
+	return q16_div(q16_sin(deg), q16_cos(deg));
+}
+
+/**
+ *	This function returns atan(n / d) in degrees for 0 <= n <= d, d > 0
+ */
+
+static q16_t atan_octant(uint32_t n, uint32_t d)
+{
+	uint32_t ratio = (uint32_t) (((uint64_t) n << 16) / d);	// 0 to 65536
+	if (ratio >= 65536)
+	{
+		return hal_flash_read_dword(&atan_table[64]);
+	}
+	//64 intervals: the top 6 bits of the ratio pick one, the rest interpolate
+	return lookup(atan_table, (uint16_t) (ratio >> 10), (uint16_t) ((ratio & 0x3FF) << 6));
+}
+
+q16_t q16_atan2(q16_t y, q16_t x)
+{
+	uint32_t ax = x >= 0 ? (uint32_t) x : -(uint32_t) x;
+	uint32_t ay = y >= 0 ? (uint32_t) y : -(uint32_t) y;
+	q16_t angle;
+
+	if (ax == 0 && ay == 0)
+	{
+		return 0;
+	}
+	if (ay <= ax)
+	{
+		angle = atan_octant(ay, ax);
+	}
+	else
+	{
+		angle = 90L * Q16_ONE - atan_octant(ax, ay);
+	}
+	if (x < 0)
+	{
+		angle = 180L * Q16_ONE - angle;
+	}
+	return y < 0 ? -angle : angle;
+}
+
+uint16_t isqrt32(uint32_t n)
+{
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+
+	while (bit > n)
+	{
+		bit >>= 2;
+	}
+	while (bit)
+	{
+		if (n >= root + bit)
+		{
+			n -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+		{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return (uint16_t) root;
+}
+
+q16_t q16_sqrt(q16_t a)
+{
+	if (a <= 0)
+	{
+		return 0;
+	}
+	//sqrt(a / 65536) * 65536 = sqrt(a * 65536)
+	uint64_t n = (uint64_t) a << 16;
+	uint64_t root = 0;
+	uint64_t bit = 1ULL << 46;
+
+	while (bit > n)
+	{
+		bit >>= 2;
+	}
+	while (bit)
+	{
+		if (n >= root + bit)
+		{
+			n -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+		{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	//round to nearest
+	if (n > root)
+	{
+		root++;
+	}
+	return (q16_t) root;
+}
+
+q16_t q16_log2(q16_t a)
+{
+	if (a <= 0)
+	{
+		return Q16_MIN;
+	}
+
+	//a = 2^p * (1 + f) with 0 <= f < 1
+	int8_t p = 30;
+	uint32_t m = (uint32_t) a;
+	while (!(m & (1UL << 30)))
+	{
+		m <<= 1;
+		p--;
+	}
+	uint16_t f = (uint16_t) ((m >> 14) & 0xFFFF);	// f in Q16
+
+	return (q16_t) (p - 16) * Q16_ONE + lookup(log2_table, f >> 10, (uint16_t) ((f & 0x3FF) << 6));
+}
+
+q16_t q16_exp2(q16_t a)
+{
+	//split a into a whole power n (rounded down) and a fraction f in [0, 1)
+	int32_t n = a >= 0 ? a / Q16_ONE : (int32_t) -((-(int64_t) a + Q16_ONE - 1) / Q16_ONE);
+	uint16_t f = (uint16_t) (a - n * Q16_ONE);
+
+	uint32_t m = (uint32_t) lookup(exp2_table, f >> 10, (uint16_t) ((f & 0x3FF) << 6));	// 1 to 2
+	if (n >= 15)
+	{
+		return Q16_MAX;
+	}
+	if (n >= 0)
+	{
+		return saturate((int64_t) m << n);
+	}
+	if (n < -31)
+	{
+		return 0;
+	}
+	return (q16_t) ((m + (1UL << (-n - 1))) >> -n);
+}
+
+q16_t q16_pow(q16_t base, q16_t e)
+{
+	if (base <= 0)
+	{
+		return Q16_MIN;
+	}
+	return q16_exp2(q16_mul(e, q16_log2(base)));
+}
+
+int32_t q16_hundredths(q16_t a)
+{
+	uint32_t mag = a >= 0 ? (uint32_t) a : -(uint32_t) a;
+	int32_t hundredths = (int32_t) (((uint64_t) mag * 100 + 0x8000) >> 16);
+	return a >= 0 ? hundredths : -hundredths;
+}
+
+char *q16_format(char *buf, q16_t a)
+{
+	char digits[12];
+	char *out = buf;
+	int i = 0;
+
+	int32_t rounded = q16_hundredths(a);
+	uint32_t hundredths = rounded >= 0 ? (uint32_t) rounded : -(uint32_t) rounded;
+
+	if (rounded < 0)
+	{
+		*out++ = '-';
+	}
+	do
+	{
+		digits[i++] = (char) ('0' + hundredths % 10);
+		hundredths /= 10;
+		if (i == 2)
+		{
+			digits[i++] = '.';
+		}
+	} while (hundredths || i < 4);
+	while (i)
+	{
+		*out++ = digits[--i];
+	}
+	*out = 0;
+	return buf;
+}
@@ -0,0 +1,126 @@
+/**
+ *	@file fixmath.h
+ *	@brief fixed-point arithmetic for the rover, so the hot paths do not
+ *	need the soft-float library
+ *
+ *	Numbers are Q16.16: a 32-bit signed integer holding value * 65536, which
+ *	covers -32768 to 32767.99998 in steps of 0.000015. Angles are in degrees,
+ *	like everywhere else in the firmware. Every operation saturates at
+ *	Q16_MAX and Q16_MIN instead of wrapping.
+ *
+ *	The functions are table based; the tables live in flash and each lookup
+ *	is interpolated linearly between neighbouring entries:
+ *
+ *	q16_sin, q16_cos	91 entries, one per degree of the first quadrant
+ *	q16_tan			q16_sin / q16_cos
+ *	q16_atan2		65 entries of atan over [0, 1], folded into all octants
+ *	q16_log2, q16_exp2	65 entries each over one octave
+ *	q16_pow			q16_exp2(e * q16_log2(base))
+ *	q16_sqrt, isqrt32	bit by bit, no table
+ *
+ *	host/fixbench.c checks each one against libm.
+ */
+
+#ifndef FIXMATH_H
+#define FIXMATH_H
+
+#include <stdint.h>
+
+/// a Q16.16 fixed-point number
+typedef int32_t q16_t;
+
+#define Q16_ONE		((q16_t) 65536)
+#define Q16_MAX		((q16_t) 0x7FFFFFFF)
+#define Q16_MIN		((q16_t) (-0x7FFFFFFF - 1))
+
+/// Q16.16 constant from a number; for constants only, it is evaluated by the compiler
+#define Q16(x)		((q16_t) ((x) * 65536.0 + ((x) >= 0 ? 0.5 : -0.5)))
+
+/// Q16.16 from an integer
+#define q16_from_int(n)	((q16_t) (n) * Q16_ONE)
+
+/// Q16.16 to double, for code that has not moved off floating point
+#define q16_to_double(a)	((a) / 65536.0)
+
+/**
+ *	This function rounds a fixed-point number to the nearest integer
+ *	@param a	number to round
+ *	@return a rounded, halves away from zero
+ */
+
+int32_t q16_to_int(q16_t a);
+
+/**
+ *	These functions add, subtract, multiply and divide two fixed-point
+ *	numbers, saturating on overflow. Dividing by zero gives Q16_MAX or Q16_MIN
+ *	with the sign of the dividend.
+ */
+
+q16_t q16_add(q16_t a, q16_t b);
+q16_t q16_sub(q16_t a, q16_t b);
+q16_t q16_mul(q16_t a, q16_t b);
+q16_t q16_div(q16_t a, q16_t b);
+
+/**
+ *	These functions return the sine, cosine and tangent of an angle
+ *	@param deg	angle in degrees
+ */
+
+q16_t q16_sin(q16_t deg);
+q16_t q16_cos(q16_t deg);
+q16_t q16_tan(q16_t deg);
+
+/**
+ *	This function returns the angle of the point (x, y)
+ *	@param y	distance along the y axis
+ *	@param x	distance along the x axis
+ *	@return angle in degrees, -180 to 180; 0 for the origin
+ */
+
+q16_t q16_atan2(q16_t y, q16_t x);
+
+/**
+ *	This function returns the square root of an unsigned 32-bit integer
+ *	@param n	number to take the root of
+ *	@return the root, rounded down
+ */
+
+uint16_t isqrt32(uint32_t n);
+
+/**
+ *	This function returns the square root of a fixed-point number
+ *	@param a	number to take the root of; negative numbers give 0
+ */
+
+q16_t q16_sqrt(q16_t a);
+
+/**
+ *	These functions return the base 2 logarithm and the power of 2 of a
+ *	fixed-point number, and base raised to the power e. q16_log2 and q16_pow
+ *	give Q16_MIN for a number that is not positive.
+ */
+
+q16_t q16_log2(q16_t a);
+q16_t q16_exp2(q16_t a);
+q16_t q16_pow(q16_t base, q16_t e);
+
+/**
+ *	This function rounds a fixed-point number to hundredths, as
+ *	q16_format() writes it
+ *	@param a	number to round
+ *	@return a times 100, rounded, halves away from zero
+ */
+
+int32_t q16_hundredths(q16_t a);
+
+/**
+ *	This function writes a fixed-point number with two decimals, as "%.2f"
+ *	would, without needing printf's floating point support
+ *	@param buf	at least 12 characters
+ *	@param a	number to write
+ *	@return buf
+ */
+
+char *q16_format(char *buf, q16_t a);
+
+#endif
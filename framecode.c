@@ -0,0 +1,174 @@
+/**
+ *	@file framecode.c
+ *	@brief the coding of sensor frames as changes from the frame before,
+ *	which the flight recorder and the sensor feed use
+ *
+ *	It needs nothing but the C library, so host tools that decode frames
+ *	link this file alone.
+ */
+
+#include <string.h>
+#include "recorder.h"
+
+/// number of sensor values in a frame
+#define REC_VALUES	36
+
+/// width in bytes of each sensor value of packet group 6, in order
+static const unsigned char value_width[REC_VALUES] = {
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	// bumps ... buttons
+	2, 2,					// distance, angle
+	1, 2, 2, 1, 2, 2,			// charging state ... capacity
+	2, 2, 2, 2, 2,				// wall and cliff signals
+	1, 2, 1, 1, 1, 1, 1,			// cargo bay ... stream packets
+	2, 2, 2, 2,				// requested velocity ... left velocity
+};
+
+/**
+ *	Reads a 1 or 2 byte sensor value of a frame, high byte first
+ */
+
+static uint16_t value_at(const unsigned char *frame, unsigned char offset, unsigned char width)
+{
+	return width == 2 ? (uint16_t) frame[offset] << 8 | frame[offset + 1] : frame[offset];
+}
+
+/**
+ *	Codes a frame as its changes from the one before
+ */
+
+unsigned char rec_encode_frame(const unsigned char *prev, const unsigned char *frame, unsigned char *out)
+{
+	unsigned char groups = 0;
+	unsigned char changed[(REC_VALUES + 7) / 8] = {0};
+	unsigned char offset = 0;
+
+	for (unsigned char i = 0; i < REC_VALUES; i++)
+	{
+		if (memcmp(prev + offset, frame + offset, value_width[i]))
+		{
+			changed[i / 8] |= 1 << (i % 8);
+			groups |= 1 << (i / 8);
+		}
+		offset += value_width[i];
+	}
+
+	unsigned char length = 0;
+	out[length++] = groups;
+	for (unsigned char g = 0; g < sizeof(changed); g++)
+	{
+		if (groups & (1 << g))
+		{
+			out[length++] = changed[g];
+		}
+	}
+
+	unsigned char nibbles = 0;
+	offset = 0;
+	for (unsigned char i = 0; i < REC_VALUES; i++)
+	{
+		unsigned char width = value_width[i];
+		if (changed[i / 8] & (1 << (i % 8)))
+		{
+			uint16_t now = value_at(frame, offset, width);
+			uint16_t zigzag;
+			if (width == 2)
+			{
+				int16_t d = now - value_at(prev, offset, width);
+				zigzag = (uint16_t) (d << 1) ^ (uint16_t) (d >> 15);
+			}
+			else
+			{
+				int8_t d = now - value_at(prev, offset, width);
+				zigzag = (uint8_t) ((uint8_t) (d << 1) ^ (uint8_t) (d >> 7));
+			}
+
+			unsigned char put[5];
+			unsigned char count = 0;
+			if (zigzag < 15)
+			{
+				put[count++] = zigzag;
+			}
+			else
+			{
+				put[count++] = 15;
+				for (signed char shift = width * 8 - 4; shift >= 0; shift -= 4)
+				{
+					put[count++] = (now >> shift) & 0x0F;
+				}
+			}
+			for (unsigned char n = 0; n < count; n++, nibbles++)
+			{
+				if (nibbles % 2 == 0)
+				{
+					out[length++] = put[n] << 4;
+				}
+				else
+				{
+					out[length - 1] |= put[n];
+				}
+			}
+		}
+		offset += width;
+	}
+	return length;
+}
+
+/**
+ *	Undoes rec_encode_frame()
+ */
+
+unsigned char rec_decode_frame(unsigned char *frame, const unsigned char *in)
+{
+	unsigned char length = 0;
+	unsigned char groups = in[length++];
+	unsigned char changed[(REC_VALUES + 7) / 8] = {0};
+	for (unsigned char g = 0; g < sizeof(changed); g++)
+	{
+		if (groups & (1 << g))
+		{
+			changed[g] = in[length++];
+		}
+	}
+
+	unsigned char nibbles = 0;
+	unsigned char offset = 0;
+	for (unsigned char i = 0; i < REC_VALUES; i++)
+	{
+		unsigned char width = value_width[i];
+		if (changed[i / 8] & (1 << (i % 8)))
+		{
+			unsigned char take = 1;
+			uint16_t value = 0;
+			for (unsigned char n = 0; n < take; n++, nibbles++)
+			{
+				unsigned char nibble = nibbles % 2 == 0 ? in[length++] >> 4 : in[length - 1] & 0x0F;
+				if (n == 0 && nibble == 15)
+				{
+					take = 1 + width * 2;
+				}
+				else if (take > 1)
+				{
+					value = value << 4 | nibble;
+				}
+				else
+				{
+					//zigzag back to a difference
+					int16_t d = (nibble >> 1) ^ -(int16_t) (nibble & 1);
+					value = value_at(frame, offset, width) + d;
+				}
+			}
+			if (width == 2)
+			{
+				frame[offset] = value >> 8;
+				frame[offset + 1] = value;
+			}
+			else
+			{
+				frame[offset] = value;
+			}
+		}
+		offset += width;
+	}
+	return length;
+}
+
@@ -0,0 +1,44 @@
+/**
+ *	@file hal.h
+ *	@brief hardware abstraction layer; the only place the rest of the
+ *	firmware reaches the ATmega128 peripherals through
+ *
+ *	Every peripheral operation the rover uses is one small function:
+ *
+ *	USART0 (base station)	hal_uart0_init, hal_uart0_write, hal_uart0_read
+ *	USART1 (Create)		hal_uart1_init, hal_uart1_baud, hal_uart1_write,
+ *				hal_uart1_ready, hal_uart1_read
+ *	Timer2 (1 ms timebase)	hal_timer2_start, hal_timer2_stop, hal_timer2_count
+ *	Timer0 (LCD refresh)	hal_timer0_start, hal_timer0_stop
+ *	Timer1 (sonar capture)	hal_sonar_init, hal_sonar_rising, hal_sonar_capture,
+ *				hal_sonar_edge, hal_sonar_pulse_start, hal_sonar_pulse_end
+ *	Timer3 (servo PWM)	hal_servo_init, hal_servo_set
+ *	ADC (IR sensor)		hal_adc_init, hal_adc_start, hal_adc_busy, hal_adc_read
+ *	Port A (LCD)		hal_lcd_port_init, hal_lcd_port_write,
+ *				hal_lcd_port_or, hal_lcd_port_and
+ *	EEPROM			hal_eeprom_read_block, hal_eeprom_update_block,
+ *				hal_eeprom_update_word
+ *	Flash tables		HAL_FLASH, hal_flash_read_dword, hal_flash_read_block
+ *	Interrupts		hal_interrupts_enable, hal_interrupts_disable,
+ *				hal_interrupts_restore, ISR(vector)
+ *	Short delays		hal_delay_1us
+ *
+ *	Busy-wait loops call hal_idle() in their body. On the robot it is empty;
+ *	on a host it lets the simulated peripherals make progress.
+ *
+ *	The AVR backend (hal_avr.h) is all static inline register accesses, so it
+ *	compiles to exactly the code that touched the registers directly. Any other
+ *	target gets the Linux backend (host/hal_linux.h), which simulates the
+ *	peripherals under a virtual clock.
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+#ifdef __AVR__
+#include "hal_avr.h"
+#else
+#include "hal_linux.h"
+#endif
+
+#endif
@@ -0,0 +1,287 @@
+/**
+ *	@file hal_avr.h
+ *	@brief ATmega128 backend of the hardware abstraction layer
+ *
+ *	Include hal.h rather than this file.
+ */
+
+#ifndef HAL_AVR_H
+#define HAL_AVR_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+
+/// Structures shared with the Create are already byte packed on the AVR
+#define HAL_PACKED
+
+/// Constant tables stay in flash instead of being copied to RAM
+#define HAL_FLASH PROGMEM
+
+/// There is only ever one robot
+#define HAL_LOCAL
+
+/// Nothing to do while busy-waiting on the robot
+static inline void hal_idle(void)
+{
+}
+
+/// Busy-wait at least one microsecond (16 cycles at 16 MHz)
+static inline void hal_delay_1us(void)
+{
+	__builtin_avr_delay_cycles(16);
+}
+
+/// Enable interrupts globally
+static inline void hal_interrupts_enable(void)
+{
+	sei();
+}
+
+/// Disable interrupts globally; returns the state to hand to hal_interrupts_restore()
+static inline unsigned char hal_interrupts_disable(void)
+{
+	unsigned char state = SREG;
+	cli();
+	return state;
+}
+
+/// Put the global interrupt enable back the way hal_interrupts_disable() found it
+static inline void hal_interrupts_restore(unsigned char state)
+{
+	SREG = state;
+}
+
+/// USART0: 8 data bits, 2 stop bits, double speed, receive interrupt on
+static inline void hal_uart0_init(unsigned int ubrr)
+{
+	UBRR0H = (unsigned char) (ubrr>>8);
+	UBRR0L = (unsigned char) ubrr;
+	UCSR0B = (1<<RXEN0) | (1 << TXEN0) | (1 << RXCIE0);
+	UCSR0C = (1<<USBS0)|(3 << UCSZ00);
+	UCSR0A = (1 << U2X0);
+}
+
+/// Send one byte on USART0 once the transmit buffer is free
+static inline void hal_uart0_write(unsigned char data)
+{
+	while(!(UCSR0A & (1 << UDRE0)))
+	;
+	UDR0 = data;
+}
+
+/// Read the byte that raised the USART0 receive interrupt
+static inline unsigned char hal_uart0_read(void)
+{
+	return UDR0;
+}
+
+/// USART1: 8 data bits, 1 stop bit
+static inline void hal_uart1_init(unsigned char ubrr)
+{
+	UBRR1L = ubrr;
+	UCSR1B = (1 << RXEN) | (1 << TXEN);
+	UCSR1C = (3 << UCSZ10);
+}
+
+/// Change the USART1 baud rate
+static inline void hal_uart1_baud(unsigned char ubrr)
+{
+	UBRR1L = ubrr;
+}
+
+/// Send one byte on USART1 once the transmit buffer is free
+static inline void hal_uart1_write(unsigned char data)
+{
+	while (!(UCSR1A & (1 << UDRE)));
+	UDR1 = data;
+}
+
+/// Nonzero when USART1 has received a byte
+static inline unsigned char hal_uart1_ready(void)
+{
+	return UCSR1A & (1 << RXC);
+}
+
+/// Read the last byte received on USART1
+static inline unsigned char hal_uart1_read(void)
+{
+	return UDR1;
+}
+
+/// Timer2 in CTC mode with the compare interrupt; unit 0 uses a prescaler of 64, unit 1 none
+static inline void hal_timer2_start(char unit, unsigned char compare)
+{
+	TCNT2 = 0;
+	OCR2 = compare;
+	if ( unit == 0 ) {
+        TCCR2=0b00001011;	//WGM:CTC, COM:OC2 disconnected,pre_scaler = 64
+        TIMSK|=0b10000000;	//Enabling O.C. Interrupt for Timer2
+	}
+	if (unit == 1) {
+        TCCR2=0b00001001;	//WGM:CTC, COM:OC2 disconnected,pre_scaler = 1
+        TIMSK|=0b10000000;	//Enabling O.C. Interrupt for Timer2
+	}
+}
+
+/// Stop the Timer2 compare interrupt
+static inline void hal_timer2_stop(void)
+{
+	TIMSK&=~0b10000000;		//Disabling O.C. Interrupt for Timer2
+	TCCR2&=0b01111111;		//Clearing O.C. settings
+}
+
+/// Current Timer2 count, 0 up to the compare value
+static inline unsigned char hal_timer2_count(void)
+{
+	return TCNT2;
+}
+
+/// Timer0 in CTC mode at 2 MHz (prescaler 8) with the compare interrupt; one interrupt every compare + 1 counts
+static inline void hal_timer0_start(unsigned char compare)
+{
+	TCNT0 = 0;
+	OCR0 = compare;
+	TCCR0 = 0b00001010;		//WGM:CTC, COM:OC0 disconnected, pre_scaler = 8
+	TIMSK |= 0b00000010;		//Enabling O.C. Interrupt for Timer0
+}
+
+/// Stop Timer0 and its compare interrupt
+static inline void hal_timer0_stop(void)
+{
+	TIMSK &= ~0b00000010;		//Disabling O.C. Interrupt for Timer0
+	TCCR0 = 0;
+}
+
+/// Timer1 input capture on the rising edge, prescaler 8, capture and overflow interrupts
+static inline void hal_sonar_init(void)
+{
+	TCCR1A = 0;
+	TCCR1B = 0xC2;
+	TCCR1C = 0;
+	TIMSK = (TIMSK & ~0x3C) | 0x24;	//only the Timer1 bits; the other timers keep theirs
+}
+
+/// Nonzero while the input capture waits for a rising edge
+static inline unsigned char hal_sonar_rising(void)
+{
+	return TCCR1B & 0x40;
+}
+
+/// Timer1 count latched by the last capture
+static inline unsigned int hal_sonar_capture(void)
+{
+	return ICR1;
+}
+
+/// Capture the next rising (1) or falling (0) edge
+static inline void hal_sonar_edge(char rising)
+{
+	TCCR1B = rising ? 0xC2 : 0x82;
+}
+
+/// Disable the Timer1 interrupts and drive the sonar pin (PD4) high
+static inline void hal_sonar_pulse_start(void)
+{
+	TIMSK &= ~0x24;
+	DDRD |= 0x10;
+	PORTD |= 0x10;
+}
+
+/// Drive the sonar pin low, turn it back into the capture input and re-enable the interrupt
+static inline void hal_sonar_pulse_end(void)
+{
+	PORTD &= 0XEF;
+	DDRD &= 0XEF;
+	TIFR &= 0xDF;
+	TIMSK |= 0x24;
+}
+
+/// Timer3 fast PWM on OC3B (PE4) with the given period and starting pulse width
+static inline void hal_servo_init(unsigned int period, unsigned int pulse)
+{
+	TCCR3A = 0x23;
+	TCCR3B = 0x1A;
+	OCR3A = period - 1;
+	OCR3B = pulse;
+	DDRE = 0x10;
+}
+
+/// Set the servo pulse width in Timer3 counts
+static inline void hal_servo_set(unsigned int pulse)
+{
+	OCR3B = pulse;
+}
+
+/// ADC channel 2 against AVCC
+static inline void hal_adc_init(void)
+{
+	ADMUX |= (0b01000010);
+}
+
+/// Start a conversion
+static inline void hal_adc_start(void)
+{
+	ADCSRA |= 0xC7;
+}
+
+/// Nonzero while a conversion is running
+static inline unsigned char hal_adc_busy(void)
+{
+	return (ADCSRA & 0b01000000) == 0b01000000;
+}
+
+/// Result of the last conversion
+static inline unsigned int hal_adc_read(void)
+{
+	return ADC;
+}
+
+/// Port A drives the LCD
+static inline void hal_lcd_port_init(void)
+{
+	DDRA = 0xFF;
+}
+
+static inline void hal_lcd_port_write(unsigned char value)
+{
+	PORTA = value;
+}
+
+static inline void hal_lcd_port_or(unsigned char bits)
+{
+	PORTA |= bits;
+}
+
+static inline void hal_lcd_port_and(unsigned char mask)
+{
+	PORTA &= mask;
+}
+
+static inline void hal_eeprom_read_block(void *dst, const void *src, unsigned int n)
+{
+	eeprom_read_block(dst, src, n);
+}
+
+static inline void hal_eeprom_update_block(const void *src, void *dst, unsigned int n)
+{
+	eeprom_update_block(src, dst, n);
+}
+
+static inline void hal_eeprom_update_word(uint16_t *dst, uint16_t value)
+{
+	eeprom_update_word(dst, value);
+}
+
+static inline int32_t hal_flash_read_dword(const int32_t *src)
+{
+	return (int32_t) pgm_read_dword(src);
+}
+
+static inline void hal_flash_read_block(void *dst, const void *src, unsigned int n)
+{
+	memcpy_P(dst, src, n);
+}
+
+#endif
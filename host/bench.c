@@ -0,0 +1,814 @@
+/**
+ *	@file bench.c
+ *	@brief end-to-end benchmarks of the firmware on the simulator
+ *
+ *	Each benchmark runs the unchanged firmware in a fresh child process on
+ *	the virtual clock, so the numbers depend only on the firmware, the
+ *	world and the seed, and not on the machine running them. They are:
+ *
+ *	sweep_time		s	one sweep() from 0 to 180 degrees
+ *	control_loop_rate	Hz	sensor updates per second inside move_forward()
+ *	sensor_update_bytes	bytes	serial bytes to and from the Create per update
+ *	recorder_frame_bytes	bytes	flight recorder bytes per update, wheel commands included
+ *	recorder_retention	s	how long the flight recorder's ring lasts at the
+ *				rate it is written during the mission of mission_time
+ *	feed_frame_bytes	bytes	sent to the base station per update with the sensor
+ *				feed on (feed.h), framing and keyframes included
+ *	bump_stop_latency	ms	bumper pressed until the wheels stop driving forward
+ *	stop_key_latency	ms	stop key sent while driving forward until the
+ *				wheels stop
+ *	stop_torn_frame_latency	ms	the same with the start of a frame whose
+ *				length was corrupted sent just before it
+ *	telemetry_r		bytes	sent to the base station for the 'r' command
+ *	telemetry_w		bytes	... for 'w' (move forward)
+ *	telemetry_g		bytes	... for 'g' (sweep)
+ *	telemetry_g_binary	bytes	... for 'b' and 'g', a sweep in blocks (sweepblock.h)
+ *	mission_time		s	'f' from the start of the reference world until
+ *				main() returns at the destination
+ *	lcd_update_time		ms	lprintf() of a full screen until the LCD shows it
+ *	lcd_blocking_time	ms	longest time an lprintf() call keeps its caller
+ *	lcd_change_bytes	bytes	sent to the LCD controller when one digit changes
+ *	lcd_overruns		writes	bytes sent to the LCD before it was ready for them
+ *	effect_blocking_time	ms	time play_song() keeps its caller
+ *	effect_serial_rate	bytes/s	sent to the Create while the song and LED
+ *				effect of play_song() play
+ *	song_notes		notes	notes of that song the Create plays
+ *	link_ack_latency	ms	a command frame (link.h) sent in the middle of a
+ *				sweep until its acknowledgement is back
+ *	oi_reset_gap		ms	longest time between two sensor answers while
+ *				driving, with the Create switched off and on on the way
+ *	oi_lost_byte_gap	ms	the same with a byte to the Create lost instead
+ *	detour_left_error	deg	heading off the start line after 'g' and a detour
+ *				round the first post of the lab world on its left
+ *				('1'); fails if anything was bumped or the robot
+ *				did not rejoin the line
+ *	detour_right_error	deg	the same on its right ('2')
+ *	detour_auto_error	deg	the same on the side the firmware picks ('3')
+ *	detour_time		s	that '3' until the wheels stop at the end of the
+ *				detour; fails the same way
+ *	calibrated_turn_error	deg	how far a 90 degree turn after 'k' is off; the
+ *				calibration has to store its tables
+ *
+ *	usage: bench [-w world] [-t thresholds] [-o results]
+ *
+ *	Results are printed one JSON object per line. The thresholds file holds
+ *	one "metric max|min limit" per line; a metric past its limit, or a
+ *	benchmark that does not finish, makes the program exit with status 1.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "hal.h"
+#include "open_interface.h"
+#include "util.h"
+#include "movement.h"
+#include "lcd.h"
+#include "music.h"
+#include "recorder.h"
+#include "feed.h"
+#include "link.h"
+#include "calibrate.h"
+#include "create.h"
+#include "world.h"
+
+/// a benchmark that has not finished after this much virtual time has failed
+#define BENCH_LIMIT_US		900000000ULL
+/// how often event-driven benchmarks check whether they are done
+#define BENCH_CHECK_US		1000
+/// the firmware counts as done with a command once the lines are quiet this long
+#define BENCH_QUIET_US		2000000
+/// when the command of a telemetry benchmark is sent
+#define BENCH_KEY_US		1000000
+/// distance driven for the control loop benchmark, millimeters
+#define BENCH_DRIVE		1000
+/// distance from the start to the obstacle of the bump benchmark, millimeters
+#define BENCH_POST		700
+/// when the command frame of the link benchmark is sent, well into the sweep
+#define BENCH_FRAME_US		4000000
+/// when the Create fails in the recovery benchmarks, after the drive starts
+#define BENCH_FAULT_US		1000000
+/// when the stop key is sent in the stop key benchmark, after the drive starts
+#define BENCH_STOP_US		1000000
+/// from the torn frame to the stop key sent after it, as long as a keystroke takes
+#define BENCH_TORN_US		50000
+/// world of the detour benchmarks, with posts to drive around
+#define BENCH_LAB_WORLD		"worlds/lab.world"
+/// keys that bring the rover within sight of the first post and sweep
+#define BENCH_APPROACH		"ewg"
+/// furthest the end of a detour may be from the line it left, millimeters
+#define BENCH_LINE_OFF		100
+
+#define MAX_LIMITS	32
+
+int rover_main(void);
+void sweep(void);
+
+/// one measured quantity
+struct metric{
+	const char *name;
+	const char *unit;
+	double (*run)(const void *arg);
+	const void *arg;
+};
+
+/// one line of the thresholds file
+struct limit{
+	char name[40];
+	int max;		// 1 for an upper bound, 0 for a lower bound
+	double value;
+};
+
+static const char *world_path = "worlds/reference.world";
+static int result_fd = -1;
+static unsigned long telemetry;		// bytes the firmware sent to the base station
+static unsigned long telemetry_start;
+static const char *bench_keys;	// sent at once, as one command
+
+static void count_telemetry(unsigned char data)
+{
+	telemetry++;
+}
+
+/**
+ *	Hand a result to the parent and end the child
+ */
+
+static void finish(double value)
+{
+	if (write(result_fd, &value, sizeof(value)) != sizeof(value))
+	{
+		_exit(2);
+	}
+	_exit(0);
+}
+
+static void give_up(uint64_t now, void *arg)
+{
+	finish(NAN);
+}
+
+/**
+ *	Load the world, put the rover in it and route the base station output
+ *	to the byte counter
+ */
+
+static void setup(void)
+{
+	if (world_load(world_path))
+	{
+		_exit(2);
+	}
+	world_seed(1);
+	world_attach();
+	hal_linux_uart0_connect(count_telemetry);
+	hal_linux_at(BENCH_LIMIT_US, give_up, 0);
+}
+
+static double sweep_time(const void *arg)
+{
+	setup();
+	uint64_t start = hal_linux_now();
+	sweep();
+	return (hal_linux_now() - start) / 1e6;
+}
+
+/**
+ *	Drive forward on open floor; returns sensor updates per second, serial
+ *	bytes per update for arg "b", recorder bytes per update for "r", or
+ *	bytes of the sensor feed per update for "f"
+ */
+
+static double control_loop(const void *arg)
+{
+	setup();
+	oi_t *sensor = oi_alloc();
+	oi_init(sensor);
+
+	unsigned long queries = create.queries;
+	unsigned long bytes = create.bytes_in + create.bytes_out;
+	uint32_t recorded = rec_total();
+	uint64_t start = hal_linux_now();
+	if (arg && *(const char *) arg == 'f')
+	{
+		feed_toggle();
+		telemetry_start = telemetry;
+	}
+	move_forward(sensor, BENCH_DRIVE);
+
+	queries = create.queries - queries;
+	bytes = create.bytes_in + create.bytes_out - bytes;
+	recorded = rec_total() - recorded;
+	if (queries == 0)
+	{
+		return NAN;
+	}
+	if (!arg)
+	{
+		return queries / ((hal_linux_now() - start) / 1e6);
+	}
+	if (*(const char *) arg == 'r')
+	{
+		return (double) recorded / queries;
+	}
+	if (*(const char *) arg == 'f')
+	{
+		return (double) (telemetry - telemetry_start) / queries;
+	}
+	return (double) bytes / queries;
+}
+
+static void watch_bump(uint64_t now, void *arg)
+{
+	if (world.bump_time && create.left_speed <= 0 && create.right_speed <= 0)
+	{
+		finish((create.drive_time - world.bump_time) / 1e3);
+	}
+	hal_linux_at(now + BENCH_CHECK_US, watch_bump, 0);
+}
+
+static double bump_stop(const void *arg)
+{
+	setup();
+	world.post_count = 1;
+	world.posts[0].x = world.start_x + BENCH_POST;
+	world.posts[0].y = world.start_y;
+	world.posts[0].r = 60;
+
+	oi_t *sensor = oi_alloc();
+	oi_init(sensor);
+	hal_linux_at(hal_linux_now(), watch_bump, 0);
+	move_forward(sensor, 2 * BENCH_POST);
+	return NAN;
+}
+
+static uint64_t stop_sent;
+
+static void watch_stop(uint64_t now, void *arg)
+{
+	if (create.left_speed == 0 && create.right_speed == 0)
+	{
+		finish((create.drive_time - stop_sent) / 1e3);
+	}
+	hal_linux_at(now + BENCH_CHECK_US, watch_stop, 0);
+}
+
+/// the start of a command frame whose length byte was hit by a line error
+static const unsigned char torn_frame[] = {LINK_START, LINK_COMMAND, 0, LINK_PAYLOAD};
+
+static void stop_now(uint64_t now, void *arg)
+{
+	stop_sent = now;
+	hal_linux_uart0_feed(USART_ABORT);
+	watch_stop(now, 0);
+}
+
+/**
+ *	Send the stop key, after the torn frame if arg is set
+ */
+
+static void send_stop(uint64_t now, void *arg)
+{
+	if (!arg)
+	{
+		stop_now(now, 0);
+		return;
+	}
+	for (unsigned int i = 0; i < sizeof(torn_frame); i++)
+	{
+		hal_linux_uart0_feed(torn_frame[i]);
+	}
+	hal_linux_at(now + BENCH_TORN_US, stop_now, 0);
+}
+
+/**
+ *	Drive forward and send the stop key on the way, after a torn frame for
+ *	arg "t"; the time until the wheels stop
+ */
+
+static double stop_key(const void *arg)
+{
+	setup();
+	USART_Init(34);
+	oi_t *sensor = oi_alloc();
+	oi_init(sensor);
+	hal_linux_at(hal_linux_now() + BENCH_STOP_US, send_stop, (void *) arg);
+	move_forward(sensor, BENCH_DRIVE);
+	return NAN;
+}
+
+static void send_key(uint64_t now, void *arg)
+{
+	telemetry_start = telemetry;
+	for (const char *k = bench_keys; *k; k++)
+	{
+		hal_linux_uart0_feed(*k);
+	}
+}
+
+static void watch_quiet(uint64_t now, void *arg)
+{
+	if (now > BENCH_KEY_US && USART_Available() == 0 &&
+			create.left_speed == 0 && create.right_speed == 0 &&
+			now - hal_linux_uart_last_activity() > BENCH_QUIET_US)
+	{
+		finish(telemetry - telemetry_start);
+	}
+	hal_linux_at(now + BENCH_CHECK_US * 100, watch_quiet, 0);
+}
+
+/**
+ *	Bytes sent to the base station for one command, from its keys until
+ *	the firmware is waiting for the next one
+ */
+
+static double telemetry_bytes(const void *arg)
+{
+	setup();
+	bench_keys = arg;
+	hal_linux_at(BENCH_KEY_US, send_key, 0);
+	hal_linux_at(BENCH_KEY_US, watch_quiet, 0);
+	rover_main();
+	return NAN;
+}
+
+/**
+ *	Run the mission of the reference world; returns how long it took, or
+ *	for arg "r" how long the flight recorder lasts at the rate it was written
+ */
+
+static double mission_time(const void *arg)
+{
+	setup();
+	bench_keys = "f";
+	hal_linux_at(0, send_key, 0);
+	rover_main();
+	if (arg && *(const char *) arg == 'r')
+	{
+		return REC_SIZE * (hal_linux_now() / 1e6) / rec_total();
+	}
+	return hal_linux_now() / 1e6;
+}
+
+/// the screen of the LCD benchmarks; only the sweep number changes
+#define LCD_SCREEN	"Sweep %d\nX: %d  Y: %d\nR: %d\nAngle: %d"
+#define LCD_VALUES	1065, -1179, 1588, -63
+
+/**
+ *	Whether the LCD shows LCD_SCREEN for a sweep number
+ */
+
+static int lcd_shows(int sweep)
+{
+	char text[4][24];
+	snprintf(text[0], sizeof(text[0]), "Sweep %d", sweep);
+	snprintf(text[1], sizeof(text[1]), "X: %d  Y: %d", 1065, -1179);
+	snprintf(text[2], sizeof(text[2]), "R: %d", 1588);
+	snprintf(text[3], sizeof(text[3]), "Angle: %d", -63);
+	for (int line = 0; line < 4; line++)
+	{
+		char want[24];
+		snprintf(want, sizeof(want), "%-20.20s", text[line]);
+		if (strcmp(hal_linux_lcd_line(line), want))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ *	Show a screen on a freshly cleared LCD, then change one digit of it
+ */
+
+static double lcd_update(const void *arg)
+{
+	setup();
+	lcd_init();
+
+	uint64_t start = hal_linux_now();
+	lprintf(LCD_SCREEN, 0, LCD_VALUES);
+	uint64_t blocking = hal_linux_now() - start;
+	while (!lcd_shows(0))
+	{
+		hal_idle();
+	}
+	uint64_t update = hal_linux_now() - start;
+
+	unsigned long writes = hal_linux_lcd_writes();
+	start = hal_linux_now();
+	lprintf(LCD_SCREEN, 1, LCD_VALUES);
+	if (hal_linux_now() - start > blocking)
+	{
+		blocking = hal_linux_now() - start;
+	}
+	while (!lcd_shows(1))
+	{
+		hal_idle();
+	}
+	writes = hal_linux_lcd_writes() - writes;
+
+	switch (*(const char *) arg)
+	{
+	case 'u':
+		return update / 1e3;
+	case 'b':
+		return blocking / 1e3;
+	case 'c':
+		return writes;
+	default:
+		return hal_linux_lcd_overruns();
+	}
+}
+
+/**
+ *	Celebrate as on arriving at the destination
+ */
+
+static double celebration(const void *arg)
+{
+	setup();
+	oi_t *sensor = oi_alloc();
+	oi_init(sensor);
+	music_init();
+
+	unsigned long bytes = create.bytes_in;
+	unsigned long notes = create.notes_played;
+	uint64_t start = hal_linux_now();
+	play_song();
+	uint64_t blocking = hal_linux_now() - start;
+	music_wait();
+	uint64_t length = hal_linux_now() - start;
+
+	switch (*(const char *) arg)
+	{
+	case 'b':
+		return blocking / 1e3;
+	case 'r':
+		return length ? (create.bytes_in - bytes) / (length / 1e6) : NAN;
+	default:
+		return create.notes_played - notes;
+	}
+}
+
+static struct link_parser bench_link;
+static uint64_t frame_sent;
+
+static void feed_byte(unsigned char data)
+{
+	hal_linux_uart0_feed(data);
+}
+
+static void send_frame(uint64_t now, void *arg)
+{
+	unsigned char key = 'r';
+	frame_sent = now;
+	link_send(feed_byte, LINK_COMMAND, 0, &key, 1);
+}
+
+static void watch_ack(unsigned char data)
+{
+	if (link_parse(&bench_link, data) == LINK_FRAME && bench_link.frame.type == LINK_ACK && bench_link.frame.seq == 0)
+	{
+		finish((hal_linux_now() - frame_sent) / 1000.0);
+	}
+}
+
+/**
+ *	Round trip of a command frame while the firmware is busy with a sweep
+ */
+
+static double ack_latency(const void *arg)
+{
+	setup();
+	hal_linux_uart0_connect(watch_ack);
+	bench_keys = "g";
+	hal_linux_at(0, send_key, 0);
+	hal_linux_at(BENCH_FRAME_US, send_frame, 0);
+	rover_main();
+	return NAN;
+}
+
+static uint64_t last_answer;
+static uint64_t longest_gap;
+
+static void watch_answer(unsigned char *frame)
+{
+	uint64_t now = hal_linux_now();
+	if (last_answer && now - last_answer > longest_gap)
+	{
+		longest_gap = now - last_answer;
+	}
+	last_answer = now;
+}
+
+static void power_cycle(uint64_t now, void *arg)
+{
+	create_power_cycle();
+}
+
+static void lose_byte(uint64_t now, void *arg)
+{
+	create_lose(1);
+}
+
+/**
+ *	Drive forward while the Create is switched off and on ("p") or loses a
+ *	byte ("l"); the longest time the control loop went without sensor data
+ */
+
+static double oi_recovery(const void *arg)
+{
+	setup();
+	oi_t *sensor = oi_alloc();
+	oi_init(sensor);
+
+	create_frame_hook(watch_answer);
+	hal_linux_at(hal_linux_now() + BENCH_FAULT_US, *(const char *) arg == 'p' ? power_cycle : lose_byte, 0);
+	move_forward(sensor, BENCH_DRIVE);
+	if (create.resets != (*(const char *) arg == 'p') || create.travelled < BENCH_DRIVE * 0.8)
+	{
+		return NAN;		//the fault never came, or the drive was cut short
+	}
+	return longest_gap / 1e3;
+}
+
+/**
+ *	Calibrate, then turn 90 degrees clockwise; how far the turn is off
+ */
+
+static double calibrated_turn(const void *arg)
+{
+	setup();
+	oi_t *sensor = oi_alloc();
+	oi_init(sensor);
+
+	if (!calibrate(sensor))
+	{
+		return NAN;
+	}
+	double heading = create.heading;
+	turn_clockwise(sensor, 90);
+	for (int i = 0; i < 4; i++)
+	{
+		oi_update(sensor);		//let it coast to a stop
+	}
+	return fabs(heading - create.heading - 90);
+}
+
+static const char *bench_script;	// keys still to send, one command at a time
+static uint64_t script_key_time;	// when the last of them was sent
+static int script_timed;		// report the time of the last command, not the pose
+
+/**
+ *	Send the next key of the script each time the firmware is done with the
+ *	one before
+ */
+
+static void watch_script(uint64_t now, void *arg)
+{
+	if (USART_Available() == 0 && create.left_speed == 0 && create.right_speed == 0 &&
+			now - hal_linux_uart_last_activity() > BENCH_QUIET_US)
+	{
+		if (!*bench_script)
+		{
+			double heading = remainder(create.heading - world.start_heading, 360);
+			if (world.bump_events || fabs(create.y - world.start_y) > BENCH_LINE_OFF)
+			{
+				finish(NAN);
+			}
+			finish(script_timed ? (create.drive_time - script_key_time) / 1e6 : fabs(heading));
+		}
+		script_key_time = now;
+		hal_linux_uart0_feed(*bench_script++);
+	}
+	hal_linux_at(now + BENCH_CHECK_US * 100, watch_script, 0);
+}
+
+/**
+ *	Sweep in front of the first post of the lab world, then drive round it
+ *	with the detour key in arg
+ */
+
+static double detour_pose(const void *arg)
+{
+	static char script[8];
+	world_path = BENCH_LAB_WORLD;
+	setup();
+	snprintf(script, sizeof(script), "%s%s", BENCH_APPROACH, (const char *) arg);
+	bench_script = script;
+	hal_linux_at(0, watch_script, 0);
+	rover_main();
+	return NAN;
+}
+
+static double detour_time(const void *arg)
+{
+	script_timed = 1;
+	return detour_pose("3");
+}
+
+static const struct metric metrics[] = {
+	{"sweep_time", "s", sweep_time, 0},
+	{"control_loop_rate", "Hz", control_loop, 0},
+	{"sensor_update_bytes", "bytes", control_loop, "b"},
+	{"recorder_frame_bytes", "bytes", control_loop, "r"},
+	{"feed_frame_bytes", "bytes", control_loop, "f"},
+	{"bump_stop_latency", "ms", bump_stop, 0},
+	{"stop_key_latency", "ms", stop_key, 0},
+	{"stop_torn_frame_latency", "ms", stop_key, "t"},
+	{"telemetry_r", "bytes", telemetry_bytes, "r"},
+	{"telemetry_w", "bytes", telemetry_bytes, "w"},
+	{"telemetry_g", "bytes", telemetry_bytes, "g"},
+	{"telemetry_g_binary", "bytes", telemetry_bytes, "bg"},
+	{"mission_time", "s", mission_time, 0},
+	{"recorder_retention", "s", mission_time, "r"},
+	{"lcd_update_time", "ms", lcd_update, "u"},
+	{"lcd_blocking_time", "ms", lcd_update, "b"},
+	{"lcd_change_bytes", "bytes", lcd_update, "c"},
+	{"lcd_overruns", "writes", lcd_update, "o"},
+	{"effect_blocking_time", "ms", celebration, "b"},
+	{"effect_serial_rate", "bytes/s", celebration, "r"},
+	{"song_notes", "notes", celebration, "n"},
+	{"link_ack_latency", "ms", ack_latency, 0},
+	{"oi_reset_gap", "ms", oi_recovery, "p"},
+	{"oi_lost_byte_gap", "ms", oi_recovery, "l"},
+	{"detour_left_error", "deg", detour_pose, "1"},
+	{"detour_right_error", "deg", detour_pose, "2"},
+	{"detour_auto_error", "deg", detour_pose, "3"},
+	{"detour_time", "s", detour_time, 0},
+	{"calibrated_turn_error", "deg", calibrated_turn, 0},
+};
+
+/**
+ *	Run one metric in a child process; NAN if it did not finish
+ */
+
+static double measure(const struct metric *m)
+{
+	int fd[2];
+	double value = NAN;
+
+	fflush(stdout);
+	if (pipe(fd))
+	{
+		perror("pipe");
+		return NAN;
+	}
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		close(fd[0]);
+		result_fd = fd[1];
+		finish(m->run(m->arg));
+	}
+	close(fd[1]);
+	if (pid < 0 || read(fd[0], &value, sizeof(value)) != sizeof(value))
+	{
+		value = NAN;
+	}
+	close(fd[0]);
+	if (pid > 0)
+	{
+		waitpid(pid, 0, 0);
+	}
+	return value;
+}
+
+/**
+ *	Read the thresholds file; returns the number of limits, or -1
+ */
+
+static int load_limits(const char *path, struct limit *limits)
+{
+	char line[200];
+	int count = 0;
+	int number = 0;
+
+	FILE *f = fopen(path, "r");
+	if (!f)
+	{
+		perror(path);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f) && count < MAX_LIMITS)
+	{
+		char bound[8];
+		number++;
+		char *hash = strchr(line, '#');
+		if (hash)
+		{
+			*hash = 0;
+		}
+		int n = sscanf(line, "%39s %7s %lf", limits[count].name, bound, &limits[count].value);
+		if (n <= 0)
+		{
+			continue;
+		}
+		if (n != 3 || (strcmp(bound, "max") && strcmp(bound, "min")))
+		{
+			fprintf(stderr, "%s:%d: expected \"metric max|min limit\"\n", path, number);
+			fclose(f);
+			return -1;
+		}
+		limits[count].max = !strcmp(bound, "max");
+		count++;
+	}
+	fclose(f);
+	return count;
+}
+
+int main(int argc, char **argv)
+{
+	const char *limits_path = 0;
+	const char *out_path = 0;
+	struct limit limits[MAX_LIMITS];
+	int limit_count = 0;
+	int failed = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "w:t:o:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'w':
+			world_path = optarg;
+			break;
+		case 't':
+			limits_path = optarg;
+			break;
+		case 'o':
+			out_path = optarg;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-w world] [-t thresholds] [-o results]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (limits_path && (limit_count = load_limits(limits_path, limits)) < 0)
+	{
+		return 2;
+	}
+	FILE *out = out_path ? fopen(out_path, "w") : stdout;
+	if (!out)
+	{
+		perror(out_path);
+		return 2;
+	}
+
+	for (unsigned int i = 0; i < sizeof(metrics) / sizeof(metrics[0]); i++)
+	{
+		const struct metric *m = &metrics[i];
+		const struct limit *l = 0;
+		const char *status = "unchecked";
+		double value = measure(m);
+
+		for (int j = 0; j < limit_count; j++)
+		{
+			if (!strcmp(limits[j].name, m->name))
+			{
+				l = &limits[j];
+			}
+		}
+		if (isnan(value))
+		{
+			status = "failed";
+			failed++;
+		}
+		else if (l && (l->max ? value > l->value : value < l->value))
+		{
+			status = "regressed";
+			failed++;
+		}
+		else if (l)
+		{
+			status = "ok";
+		}
+
+		fprintf(out, "{\"metric\": \"%s\", \"value\": %.3f, \"unit\": \"%s\"", m->name,
+			isnan(value) ? 0.0 : value, m->unit);
+		if (l)
+		{
+			fprintf(out, ", \"%s\": %.3f", l->max ? "max" : "min", l->value);
+		}
+		fprintf(out, ", \"status\": \"%s\"}\n", status);
+		fflush(out);
+
+		if (strcmp(status, "ok") && strcmp(status, "unchecked"))
+		{
+			fprintf(stderr, "bench: %s %s (%.3f %s)\n", m->name, status, value, m->unit);
+		}
+	}
+
+	if (out != stdout)
+	{
+		fclose(out);
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,68 @@
+/**
+ *	@file console.c
+ *	@brief the terminal as the base station on USART0 of the host build
+ *
+ *	Bytes the firmware transmits go to stdout and bytes read from stdin are
+ *	sent to it. Once stdin is closed and the firmware has not read anything
+ *	for ten virtual minutes the program exits.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <unistd.h>
+#include "hal.h"
+
+/// console input is checked this often
+#define CONSOLE_POLL_US		1000
+/// bytes taken from stdin per check, so a long pipe cannot overrun the line
+#define CONSOLE_CHUNK		16
+/// the program ends this long after stdin closed and the firmware stopped reading
+#define CONSOLE_EXIT_US		600000000ULL
+
+static char console_eof;
+
+static void console_tx(unsigned char data)
+{
+	putchar(data);
+	if (data == '\r')
+	{
+		fflush(stdout);
+	}
+}
+
+static void console_poll(uint64_t t, void *arg)
+{
+	if (console_eof)
+	{
+		if (t - hal_linux_uart0_last_read() > CONSOLE_EXIT_US)
+		{
+			fflush(stdout);
+			exit(0);
+		}
+		hal_linux_at(t + CONSOLE_POLL_US, console_poll, 0);
+		return;
+	}
+
+	struct pollfd fd = {0, POLLIN, 0};
+	for (int i = 0; i < CONSOLE_CHUNK && poll(&fd, 1, 0) > 0; i++)
+	{
+		unsigned char data;
+		if (read(0, &data, 1) != 1)
+		{
+			console_eof = 1;
+			break;
+		}
+		hal_linux_uart0_feed(data);
+	}
+	hal_linux_at(t + CONSOLE_POLL_US, console_poll, 0);
+}
+
+__attribute__((constructor))
+static void console_attach(void)
+{
+	hal_linux_uart0_connect(console_tx);
+	hal_linux_at(0, console_poll, 0);
+}
@@ -0,0 +1,363 @@
+/**
+ *	@file create.c
+ *	@brief model of the iRobot Create on the other end of USART1
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hal.h"
+#include "open_interface.h"
+#include "create.h"
+
+#define PI 3.14159265358979
+
+/// the body is moved along this often, in microseconds
+#define CREATE_STEP_US	1000
+
+HAL_LOCAL struct create_model create;
+
+static HAL_LOCAL unsigned char command[64];	// opcode and arguments received so far
+static HAL_LOCAL int command_length;
+static HAL_LOCAL int command_needed;		// total bytes of the command being received
+static HAL_LOCAL uint64_t last_step;
+static HAL_LOCAL unsigned char frame[52];		// packet group 6 being put together
+static HAL_LOCAL int frame_length;
+static HAL_LOCAL create_frame_fn frame_hook;
+static HAL_LOCAL create_drive_fn drive_hook;
+
+/// baud rates of the codes of OI_OPCODE_BAUD
+static const unsigned long baud_rates[] = {300, 600, 1200, 2400, 4800, 9600, 14400, 19200, 28800, 38400, 57600, 115200};
+
+/**
+ *	Number of bytes an Open Interface command takes, including the opcode;
+ *	0 if the length depends on the arguments
+ */
+
+static int command_size(unsigned char opcode)
+{
+	switch (opcode)
+	{
+	case OI_OPCODE_BAUD: case OI_OPCODE_PLAY: case OI_OPCODE_SENSORS:
+	case OI_OPCODE_OUTPUTS: case OI_OPCODE_DO_STREAM: case OI_OPCODE_SEND_IR_CHAR:
+	case OI_OPCODE_WAIT_TIME: case OI_OPCODE_WAIT_EVENT:
+		return 2;
+	case OI_OPCODE_MOTORS:
+		return 2;
+	case OI_OPCODE_LEDS: case OI_OPCODE_PWM_MOTORS:
+		return 4;
+	case OI_OPCODE_DRIVE: case OI_OPCODE_DRIVE_WHEELS: case OI_OPCODE_DRIVE_PWM:
+	case OI_OPCODE_WAIT_DISTANCE: case OI_OPCODE_WAIT_ANGLE:
+		return 5;
+	case OI_OPCODE_SONG:
+		return command_length >= 3 ? 3 + 2 * command[2] : 0;
+	case OI_OPCODE_STREAM: case OI_OPCODE_QUERY_LIST: case OI_OPCODE_SCRIPT:
+		return command_length >= 2 ? 2 + command[1] : 0;
+	default:
+		return 1;
+	}
+}
+
+static void put(unsigned char data)
+{
+	frame[frame_length++] = data;
+}
+
+static void put16(int value)
+{
+	put((value >> 8) & 0xff);
+	put(value & 0xff);
+}
+
+/**
+ *	Answer a query for sensor packet group 6 (packets 7 to 42, 52 bytes)
+ */
+
+static void send_group6(void)
+{
+	frame_length = 0;
+	int distance = (int) lround(create.distance);
+	int angle = (int) lround(create.angle);
+	create.distance -= distance;
+	create.angle -= angle;
+	create.queries++;
+
+	put(create.bumps);			// 7 bumps and wheel drops
+	put(0);					// 8 wall
+	for (int i = 0; i < 4; i++)
+	{
+		put(create.cliff[i]);		// 9-12 cliffs
+	}
+	put(0);					// 13 virtual wall
+	put(0);					// 14 overcurrents
+	put16(0);				// 15-16 unused
+	put(0);					// 17 infrared
+	put(0);					// 18 buttons
+	put16(distance);			// 19 distance
+	put16(angle);				// 20 angle
+	put(0);					// 21 charging state
+	put16(create.voltage);			// 22 voltage
+	put16(0);				// 23 current
+	put(25);				// 24 temperature
+	put16(2500);				// 25 charge
+	put16(2700);				// 26 capacity
+	put16(0);				// 27 wall signal
+	for (int i = 0; i < 4; i++)
+	{
+		put16(create.cliff_signal[i]);	// 28-31 cliff signals
+	}
+	put(0);					// 32 cargo bay digital inputs
+	put16(0);				// 33 cargo bay analog signal
+	put(0);					// 34 charging sources
+	put(create.oi_mode);			// 35 OI mode
+	put(create.song_number);		// 36 song number
+	put(hal_linux_now() < create.song_end);	// 37 song playing
+	put(0);					// 38 stream packets
+	put16((create.right_speed + create.left_speed) / 2);	// 39 requested velocity
+	put16(0);				// 40 requested radius
+	put16(create.right_speed);		// 41 requested right velocity
+	put16(create.left_speed);		// 42 requested left velocity
+
+	if (frame_hook)
+	{
+		frame_hook(frame);
+	}
+	for (int i = 0; i < frame_length; i++)
+	{
+		create.bytes_out++;
+		hal_linux_uart1_feed(frame[i]);
+	}
+}
+
+static void create_step(uint64_t now);
+
+/**
+ *	Keep a song; the Create takes songs 0 to 15 of 1 to 16 notes and
+ *	ignores any other
+ */
+
+static void store_song(void)
+{
+	int slot = command[1];
+	int notes = command[2];
+	if (slot > 15 || notes < 1 || notes > 16)
+	{
+		return;
+	}
+	create.song_length[slot] = notes;
+	create.song_ticks[slot] = 0;
+	for (int i = 0; i < notes; i++)
+	{
+		create.song_ticks[slot] += command[4 + 2 * i];
+	}
+}
+
+/**
+ *	Carry out a complete command
+ */
+
+static void execute(void)
+{
+	int16_t a = (int16_t) (command[1] << 8 | command[2]);
+	int16_t b = (int16_t) (command[3] << 8 | command[4]);
+
+	if (create.oi_mode == 0 && command[0] != OI_OPCODE_START)
+	{
+		return;
+	}
+	switch (command[0])
+	{
+	case OI_OPCODE_START:
+		create.oi_mode = 1;
+		break;
+	case OI_OPCODE_BAUD:
+		if (command[1] < sizeof(baud_rates) / sizeof(baud_rates[0]))
+		{
+			create.baud = baud_rates[command[1]];
+		}
+		break;
+	case OI_OPCODE_SAFE:
+		create.oi_mode = 2;
+		break;
+	case OI_OPCODE_FULL:
+		create.oi_mode = 3;
+		break;
+	case OI_OPCODE_DRIVE_WHEELS:
+		if (drive_hook)
+		{
+			drive_hook(command[0], a, b);
+		}
+		create_step(hal_linux_now());
+		create.drive_time = hal_linux_now();
+		create.right_speed = a;
+		create.left_speed = b;
+		break;
+	case OI_OPCODE_DRIVE:
+		if (drive_hook)
+		{
+			drive_hook(command[0], a, b);
+		}
+		create_step(hal_linux_now());
+		create.drive_time = hal_linux_now();
+		if (b == OI_RADIUS_STRAIGHT || b == 0x7FFF)
+		{
+			create.right_speed = create.left_speed = a;
+		}
+		else if (b == OI_RADIUS_SPIN_CCW)
+		{
+			create.right_speed = a;
+			create.left_speed = -a;
+		}
+		else if (b == OI_RADIUS_SPIN_CW)
+		{
+			create.right_speed = -a;
+			create.left_speed = a;
+		}
+		else
+		{
+			create.right_speed = (int16_t) lround(a * (b + CREATE_WHEELBASE / 2) / b);
+			create.left_speed = (int16_t) lround(a * (b - CREATE_WHEELBASE / 2) / b);
+		}
+		break;
+	case OI_OPCODE_SENSORS:
+		if (command[1] == OI_SENSOR_PACKET_GROUP6)
+		{
+			send_group6();
+		}
+		break;
+	case OI_OPCODE_LEDS:
+		create.leds = command[1];
+		create.led_color = command[2];
+		create.led_intensity = command[3];
+		create.led_commands++;
+		break;
+	case OI_OPCODE_SONG:
+		store_song();
+		break;
+	case OI_OPCODE_PLAY:
+		//a song only starts if it is stored and no other song is playing
+		if (command[1] < 16 && create.song_length[command[1]] && hal_linux_now() >= create.song_end)
+		{
+			create.song_number = command[1];
+			create.song_end = hal_linux_now() + create.song_ticks[command[1]] * 1000000ULL / 64;
+			create.notes_played += create.song_length[command[1]];
+		}
+		break;
+	}
+}
+
+/**
+ *	Receive one byte from the firmware
+ */
+
+static void create_rx(unsigned char data)
+{
+	create.bytes_in++;
+	unsigned long rate = hal_linux_uart1_baud();
+	if (create.lose > 0 || labs((long) rate - (long) create.baud) * 20 > (long) create.baud)
+	{
+		create.lose -= create.lose > 0;
+		create.bytes_lost++;
+		return;
+	}
+	if (command_length < (int) sizeof(command))
+	{
+		command[command_length] = data;
+	}
+	command_length++;
+	command_needed = command_size(command[0]);
+	if (command_needed && command_length >= command_needed)
+	{
+		execute();
+		command_length = 0;
+	}
+}
+
+/**
+ *	Move the body along on the virtual clock
+ */
+
+static void create_step(uint64_t now)
+{
+	double dt = (now - last_step) / 1000000.0;
+	last_step = now;
+	create.travelled += fabs(create.right_speed + create.left_speed) / 2.0 * dt;
+	if (create.right_speed == 0 && create.left_speed == 0)
+	{
+		return;
+	}
+
+	double v = (create.right_speed + create.left_speed) / 2.0;
+	double w = (create.right_speed - create.left_speed) / CREATE_WHEELBASE * 180.0 / PI;
+	double h = create.heading * PI / 180.0;
+
+	create.x += v * dt * cos(h);
+	create.y += v * dt * sin(h);
+	create.heading += w * dt;
+	create.distance += v * dt * create.distance_scale;
+	create.angle += w * dt * create.angle_scale;
+}
+
+static void create_tick(uint64_t now, void *arg)
+{
+	create_step(now);
+	hal_linux_at(now + CREATE_STEP_US, create_tick, 0);
+}
+
+void create_reset(double x, double y, double heading)
+{
+	create.x = x;
+	create.y = y;
+	create.heading = heading;
+	create.right_speed = create.left_speed = 0;
+	create.distance = create.angle = 0;
+	create.travelled = 0;
+	create.voltage = 16000;
+	if (create.distance_scale == 0)
+	{
+		create.distance_scale = create.angle_scale = 1;
+	}
+	last_step = hal_linux_now();
+}
+
+void create_attach(void)
+{
+	create_reset(0, 0, 0);
+	create.baud = 57600;
+	command_length = 0;
+	hal_linux_uart1_connect(create_rx);
+	hal_linux_at(hal_linux_now() + CREATE_STEP_US, create_tick, 0);
+}
+
+void create_power_cycle(void)
+{
+	create_step(hal_linux_now());
+	create.right_speed = create.left_speed = 0;
+	create.oi_mode = 0;
+	create.baud = 57600;
+	memset(create.song_length, 0, sizeof(create.song_length));
+	create.song_end = 0;
+	command_length = 0;
+	create.resets++;
+}
+
+void create_lose(int bytes)
+{
+	create.lose += bytes;
+}
+
+void create_frame_hook(create_frame_fn fn)
+{
+	frame_hook = fn;
+}
+
+void create_drive_hook(create_drive_fn fn)
+{
+	drive_hook = fn;
+}
+
+__attribute__((constructor))
+static void create_constructor(void)
+{
+	create_attach();
+}
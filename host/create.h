@@ -0,0 +1,88 @@
+/**
+ *	@file create.h
+ *	@brief model of the iRobot Create on the other end of USART1
+ *
+ *	The model understands the Open Interface commands the firmware sends,
+ *	drives a differential-drive body on the virtual clock and answers sensor
+ *	queries with packet group 6. Like the real one it starts at 57600 baud
+ *	and in the off mode, where it takes nothing but a start; bytes sent at
+ *	a baud rate more than 5% off its own are lost. Anything that knows about the world around the
+ *	robot (bumpers, cliff sensors, obstacles in the way) writes the sensor
+ *	fields and the pose directly.
+ */
+
+#ifndef CREATE_MODEL_H
+#define CREATE_MODEL_H
+
+#include <stdint.h>
+#include "hal.h"
+
+/// distance between the wheels in millimeters
+#define CREATE_WHEELBASE	258.0
+
+/// state of the simulated Create
+struct create_model{
+	double x;			//position in millimeters
+	double y;
+	double heading;			//degrees, counterclockwise positive
+	int16_t right_speed;		//wheel speeds in mm/s
+	int16_t left_speed;
+	double distance;		//odometry not yet reported, millimeters
+	double angle;			//odometry not yet reported, degrees
+	double travelled;		//total distance driven, millimeters
+	uint64_t drive_time;		//virtual time of the last drive command
+	double distance_scale;		//reported distance per millimeter driven
+	double angle_scale;		//reported angle per degree turned
+
+	uint8_t bumps;			//packet 7: bit 0 right bumper, bit 1 left bumper
+	uint8_t cliff[4];		//left, front left, front right, right
+	uint16_t cliff_signal[4];	//left, front left, front right, right
+	uint8_t oi_mode;		//0 off, 1 passive, 2 safe, 3 full
+	unsigned long baud;
+	uint16_t voltage;		//mV
+
+	uint8_t leds;			//play (bit 1) and advance (bit 3) LEDs
+	uint8_t led_color;		//power LED, 0 green to 255 red
+	uint8_t led_intensity;
+	unsigned long led_commands;	//LEDs commands received
+	uint8_t song_length[16];	//notes stored in each song slot, 0 if empty
+	unsigned int song_ticks[16];	//length of each song in 1/64 s
+	uint8_t song_number;		//packet 36: song playing or last played
+	uint64_t song_end;		//virtual time the song playing ends
+	unsigned long notes_played;	//notes of all songs started
+
+	unsigned long bytes_in;		//bytes received from the firmware
+	unsigned long bytes_out;	//bytes sent to the firmware
+	unsigned long queries;		//sensor queries answered
+	unsigned long bytes_lost;	//bytes from the firmware lost to create_lose() or a wrong baud rate
+	unsigned long resets;		//create_power_cycle() calls
+	int lose;			//bytes from the firmware still to be lost
+};
+
+extern HAL_LOCAL struct create_model create;
+
+/// sees the 52 bytes of every sensor answer before they are sent, and may change them
+typedef void (*create_frame_fn)(unsigned char *frame);
+/// sees every drive command: the opcode and its two arguments
+typedef void (*create_drive_fn)(unsigned char opcode, int16_t a, int16_t b);
+
+/// Put the Create at a pose and clear its odometry
+void create_reset(double x, double y, double heading);
+
+/// Attach the Create to USART1
+void create_attach(void);
+
+/// Switch the Create off and on again: it stops, forgets its songs and
+/// goes back to 57600 baud and the off mode
+void create_power_cycle(void);
+
+/// Lose the next bytes the firmware sends, as a noisy line would
+void create_lose(int bytes);
+
+/// Pass every sensor answer through fn, or through nothing if fn is 0
+void create_frame_hook(create_frame_fn fn);
+
+/// Pass every drive command to fn, or to nothing if fn is 0
+void create_drive_hook(create_drive_fn fn);
+
+#endif
@@ -0,0 +1,187 @@
+/**
+ *	@file fixbench.c
+ *	@brief accuracy and speed of fixmath.c against libm
+ *
+ *	Every function is run over the range the firmware uses it in and
+ *	compared with the libm result in double precision. For each one the
+ *	largest error is checked against its bound; relative errors are taken
+ *	against at least 1, since below that the Q16.16 step of 0.000015 is
+ *	larger than any relative bound. The time per call of the fixed-point
+ *	version and of libm is measured on this machine too. The times only
+ *	compare the two on the host; the AVR has no FPU, so there the gap is
+ *	far wider than here.
+ *
+ *	usage: fixbench
+ *
+ *	Results are printed one JSON object per line. The program exits with
+ *	status 1 if any function is less accurate than its bound.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "fixmath.h"
+
+#define PI		3.14159265358979323846
+#define SAMPLES		20000
+#define REPEATS		50
+
+/// one function under test
+struct check{
+	const char *name;
+	const char *error_unit;		// "abs" or "rel"
+	double bound;
+	double lo, hi;			// range of the first argument
+	double arg2;			// second argument, if any
+	q16_t (*fixed)(q16_t a, q16_t b);
+	double (*exact)(double a, double b);
+};
+
+static q16_t f_mul(q16_t a, q16_t b) { return q16_mul(a, b); }
+static q16_t f_div(q16_t a, q16_t b) { return q16_div(a, b); }
+static q16_t f_sin(q16_t a, q16_t b) { return q16_sin(a); }
+static q16_t f_cos(q16_t a, q16_t b) { return q16_cos(a); }
+static q16_t f_tan(q16_t a, q16_t b) { return q16_tan(a); }
+static q16_t f_atan2(q16_t a, q16_t b) { return q16_atan2(a, b); }
+static q16_t f_sqrt(q16_t a, q16_t b) { return q16_sqrt(a); }
+static q16_t f_log2(q16_t a, q16_t b) { return q16_log2(a); }
+static q16_t f_exp2(q16_t a, q16_t b) { return q16_exp2(a); }
+static q16_t f_pow(q16_t a, q16_t b) { return q16_pow(a, b); }
+
+static double d_mul(double a, double b) { return a * b; }
+static double d_div(double a, double b) { return a / b; }
+static double d_sin(double a, double b) { return sin(a * PI / 180); }
+static double d_cos(double a, double b) { return cos(a * PI / 180); }
+static double d_tan(double a, double b) { return tan(a * PI / 180); }
+static double d_atan2(double a, double b) { return atan2(a, b) * 180 / PI; }
+static double d_sqrt(double a, double b) { return sqrt(a); }
+static double d_log2(double a, double b) { return log2(a); }
+static double d_exp2(double a, double b) { return exp2(a); }
+static double d_pow(double a, double b) { return pow(a, b); }
+
+static const struct check checks[] = {
+	{"q16_mul", "abs", 0.00002, -180, 180, 1.7, f_mul, d_mul},
+	{"q16_div", "abs", 0.00002, -3000, 3000, 17.0, f_div, d_div},
+	{"q16_sin", "abs", 0.00005, -720, 720, 0, f_sin, d_sin},
+	{"q16_cos", "abs", 0.00005, -720, 720, 0, f_cos, d_cos},
+	{"q16_tan", "rel", 0.0005, -75, 75, 0, f_tan, d_tan},
+	{"q16_atan2", "abs", 0.002, -1000, 1000, -250, f_atan2, d_atan2},
+	{"q16_sqrt", "rel", 0.00002, 1, 30000, 0, f_sqrt, d_sqrt},
+	{"q16_log2", "abs", 0.0001, 0.01, 30000, 0, f_log2, d_log2},
+	{"q16_exp2", "rel", 0.0001, -10, 14, 0, f_exp2, d_exp2},
+	{"q16_pow", "rel", 0.0005, 20, 1000, -1.376, f_pow, d_pow},
+};
+
+static double elapsed_ns(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1e9 + (b->tv_nsec - a->tv_nsec);
+}
+
+int main(void)
+{
+	static q16_t in[SAMPLES];
+	static double din[SAMPLES];
+	int failed = 0;
+
+	for (unsigned int c = 0; c < sizeof(checks) / sizeof(checks[0]); c++)
+	{
+		const struct check *k = &checks[c];
+		q16_t b = Q16(k->arg2);
+		double worst = 0;
+		double worst_at = 0;
+
+		for (int i = 0; i < SAMPLES; i++)
+		{
+			double a = k->lo + (k->hi - k->lo) * i / (SAMPLES - 1);
+			in[i] = (q16_t) lround(a * 65536);
+			din[i] = in[i] / 65536.0;
+
+			double want = k->exact(din[i], b / 65536.0);
+			double got = k->fixed(in[i], b) / 65536.0;
+			double err = fabs(got - want);
+			if (k->error_unit[0] == 'r')
+			{
+				err /= fabs(want) > 1 ? fabs(want) : 1;	// below 1 the Q16 step dominates
+			}
+			if (err > worst)
+			{
+				worst = err;
+				worst_at = din[i];
+			}
+		}
+
+		struct timespec t0, t1, t2;
+		volatile q16_t fsink = 0;
+		volatile double dsink = 0;
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (int r = 0; r < REPEATS; r++)
+		{
+			for (int i = 0; i < SAMPLES; i++)
+			{
+				fsink += k->fixed(in[i], b);
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		for (int r = 0; r < REPEATS; r++)
+		{
+			for (int i = 0; i < SAMPLES; i++)
+			{
+				dsink += k->exact(din[i], k->arg2);
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t2);
+
+		const char *status = worst > k->bound ? "inaccurate" : "ok";
+		if (worst > k->bound)
+		{
+			failed++;
+			fprintf(stderr, "fixbench: %s is off by %g (%s) at %g\n", k->name, worst, k->error_unit, worst_at);
+		}
+		printf("{\"function\": \"%s\", \"max_error\": %.3g, \"error\": \"%s\", \"bound\": %g, "
+			"\"ns_fixed\": %.1f, \"ns_libm\": %.1f, \"status\": \"%s\"}\n",
+			k->name, worst, k->error_unit, k->bound,
+			elapsed_ns(&t0, &t1) / (REPEATS * SAMPLES), elapsed_ns(&t1, &t2) / (REPEATS * SAMPLES), status);
+	}
+
+	//isqrt32 must be exact
+	unsigned long wrong = 0;
+	for (uint32_t n = 0; n < 4000000000UL; n += 65521)
+	{
+		uint32_t r = isqrt32(n);
+		if ((uint64_t) r * r > n || (uint64_t) (r + 1) * (r + 1) <= n)
+		{
+			wrong++;
+		}
+	}
+	printf("{\"function\": \"isqrt32\", \"wrong\": %lu, \"status\": \"%s\"}\n", wrong, wrong ? "inaccurate" : "ok");
+	if (wrong)
+	{
+		failed++;
+	}
+
+	//q16_format must match "%.2f"
+	char mine[16], theirs[16];
+	unsigned long mismatched = 0;
+	for (int32_t v = -2000000; v <= 2000000; v += 37)
+	{
+		if ((int64_t) v * 100 % 65536 == 32768 || (int64_t) v * 100 % 65536 == -32768)
+		{
+			continue;	// exact halves: printf rounds them to even, q16_format away from zero
+		}
+		q16_format(mine, v);
+		snprintf(theirs, sizeof(theirs), "%.2f", v / 65536.0);
+		mismatched += strcmp(mine, theirs) != 0 && strcmp(theirs, "-0.00") != 0;
+	}
+	printf("{\"function\": \"q16_format\", \"mismatched\": %lu, \"status\": \"%s\"}\n",
+		mismatched, mismatched ? "inaccurate" : "ok");
+	if (mismatched)
+	{
+		failed++;
+	}
+
+	return failed ? 1 : 0;
+}
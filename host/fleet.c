@@ -0,0 +1,364 @@
+/**
+ *	@file fleet.c
+ *	@brief runs many simulated rovers at once, each the unchanged firmware
+ *	against its own Create model and course, on a work-stealing pool
+ *
+ *	usage: fleet [-n rovers] [-j workers] [-t seconds] [-T bands] [-v] [-m "world script"]...
+ *
+ *	Rover k runs mission k mod the number of missions (a world file and a
+ *	sim script) with seed k / missions + 1, so the rovers of a mission
+ *	differ only in their sensor noise, and each one runs exactly as
+ *	"sim -s seed -w world script" would. Without -m the missions are the
+ *	seeks of the reference world tune uses and a sweep and detour on the
+ *	lab course.
+ *
+ *	All state of the firmware, the simulated peripherals, the Create and
+ *	the course is HAL_LOCAL (thread-local on the host), so every rover runs
+ *	on a thread of its own and shares nothing with the others: each starts
+ *	from the program's initial state, as after a reset. The rovers do not
+ *	see each other; each has the course to itself.
+ *
+ *	-j workers (all cores by default) run the rovers. Each worker starts
+ *	with an even share in a deque of its own, runs them from the back, one
+ *	at a time, and when it runs out takes from the front of another
+ *	worker's, so long missions do not leave cores idle at the end.
+ *
+ *	Per mission it prints, as JSON, how many rovers reached the
+ *	destination and how fast, and their false stops and missed hazards
+ *	(as sim counts them); -v adds a line per rover. The last line gives
+ *	simulated rover-seconds per wall-clock second.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "hal.h"
+#include "create.h"
+#include "world.h"
+#include "mission.h"
+
+#define MAX_MISSIONS	32
+#define MAX_WORKERS	256
+#define MAX_WORDS	64
+/// how often a rover is checked for being done, in microseconds
+#define FLEET_CHECK_US	100000
+/// default time limit of a rover in seconds, as sim's
+#define FLEET_LIMIT	600
+/// stack of a rover's thread; the firmware needs little
+#define FLEET_STACK	(256 * 1024)
+
+int rover_main(void);
+
+/// one rover and how its run went
+struct rover{
+	int mission;
+	uint64_t seed;
+	int worker;			// that ran it
+	char stolen;			// taken from another worker's deque
+	const char *result;		// complete, idle, timeout or failed
+	double time;			// virtual seconds it ran
+	double goal;			// virtual seconds to the destination, 0 if never
+	unsigned long false_stops, missed, bumps;
+	double travelled;		// mm
+};
+
+/// a worker of the pool and its deque of rovers to run
+struct worker{
+	pthread_t thread;
+	pthread_mutex_t lock;
+	int *deque;
+	int head, tail;			// front and back; empty when equal
+	unsigned long ran, stolen;
+};
+
+static const char *default_missions[] = {
+	"worlds/reference.world f",
+	"worlds/reference.world aaa f",
+	"worlds/reference.world ddd f",
+	"worlds/reference.world dddddd f",
+	"worlds/reference.world x f",
+	"worlds/lab.world g 3 f",
+};
+
+static const char *missions[MAX_MISSIONS];
+static int mission_count;
+static struct rover *rovers;
+static struct worker workers[MAX_WORKERS];
+static int worker_count;
+static double limit = FLEET_LIMIT;
+static const char *bands;
+
+/// the rover of this thread
+static HAL_LOCAL struct rover *self;
+static HAL_LOCAL uint64_t script_end;
+static HAL_LOCAL char line[256];
+static HAL_LOCAL size_t line_length;
+
+/**
+ *	Record how the rover of this thread did and end its thread
+ */
+
+static void finish(const char *result)
+{
+	self->result = result;
+	self->time = hal_linux_now() / 1e6;
+	self->goal = world.goal_time / 1e6;
+	self->false_stops = world.false_stops;
+	self->missed = world.missed_events;
+	self->bumps = world.bump_events;
+	self->travelled = create.travelled;
+	pthread_exit(0);
+}
+
+static void base_station_rx(unsigned char data)
+{
+	if (data == '\n')
+	{
+		line[line_length] = '\0';
+		mission_text(line);
+		line_length = 0;
+	}
+	else if (data != '\r' && line_length < sizeof(line) - 1)
+	{
+		line[line_length++] = data;
+	}
+}
+
+static void send_key(uint64_t now, void *arg)
+{
+	hal_linux_uart0_feed((unsigned char) (uintptr_t) arg);
+}
+
+static void time_limit(uint64_t now, void *arg)
+{
+	finish("timeout");
+}
+
+static void check_done(uint64_t now, void *arg)
+{
+	if (mission_idle(now, script_end))
+	{
+		finish("idle");
+	}
+	hal_linux_at(now + FLEET_CHECK_US, check_done, 0);
+}
+
+/**
+ *	A rover's thread: the course, the script and the firmware, from scratch
+ */
+
+static void *run_rover(void *arg)
+{
+	self = arg;
+	self->result = "failed";
+
+	char words[512];
+	char *argv[MAX_WORDS];
+	int argc = 0;
+	snprintf(words, sizeof(words), "%s", missions[self->mission]);
+	for (char *save, *w = strtok_r(words, " ", &save); w && argc < MAX_WORDS; w = strtok_r(0, " ", &save))
+	{
+		argv[argc++] = w;
+	}
+
+	char spec[512];
+	snprintf(spec, sizeof(spec), "%s", bands ? bands : "");
+	int64_t end = argc == 0 || world_load(argv[0]) || (bands && mission_bands(spec)) ? -1 :
+		mission_schedule(argc - 1, argv + 1, send_key);
+	if (end < 0)
+	{
+		return 0;
+	}
+	script_end = end;
+
+	//the Create attaches itself to the main thread's USART1 only
+	create_attach();
+	world_seed(self->seed);
+	world_attach();
+	hal_linux_uart0_connect(base_station_rx);
+	hal_linux_at((uint64_t) (limit * 1e6), time_limit, 0);
+	hal_linux_at(FLEET_CHECK_US, check_done, 0);
+	rover_main();
+	finish("complete");
+	return 0;
+}
+
+/**
+ *	Take the next rover for a worker: its own newest, or another's oldest; -1 if there are none left
+ */
+
+static int next_rover(struct worker *w, char *stolen)
+{
+	int r = -1;
+	pthread_mutex_lock(&w->lock);
+	if (w->head != w->tail)
+	{
+		r = w->deque[--w->tail];
+	}
+	pthread_mutex_unlock(&w->lock);
+	*stolen = 0;
+
+	for (int i = 1; r < 0 && i < worker_count; i++)
+	{
+		struct worker *victim = &workers[(w - workers + i) % worker_count];
+		pthread_mutex_lock(&victim->lock);
+		if (victim->head != victim->tail)
+		{
+			r = victim->deque[victim->head++];
+			*stolen = 1;
+		}
+		pthread_mutex_unlock(&victim->lock);
+	}
+	return r;
+}
+
+static void *work(void *arg)
+{
+	struct worker *w = arg;
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, FLEET_STACK);
+
+	char stolen;
+	for (int r; (r = next_rover(w, &stolen)) >= 0; )
+	{
+		//a new thread for every rover, so its state starts out as after a reset
+		pthread_t thread;
+		rovers[r].worker = w - workers;
+		rovers[r].stolen = stolen;
+		if (pthread_create(&thread, &attr, run_rover, &rovers[r]) == 0)
+		{
+			pthread_join(thread, 0);
+		}
+		w->ran++;
+		w->stolen += stolen;
+	}
+	pthread_attr_destroy(&attr);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	long count = 100;
+	long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	int verbose = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:j:t:T:vm:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			count = atol(optarg);
+			break;
+		case 'j':
+			jobs = atol(optarg);
+			break;
+		case 't':
+			limit = atof(optarg);
+			break;
+		case 'T':
+			bands = optarg;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		case 'm':
+			if (mission_count < MAX_MISSIONS)
+			{
+				missions[mission_count++] = optarg;
+			}
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n rovers] [-j workers] [-t seconds] [-T bands] [-v] [-m \"world script\"]...\n", argv[0]);
+			return 2;
+		}
+	}
+	if (mission_count == 0)
+	{
+		mission_count = sizeof(default_missions) / sizeof(default_missions[0]);
+		memcpy(missions, default_missions, sizeof(default_missions));
+	}
+	if (count < 1 || limit <= 0)
+	{
+		fprintf(stderr, "fleet: -n and -t must be positive\n");
+		return 2;
+	}
+	worker_count = jobs < 1 ? 1 : jobs > MAX_WORKERS ? MAX_WORKERS : jobs;
+
+	//deal the rovers out to the workers' deques
+	rovers = calloc(count, sizeof(*rovers));
+	for (int i = 0; i < worker_count; i++)
+	{
+		pthread_mutex_init(&workers[i].lock, 0);
+		workers[i].deque = malloc(count * sizeof(int));
+	}
+	for (long k = 0; k < count; k++)
+	{
+		rovers[k].mission = k % mission_count;
+		rovers[k].seed = k / mission_count + 1;
+		struct worker *w = &workers[k % worker_count];
+		w->deque[w->tail++] = k;
+	}
+
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (int i = 0; i < worker_count; i++)
+	{
+		pthread_create(&workers[i].thread, 0, work, &workers[i]);
+	}
+	for (int i = 0; i < worker_count; i++)
+	{
+		pthread_join(workers[i].thread, 0);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	double wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+	double rover_seconds = 0;
+	int failed = 0;
+	unsigned long stolen = 0;
+	for (long k = 0; k < count; k++)
+	{
+		struct rover *r = &rovers[k];
+		rover_seconds += r->time;
+		failed += !strcmp(r->result, "failed");
+		if (verbose)
+		{
+			printf("{\"rover\": %ld, \"mission\": %d, \"seed\": %llu, \"worker\": %d, \"stolen\": %s, \"result\": \"%s\", "
+				"\"time\": %.3f, \"goal\": %.3f, \"false_stops\": %lu, \"missed\": %lu, \"bumps\": %lu, \"travelled\": %.0f}\n",
+				k, r->mission, (unsigned long long) r->seed, r->worker, r->stolen ? "true" : "false", r->result,
+				r->time, r->goal, r->false_stops, r->missed, r->bumps, r->travelled);
+		}
+	}
+	for (int m = 0; m < mission_count; m++)
+	{
+		int n = 0, goals = 0;
+		double goal_time = 0;
+		unsigned long false_stops = 0, missed = 0, bumps = 0;
+		for (long k = m; k < count; k += mission_count)
+		{
+			n++;
+			goals += rovers[k].goal > 0;
+			goal_time += rovers[k].goal;
+			false_stops += rovers[k].false_stops;
+			missed += rovers[k].missed;
+			bumps += rovers[k].bumps;
+		}
+		printf("{\"mission\": \"%s\", \"rovers\": %d, \"goals\": %d, \"mean_goal_time\": %.3f, "
+			"\"false_stops\": %lu, \"missed\": %lu, \"bumps\": %lu}\n",
+			missions[m], n, goals, goals ? goal_time / goals : 0, false_stops, missed, bumps);
+	}
+	for (int i = 0; i < worker_count; i++)
+	{
+		stolen += workers[i].stolen;
+	}
+	printf("{\"rovers\": %ld, \"failed\": %d, \"workers\": %d, \"stolen\": %lu, \"wall\": %.3f, "
+		"\"rover_seconds\": %.1f, \"rover_seconds_per_second\": %.0f}\n",
+		count, failed, worker_count, stolen, wall, rover_seconds, wall > 0 ? rover_seconds / wall : 0);
+	return failed ? 1 : 0;
+}
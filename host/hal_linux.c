@@ -0,0 +1,764 @@
+/**
+ *	@file hal_linux.c
+ *	@brief Linux backend of the hardware abstraction layer
+ *
+ *	Register state is kept the way the ATmega128 keeps it (TIMSK bits, the
+ *	Timer1 edge select) so side effects such as send_pulse() masking the
+ *	Timer1 interrupts behave as they do on the robot.
+ *
+ *	Time only moves in hal_idle(), which jumps to the earliest pending event.
+ *	If the firmware busy-waits while no event is pending it would wait forever
+ *	on the robot too, so the program reports it and exits.
+ *
+ *	Serial lines are timed from the baud rate the firmware programs: a byte
+ *	the firmware writes reaches the device one frame time later, and the
+ *	writer stalls once the transmit buffer is full, as it does on the AVR.
+ *
+ *	Port A drives a model of the HD44780 LCD controller. It latches the data
+ *	lines on each falling edge of E, keeps the display RAM, and counts the
+ *	writes that arrive before the previous one has had its execution time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "hal.h"
+
+#define TIMSK_TOIE1	0x04	// Timer1 overflow interrupt
+#define TIMSK_TICIE1	0x20	// Timer1 input capture interrupt
+#define TIMSK_OCIE2	0x80	// Timer2 compare interrupt
+#define TIMSK_OCIE0	0x02	// Timer0 compare interrupt
+
+#define MAX_EVENTS	1024
+#define UART_QUEUE	256
+
+/// CPU clock of the ATmega128 in Hz
+#define F_CPU_HZ	16000000.0
+
+// HD44780 on port A: D4-D7 on PA0-PA3, RS on PA4, E on PA6
+#define LCD_E		0x40
+#define LCD_RS		0x10
+#define LCD_EXEC_US	37	// execution time of a write
+#define LCD_SLOW_US	1520	// ... of clear and return home
+/// delay between the end of the trigger pulse and the start of the echo
+#define SONAR_HOLDOFF_US	750
+/// time for one ADC conversion (13 cycles at 125 kHz)
+#define ADC_CONVERSION_US	104
+/// one period of Timer1 (65536 counts at 2 MHz)
+#define TIMER1_PERIOD_US	32768
+
+/// one entry of the event queue
+struct event{
+	uint64_t when;
+	unsigned long seq;		// breaks ties in the order events were scheduled
+	hal_linux_event_fn fn;
+	void *arg;
+};
+
+/// one direction pair of a USART and the device on its far end
+struct uart_line{
+	hal_linux_tx_fn tx;		// device receiving what the firmware writes
+	unsigned int frame_us;		// time one byte takes on the line
+	uint64_t tx_done;		// when the last byte written finishes
+	uint64_t rx_free;		// when the last byte fed finishes arriving
+	unsigned char rx_data[UART_QUEUE];
+	uint64_t rx_at[UART_QUEUE];	// arrival time of each fed byte
+	unsigned int rx_head, rx_tail;
+};
+
+static HAL_LOCAL uint64_t now;
+static HAL_LOCAL char interrupts;
+static HAL_LOCAL unsigned char timsk;
+
+static HAL_LOCAL struct event queue[MAX_EVENTS];	// binary heap ordered by (when, seq)
+static HAL_LOCAL int queued;
+static HAL_LOCAL unsigned long scheduled;
+static HAL_LOCAL unsigned long ran;
+
+static HAL_LOCAL struct uart_line uart0 = {0, 193};
+static HAL_LOCAL struct uart_line uart1 = {0, 174};
+static HAL_LOCAL unsigned long uart1_rate = 57600;	// baud USART1 is set to
+static HAL_LOCAL unsigned char uart0_rxcie;
+static HAL_LOCAL unsigned char uart0_data;
+static HAL_LOCAL uint64_t uart0_read_at;
+static HAL_LOCAL uint64_t uart_activity;
+
+// Timer2
+static HAL_LOCAL char timer2_running;
+static HAL_LOCAL unsigned long timer2_gen;
+static HAL_LOCAL uint64_t timer2_period;
+static HAL_LOCAL uint64_t timer2_cleared;		// when the count last went back to 0
+
+// Timer0
+static HAL_LOCAL unsigned long timer0_gen;
+static HAL_LOCAL uint64_t timer0_period;
+
+// Timer1 and the sonar
+static HAL_LOCAL unsigned long timer1_gen;
+static HAL_LOCAL uint64_t timer1_origin;
+static HAL_LOCAL unsigned char capture_rising = 1;
+static HAL_LOCAL unsigned int icr1;
+static HAL_LOCAL double sonar_cm = 100;
+static HAL_LOCAL hal_linux_sample_fn sonar_source;
+static HAL_LOCAL unsigned long echo_gen;
+
+// Timer3, ADC and port A
+static HAL_LOCAL unsigned int servo_pulse;
+static HAL_LOCAL unsigned int adc_value = 100;
+static HAL_LOCAL hal_linux_sample_fn adc_source;
+static HAL_LOCAL uint64_t adc_done;
+static HAL_LOCAL unsigned char porta;
+
+// LCD controller
+static HAL_LOCAL char lcd_ddram[128];
+static HAL_LOCAL unsigned char lcd_address;
+static HAL_LOCAL char lcd_four_bit;
+static HAL_LOCAL char lcd_half;			// the high nibble of a byte has been latched
+static HAL_LOCAL unsigned char lcd_high;
+static HAL_LOCAL uint64_t lcd_ready_at;
+static HAL_LOCAL unsigned long lcd_writes;
+static HAL_LOCAL unsigned long lcd_overruns;
+
+/**
+ *	Heap order: earlier events first, equal times in scheduling order
+ */
+
+static int before(const struct event *a, const struct event *b)
+{
+	return a->when < b->when || (a->when == b->when && a->seq < b->seq);
+}
+
+void hal_linux_at(uint64_t when, hal_linux_event_fn fn, void *arg)
+{
+	if (queued == MAX_EVENTS)
+	{
+		fprintf(stderr, "hal_linux: event queue full at %llu us\n", (unsigned long long) now);
+		exit(3);
+	}
+	struct event e = {when < now ? now : when, scheduled++, fn, arg};
+	int i = queued++;
+	while (i > 0 && before(&e, &queue[(i - 1) / 2]))
+	{
+		queue[i] = queue[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	queue[i] = e;
+}
+
+static struct event pop(void)
+{
+	struct event top = queue[0];
+	struct event last = queue[--queued];
+	int i = 0;
+	for (;;)
+	{
+		int c = 2 * i + 1;
+		if (c >= queued)
+		{
+			break;
+		}
+		if (c + 1 < queued && before(&queue[c + 1], &queue[c]))
+		{
+			c++;
+		}
+		if (!before(&queue[c], &last))
+		{
+			break;
+		}
+		queue[i] = queue[c];
+		i = c;
+	}
+	queue[i] = last;
+	return top;
+}
+
+/**
+ *	Jump the virtual clock to the next event and run everything due by then
+ */
+
+void hal_idle(void)
+{
+	if (queued == 0)
+	{
+		fprintf(stderr, "hal_linux: the firmware is waiting for something that will never happen (t = %llu us)\n",
+			(unsigned long long) now);
+		exit(3);
+	}
+	if (queue[0].when > now)
+	{
+		now = queue[0].when;
+	}
+	while (queued && queue[0].when <= now)
+	{
+		struct event e = pop();
+		ran++;
+		if (e.fn)
+		{
+			e.fn(now, e.arg);
+		}
+	}
+}
+
+/**
+ *	Time one frame of 1 start bit, 8 data bits and stop bits takes at a baud rate
+ */
+
+static unsigned int frame_time(double baud, int stop_bits)
+{
+	return (unsigned int) ((9 + stop_bits) * 1000000.0 / baud + 0.5);
+}
+
+/**
+ *	Hand the bytes that arrived on USART0 to the receive interrupt
+ */
+
+static void uart0_deliver(void)
+{
+	while (interrupts && uart0_rxcie && uart0.rx_head != uart0.rx_tail &&
+			uart0.rx_at[uart0.rx_tail] <= now)
+	{
+		uart0_data = uart0.rx_data[uart0.rx_tail];
+		uart0.rx_tail = (uart0.rx_tail + 1) % UART_QUEUE;
+		USART0_RX_vect();
+	}
+}
+
+static void uart0_arrived(uint64_t t, void *arg)
+{
+	uart_activity = t;
+	uart0_deliver();
+}
+
+/**
+ *	Byte the firmware wrote has finished on the line; give it to the device
+ */
+
+static void uart0_sent(uint64_t t, void *arg)
+{
+	uart_activity = t;
+	if (uart0.tx)
+	{
+		uart0.tx((unsigned char) (uintptr_t) arg);
+	}
+}
+
+static void uart1_sent(uint64_t t, void *arg)
+{
+	uart_activity = t;
+	if (uart1.tx)
+	{
+		uart1.tx((unsigned char) (uintptr_t) arg);
+	}
+}
+
+/**
+ *	Start a byte on the transmit side of a line. The AVR has one byte of
+ *	buffer behind the shift register, so the writer waits while a byte is
+ *	still queued behind the one being shifted out.
+ */
+
+static void uart_write(struct uart_line *line, hal_linux_event_fn sent, unsigned char data)
+{
+	while (line->tx_done > now + line->frame_us)
+	{
+		hal_idle();
+	}
+	line->tx_done = (line->tx_done > now ? line->tx_done : now) + line->frame_us;
+	hal_linux_at(line->tx_done, sent, (void *) (uintptr_t) data);
+}
+
+/**
+ *	Queue a byte from the device; it arrives once the line is free and one
+ *	frame time has passed
+ */
+
+static void uart_feed(struct uart_line *line, hal_linux_event_fn arrived, unsigned char data)
+{
+	unsigned int next = (line->rx_head + 1) % UART_QUEUE;
+	if (next == line->rx_tail)
+	{
+		return;		// overrun: the byte is lost
+	}
+	line->rx_free = (line->rx_free > now ? line->rx_free : now) + line->frame_us;
+	line->rx_data[line->rx_head] = data;
+	line->rx_at[line->rx_head] = line->rx_free;
+	line->rx_head = next;
+	hal_linux_at(line->rx_free, arrived, line);
+}
+
+void hal_interrupts_enable(void)
+{
+	interrupts = 1;
+	uart0_deliver();
+}
+
+unsigned char hal_interrupts_disable(void)
+{
+	unsigned char state = interrupts;
+	interrupts = 0;
+	return state;
+}
+
+void hal_interrupts_restore(unsigned char state)
+{
+	if (state)
+	{
+		hal_interrupts_enable();
+	}
+	else
+	{
+		interrupts = 0;
+	}
+}
+
+void hal_uart0_init(unsigned int ubrr)
+{
+	//double speed mode, two stop bits
+	uart0.frame_us = frame_time(F_CPU_HZ / 8 / (ubrr + 1), 2);
+	uart0_rxcie = 1;
+}
+
+void hal_uart0_write(unsigned char data)
+{
+	uart_write(&uart0, uart0_sent, data);
+}
+
+unsigned char hal_uart0_read(void)
+{
+	uart0_read_at = now;
+	return uart0_data;
+}
+
+void hal_uart1_init(unsigned char ubrr)
+{
+	hal_uart1_baud(ubrr);
+	uart1.rx_head = uart1.rx_tail = 0;
+}
+
+void hal_uart1_baud(unsigned char ubrr)
+{
+	uart1.frame_us = frame_time(F_CPU_HZ / 16 / (ubrr + 1), 1);
+	uart1_rate = F_CPU_HZ / 16 / (ubrr + 1);
+}
+
+void hal_uart1_write(unsigned char data)
+{
+	uart_write(&uart1, uart1_sent, data);
+}
+
+unsigned char hal_uart1_ready(void)
+{
+	return uart1.rx_head != uart1.rx_tail && uart1.rx_at[uart1.rx_tail] <= now;
+}
+
+unsigned char hal_uart1_read(void)
+{
+	unsigned char data = 0;
+	if (hal_uart1_ready())
+	{
+		data = uart1.rx_data[uart1.rx_tail];
+		uart1.rx_tail = (uart1.rx_tail + 1) % UART_QUEUE;
+	}
+	return data;
+}
+
+static void timer2_compare(uint64_t t, void *arg)
+{
+	if (!timer2_running || (unsigned long) (uintptr_t) arg != timer2_gen)
+	{
+		return;
+	}
+	timer2_cleared = t;
+	hal_linux_at(t + timer2_period, timer2_compare, arg);
+	if (interrupts && (timsk & TIMSK_OCIE2))
+	{
+		TIMER2_COMP_vect();
+	}
+}
+
+void hal_timer2_start(char unit, unsigned char compare)
+{
+	//prescaler 64 (4 us per count) for unit 0, 1 (62.5 ns per count) for unit 1;
+	//CTC mode counts compare + 1 times per period
+	timer2_period = unit == 0 ? (compare + 1) * 4ULL : (compare + 16) / 16;
+	if (timer2_period == 0)
+	{
+		timer2_period = 1;
+	}
+	timer2_running = 1;
+	timer2_cleared = now;
+	timer2_gen++;
+	timsk |= TIMSK_OCIE2;
+	hal_linux_at(now + timer2_period, timer2_compare, (void *) (uintptr_t) timer2_gen);
+}
+
+void hal_timer2_stop(void)
+{
+	timsk &= ~TIMSK_OCIE2;
+	timer2_running = 0;
+}
+
+unsigned char hal_timer2_count(void)
+{
+	//only the 4 us counts of unit 0 are modelled
+	return timer2_running ? (unsigned char) ((now - timer2_cleared) / 4) : 0;
+}
+
+static void timer0_compare(uint64_t t, void *arg)
+{
+	if ((unsigned long) (uintptr_t) arg != timer0_gen)
+	{
+		return;
+	}
+	hal_linux_at(t + timer0_period, timer0_compare, arg);
+	if (interrupts && (timsk & TIMSK_OCIE0))
+	{
+		TIMER0_COMP_vect();
+	}
+}
+
+void hal_timer0_start(unsigned char compare)
+{
+	//prescaler 8: 0.5 us per count, compare + 1 counts per interrupt
+	timer0_period = (compare + 2) / 2;
+	timer0_gen++;
+	timsk |= TIMSK_OCIE0;
+	hal_linux_at(now + timer0_period, timer0_compare, (void *) (uintptr_t) timer0_gen);
+}
+
+void hal_timer0_stop(void)
+{
+	timsk &= ~TIMSK_OCIE0;
+	timer0_gen++;
+}
+
+/**
+ *	Current Timer1 count; it runs at 2 MHz (16 MHz, prescaler 8)
+ */
+
+static unsigned int timer1_count(void)
+{
+	return (unsigned int) (((now - timer1_origin) * 2) & 0xFFFF);
+}
+
+static void timer1_overflow(uint64_t t, void *arg)
+{
+	if ((unsigned long) (uintptr_t) arg != timer1_gen)
+	{
+		return;
+	}
+	hal_linux_at(t + TIMER1_PERIOD_US, timer1_overflow, arg);
+	if (interrupts && (timsk & TIMSK_TOIE1))
+	{
+		TIMER1_OVF_vect();
+	}
+}
+
+/**
+ *	An edge of the echo reached the input capture pin; arg tells rising
+ *	(odd) from falling (even) and which pulse it belongs to
+ */
+
+static void echo_edge(uint64_t t, void *arg)
+{
+	unsigned long code = (unsigned long) (uintptr_t) arg;
+	if (code / 2 != echo_gen)
+	{
+		return;
+	}
+	if (interrupts && (timsk & TIMSK_TICIE1) && capture_rising == (code & 1))
+	{
+		icr1 = timer1_count();
+		TIMER1_CAPT_vect();
+	}
+}
+
+void hal_sonar_init(void)
+{
+	timer1_gen++;
+	timer1_origin = now;
+	capture_rising = 1;
+	timsk |= TIMSK_TICIE1 | TIMSK_TOIE1;
+	hal_linux_at(now + TIMER1_PERIOD_US, timer1_overflow, (void *) (uintptr_t) timer1_gen);
+}
+
+unsigned char hal_sonar_rising(void)
+{
+	return capture_rising;
+}
+
+unsigned int hal_sonar_capture(void)
+{
+	return icr1;
+}
+
+void hal_sonar_edge(char rising)
+{
+	capture_rising = rising ? 1 : 0;
+}
+
+void hal_sonar_pulse_start(void)
+{
+	timsk &= ~(TIMSK_TICIE1 | TIMSK_TOIE1);
+}
+
+void hal_sonar_pulse_end(void)
+{
+	//the firmware reads (width in ms) * 17 - 30 as the distance in centimeters
+	double cm = sonar_source ? sonar_source() : sonar_cm;
+	uint64_t rise = now + SONAR_HOLDOFF_US;
+	uint64_t fall = rise + (uint64_t) ((cm + 30) / 17.0 * 1000.0);
+
+	echo_gen++;
+	hal_linux_at(rise, echo_edge, (void *) (uintptr_t) (echo_gen * 2 + 1));
+	hal_linux_at(fall, echo_edge, (void *) (uintptr_t) (echo_gen * 2));
+	timsk |= TIMSK_TICIE1 | TIMSK_TOIE1;
+}
+
+void hal_servo_init(unsigned int period, unsigned int pulse)
+{
+	servo_pulse = pulse;
+}
+
+void hal_servo_set(unsigned int pulse)
+{
+	servo_pulse = pulse;
+}
+
+void hal_adc_init(void)
+{
+}
+
+void hal_adc_start(void)
+{
+	if (adc_source)
+	{
+		double value = adc_source();
+		adc_value = value < 0 ? 0 : value > 1023 ? 1023 : (unsigned int) (value + 0.5);
+	}
+	adc_done = now + ADC_CONVERSION_US;
+	hal_linux_at(adc_done, 0, 0);
+}
+
+unsigned char hal_adc_busy(void)
+{
+	return now < adc_done;
+}
+
+unsigned int hal_adc_read(void)
+{
+	return adc_value;
+}
+
+/**
+ *	The LCD controller carries out one byte
+ */
+
+static void lcd_byte(unsigned char data, char rs)
+{
+	uint64_t busy = LCD_EXEC_US;
+
+	lcd_writes++;
+	if (now < lcd_ready_at)
+	{
+		lcd_overruns++;
+	}
+	if (rs)
+	{
+		lcd_ddram[lcd_address] = (char) data;
+		//in two-line mode the display RAM is 0x00-0x27 and 0x40-0x67
+		lcd_address = lcd_address == 0x27 ? 0x40 : lcd_address == 0x67 ? 0x00 : lcd_address + 1;
+	}
+	else if (data & 0x80)
+	{
+		lcd_address = data & 0x7F;
+	}
+	else if (data & 0x20)
+	{
+		lcd_four_bit = !(data & 0x10);
+	}
+	else if (data == 0x01)
+	{
+		memset(lcd_ddram, ' ', sizeof(lcd_ddram));
+		lcd_address = 0;
+		busy = LCD_SLOW_US;
+	}
+	else if ((data & 0xFE) == 0x02)
+	{
+		lcd_address = 0;
+		busy = LCD_SLOW_US;
+	}
+	lcd_ready_at = now + busy;
+}
+
+/**
+ *	Port A changes; the controller reads the data lines when E falls
+ */
+
+static void lcd_port(unsigned char value)
+{
+	unsigned char old = porta;
+	porta = value;
+	if (!(old & LCD_E) || (value & LCD_E))
+	{
+		return;
+	}
+	unsigned char nibble = old & 0x0F;
+	if (!lcd_four_bit)
+	{
+		//8-bit interface with only D4-D7 wired up
+		lcd_half = 0;
+		lcd_byte(nibble << 4, old & LCD_RS);
+	}
+	else if (!lcd_half)
+	{
+		lcd_high = nibble;
+		lcd_half = 1;
+	}
+	else
+	{
+		lcd_half = 0;
+		lcd_byte((lcd_high << 4) | nibble, old & LCD_RS);
+	}
+}
+
+void hal_lcd_port_init(void)
+{
+	if (!lcd_writes)
+	{
+		memset(lcd_ddram, ' ', sizeof(lcd_ddram));
+	}
+}
+
+void hal_lcd_port_write(unsigned char value)
+{
+	lcd_port(value);
+}
+
+void hal_lcd_port_or(unsigned char bits)
+{
+	lcd_port(porta | bits);
+}
+
+void hal_lcd_port_and(unsigned char mask)
+{
+	lcd_port(porta & mask);
+}
+
+void hal_eeprom_read_block(void *dst, const void *src, unsigned int n)
+{
+	memcpy(dst, src, n);
+}
+
+void hal_eeprom_update_block(const void *src, void *dst, unsigned int n)
+{
+	memmove(dst, src, n);
+}
+
+void hal_eeprom_update_word(uint16_t *dst, uint16_t value)
+{
+	*dst = value;
+}
+
+uint64_t hal_linux_now(void)
+{
+	return now;
+}
+
+unsigned long hal_linux_events(void)
+{
+	return ran;
+}
+
+void hal_linux_uart0_connect(hal_linux_tx_fn tx)
+{
+	uart0.tx = tx;
+}
+
+void hal_linux_uart1_connect(hal_linux_tx_fn tx)
+{
+	uart1.tx = tx;
+}
+
+void hal_linux_uart0_feed(unsigned char data)
+{
+	uart_feed(&uart0, uart0_arrived, data);
+}
+
+static void uart1_arrived(uint64_t t, void *arg)
+{
+	uart_activity = t;
+}
+
+void hal_linux_uart1_feed(unsigned char data)
+{
+	uart_feed(&uart1, uart1_arrived, data);
+}
+
+unsigned long hal_linux_uart1_baud(void)
+{
+	return uart1_rate;
+}
+
+uint64_t hal_linux_uart0_last_read(void)
+{
+	return uart0_read_at;
+}
+
+uint64_t hal_linux_uart_last_activity(void)
+{
+	return uart_activity;
+}
+
+void hal_linux_adc_set(unsigned int value)
+{
+	adc_value = value;
+}
+
+void hal_linux_sonar_set(double cm)
+{
+	sonar_cm = cm;
+}
+
+void hal_linux_adc_source(hal_linux_sample_fn fn)
+{
+	adc_source = fn;
+}
+
+void hal_linux_sonar_source(hal_linux_sample_fn fn)
+{
+	sonar_source = fn;
+}
+
+unsigned int hal_linux_servo_pulse(void)
+{
+	return servo_pulse;
+}
+
+unsigned char hal_linux_lcd_port(void)
+{
+	return porta;
+}
+
+const char *hal_linux_lcd_line(int line)
+{
+	static const unsigned char start[4] = {0x00, 0x40, 0x14, 0x54};
+	static HAL_LOCAL char text[21];
+	for (int i = 0; i < 20; i++)
+	{
+		char c = lcd_ddram[start[line & 3] + i];
+		text[i] = c >= ' ' && c <= '~' ? c : '?';
+	}
+	return text;
+}
+
+unsigned long hal_linux_lcd_writes(void)
+{
+	return lcd_writes;
+}
+
+unsigned long hal_linux_lcd_overruns(void)
+{
+	return lcd_overruns;
+}
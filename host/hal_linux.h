@@ -0,0 +1,156 @@
+/**
+ *	@file hal_linux.h
+ *	@brief Linux backend of the hardware abstraction layer
+ *
+ *	The peripherals are simulated as a discrete-event system on a virtual
+ *	microsecond clock. Every peripheral action that completes later (a Timer2
+ *	compare, a sonar echo edge, an ADC conversion, a byte finishing on a
+ *	serial line) is an event in a time-ordered queue. When the firmware
+ *	busy-waits, hal_idle() jumps the clock straight to the next event and
+ *	runs it, so a run takes as long as the work the firmware does and not
+ *	as long as the time it spends waiting. Events due at the same time run
+ *	in the order they were scheduled, which makes every run with the same
+ *	inputs identical.
+ *
+ *	Interrupt handlers written with ISR() become plain functions that the
+ *	backend calls when their event happens, so the firmware sources build
+ *	unchanged. Devices attach to the simulated peripherals through the
+ *	hal_linux_ functions at the bottom of this file.
+ *
+ *	Include hal.h rather than this file.
+ */
+
+#ifndef HAL_LINUX_H
+#define HAL_LINUX_H
+
+#include <stdint.h>
+#include <string.h>
+
+/// Lay structures shared with the Create out byte by byte, as on the AVR
+#define HAL_PACKED __attribute__((packed))
+
+/// EEPROM variables and flash tables are ordinary memory on the host
+#define EEMEM
+#define HAL_FLASH
+
+/// State of the firmware and the simulated peripherals belongs to one rover;
+/// each thread has its own, so a fleet of rovers can run side by side (fleet.c)
+#define HAL_LOCAL __thread
+
+/// Interrupt handlers become functions called by the simulated peripherals
+#define ISR(vector) void vector(void)
+void TIMER1_CAPT_vect(void);
+void TIMER1_OVF_vect(void);
+void TIMER2_COMP_vect(void);
+void TIMER0_COMP_vect(void);
+void USART0_RX_vect(void);
+
+void hal_idle(void);
+void hal_interrupts_enable(void);
+unsigned char hal_interrupts_disable(void);
+void hal_interrupts_restore(unsigned char state);
+
+void hal_uart0_init(unsigned int ubrr);
+void hal_uart0_write(unsigned char data);
+unsigned char hal_uart0_read(void);
+
+void hal_uart1_init(unsigned char ubrr);
+void hal_uart1_baud(unsigned char ubrr);
+void hal_uart1_write(unsigned char data);
+unsigned char hal_uart1_ready(void);
+unsigned char hal_uart1_read(void);
+
+void hal_timer2_start(char unit, unsigned char compare);
+void hal_timer2_stop(void);
+unsigned char hal_timer2_count(void);
+
+void hal_timer0_start(unsigned char compare);
+void hal_timer0_stop(void);
+
+/// The CPU takes no virtual time, so a short delay has nothing to wait for
+static inline void hal_delay_1us(void)
+{
+}
+
+void hal_sonar_init(void);
+unsigned char hal_sonar_rising(void);
+unsigned int hal_sonar_capture(void);
+void hal_sonar_edge(char rising);
+void hal_sonar_pulse_start(void);
+void hal_sonar_pulse_end(void);
+
+void hal_servo_init(unsigned int period, unsigned int pulse);
+void hal_servo_set(unsigned int pulse);
+
+void hal_adc_init(void);
+void hal_adc_start(void);
+unsigned char hal_adc_busy(void);
+unsigned int hal_adc_read(void);
+
+void hal_lcd_port_init(void);
+void hal_lcd_port_write(unsigned char value);
+void hal_lcd_port_or(unsigned char bits);
+void hal_lcd_port_and(unsigned char mask);
+
+void hal_eeprom_read_block(void *dst, const void *src, unsigned int n);
+void hal_eeprom_update_block(const void *src, void *dst, unsigned int n);
+void hal_eeprom_update_word(uint16_t *dst, uint16_t value);
+
+static inline int32_t hal_flash_read_dword(const int32_t *src)
+{
+	return *src;
+}
+
+static inline void hal_flash_read_block(void *dst, const void *src, unsigned int n)
+{
+	memcpy(dst, src, n);
+}
+
+/// Receives every byte the firmware transmits on a USART
+typedef void (*hal_linux_tx_fn)(unsigned char data);
+/// Runs when a scheduled event is due; now is the current virtual time in microseconds
+typedef void (*hal_linux_event_fn)(uint64_t now, void *arg);
+/// Returns a sensor reading at the moment it is taken
+typedef double (*hal_linux_sample_fn)(void);
+
+/// Current virtual time in microseconds
+uint64_t hal_linux_now(void);
+/// Run fn(arg) at virtual time when (or at once, if when has passed)
+void hal_linux_at(uint64_t when, hal_linux_event_fn fn, void *arg);
+/// Number of events run so far
+unsigned long hal_linux_events(void);
+
+/// Attach the device on the other end of USART0 (base station) or USART1 (Create)
+void hal_linux_uart0_connect(hal_linux_tx_fn tx);
+void hal_linux_uart1_connect(hal_linux_tx_fn tx);
+/// Send a byte to the firmware on USART0 or USART1; it arrives one frame
+/// time after the line is free
+void hal_linux_uart0_feed(unsigned char data);
+void hal_linux_uart1_feed(unsigned char data);
+/// Baud rate the firmware has set USART1 to
+unsigned long hal_linux_uart1_baud(void);
+/// Virtual time at which the firmware last read a byte from USART0
+uint64_t hal_linux_uart0_last_read(void);
+/// Virtual time at which a byte last finished on either USART, in either direction
+uint64_t hal_linux_uart_last_activity(void);
+
+/// Value the ADC converts to, unless a source is attached
+void hal_linux_adc_set(unsigned int value);
+/// Distance in centimeters the sonar echo comes back from, unless a source is attached
+void hal_linux_sonar_set(double cm);
+/// Sample the ADC value at the start of each conversion
+void hal_linux_adc_source(hal_linux_sample_fn fn);
+/// Sample the sonar distance in centimeters when each trigger pulse ends
+void hal_linux_sonar_source(hal_linux_sample_fn fn);
+/// Servo pulse width in Timer3 counts
+unsigned int hal_linux_servo_pulse(void);
+/// Current level of the LCD port
+unsigned char hal_linux_lcd_port(void);
+/// Text the LCD shows on line 0 to 3, as a 20 character string
+const char *hal_linux_lcd_line(int line);
+/// Bytes written to the LCD controller, and writes that came before it had
+/// finished the previous one
+unsigned long hal_linux_lcd_writes(void);
+unsigned long hal_linux_lcd_overruns(void);
+
+#endif
@@ -0,0 +1,114 @@
+/**
+ *	@file mission.c
+ *	@brief what sim and fleet share about running the rover on a course
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hal.h"
+#include "util.h"
+#include "thresholds.h"
+#include "create.h"
+#include "world.h"
+#include "mission.h"
+
+/// the bands that can be set, by name
+static const struct{
+	const char *name;
+	size_t offset;		// in struct thresholds
+} bands[] = {
+	{"tape_left", offsetof(struct thresholds, tape[SENSE_LEFT])},
+	{"tape_frontleft", offsetof(struct thresholds, tape[SENSE_FRONTLEFT])},
+	{"tape_frontright", offsetof(struct thresholds, tape[SENSE_FRONTRIGHT])},
+	{"tape_right", offsetof(struct thresholds, tape[SENSE_RIGHT])},
+	{"dest_left", offsetof(struct thresholds, dest[SENSE_LEFT])},
+	{"dest_frontleft", offsetof(struct thresholds, dest[SENSE_FRONTLEFT])},
+	{"dest_frontright", offsetof(struct thresholds, dest[SENSE_FRONTRIGHT])},
+	{"dest_right", offsetof(struct thresholds, dest[SENSE_RIGHT])},
+	{"ir", offsetof(struct thresholds, ir)},
+};
+
+int64_t mission_schedule(int count, char **words, hal_linux_event_fn key)
+{
+	uint64_t at = 0;
+	for (int i = 0; i < count; i++)
+	{
+		char *w = words[i];
+		char *end;
+		if (w[0] == '@' || w[0] == '+')
+		{
+			double s = strtod(w + 1, &end);
+			if (end == w + 1 || *end || s < 0)
+			{
+				fprintf(stderr, "cannot read time '%s'\n", w);
+				return -1;
+			}
+			at = (w[0] == '@' ? 0 : at) + (uint64_t) (s * 1e6);
+		}
+		else if (!strcmp(w, "space"))
+		{
+			hal_linux_at(at, key, (void *) (uintptr_t) USART_ABORT);
+		}
+		else
+		{
+			for (int j = 0; w[j]; j++)
+			{
+				hal_linux_at(at, key, (void *) (uintptr_t) (unsigned char) w[j]);
+			}
+		}
+	}
+	return at;
+}
+
+int mission_bands(char *spec)
+{
+	char *save;
+	for (char *item = strtok_r(spec, ",", &save); item; item = strtok_r(0, ",", &save))
+	{
+		char name[32];
+		int lo, hi;
+		size_t i = 0;
+		if (sscanf(item, "%31[a-z_]=%d:%d", name, &lo, &hi) == 3)
+		{
+			for (i = 0; i < sizeof(bands) / sizeof(bands[0]) && strcmp(name, bands[i].name); i++)
+			{
+			}
+		}
+		if (i == sizeof(bands) / sizeof(bands[0]) || lo >= hi)
+		{
+			fprintf(stderr, "cannot use band '%s'\n", item);
+			return -1;
+		}
+		struct band *b = (struct band *) ((char *) &thresholds + bands[i].offset);
+		b->lo = lo;
+		b->hi = hi;
+	}
+	return 0;
+}
+
+void mission_text(const char *line)
+{
+	if (strstr(line, "white tape!"))
+	{
+		world_reaction(WORLD_TAPE);
+	}
+	else if (strstr(line, "cliff!"))
+	{
+		world_reaction(WORLD_HOLE);
+	}
+	else if (strstr(line, "Destination!") || strstr(line, "Arrived at destination!"))
+	{
+		world_reaction(WORLD_GOAL);
+	}
+}
+
+int mission_idle(uint64_t now, uint64_t script_end)
+{
+	return now > script_end && USART_Available() == 0 &&
+		create.left_speed == 0 && create.right_speed == 0 &&
+		now - hal_linux_uart_last_activity() > MISSION_QUIET_US;
+}
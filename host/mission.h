@@ -0,0 +1,38 @@
+/**
+ *	@file mission.h
+ *	@brief what sim and fleet share about running the rover on a course:
+ *	the command script, the bands it runs with, how it is scored and when
+ *	it is done
+ *
+ *	A script is a list of words. @T waits until T seconds of virtual time,
+ *	+T waits T seconds more, "space" sends the stop key, and any other word
+ *	is sent one character at a time.
+ *
+ *	Bands are given as "name=lo:hi,...", the names being tape_ and dest_
+ *	with left, frontleft, frontright or right, and ir (see thresholds.h).
+ *
+ *	All of it works on the rover of the calling thread.
+ */
+
+#ifndef MISSION_H
+#define MISSION_H
+
+#include <stdint.h>
+#include "hal.h"
+
+/// the rover counts as done once the serial lines have been quiet this long
+#define MISSION_QUIET_US	2000000
+
+/// Schedule the words of a script, each key through key(); returns the time of the last, or -1 if a word cannot be read
+int64_t mission_schedule(int count, char **words, hal_linux_event_fn key);
+
+/// Set bands from a list; returns 0, or -1 after printing the problem
+int mission_bands(char *spec);
+
+/// Score a line the firmware sent against the world (false stops, missed hazards)
+void mission_text(const char *line);
+
+/// Whether the rover is done: script used up, nothing moving and the lines quiet
+int mission_idle(uint64_t now, uint64_t script_end);
+
+#endif
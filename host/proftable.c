@@ -0,0 +1,214 @@
+/**
+ *	@file proftable.c
+ *	@brief adds up the profiler's blocks (see profile.h) into a table of
+ *	where each command spends its time
+ *
+ *	Reads what the rover sent to the base station with the profiler on
+ *	(the 'o' key) and, for every command key seen, prints how many times it
+ *	ran and how long it took, then one row per timed function:
+ *
+ *	calls		calls per run of the command
+ *	inclusive	ms per run, calls inside it included
+ *	exclusive	ms per run, timed calls inside it left out
+ *	share		exclusive time as a percentage of the command's time
+ *	longest		ms of the longest single call
+ *
+ *	The rows go from the largest exclusive time down, so the first is the
+ *	call that holds the command up most; "(untimed)" is the time spent
+ *	outside any timed function. Everything else in the input is skipped,
+ *	frames of the link included, so the sensor feed may be on.
+ *
+ *	usage: proftable [capture ...]	(standard input without one)
+ *
+ *	A line "proftable: blocks= commands= bad=" goes to stderr at the end, and
+ *	the status is 1 if there was no block or a block could not be read.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "link.h"
+
+/// timed functions a command can have; the firmware has fewer
+#define FUNCTIONS	16
+
+struct function{
+	char name[32];
+	unsigned long calls;
+	double inclusive;	// us, over every run
+	double exclusive;
+	unsigned long longest;
+};
+
+struct command{
+	unsigned long runs;
+	double total;		// us, over every run
+	double untimed;
+	unsigned long longest;
+	int count;		// functions
+	struct function functions[FUNCTIONS];
+};
+
+static struct command commands[256];
+static unsigned long blocks, bad;
+
+/**
+ *	Finds a function of a command by name, adding it if it is new
+ */
+
+static struct function *function_of(struct command *c, const char *name)
+{
+	for (int i = 0; i < c->count; i++)
+	{
+		if (!strcmp(c->functions[i].name, name))
+		{
+			return &c->functions[i];
+		}
+	}
+	if (c->count == FUNCTIONS)
+	{
+		return NULL;
+	}
+	struct function *f = &c->functions[c->count++];
+	snprintf(f->name, sizeof(f->name), "%s", name);
+	return f;
+}
+
+/**
+ *	Reads the blocks of one capture
+ */
+
+static void read_capture(FILE *in)
+{
+	struct link_parser parser = {0};
+	char line[256];
+	int length = 0;
+	struct command *c = NULL;	// of the block being read
+	int ch;
+
+	while ((ch = getc(in)) != EOF)
+	{
+		if (link_parse(&parser, ch) != LINK_BYTE || ch == '\r')
+		{
+			continue;
+		}
+		if (ch != '\n')
+		{
+			if (length < (int) sizeof(line) - 1)
+			{
+				line[length++] = ch;
+			}
+			continue;
+		}
+		line[length] = 0;
+		length = 0;
+
+		unsigned long total, untimed;
+		if (!strncmp(line, "PROF ", 5) && line[5] && sscanf(line + 6, "%lu %lu", &total, &untimed) == 2)
+		{
+			if (c)
+			{
+				bad++;		//the END of the one before was lost
+			}
+			c = &commands[(unsigned char) line[5]];
+			c->runs++;
+			c->total += total;
+			c->untimed += untimed;
+			if (total > c->longest)
+			{
+				c->longest = total;
+			}
+			blocks++;
+			continue;
+		}
+		if (!c)
+		{
+			continue;
+		}
+		if (!strcmp(line, "END"))
+		{
+			c = NULL;
+			continue;
+		}
+
+		char name[32];
+		unsigned long calls, inclusive, exclusive, longest;
+		struct function *f;
+		if (sscanf(line, "%31s %lu %lu %lu %lu", name, &calls, &inclusive, &exclusive, &longest) != 5 || !(f = function_of(c, name)))
+		{
+			bad++;
+			c = NULL;
+			continue;
+		}
+		f->calls += calls;
+		f->inclusive += inclusive;
+		f->exclusive += exclusive;
+		if (longest > f->longest)
+		{
+			f->longest = longest;
+		}
+	}
+	if (c)
+	{
+		bad++;
+	}
+}
+
+static int by_exclusive(const void *a, const void *b)
+{
+	const struct function *x = a, *y = b;
+	return (x->exclusive < y->exclusive) - (x->exclusive > y->exclusive);
+}
+
+/**
+ *	Prints the table of a command
+ */
+
+static void print_command(int key, struct command *c)
+{
+	double runs = c->runs;
+	printf("command %c: runs=%lu mean_ms=%.1f longest_ms=%.1f\n", key, c->runs, c->total / runs / 1000, c->longest / 1000.0);
+	printf("  %-16s %8s %12s %12s %6s %10s\n", "function", "calls", "inclusive", "exclusive", "share", "longest");
+
+	qsort(c->functions, c->count, sizeof(c->functions[0]), by_exclusive);
+	for (int i = 0; i < c->count; i++)
+	{
+		struct function *f = &c->functions[i];
+		printf("  %-16s %8.1f %12.1f %12.1f %5.1f%% %10.1f\n", f->name, f->calls / runs,
+			f->inclusive / runs / 1000, f->exclusive / runs / 1000,
+			c->total ? 100 * f->exclusive / c->total : 0, f->longest / 1000.0);
+	}
+	printf("  %-16s %8s %12.1f %12.1f %5.1f%%\n", "(untimed)", "",
+		c->untimed / runs / 1000, c->untimed / runs / 1000, c->total ? 100 * c->untimed / c->total : 0);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		read_capture(stdin);
+	}
+	for (int i = 1; i < argc; i++)
+	{
+		FILE *in = fopen(argv[i], "rb");
+		if (!in)
+		{
+			perror(argv[i]);
+			return 1;
+		}
+		read_capture(in);
+		fclose(in);
+	}
+
+	int count = 0;
+	for (int key = 0; key < 256; key++)
+	{
+		if (commands[key].runs)
+		{
+			printf("%s", count++ ? "\n" : "");
+			print_command(key, &commands[key]);
+		}
+	}
+	fprintf(stderr, "proftable: blocks=%lu commands=%d bad=%lu\n", blocks, count, bad);
+	return !blocks || bad;
+}
@@ -0,0 +1,244 @@
+/**
+ *	@file recdump.c
+ *	@brief expands a flight recorder dump into a trace of timed events
+ *
+ *	Reads what the rover sent to the base station, finds every recording
+ *	between a "REC <bytes> <time>" line and an "END" line (sent for the
+ *	'p' and 'P' keys; see recorder.h) and decodes it with the firmware's
+ *	own recorder.c. Everything else in the input is skipped, so a whole
+ *	terminal capture can be given.
+ *
+ *	usage: recdump [capture]	(standard input without one)
+ *
+ *	Each recording becomes one line "# recording <bytes> <time>" followed
+ *	by its records as a trace (see trace.h), in the order they were made.
+ *
+ *	Times are milliseconds of the rover's clock. They are counted from the
+ *	first keyframe in the ring; the records before it, the tail of those
+ *	dropped when the ring was full, get their times counted back from it,
+ *	but their sensor frames cannot be decoded and are left out.
+ *
+ *	A REC_RUN becomes its frames again, each one the frame before it with
+ *	an even share of the distance and the angle, timed evenly from the
+ *	frame before the run to the run. The firmware then gets as many frames
+ *	in the replay as it had on the robot, and goes as far.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "recorder.h"
+#include "trace.h"
+
+/// one record, split up
+struct record{
+	unsigned char kind;
+	uint32_t dt;
+	uint32_t time;
+	const unsigned char *body;
+	unsigned char length;		// of the body
+};
+
+static int16_t get16(const unsigned char *p)
+{
+	return (int16_t) (p[0] << 8 | p[1]);
+}
+
+static void set16(unsigned char *p, int16_t value)
+{
+	p[0] = (uint16_t) value >> 8;
+	p[1] = value;
+}
+
+/**
+ *	Writes the frames of a REC_RUN
+ *	@param frame	the frame before the run
+ *	@param from	its time
+ */
+
+static void expand_run(const unsigned char *frame, uint32_t from, const struct record *r)
+{
+	static struct trace_event e;
+	unsigned char count = r->body[0];
+	int distance = get16(r->body + 1), angle = get16(r->body + 3);
+
+	e.kind = TRACE_FRAME;
+	memcpy(e.frame, frame, sizeof(e.frame));
+	for (int i = 1; i <= count; i++)
+	{
+		e.ms = from + (r->time - from) * i / count;
+		set16(e.frame + REC_DISTANCE, distance * i / count - distance * (i - 1) / count);
+		set16(e.frame + REC_ANGLE, angle * i / count - angle * (i - 1) / count);
+		trace_write(stdout, &e);
+	}
+}
+
+/**
+ *	Decodes and prints one recording
+ *	@return 0, or -1 if the records do not fit the bytes
+ */
+
+static int expand(const unsigned char *data, unsigned int size, uint32_t dumped)
+{
+	struct record *records = calloc(size / 3 + 1, sizeof(*records));
+	unsigned int count = 0;
+	int key = -1;		// first keyframe
+
+	for (unsigned int at = 0; at < size; count++)
+	{
+		struct record *r = &records[count];
+		unsigned char length = data[at];
+		if (length < 3 || at + length > size)
+		{
+			free(records);
+			return -1;
+		}
+		unsigned char n = 1;
+		r->kind = data[at + n++];
+		for (unsigned char shift = 0; ; shift += 7)
+		{
+			unsigned char b = data[at + n++];
+			r->dt |= (uint32_t) (b & 0x7F) << shift;
+			if (!(b & 0x80) || n >= length)
+			{
+				break;
+			}
+		}
+		r->body = data + at + n;
+		r->length = length - n;
+		if (r->kind == REC_KEYFRAME && key < 0 && r->length >= 4)
+		{
+			key = count;
+			r->time = r->body[0] | r->body[1] << 8 | (uint32_t) r->body[2] << 16 | (uint32_t) r->body[3] << 24;
+		}
+		at += length;
+	}
+
+	//no keyframe: the last record was made before the dump, at the latest
+	if (key < 0 && count)
+	{
+		key = count - 1;
+		records[key].time = dumped;
+	}
+	for (int i = key - 1; i >= 0; i--)
+	{
+		records[i].time = records[i + 1].time - records[i + 1].dt;
+	}
+	for (unsigned int i = key + 1; i < count; i++)
+	{
+		records[i].time = records[i - 1].time + records[i].dt;
+	}
+
+	static struct trace_event e;
+	unsigned char frame[REC_FRAME_BYTES];
+	uint32_t frame_ms = 0;
+	char have_frame = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		struct record *r = &records[i];
+		const unsigned char *b = r->body;
+		e.ms = r->time;
+		switch (r->kind)
+		{
+		case REC_KEYFRAME:
+			memset(frame, 0, sizeof(frame));
+			rec_decode_frame(frame, b + 4);
+			have_frame = 1;
+			frame_ms = r->time;
+			memcpy(e.frame, frame, sizeof(frame));
+			e.kind = TRACE_FRAME;
+			break;
+		case REC_FRAME:
+			if (!have_frame)
+			{
+				continue;
+			}
+			rec_decode_frame(frame, b);
+			frame_ms = r->time;
+			memcpy(e.frame, frame, sizeof(frame));
+			e.kind = TRACE_FRAME;
+			break;
+		case REC_RUN:
+			if (have_frame && r->length == 5 && b[0])
+			{
+				expand_run(frame, frame_ms, r);
+				frame_ms = r->time;
+			}
+			continue;
+		case REC_WHEELS:
+		case REC_DRIVE:
+			e.kind = r->kind == REC_WHEELS ? TRACE_WHEELS : TRACE_DRIVE;
+			e.a = get16(b);
+			e.b = get16(b + 2);
+			break;
+		case REC_SWEEP:
+			e.kind = TRACE_SWEEP;
+			e.a = b[0];
+			e.b = get16(b + 1);
+			e.c = get16(b + 3);
+			break;
+		case REC_KEY:
+			e.kind = TRACE_KEY;
+			e.key = b[0];
+			break;
+		default:
+			continue;
+		}
+		trace_write(stdout, &e);
+	}
+	free(records);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	FILE *in = stdin;
+	if (argc > 1 && !(in = fopen(argv[1], "r")))
+	{
+		perror(argv[1]);
+		return 1;
+	}
+
+	char line[256];
+	unsigned char *data = 0;
+	unsigned int size = 0, have = 0;
+	unsigned long dumped = 0;
+	char inside = 0;
+	int status = 0;
+
+	while (fgets(line, sizeof(line), in))
+	{
+		char *text = line + strspn(line, "\r\n");	// the rover ends lines with \n\r
+		if (!inside)
+		{
+			char *rec = strstr(text, "REC ");
+			if (rec && sscanf(rec, "REC %u %lu", &size, &dumped) == 2)
+			{
+				data = realloc(data, size + 1);
+				have = 0;
+				inside = 1;
+			}
+		}
+		else if (!strncmp(text, "END", 3))
+		{
+			inside = 0;
+			printf("# recording %u %lu\n", size, dumped);
+			if (have != size || expand(data, size, dumped) < 0)
+			{
+				fprintf(stderr, "recdump: recording at %lu is damaged\n", dumped);
+				status = 1;
+			}
+		}
+		else
+		{
+			unsigned int byte;
+			for (char *p = text; have < size && sscanf(p, "%2x", &byte) == 1; p += 2)
+			{
+				data[have++] = byte;
+			}
+		}
+	}
+	free(data);
+	return status;
+}
@@ -0,0 +1,381 @@
+/**
+ *	@file replay.c
+ *	@brief runs the firmware against a recorded trace and compares what it
+ *	does with what it did when the trace was recorded
+ *
+ *	The firmware's main() (auto.c, built as rover_main) runs unchanged
+ *	against the Linux HAL and the Create model, as in sim.c, but with no
+ *	world: every sensor query is answered with the next frame of the trace
+ *	instead of the model's own, and the keys of the trace are sent at the
+ *	times they arrived. move_forward(), checkCondition() and the turns then
+ *	see exactly what they saw on the recorded run. The drive commands the
+ *	firmware sends and the lines it sends to the base station are compared
+ *	with those of the trace, one by one.
+ *
+ *	usage: replay [-q] [-o trace] trace
+ *
+ *	The trace is one written by sim -r or by recdump (see trace.h). It has
+ *	to start where the firmware starts, as one from sim -r always does and
+ *	a flight recorder dump does until the ring first fills up. A trace
+ *	from the flight recorder has no text lines, so only the drive commands
+ *	are compared. Sweeps are not replayed: the trace has the IR distance
+ *	after calibration and not the ADC counts, so the sensor reads nothing.
+ *
+ *	The run ends when the firmware asks for a frame past the last one, when
+ *	main() returns, or when the keys are used up and the rover has been
+ *	quiet for two seconds. Everything runs on the virtual clock, so a trace
+ *	replays hundreds of times faster than it was recorded. The first
+ *	differences go to stderr, then a one-line summary. -q keeps what the
+ *	firmware sends to the base station off stdout; -o writes the replayed
+ *	run as a trace, for diff.
+ *
+ *	The program exits with status 1 if anything differs.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "hal.h"
+#include "util.h"
+#include "open_interface.h"
+#include "create.h"
+#include "trace.h"
+
+/// how often the end of the run is checked for, in microseconds
+#define REPLAY_CHECK_US		100000
+/// the rover counts as done once the serial lines have been quiet this long
+#define REPLAY_QUIET_US		2000000
+/// differences printed before the rest are only counted
+#define REPLAY_SHOW		10
+
+int rover_main(void);
+
+/// the events of one kind, in order
+struct events{
+	struct trace_event *list;
+	unsigned long count;
+	unsigned long size;
+};
+
+static struct events frames, commands, keys, texts;	// from the trace
+static struct events sent_commands, sent_texts;		// from the replay
+static unsigned long next_frame;
+static uint32_t last_ms;			// time of the last event of the trace
+static const char *result = "stalled";
+static int quiet;
+static FILE *out;
+static struct trace_event line;			// line being sent to the base station
+static struct timespec started;
+
+static void add(struct events *events, const struct trace_event *e)
+{
+	if (events->count == events->size)
+	{
+		events->size = events->size ? events->size * 2 : 256;
+		events->list = realloc(events->list, events->size * sizeof(*events->list));
+		if (!events->list)
+		{
+			fprintf(stderr, "replay: out of memory\n");
+			exit(2);
+		}
+	}
+	events->list[events->count++] = *e;
+}
+
+static uint32_t now_ms(void)
+{
+	return hal_linux_now() / 1000;
+}
+
+/**
+ *	Read the trace; returns -1 if it cannot be read
+ */
+
+static int load(const char *path)
+{
+	FILE *in = fopen(path, "r");
+	if (!in)
+	{
+		perror(path);
+		return -1;
+	}
+	static char text[2 * TRACE_TEXT_MAX];
+	static struct trace_event e;
+	unsigned long number = 0;
+	while (fgets(text, sizeof(text), in))
+	{
+		number++;
+		int got = trace_parse(text, &e);
+		if (got < 0)
+		{
+			fprintf(stderr, "%s:%lu: cannot read the line\n", path, number);
+			fclose(in);
+			return -1;
+		}
+		if (got == 0)
+		{
+			continue;
+		}
+		switch (e.kind)
+		{
+		case TRACE_FRAME:
+			add(&frames, &e);
+			break;
+		case TRACE_WHEELS:
+		case TRACE_DRIVE:
+			add(&commands, &e);
+			break;
+		case TRACE_KEY:
+			add(&keys, &e);
+			break;
+		case TRACE_TEXT:
+			add(&texts, &e);
+			break;
+		}
+		last_ms = e.ms;
+	}
+	fclose(in);
+	return 0;
+}
+
+static void record(struct events *events, const struct trace_event *e)
+{
+	add(events, e);
+	if (out)
+	{
+		trace_write(out, e);
+	}
+}
+
+static void finish_line(void)
+{
+	if (line.text[0])
+	{
+		line.ms = now_ms();
+		line.kind = TRACE_TEXT;
+		record(&sent_texts, &line);
+		line.text[0] = '\0';
+	}
+}
+
+static void base_station_rx(unsigned char data)
+{
+	if (!quiet)
+	{
+		putchar(data);
+	}
+	if (data == '\n')
+	{
+		finish_line();
+	}
+	else if (data != '\r')
+	{
+		size_t length = strlen(line.text);
+		if (length < TRACE_TEXT_MAX - 1)
+		{
+			line.text[length] = data;
+			line.text[length + 1] = '\0';
+		}
+	}
+}
+
+/**
+ *	Answer a sensor query with the next frame of the trace
+ */
+
+static void serve_frame(unsigned char *frame)
+{
+	if (next_frame == frames.count)
+	{
+		result = "complete";
+		exit(0);
+	}
+	memcpy(frame, frames.list[next_frame].frame, TRACE_FRAME_BYTES);
+	if (out)
+	{
+		struct trace_event e = frames.list[next_frame];
+		e.ms = now_ms();
+		trace_write(out, &e);
+	}
+	next_frame++;
+}
+
+static void sent_drive(unsigned char opcode, int16_t a, int16_t b)
+{
+	struct trace_event e = {.ms = now_ms(), .a = a, .b = b};
+	e.kind = opcode == OI_OPCODE_DRIVE ? TRACE_DRIVE : TRACE_WHEELS;
+	record(&sent_commands, &e);
+}
+
+static void send_key(uint64_t now, void *arg)
+{
+	const struct trace_event *k = arg;
+	if (out)
+	{
+		trace_write(out, k);
+	}
+	hal_linux_uart0_feed(k->key);
+}
+
+/**
+ *	End the run once the keys are used up and nothing is moving or talking
+ */
+
+static void check_done(uint64_t now, void *arg)
+{
+	if (now / 1000 > last_ms && USART_Available() == 0 &&
+			create.left_speed == 0 && create.right_speed == 0 &&
+			now - hal_linux_uart_last_activity() > REPLAY_QUIET_US)
+	{
+		result = "idle";
+		exit(0);
+	}
+	hal_linux_at(now + REPLAY_CHECK_US, check_done, 0);
+}
+
+static int same(const struct trace_event *a, const struct trace_event *b)
+{
+	if (a->kind != b->kind)
+	{
+		return 0;
+	}
+	if (a->kind == TRACE_TEXT)
+	{
+		return !strcmp(a->text, b->text);
+	}
+	return a->a == b->a && a->b == b->b;
+}
+
+static void show(const char *what, const struct trace_event *e)
+{
+	if (!e)
+	{
+		fprintf(stderr, "%s nothing", what);
+		return;
+	}
+	fprintf(stderr, "%s at %lu ms ", what, (unsigned long) e->ms);
+	if (e->kind == TRACE_TEXT)
+	{
+		fprintf(stderr, "\"%s\"", e->text);
+	}
+	else
+	{
+		fprintf(stderr, "%s %d %d", e->kind == TRACE_DRIVE ? "drive" : "wheels", e->a, e->b);
+	}
+}
+
+/**
+ *	Compare the events of the replay with those of the trace, in order;
+ *	returns the number that differ
+ */
+
+static unsigned long compare(const char *name, const struct events *recorded, const struct events *replayed)
+{
+	unsigned long count = recorded->count > replayed->count ? recorded->count : replayed->count;
+	unsigned long differ = 0;
+	for (unsigned long i = 0; i < count; i++)
+	{
+		const struct trace_event *a = i < recorded->count ? &recorded->list[i] : 0;
+		const struct trace_event *b = i < replayed->count ? &replayed->list[i] : 0;
+		if (a && b && same(a, b))
+		{
+			continue;
+		}
+		if (differ++ < REPLAY_SHOW)
+		{
+			fprintf(stderr, "replay: %s %lu: ", name, i + 1);
+			show("recorded", a);
+			show(", replayed", b);
+			fprintf(stderr, "\n");
+		}
+	}
+	return differ;
+}
+
+/**
+ *	Compare the runs and print the summary; runs however the program ends
+ */
+
+static void report(void)
+{
+	struct timespec ended;
+	clock_gettime(CLOCK_MONOTONIC, &ended);
+	double wall = (ended.tv_sec - started.tv_sec) + (ended.tv_nsec - started.tv_nsec) / 1e9;
+	double t = hal_linux_now() / 1e6;
+
+	finish_line();
+	fflush(stdout);
+	if (out)
+	{
+		fclose(out);
+	}
+
+	unsigned long differ = compare("command", &commands, &sent_commands);
+	char text_summary[48] = "-";
+	if (texts.count)
+	{
+		unsigned long lines = compare("line", &texts, &sent_texts);
+		differ += lines;
+		snprintf(text_summary, sizeof(text_summary), "%lu/%lu", texts.count - (lines < texts.count ? lines : texts.count), texts.count);
+	}
+	fprintf(stderr, "replay: result=%s frames=%lu/%lu commands=%lu/%lu text=%s differences=%lu "
+		"time=%.3f wall=%.3f speedup=%.0f\n",
+		result, next_frame, frames.count, sent_commands.count, commands.count, text_summary, differ,
+		t, wall, wall > 0 ? t / wall : 0);
+	if (differ)
+	{
+		_exit(1);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+	while ((opt = getopt(argc, argv, "qo:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'q':
+			quiet = 1;
+			break;
+		case 'o':
+			if (!(out = fopen(optarg, "w")))
+			{
+				perror(optarg);
+				return 2;
+			}
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-q] [-o trace] trace\n", argv[0]);
+			return 2;
+		}
+	}
+	if (optind != argc - 1)
+	{
+		fprintf(stderr, "usage: %s [-q] [-o trace] trace\n", argv[0]);
+		return 2;
+	}
+	if (load(argv[optind]))
+	{
+		return 2;
+	}
+
+	for (unsigned long i = 0; i < keys.count; i++)
+	{
+		hal_linux_at(keys.list[i].ms * 1000ULL, send_key, &keys.list[i]);
+	}
+	create_frame_hook(serve_frame);
+	create_drive_hook(sent_drive);
+	hal_linux_uart0_connect(base_station_rx);
+	hal_linux_at(REPLAY_CHECK_US, check_done, 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &started);
+	atexit(report);
+	rover_main();
+	result = "complete";
+	return 0;
+}
@@ -0,0 +1,363 @@
+/**
+ *	@file sim.c
+ *	@brief deterministic simulation of the whole rover on a course
+ *
+ *	The firmware's main() (auto.c, built as rover_main) runs unchanged
+ *	against the Linux HAL, the Create model and a world file. Base station
+ *	commands come from a script instead of a terminal, so a run depends only
+ *	on the world, the script and the seed, and the same three always give
+ *	the same run.
+ *
+ *	usage: sim [-w world] [-s seed] [-t seconds] [-q] [-r trace] [-i] [-T bands] [-E rate]
+ *		[-P seconds] [-L seconds] [script ...]
+ *
+ *	The script is a list of words. @T waits until T seconds of virtual time,
+ *	+T waits T seconds more, "space" sends the stop key, and any other word is
+ *	sent one character at a time. The commands queue up in the firmware's
+ *	receive buffer and run one after another, so "g 3 f" sweeps, drives
+ *	around the nearest obstacle and then seeks the destination; "f @4.5 space"
+ *	stops the seek four and a half seconds in.
+ *
+ *	The run ends when main() returns (the destination was reached), when
+ *	the script is used up and the rover has been quiet for two seconds, or at
+ *	the time limit. A one-line summary goes to stderr; what the firmware sends
+ *	to the base station goes to stdout unless -q is given. -r writes a trace
+ *	of the run (see trace.h) that replay can run the firmware against.
+ *
+ *	The summary also scores how the firmware told the floor apart: a
+ *	false stop is a reaction to tape, a cliff or the destination that no
+ *	cliff sensor had been over in the last 100 ms, and a missed hazard is a
+ *	cliff sensor going onto tape or a hole and off it again with no
+ *	reaction in between. -T sets the bands of thresholds.h for the run,
+ *	e.g. -T tape_frontleft=900:1020,dest_right=820:940; the names are
+ *	tape_ and dest_ with left, frontleft, frontright or right, and ir.
+ *
+ *	-E puts errors on the line from the base station: each byte is lost
+ *	or has one bit flipped, each with half the given probability (e.g.
+ *	-E 0.02), from a generator of its own seeded with -s, so the course
+ *	sees the same noise with and without it. The summary then also counts
+ *	the bytes lost and garbled. The framed commands of link.h (station -f)
+ *	get through such a line; bare keys do not.
+ *
+ *	-P switches the Create off and on again at the given virtual time, and
+ *	-L loses the next byte the firmware sends it after that time; both
+ *	may be given more than once. The Create then stops answering until the
+ *	firmware gets it going again (oi_resync()), and the summary counts the
+ *	resets and the bytes the Create lost.
+ *
+ *	-i also takes commands from stdin, as ./rover does, and keeps the
+ *	virtual clock from running ahead of the wall clock, so the simulated
+ *	rover can stand in for the real one behind a terminal or the base
+ *	station (station -e). It then runs until stdin is closed, with no time
+ *	limit unless -t is given.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include "hal.h"
+#include "util.h"
+#include "open_interface.h"
+#include "create.h"
+#include "world.h"
+#include "trace.h"
+#include "mission.h"
+
+/// how often the end of the run is checked for, in microseconds
+#define SIM_CHECK_US	100000
+/// default time limit in seconds
+#define SIM_LIMIT	600
+/// with -i, stdin is checked this often, in microseconds
+#define SIM_INPUT_US	1000
+/// with -i, bytes taken from stdin per check, so a long pipe cannot overrun the line
+#define SIM_INPUT_CHUNK	16
+
+int rover_main(void);
+
+static const char *result = "stalled";
+static uint64_t seed = 1;
+static int quiet;
+static uint64_t script_end;
+static struct timespec started;
+static int interactive;
+static FILE *trace;
+static struct trace_event event;
+static double line_errors;		// -E
+static uint64_t line_rng;
+static unsigned long lost, garbled;
+static int create_faults;		// -P and -L given
+
+static uint32_t now_ms(void)
+{
+	return hal_linux_now() / 1000;
+}
+
+/**
+ *	Trace the line sent to the base station so far
+ */
+
+static void trace_text(void)
+{
+	if (trace && event.text[0])
+	{
+		event.ms = now_ms();
+		event.kind = TRACE_TEXT;
+		trace_write(trace, &event);
+	}
+	event.text[0] = '\0';
+}
+
+static void base_station_rx(unsigned char data)
+{
+	if (!quiet)
+	{
+		putchar(data);
+	}
+	if (data == '\n')
+	{
+		mission_text(event.text);
+		trace_text();
+	}
+	else if (data != '\r')
+	{
+		size_t length = strlen(event.text);
+		if (length < TRACE_TEXT_MAX - 1)
+		{
+			event.text[length] = data;
+			event.text[length + 1] = '\0';
+		}
+	}
+}
+
+static void trace_frame(unsigned char *frame)
+{
+	struct trace_event e = {.ms = now_ms(), .kind = TRACE_FRAME};
+	memcpy(e.frame, frame, TRACE_FRAME_BYTES);
+	trace_write(trace, &e);
+}
+
+static void trace_drive(unsigned char opcode, int16_t a, int16_t b)
+{
+	struct trace_event e = {.ms = now_ms(), .a = a, .b = b};
+	e.kind = opcode == OI_OPCODE_DRIVE ? TRACE_DRIVE : TRACE_WHEELS;
+	trace_write(trace, &e);
+}
+
+/**
+ *	Print the summary line; runs however the program ends
+ */
+
+static void report(void)
+{
+	struct timespec ended;
+	clock_gettime(CLOCK_MONOTONIC, &ended);
+	double wall = (ended.tv_sec - started.tv_sec) + (ended.tv_nsec - started.tv_nsec) / 1e9;
+	double t = hal_linux_now() / 1e6;
+
+	mission_text(event.text);
+	trace_text();
+	if (trace)
+	{
+		fclose(trace);
+	}
+	fflush(stdout);
+	fprintf(stderr, "sim: result=%s time=%.3f seed=%llu goal=%.3f travelled=%.0f bumps=%lu cliffs=%lu tape=%lu "
+		"false_stops=%lu missed=%lu x=%.0f y=%.0f heading=%.1f events=%lu wall=%.3f speedup=%.0f\n",
+		result, t, (unsigned long long) seed, world.goal_time / 1e6, create.travelled,
+		world.bump_events, world.cliff_events, world.tape_events, world.false_stops, world.missed_events,
+		create.x, create.y, create.heading,
+		hal_linux_events(), wall, wall > 0 ? t / wall : 0);
+	if (line_errors > 0)
+	{
+		fprintf(stderr, "sim: line_errors=%g lost=%lu garbled=%lu\n", line_errors, lost, garbled);
+	}
+	if (create_faults)
+	{
+		fprintf(stderr, "sim: create_resets=%lu create_lost=%lu\n", create.resets, create.bytes_lost);
+	}
+}
+
+/**
+ *	Uniform in [0, 1), for the line errors of -E
+ */
+
+static double line_noise(void)
+{
+	line_rng = line_rng * 6364136223846793005ULL + 1442695040888963407ULL;
+	return (line_rng >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void send_key(uint64_t now, void *arg)
+{
+	unsigned char key = (uintptr_t) arg;
+	if (line_errors > 0 && line_noise() < line_errors)
+	{
+		if (line_noise() < 0.5)
+		{
+			lost++;
+			return;
+		}
+		key ^= 1 << (int) (line_noise() * 8);
+		garbled++;
+	}
+	if (trace)
+	{
+		struct trace_event e = {.ms = now / 1000, .kind = TRACE_KEY, .key = key};
+		trace_write(trace, &e);
+	}
+	hal_linux_uart0_feed(key);
+}
+
+/**
+ *	Pass on what was typed; with nothing to do, wait for the wall clock to
+ *	catch up with the virtual one
+ */
+
+static void keyboard(uint64_t now, void *arg)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	int64_t ahead = (int64_t) now - ((t.tv_sec - started.tv_sec) * 1000000LL + (t.tv_nsec - started.tv_nsec) / 1000);
+
+	fflush(stdout);		//what the rover sent since the last check, acknowledgements included
+	struct pollfd fd = {0, POLLIN, 0};
+	for (int i = 0; i < SIM_INPUT_CHUNK && poll(&fd, 1, i == 0 && ahead > 0 ? ahead / 1000 : 0) > 0; i++)
+	{
+		unsigned char data;
+		if (read(0, &data, 1) != 1)
+		{
+			interactive = 0;	//stdin closed; end as a script would
+			script_end = now;
+			return;
+		}
+		send_key(now, (void *) (uintptr_t) data);
+	}
+	hal_linux_at(now + SIM_INPUT_US, keyboard, 0);
+}
+
+static void power_cycle(uint64_t now, void *arg)
+{
+	create_power_cycle();
+}
+
+static void lose_byte(uint64_t now, void *arg)
+{
+	create_lose(1);
+}
+
+static void time_limit(uint64_t now, void *arg)
+{
+	result = "timeout";
+	exit(1);
+}
+
+/**
+ *	End the run once the script is used up and nothing is moving or talking
+ */
+
+static void check_done(uint64_t now, void *arg)
+{
+	if (!interactive && mission_idle(now, script_end))
+	{
+		result = "idle";
+		exit(0);
+	}
+	hal_linux_at(now + SIM_CHECK_US, check_done, 0);
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = 0;
+	double limit = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "w:s:t:qr:iT:E:P:L:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'w':
+			path = optarg;
+			break;
+		case 's':
+			seed = strtoull(optarg, 0, 0);
+			break;
+		case 't':
+			limit = atof(optarg);
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 'i':
+			interactive = 1;
+			break;
+		case 'E':
+			line_errors = atof(optarg);
+			break;
+		case 'P':
+			hal_linux_at((uint64_t) (atof(optarg) * 1e6), power_cycle, 0);
+			create_faults = 1;
+			break;
+		case 'L':
+			hal_linux_at((uint64_t) (atof(optarg) * 1e6), lose_byte, 0);
+			create_faults = 1;
+			break;
+		case 'T':
+			if (mission_bands(optarg))
+			{
+				return 2;
+			}
+			break;
+		case 'r':
+			if (!(trace = fopen(optarg, "w")))
+			{
+				perror(optarg);
+				return 2;
+			}
+			create_frame_hook(trace_frame);
+			create_drive_hook(trace_drive);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-w world] [-s seed] [-t seconds] [-q] [-r trace] [-i] [-T bands] [-E rate] [-P seconds] [-L seconds] [script ...]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	int64_t end = world_load(path) ? -1 : mission_schedule(argc - optind, argv + optind, send_key);
+	if (end < 0)
+	{
+		return 2;
+	}
+	script_end = end;
+	if (trace)
+	{
+		fprintf(trace, "# sim -w %s -s %llu\n", path ? path : "(default)", (unsigned long long) seed);
+	}
+	world_seed(seed);
+	line_rng = seed;
+	world_attach();
+	hal_linux_uart0_connect(base_station_rx);
+	if (limit == 0 && !interactive)
+	{
+		limit = SIM_LIMIT;
+	}
+	if (limit > 0)
+	{
+		hal_linux_at((uint64_t) (limit * 1e6), time_limit, 0);
+	}
+	hal_linux_at(SIM_CHECK_US, check_done, 0);
+	if (interactive)
+	{
+		hal_linux_at(0, keyboard, 0);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &started);
+	atexit(report);
+	rover_main();
+	result = "complete";
+	return 0;
+}
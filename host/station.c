@@ -0,0 +1,792 @@
+/**
+ *	@file station.c
+ *	@brief base station: sends keys to the rover on USART0 as they are
+ *	typed, and keeps a live map and status from what it sends back
+ *
+ *	usage: station [-d device] [-b baud] [-e command] [-s script] [-m mm] [-f]
+ *
+ *	-d talks to the rover on a serial device (57600 baud, or -b). -e runs
+ *	a command on a pseudo-terminal and talks to that instead; the command
+ *	is the rover stand-in, usually ./sim -i -w worlds/lab.world. One of
+ *	the two is needed.
+ *
+ *	Every key typed goes to the rover on its own, the moment it can be
+ *	read, before anything is drawn; Ctrl-] quits. What the rover sends is
+ *	read as it arrives with telemetry.c, and the screen is redrawn at most
+ *	every STATION_FRAME_MS, only when something changed: the pose, status,
+ *	objects and key latency at the top, the map in the middle and the last
+ *	lines received at the bottom. The map is centred on the rover, -m
+ *	millimeters to a column (100 by default) and twice that to a row. It
+ *	shows the trail (.), the sonar returns of the last sweep (+), its
+ *	objects (their index), what the rover ran into (B bumper, C cliff,
+ *	T tape, D destination) and the rover itself (> ^ < v).
+ *
+ *	-s sends a script instead of the keyboard, with the words of sim.c,
+ *	timed by the wall clock: @T waits until T seconds after the start, +T
+ *	waits T seconds more, "space" sends the stop key and any other word is
+ *	sent one character at a time. Once the script is done and the rover has
+ *	been quiet for STATION_QUIET_MS, the program ends. Nothing is drawn.
+ *
+ *	-f sends every key but the stop key as a command frame of its own
+ *	(link.h) instead of bare. It first sends a LINK_SYNC, every
+ *	STATION_RESEND_MS until the rover acknowledges it: until then the
+ *	rover still takes bare keys, and the rest of a command frame whose
+ *	start was lost would be taken as keys. Then up to LINK_WINDOW commands
+ *	are on their way at a time, without waiting for what the rover prints
+ *	back for each; the rest wait their turn. When the oldest has not been
+ *	acknowledged after STATION_RESEND_MS, all that are on their way are
+ *	sent again. An acknowledgement of a seq that was never sent means the
+ *	rover counts from elsewhere (it was reset, or talked to another
+ *	station), and it is synced again. A rover that acknowledges nothing
+ *	for STATION_GIVE_UP_MS is given up on. The stop key is always sent
+ *	bare, so that it works at once. With a script, the program only ends
+ *	once every command has been acknowledged.
+ *
+ *	The rover's sensor feed (feed.h; the 't' key turns it on and off) is
+ *	taken out of what it sends, framed or not, and shown under the status:
+ *	bumpers, cliff sensors and cliff signals as of the last frame, and the
+ *	frames lost on the way.
+ *
+ *	Either way, it ends by printing the state it kept and the key latency,
+ *	the time from a key being ready to read (or due, for a script) until
+ *	it was written to the rover, and with -f the frames sent, sent again
+ *	and acknowledged, and the round trip time of the acknowledgements, if
+ *	the feed was on, the frames of it, their rate and their size, and if
+ *	sweeps came in binary (the 'b' key), the blocks of them.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "telemetry.h"
+#include "link.h"
+
+/// the screen is redrawn at most this often
+#define STATION_FRAME_MS	50
+/// a script ends once the rover has been quiet this long
+#define STATION_QUIET_MS	1500
+/// map size in characters
+#define MAP_COLUMNS		64
+#define MAP_ROWS		20
+/// lines of the log and of the object list shown
+#define SHOW_LOG		6
+#define SHOW_OBJECTS		4
+/// sonar returns further than this are not put on the map, cm
+#define SONAR_SHOWN		250
+/// quits
+#define KEY_QUIT		0x1D
+/// with -f, commands not acknowledged after this long are sent again
+#define STATION_RESEND_MS	250
+/// and a rover that acknowledges none for this long is given up on
+#define STATION_GIVE_UP_MS	10000
+/// keys that can wait for room in the window
+#define STATION_WAITING		1024
+#define MAX_WORDS		256
+
+/// a key of the script, due at a time
+struct scripted{
+	uint64_t at;		// us after the start
+	unsigned char key;
+};
+
+static struct telemetry state;
+static int rover = -1;			// serial device or pty master
+static pid_t child;
+static struct termios saved;		// terminal as it was
+static char raw_terminal;
+static uint64_t started;
+
+static unsigned long keys;
+static uint64_t latency_total;
+static uint64_t latency_max;
+
+// -f: commands in frames; a seq counts modulo 256
+static char framed;
+static struct link_parser from_rover;
+static unsigned char window_key[256];		// key of each seq on its way
+static uint64_t window_sent[256];		// when it was first sent
+static char window_resent[256];
+static unsigned char base;			// oldest seq not acknowledged
+static unsigned char next_seq;			// seq of the next new frame
+static uint64_t resend_at;			// when the LINK_SYNC or window goes out again
+static uint64_t last_ack;			// last acknowledgement, or when the window was last empty
+static char synced;				// the rover acknowledged the LINK_SYNC
+static struct scripted waiting[STATION_WAITING];	// keys for which the window has no room yet
+static unsigned int waiting_head, waiting_tail;
+static unsigned long frames, resent, acked, sync_frames;
+static uint64_t rtt_total, rtt_max;		// of acknowledgements of frames sent once
+static unsigned long rtt_count;
+
+static uint64_t now_us(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000000ULL + t.tv_nsec / 1000 - started;
+}
+
+static speed_t baud_rate(long baud)
+{
+	switch (baud)
+	{
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	default: return 0;
+	}
+}
+
+/**
+ *	Open the serial line to the rover, raw, 8N1
+ */
+
+static int open_device(const char *path, long baud)
+{
+	speed_t speed = baud_rate(baud);
+	if (!speed)
+	{
+		fprintf(stderr, "station: cannot set %ld baud\n", baud);
+		return -1;
+	}
+	int fd = open(path, O_RDWR | O_NOCTTY);
+	if (fd < 0)
+	{
+		perror(path);
+		return -1;
+	}
+	struct termios t;
+	if (tcgetattr(fd, &t) == 0)
+	{
+		cfmakeraw(&t);
+		t.c_cflag |= CLOCAL | CREAD;
+		cfsetispeed(&t, speed);
+		cfsetospeed(&t, speed);
+		tcsetattr(fd, TCSANOW, &t);
+	}
+	return fd;
+}
+
+/**
+ *	Run the stand-in on a pseudo-terminal; its stderr stays ours
+ */
+
+static int open_command(const char *command)
+{
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) || unlockpt(master))
+	{
+		perror("station: pty");
+		return -1;
+	}
+	int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+	if (slave < 0)
+	{
+		perror("station: pty");
+		return -1;
+	}
+	struct termios t;
+	tcgetattr(slave, &t);
+	cfmakeraw(&t);
+	tcsetattr(slave, TCSANOW, &t);
+
+	child = fork();
+	if (child == 0)
+	{
+		setsid();
+		dup2(slave, 0);
+		dup2(slave, 1);
+		close(slave);
+		close(master);
+		execl("/bin/sh", "sh", "-c", command, (char *) 0);
+		_exit(127);
+	}
+	close(slave);
+	if (child < 0)
+	{
+		perror("station: fork");
+		return -1;
+	}
+	return master;
+}
+
+static void restore_terminal(void)
+{
+	if (raw_terminal)
+	{
+		tcsetattr(0, TCSANOW, &saved);
+		fputs("\033[?25h\n", stdout);
+		raw_terminal = 0;
+	}
+}
+
+static void write_rover(const unsigned char *data, size_t n)
+{
+	for (size_t done = 0; done < n; )
+	{
+		ssize_t w = write(rover, data + done, n - done);
+		if (w < 0 && errno != EINTR)
+		{
+			break;
+		}
+		done += w > 0 ? w : 0;
+	}
+}
+
+static void count_key(uint64_t ready)
+{
+	uint64_t latency = now_us() - ready;
+	keys++;
+	latency_total += latency;
+	if (latency > latency_max)
+	{
+		latency_max = latency;
+	}
+}
+
+/// a frame is put together here, then written at once
+static unsigned char frame_bytes[LINK_PAYLOAD + 6];
+static size_t frame_length;
+
+static void frame_byte(unsigned char data)
+{
+	frame_bytes[frame_length++] = data;
+}
+
+static void write_frame(unsigned char type, unsigned char seq, const unsigned char *payload, unsigned char length)
+{
+	frame_length = 0;
+	link_send(frame_byte, type, seq, payload, length);
+	write_rover(frame_bytes, frame_length);
+	frames++;
+}
+
+/**
+ *	Send the commands waiting for it while the window has room
+ */
+
+static void fill_window(uint64_t now)
+{
+	while (synced && waiting_tail != waiting_head && (unsigned char) (next_seq - base) < LINK_WINDOW)
+	{
+		struct scripted *k = &waiting[waiting_tail];
+		waiting_tail = (waiting_tail + 1) % STATION_WAITING;
+		if (next_seq == base)
+		{
+			resend_at = now + STATION_RESEND_MS * 1000ULL;
+			last_ack = now;
+		}
+		window_key[next_seq] = k->key;
+		window_sent[next_seq] = now;
+		window_resent[next_seq] = 0;
+		write_frame(LINK_COMMAND, next_seq, &k->key, 1);
+		count_key(k->at);
+		next_seq++;
+	}
+}
+
+/**
+ *	Send the LINK_SYNC, or the whole window, again if it has gone
+ *	unacknowledged too long; returns -1 once the rover is given up on
+ */
+
+static int resend(uint64_t now)
+{
+	if ((synced && base == next_seq) || now < resend_at)
+	{
+		return 0;
+	}
+	if (now - last_ack >= STATION_GIVE_UP_MS * 1000ULL)
+	{
+		fprintf(stderr, "station: the rover does not acknowledge commands\n");
+		return -1;
+	}
+	resend_at = now + STATION_RESEND_MS * 1000ULL;
+	if (!synced)
+	{
+		write_frame(LINK_SYNC, base - 1, 0, 0);
+		sync_frames++;
+		return 0;
+	}
+	for (unsigned char seq = base; seq != next_seq; seq++)
+	{
+		write_frame(LINK_COMMAND, seq, &window_key[seq], 1);
+		window_resent[seq] = 1;
+		resent++;
+	}
+	return 0;
+}
+
+/**
+ *	The rover took every command up to seq
+ */
+
+static void take_ack(unsigned char seq, uint64_t now)
+{
+	if (!synced)
+	{
+		if (seq == (unsigned char) (base - 1))
+		{
+			synced = 1;
+			last_ack = now;
+			resend_at = now + STATION_RESEND_MS * 1000ULL;
+			fill_window(now);
+		}
+		return;		//anything else is from before the LINK_SYNC
+	}
+	if (seq == (unsigned char) (base - 1))
+	{
+		return;		//nothing new: a frame it did not take
+	}
+	if ((unsigned char) (seq - base) >= (unsigned char) (next_seq - base))
+	{
+		synced = 0;	//it counts from elsewhere; sync it again, then send the window
+		resend_at = now;
+		return;
+	}
+	for (unsigned char s = base; s != (unsigned char) (seq + 1); s++)
+	{
+		acked++;
+		if (!window_resent[s])
+		{
+			uint64_t rtt = now - window_sent[s];
+			rtt_total += rtt;
+			rtt_count++;
+			rtt_max = rtt > rtt_max ? rtt : rtt_max;
+		}
+	}
+	base = seq + 1;
+	last_ack = now;
+	resend_at = now + STATION_RESEND_MS * 1000ULL;
+	fill_window(now);
+}
+
+/**
+ *	Send one key to the rover; ready is when it could first have been sent
+ */
+
+static void send_key(unsigned char key, uint64_t ready)
+{
+	if (framed && key != ' ')
+	{
+		unsigned int next = (waiting_head + 1) % STATION_WAITING;
+		if (next != waiting_tail)
+		{
+			waiting[waiting_head].key = key;
+			waiting[waiting_head].at = ready;
+			waiting_head = next;
+		}
+		fill_window(now_us());
+		return;
+	}
+	write_rover(&key, 1);
+	count_key(ready);
+}
+
+/**
+ *	Take the acknowledgements and the sensor feed out of what the rover
+ *	sent, and read the rest
+ */
+
+static void receive(char *data, ssize_t n, uint64_t now)
+{
+	ssize_t text = 0;
+	for (ssize_t i = 0; i < n; i++)
+	{
+		int r = link_parse(&from_rover, data[i]);
+		if (r == LINK_BYTE)
+		{
+			data[text++] = data[i];
+		}
+		else if (r == LINK_FRAME && from_rover.frame.type == LINK_ACK)
+		{
+			if (framed)
+			{
+				take_ack(from_rover.frame.seq, now);
+			}
+		}
+		else if (r == LINK_FRAME)
+		{
+			telemetry_frame(&state, &from_rover.frame);
+		}
+	}
+	telemetry_feed(&state, data, text);
+}
+
+/**
+ *	Put a character on the map at a point, if it is in view
+ */
+
+static void plot(char map[MAP_ROWS][MAP_COLUMNS], double x, double y, long scale, char c)
+{
+	long column = lround((x - state.pose.x) / scale) + MAP_COLUMNS / 2;
+	long row = MAP_ROWS / 2 - lround((y - state.pose.y) / (2.0 * scale));
+	if (column >= 0 && column < MAP_COLUMNS && row >= 0 && row < MAP_ROWS)
+	{
+		map[row][column] = c;
+	}
+}
+
+/**
+ *	Draw the whole screen with one write
+ */
+
+static void render(long scale)
+{
+	static char screen[16384];
+	char map[MAP_ROWS][MAP_COLUMNS];
+	size_t n = 0;
+	const struct telemetry *t = &state;
+
+#define PUT(...) (n += snprintf(screen + n, n < sizeof(screen) ? sizeof(screen) - n : 0, __VA_ARGS__))
+
+	memset(map, ' ', sizeof(map));
+	unsigned long first = t->trail_count > TELEMETRY_TRAIL ? t->trail_count - TELEMETRY_TRAIL : 0;
+	for (unsigned long i = first; i < t->trail_count; i++)
+	{
+		plot(map, t->trail[i % TELEMETRY_TRAIL].x, t->trail[i % TELEMETRY_TRAIL].y, scale, '.');
+	}
+	for (int d = 0; d < TELEMETRY_DEGREES; d++)
+	{
+		if (t->sonar[d] > 0 && t->sonar[d] < SONAR_SHOWN)
+		{
+			double a = (t->sweep_pose.angle + d - 90) * M_PI / 180;
+			plot(map, t->sweep_pose.x + t->sonar[d] * 10 * cos(a), t->sweep_pose.y + t->sonar[d] * 10 * sin(a), scale, '+');
+		}
+	}
+	for (int i = 0; i < t->object_count; i++)
+	{
+		plot(map, t->objects[i].x, t->objects[i].y, scale, '0' + t->objects[i].index % 10);
+	}
+	first = t->hazard_count > TELEMETRY_HAZARDS ? t->hazard_count - TELEMETRY_HAZARDS : 0;
+	for (unsigned long i = first; i < t->hazard_count; i++)
+	{
+		const struct telemetry_hazard *h = &t->hazards[i % TELEMETRY_HAZARDS];
+		plot(map, h->x, h->y, scale, h->kind - 'a' + 'A');
+	}
+	int heading = ((t->pose.angle % 360) + 360 + 45) % 360 / 90;
+	plot(map, t->pose.x, t->pose.y, scale, ">^<v"[heading]);
+
+	PUT("\033[H\033[?25l");
+	PUT("X %6d mm  Y %6d mm  angle %4d  objects %d  keys %lu  latency max %llu us\033[K\r\n",
+		t->pose.x, t->pose.y, t->pose.angle, t->object_count, keys, (unsigned long long) latency_max);
+	PUT("%.*s\033[K\r\n", MAP_COLUMNS + 14, t->status);
+	const struct telemetry_sensors *f = &t->sensors;
+	if (f->valid)
+	{
+		PUT("bump %c%c  cliff %c%c%c%c  signals %4d %4d %4d %4d  lost %lu\033[K\r\n",
+			f->bumper_left ? 'L' : '-', f->bumper_right ? 'R' : '-',
+			f->cliff[0] ? 'L' : '-', f->cliff[1] ? 'l' : '-', f->cliff[2] ? 'r' : '-', f->cliff[3] ? 'R' : '-',
+			f->cliff_signal[0], f->cliff_signal[1], f->cliff_signal[2], f->cliff_signal[3], f->lost);
+	}
+	else
+	{
+		PUT("%s\033[K\r\n", f->frames ? "sensor feed: waiting for a keyframe" : "");
+	}
+	for (int i = 0; i < SHOW_OBJECTS; i++)
+	{
+		if (i < t->object_count)
+		{
+			const struct telemetry_object *o = &t->objects[i];
+			PUT("object %d: %3d deg  width %6.2f cm  sonar %6.2f cm  IR %6.2f cm\033[K\r\n",
+				o->index, o->degree, o->width, o->sonar, o->ir);
+		}
+		else
+		{
+			PUT("\033[K\r\n");
+		}
+	}
+	PUT("+%.*s+\033[K\r\n", MAP_COLUMNS, "----------------------------------------------------------------");
+	for (int r = 0; r < MAP_ROWS; r++)
+	{
+		PUT("|%.*s|\033[K\r\n", MAP_COLUMNS, map[r]);
+	}
+	PUT("+%.*s+ %ld mm/column\033[K\r\n", MAP_COLUMNS, "----------------------------------------------------------------", scale);
+	for (int i = SHOW_LOG; i > 0; i--)
+	{
+		const char *line = t->lines >= (unsigned long) i ? t->log[(t->lines - i) % TELEMETRY_LOG] : "";
+		PUT("%.*s\033[K\r\n", MAP_COLUMNS + 14, line);
+	}
+	PUT("\033[J");
+#undef PUT
+
+	if (n > sizeof(screen))
+	{
+		n = sizeof(screen);
+	}
+	for (size_t done = 0; done < n; )
+	{
+		ssize_t w = write(1, screen + done, n - done);
+		if (w < 0 && errno != EINTR)
+		{
+			break;
+		}
+		done += w > 0 ? w : 0;
+	}
+}
+
+/**
+ *	Read the script into keys due at times; returns the count, or -1
+ */
+
+static int schedule(char *script, struct scripted *out, int size)
+{
+	uint64_t at = 0;
+	int count = 0;
+	for (char *w = strtok(script, " \t\n"); w; w = strtok(0, " \t\n"))
+	{
+		if (w[0] == '@' || w[0] == '+')
+		{
+			char *end;
+			double s = strtod(w + 1, &end);
+			if (end == w + 1 || *end || s < 0)
+			{
+				fprintf(stderr, "station: cannot read time '%s'\n", w);
+				return -1;
+			}
+			at = (w[0] == '@' ? 0 : at) + (uint64_t) (s * 1e6);
+			continue;
+		}
+		const char *send = strcmp(w, "space") ? w : " ";
+		for (int j = 0; send[j] && count < size; j++)
+		{
+			out[count].at = at;
+			out[count++].key = send[j];
+		}
+	}
+	return count;
+}
+
+static void summary(void)
+{
+	const struct telemetry *t = &state;
+	printf("station: x=%d y=%d angle=%d lines=%lu objects=%d hazards=%lu keys=%lu "
+		"latency_max_us=%llu latency_mean_us=%.1f\n",
+		t->pose.x, t->pose.y, t->pose.angle, t->lines, t->object_count, t->hazard_count, keys,
+		(unsigned long long) latency_max, keys ? (double) latency_total / keys : 0.0);
+	if (framed)
+	{
+		unsigned int unacked = (unsigned char) (next_seq - base) + (waiting_head - waiting_tail) % STATION_WAITING;
+		printf("link: frames=%lu resent=%lu syncs=%lu acked=%lu unacked=%u ack_rtt_max_ms=%.1f "
+			"ack_rtt_mean_ms=%.1f crc_errors=%u\n",
+			frames, resent, sync_frames, acked, unacked,
+			rtt_max / 1000.0, rtt_count ? rtt_total / 1000.0 / rtt_count : 0.0, from_rover.errors);
+	}
+	const struct telemetry_sensors *f = &t->sensors;
+	if (f->frames || f->skipped)
+	{
+		uint32_t span = f->ms - f->first_ms;
+		printf("feed: frames=%lu keyframes=%lu lost=%lu skipped=%lu rate_hz=%.1f payload_bytes=%.1f "
+			"cliff_signal_min=%d,%d,%d,%d\n",
+			f->frames, f->keyframes, f->lost, f->skipped, span && f->frames > 1 ? (f->frames - 1) * 1000.0 / span : 0.0,
+			(f->frames + f->skipped) ? (double) f->bytes / (f->frames + f->skipped) : 0.0,
+			f->cliff_signal_min[0], f->cliff_signal_min[1], f->cliff_signal_min[2], f->cliff_signal_min[3]);
+	}
+	if (t->blocks || t->blocks_lost)
+	{
+		int samples = 0;
+		for (int d = 0; d < TELEMETRY_DEGREES; d++)
+		{
+			samples += t->sonar[d] >= 0 || t->ir[d] >= 0;
+		}
+		printf("sweep: blocks=%lu lost=%lu samples=%d\n", t->blocks, t->blocks_lost, samples);
+	}
+	for (int i = 0; i < t->object_count; i++)
+	{
+		const struct telemetry_object *o = &t->objects[i];
+		printf("object %d: degree=%d width=%.2f sonar=%.2f ir=%.2f x=%.0f y=%.0f\n",
+			o->index, o->degree, o->width, o->sonar, o->ir, o->x, o->y);
+	}
+	if (t->status[0])
+	{
+		printf("status: %s\n", t->status);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *device = 0, *command = 0;
+	char *script = 0;
+	long baud = 57600, scale = 100;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:b:e:s:m:f")) != -1)
+	{
+		switch (opt)
+		{
+		case 'd':
+			device = optarg;
+			break;
+		case 'b':
+			baud = atol(optarg);
+			break;
+		case 'e':
+			command = optarg;
+			break;
+		case 's':
+			script = optarg;
+			break;
+		case 'm':
+			scale = atol(optarg) > 0 ? atol(optarg) : 100;
+			break;
+		case 'f':
+			framed = 1;
+			break;
+		default:
+			device = command = 0;
+			optind = argc + 1;
+			break;
+		}
+	}
+	if (!device == !command || optind != argc)
+	{
+		fprintf(stderr, "usage: %s [-d device] [-b baud] [-e command] [-s script] [-m mm] [-f]\n", argv[0]);
+		return 2;
+	}
+
+	static struct scripted scripted[MAX_WORDS * 4];
+	int script_keys = 0, next_key = 0;
+	if (script && (script_keys = schedule(script, scripted, MAX_WORDS * 4)) < 0)
+	{
+		return 2;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	rover = device ? open_device(device, baud) : open_command(command);
+	if (rover < 0)
+	{
+		return 1;
+	}
+	telemetry_init(&state);
+	started = 0;
+	started = now_us();
+
+	if (!script && isatty(0) && tcgetattr(0, &saved) == 0)
+	{
+		struct termios t = saved;
+		cfmakeraw(&t);
+		tcsetattr(0, TCSANOW, &t);
+		raw_terminal = 1;
+		atexit(restore_terminal);
+		fputs("\033[2J", stdout);
+		fflush(stdout);
+	}
+
+	uint64_t last_render = 0, last_heard = 0;
+	unsigned long rendered = ~0UL;
+	int input = script ? -1 : 0;
+	for (;;)
+	{
+		uint64_t now = now_us();
+		uint64_t due = UINT64_MAX;	// when something has to be done without input
+		if (script)
+		{
+			if (next_key < script_keys)
+			{
+				due = scripted[next_key].at;
+			}
+			else if (framed && (!synced || base != next_seq))
+			{
+				//commands still on their way; resend() runs when they are due
+			}
+			else if (now - last_heard >= STATION_QUIET_MS * 1000ULL)
+			{
+				break;
+			}
+			else
+			{
+				due = last_heard + STATION_QUIET_MS * 1000ULL;
+			}
+		}
+		else if (raw_terminal && state.changes != rendered)
+		{
+			due = last_render + STATION_FRAME_MS * 1000ULL;
+		}
+		if (framed && (!synced || base != next_seq) && resend_at < due)
+		{
+			due = resend_at;
+		}
+		struct timespec wait = {0, 0};
+		if (due > now && due != UINT64_MAX)
+		{
+			wait.tv_sec = (due - now) / 1000000;
+			wait.tv_nsec = (due - now) % 1000000 * 1000;
+		}
+
+		struct pollfd fds[2] = {{rover, POLLIN, 0}, {input, POLLIN, 0}};
+		int ready = ppoll(fds, input >= 0 ? 2 : 1, due == UINT64_MAX ? 0 : &wait, 0);
+		now = now_us();
+		if (ready < 0 && errno != EINTR)
+		{
+			break;
+		}
+
+		//keys first: nothing else may come between a key and the rover
+		while (script && next_key < script_keys && scripted[next_key].at <= now)
+		{
+			send_key(scripted[next_key].key, scripted[next_key].at);
+			next_key++;
+		}
+		if (input >= 0 && (fds[1].revents & (POLLIN | POLLHUP)))
+		{
+			unsigned char typed[64];
+			ssize_t got = read(0, typed, sizeof(typed));
+			if (got <= 0)
+			{
+				input = -1;
+			}
+			for (ssize_t i = 0; i < got; i++)
+			{
+				if (typed[i] == KEY_QUIT)
+				{
+					goto done;
+				}
+				send_key(typed[i], now);
+			}
+		}
+
+		if (fds[0].revents & (POLLIN | POLLHUP | POLLERR))
+		{
+			char received[4096];
+			ssize_t got = read(rover, received, sizeof(received));
+			if (got <= 0)
+			{
+				break;		//the stand-in exited, or the device went away
+			}
+			receive(received, got, now);
+			last_heard = now;
+		}
+		if (framed && resend(now))
+		{
+			break;
+		}
+
+		if (raw_terminal && state.changes != rendered && now - last_render >= STATION_FRAME_MS * 1000ULL)
+		{
+			render(scale);
+			rendered = state.changes;
+			last_render = now;
+		}
+	}
+done:
+	restore_terminal();
+	close(rover);
+	if (child > 0)
+	{
+		waitpid(child, 0, 0);
+	}
+	summary();
+	return 0;
+}
@@ -0,0 +1,671 @@
+/**
+ *	@file sweepscan.c
+ *	@brief runs the object segmentation of sweep() again over an archive of
+ *	logs, with other parameters, and scores each set against the course
+ *
+ *	usage: sweepscan -w world [-j threads] [-r cm] [-p lo,hi,min,smooth,width]... log...
+ *
+ *	A log is what the rover sent to the base station (a terminal capture,
+ *	or sim output). Every sweep() table in it is taken with the pose of the
+ *	last "Location:" line before it, and the objects sweep() listed after it.
+ *	The files are memory-mapped and read in place: lines and numbers are
+ *	found with pointers into the mapping, nothing is copied.
+ *
+ *	The segmentation is the one in sweep(): an object starts where the IR
+ *	distance comes into (lo, hi) cm and ends where it leaves, and its width
+ *	is 2 d tan(span / 2). A parameter set changes
+ *
+ *	lo, hi		the IR band, cm (sweep() uses 5 and 50)
+ *	min		narrowest object kept, degrees (0)
+ *	smooth		median filter over this many degrees of IR first (1, none)
+ *	width		d for the width: 0 sonar at the last degree, as sweep()
+ *			does, 1 median sonar over the object, 2 IR at its middle
+ *
+ *	Without -p, a grid of 216 sets around the firmware's is tried.
+ *
+ *	The truth comes from the world file: the posts (walls are not objects
+ *	sweep() is meant to find) whose near side is within -r cm (50) of the
+ *	servo and in front of it, placed from the course's start pose and the
+ *	rover's reported pose. That is only as good as the rover's odometry:
+ *	a log whose turns drifted is scored against where the rover thought it
+ *	was, so archives for comparing settings are best taken on straight
+ *	runs, or after calibrating. A detection matches a post when its degree is
+ *	within the post's angular half-width plus MATCH_SLACK degrees.
+ *
+ *	The logs are shared out among -j threads (all cores by default), each
+ *	one taking the next file and scoring it against every set, and the
+ *	counts are added up at the end. One JSON object per set is printed, in
+ *	the order tried, then the best by F1 and a summary: files, sweeps, time,
+ *	and how many sweeps the firmware's own set gives exactly the objects
+ *	the log lists, which checks this copy of the segmentation.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define PI		3.14159265358979
+#define DEGREES		181
+#define MAX_SETS	512
+#define MAX_POSTS	64
+#define MAX_FOUND	16
+#define MAX_THREADS	256
+/// degrees of slack on top of a post's angular half-width for a match
+#define MATCH_SLACK	5
+
+/// one parameter set
+struct params{
+	double lo, hi;
+	int min_span;
+	int smooth;
+	int width;
+};
+
+/// what one set got right and wrong, added up over sweeps
+struct score{
+	unsigned long truth;		// posts that should have been found
+	unsigned long found;		// objects found
+	unsigned long matched;		// found objects that match a post
+	double width_error;		// sum of |width - post diameter| over matches, cm
+};
+
+/// an object, found or listed
+struct object{
+	int degree;
+	double width;
+};
+
+/// a sweep taken from a log
+struct sweep{
+	double x, y, heading;		// servo pose on the course, mm and degrees
+	double ir[DEGREES];
+	double sonar[DEGREES];
+	char have[DEGREES];
+	struct object listed[MAX_FOUND];	// what the firmware sent
+	int listed_count;
+};
+
+/// the parts of the course the truth needs
+static struct{
+	double start_x, start_y, start_heading;
+	double mount;
+	double posts[MAX_POSTS][3];
+	int post_count;
+} course;
+
+static struct params sets[MAX_SETS];
+static int set_count;
+static double truth_range = 50;
+
+static char **files;
+static int file_count;
+static int next_file;
+static pthread_mutex_t next_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/// what one thread added up
+struct tally{
+	struct score scores[MAX_SETS];
+	unsigned long sweeps;
+	unsigned long agree;		// sweeps where the firmware's set reproduced the log
+	unsigned long bytes;
+	unsigned long failed;		// files that could not be read
+};
+
+static int load_world(const char *path)
+{
+	FILE *in = fopen(path, "r");
+	if (!in)
+	{
+		perror(path);
+		return -1;
+	}
+	char line[256];
+	while (fgets(line, sizeof(line), in))
+	{
+		double a, b, c;
+		if (sscanf(line, " start %lf %lf %lf", &a, &b, &c) == 3)
+		{
+			course.start_x = a;
+			course.start_y = b;
+			course.start_heading = c;
+		}
+		else if (sscanf(line, " post %lf %lf %lf", &a, &b, &c) == 3 && course.post_count < MAX_POSTS)
+		{
+			course.posts[course.post_count][0] = a;
+			course.posts[course.post_count][1] = b;
+			course.posts[course.post_count++][2] = c;
+		}
+		else if (sscanf(line, " mount %lf", &a) == 1)
+		{
+			course.mount = a;
+		}
+	}
+	fclose(in);
+	return 0;
+}
+
+/**
+ *	Read a number at *p, not past end; moves *p past it. Returns 0 if there is none.
+ */
+
+static int number(const char **p, const char *end, double *value)
+{
+	const char *s = *p;
+	while (s < end && (*s == ' ' || *s == '\t'))
+	{
+		s++;
+	}
+	int negative = s < end && *s == '-';
+	s += negative;
+	const char *digits = s;
+	double v = 0;
+	while (s < end && *s >= '0' && *s <= '9')
+	{
+		v = v * 10 + (*s++ - '0');
+	}
+	if (s < end && *s == '.')
+	{
+		double scale = 0.1;
+		for (s++; s < end && *s >= '0' && *s <= '9'; s++, scale /= 10)
+		{
+			v += (*s - '0') * scale;
+		}
+	}
+	if (s == digits)
+	{
+		return 0;
+	}
+	*value = negative ? -v : v;
+	*p = s;
+	return 1;
+}
+
+static int starts(const char *p, const char *end, const char *prefix)
+{
+	size_t n = strlen(prefix);
+	return (size_t) (end - p) >= n && !memcmp(p, prefix, n);
+}
+
+/**
+ *	Read the number after a label in a line, as in "Degree: 90"
+ */
+
+static int field(const char *p, const char *end, const char *label, double *value)
+{
+	if (!starts(p, end, label))
+	{
+		return 0;
+	}
+	p += strlen(label);
+	return number(&p, end, value);
+}
+
+static double median(double *v, int n)
+{
+	for (int i = 1; i < n; i++)
+	{
+		for (int j = i; j > 0 && v[j - 1] > v[j]; j--)
+		{
+			double t = v[j];
+			v[j] = v[j - 1];
+			v[j - 1] = t;
+		}
+	}
+	return v[n / 2];
+}
+
+/**
+ *	sweep()'s segmentation with a parameter set; returns the objects found
+ */
+
+static int segment(const struct sweep *s, const struct params *p, struct object *found)
+{
+	double ir[DEGREES];
+	for (int i = 0; i < DEGREES; i++)
+	{
+		double window[DEGREES];
+		int n = 0;
+		for (int j = i - p->smooth / 2; j <= i + p->smooth / 2; j++)
+		{
+			if (j >= 0 && j < DEGREES)
+			{
+				window[n++] = s->ir[j];
+			}
+		}
+		ir[i] = n == 1 ? window[0] : median(window, n);
+	}
+
+	int count = 0;
+	int start = 0;
+	double last, current = 0;
+	for (int i = 0; i < DEGREES; i++)
+	{
+		last = current;
+		current = ir[i];
+		if ((last < p->lo || last > p->hi) && current < p->hi && current > p->lo)
+		{
+			start = i;
+		}
+		if (last > p->lo && last < p->hi && (current > p->hi || current < p->lo) && count < MAX_FOUND)
+		{
+			int span = i - start;
+			if (span < p->min_span)
+			{
+				continue;
+			}
+			int middle = (i + start) / 2;
+			double d;
+			if (p->width == 0)
+			{
+				d = s->sonar[i] != 0 ? s->sonar[i] : ir[middle];	//0 is no echo
+			}
+			else if (p->width == 1)
+			{
+				double window[DEGREES];
+				int n = 0;
+				for (int j = start; j < i; j++)
+				{
+					window[n++] = s->sonar[j];
+				}
+				d = n ? median(window, n) : s->sonar[i];
+			}
+			else
+			{
+				d = ir[middle];
+			}
+			found[count].degree = middle;
+			found[count++].width = 2 * d * tan(span * PI / 360);
+		}
+	}
+	return count;
+}
+
+/**
+ *	Score the objects found in a sweep against the posts in front of it
+ */
+
+static void score(const struct sweep *s, const struct object *found, int count, struct score *sc)
+{
+	char used[MAX_FOUND] = {0};
+	for (int k = 0; k < course.post_count; k++)
+	{
+		double dx = course.posts[k][0] - s->x;
+		double dy = course.posts[k][1] - s->y;
+		double r = course.posts[k][2];
+		double d = sqrt(dx * dx + dy * dy);
+		double degree = atan2(dy, dx) * 180 / PI - s->heading + 90;
+		degree = fmod(degree + 540, 360) - 180;
+		if (d - r > truth_range * 10 || d <= r || degree < 0 || degree > 180)
+		{
+			continue;
+		}
+		sc->truth++;
+
+		double tolerance = asin(r / d) * 180 / PI + MATCH_SLACK;
+		int best = -1;
+		for (int i = 0; i < count; i++)
+		{
+			double off = fabs(found[i].degree - degree);
+			if (!used[i] && off <= tolerance && (best < 0 || off < fabs(found[best].degree - degree)))
+			{
+				best = i;
+			}
+		}
+		if (best >= 0)
+		{
+			used[best] = 1;
+			sc->matched++;
+			sc->width_error += fabs(found[best].width - 2 * r / 10);
+		}
+	}
+	sc->found += count;
+}
+
+/**
+ *	Whether a set reproduces the objects the firmware listed
+ */
+
+static int agrees(const struct sweep *s, const struct object *found, int count)
+{
+	if (count != s->listed_count)
+	{
+		return 0;
+	}
+	for (int i = 0; i < count; i++)
+	{
+		if (found[i].degree != s->listed[i].degree || fabs(found[i].width - s->listed[i].width) > 0.5)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void finish_sweep(struct sweep *s, struct tally *t)
+{
+	struct object found[MAX_FOUND];
+	t->sweeps++;
+	for (int k = 0; k < set_count; k++)
+	{
+		int count = segment(s, &sets[k], found);
+		score(s, found, count, &t->scores[k]);
+		if (k == 0 && agrees(s, found, count))
+		{
+			t->agree++;
+		}
+	}
+}
+
+/**
+ *	Read one log in place and score its sweeps
+ */
+
+static void scan(const char *path, struct tally *t)
+{
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st))
+	{
+		perror(path);
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+		t->failed++;
+		return;
+	}
+	if (st.st_size == 0)
+	{
+		close(fd);
+		return;
+	}
+	const char *data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		perror(path);
+		t->failed++;
+		return;
+	}
+	madvise((void *) data, st.st_size, MADV_SEQUENTIAL);
+	t->bytes += st.st_size;
+
+	static __thread struct sweep s;
+	double px = 0, py = 0, pa = 0;		// reported pose
+	int state = 0;				// 0 outside a sweep, 1 in its table, 2 in its objects
+	const char *end = data + st.st_size;
+	for (const char *p = data; p < end; )
+	{
+		const char *eol = memchr(p, '\n', end - p);
+		if (!eol)
+		{
+			eol = end;
+		}
+		const char *q = p;
+		while (q < eol && (*q == '\r' || *q == '\t' || *q == ' '))
+		{
+			q++;
+		}
+		const char *e = eol > q && eol[-1] == '\r' ? eol - 1 : eol;
+		double v[3];
+
+		if (state == 1)
+		{
+			const char *r = q;
+			if (number(&r, e, &v[0]) && number(&r, e, &v[1]) && number(&r, e, &v[2]) && v[0] >= 0 && v[0] < DEGREES)
+			{
+				int d = (int) v[0];
+				s.ir[d] = v[1];
+				s.sonar[d] = v[2];
+				s.have[d] = 1;
+				p = eol + 1;
+				continue;
+			}
+			state = 2;
+		}
+		if (state == 2)
+		{
+			if (field(q, e, "Index:", &v[0]))
+			{
+				if (s.listed_count < MAX_FOUND)
+				{
+					s.listed[s.listed_count++].degree = 0;
+				}
+				p = eol + 1;
+				continue;
+			}
+			if (s.listed_count && field(q, e, "Degree:", &v[0]))
+			{
+				s.listed[s.listed_count - 1].degree = (int) v[0];
+				p = eol + 1;
+				continue;
+			}
+			if (s.listed_count && field(q, e, "Width:", &v[0]))
+			{
+				s.listed[s.listed_count - 1].width = v[0];
+				p = eol + 1;
+				continue;
+			}
+			if (q == e || starts(q, e, "Sonar Distance:") || starts(q, e, "IR distance:"))
+			{
+				p = eol + 1;
+				continue;
+			}
+			finish_sweep(&s, t);
+			state = 0;
+		}
+
+		if (field(q, e, "Location: X:", &v[0]))
+		{
+			const char *r = q + strlen("Location: X:");
+			double x, y, rr, a;
+			if (number(&r, e, &x) && (r = memmem(r, e - r, "Y:", 2)) && (r += 2, number(&r, e, &y)) &&
+					(r = memmem(r, e - r, "R:", 2)) && (r += 2, number(&r, e, &rr)) &&
+					(r = memmem(r, e - r, "Angle:", 6)) && (r += 6, number(&r, e, &a)))
+			{
+				px = x;
+				py = y;
+				pa = a;
+			}
+		}
+		else if (starts(q, e, "Degrees"))
+		{
+			//the rover's frame starts at the course's start pose
+			double h = course.start_heading * PI / 180;
+			double heading = course.start_heading + pa;
+			double hr = heading * PI / 180;
+			memset(&s, 0, sizeof(s));
+			s.x = course.start_x + px * cos(h) - py * sin(h) + course.mount * cos(hr);
+			s.y = course.start_y + px * sin(h) + py * cos(h) + course.mount * sin(hr);
+			s.heading = heading;
+			state = 1;
+		}
+		p = eol + 1;
+	}
+	if (state)
+	{
+		finish_sweep(&s, t);
+	}
+	munmap((void *) data, st.st_size);
+}
+
+static void *worker(void *arg)
+{
+	struct tally *t = arg;
+	for (;;)
+	{
+		pthread_mutex_lock(&next_lock);
+		int i = next_file++;
+		pthread_mutex_unlock(&next_lock);
+		if (i >= file_count)
+		{
+			return 0;
+		}
+		scan(files[i], t);
+	}
+}
+
+/**
+ *	The firmware's set first, then a grid around it
+ */
+
+static void default_sets(void)
+{
+	static const double los[] = {5, 10};
+	static const double his[] = {40, 50, 60, 80};
+	static const int spans[] = {0, 3, 6};
+	static const int smooths[] = {1, 3, 5};
+
+	sets[set_count++] = (struct params) {5, 50, 0, 1, 0};
+	for (int a = 0; a < 2; a++)
+	for (int b = 0; b < 4; b++)
+	for (int c = 0; c < 3; c++)
+	for (int d = 0; d < 3; d++)
+	for (int w = 0; w < 3; w++)
+	{
+		struct params p = {los[a], his[b], spans[c], smooths[d], w};
+		if (p.lo != 5 || p.hi != 50 || p.min_span || p.smooth != 1 || p.width)
+		{
+			sets[set_count++] = p;
+		}
+	}
+}
+
+static double f1_of(const struct score *sc)
+{
+	double precision = sc->found ? (double) sc->matched / sc->found : 0;
+	double recall = sc->truth ? (double) sc->matched / sc->truth : 0;
+	return precision + recall > 0 ? 2 * precision * recall / (precision + recall) : 0;
+}
+
+static double width_error_of(const struct score *sc)
+{
+	return sc->matched ? sc->width_error / sc->matched : 0;
+}
+
+static void print_set(const char *label, int k, const struct score *sc)
+{
+	const struct params *p = &sets[k];
+	double precision = sc->found ? (double) sc->matched / sc->found : 0;
+	double recall = sc->truth ? (double) sc->matched / sc->truth : 0;
+	printf("{\"%s\": {\"lo\": %g, \"hi\": %g, \"min\": %d, \"smooth\": %d, \"width\": %d}, "
+		"\"truth\": %lu, \"found\": %lu, \"matched\": %lu, \"precision\": %.3f, \"recall\": %.3f, "
+		"\"f1\": %.3f, \"width_error_cm\": %.2f}\n",
+		label, p->lo, p->hi, p->min_span, p->smooth, p->width, sc->truth, sc->found, sc->matched,
+		precision, recall, f1_of(sc), width_error_of(sc));
+}
+
+int main(int argc, char **argv)
+{
+	const char *world_path = 0;
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int opt;
+
+	while ((opt = getopt(argc, argv, "w:j:r:p:")) != -1)
+	{
+		struct params p;
+		switch (opt)
+		{
+		case 'w':
+			world_path = optarg;
+			break;
+		case 'j':
+			threads = atol(optarg);
+			break;
+		case 'r':
+			truth_range = atof(optarg);
+			break;
+		case 'p':
+			if (set_count == MAX_SETS ||
+					sscanf(optarg, "%lf,%lf,%d,%d,%d", &p.lo, &p.hi, &p.min_span, &p.smooth, &p.width) != 5 ||
+					p.smooth < 1 || p.width < 0 || p.width > 2)
+			{
+				fprintf(stderr, "sweepscan: cannot use parameter set '%s'\n", optarg);
+				return 2;
+			}
+			sets[set_count++] = p;
+			break;
+		default:
+			world_path = 0;
+			optind = argc;
+			break;
+		}
+	}
+	if (!world_path || optind >= argc)
+	{
+		fprintf(stderr, "usage: %s -w world [-j threads] [-r cm] [-p lo,hi,min,smooth,width]... log...\n", argv[0]);
+		return 2;
+	}
+	if (load_world(world_path))
+	{
+		return 2;
+	}
+	if (set_count == 0)
+	{
+		default_sets();
+	}
+	if (threads < 1)
+	{
+		threads = 1;
+	}
+	if (threads > MAX_THREADS)
+	{
+		threads = MAX_THREADS;
+	}
+	files = argv + optind;
+	file_count = argc - optind;
+
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	struct tally *tallies = calloc(threads, sizeof(*tallies));
+	pthread_t ids[MAX_THREADS];
+	for (long i = 0; i < threads; i++)
+	{
+		pthread_create(&ids[i], 0, worker, &tallies[i]);
+	}
+	struct tally total = {0};
+	for (long i = 0; i < threads; i++)
+	{
+		pthread_join(ids[i], 0);
+		for (int k = 0; k < set_count; k++)
+		{
+			total.scores[k].truth += tallies[i].scores[k].truth;
+			total.scores[k].found += tallies[i].scores[k].found;
+			total.scores[k].matched += tallies[i].scores[k].matched;
+			total.scores[k].width_error += tallies[i].scores[k].width_error;
+		}
+		total.sweeps += tallies[i].sweeps;
+		total.agree += tallies[i].agree;
+		total.bytes += tallies[i].bytes;
+		total.failed += tallies[i].failed;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+	int best = 0;
+	for (int k = 0; k < set_count; k++)
+	{
+		print_set("params", k, &total.scores[k]);
+		//ties go to the smaller width error
+		double f1 = f1_of(&total.scores[k]), best_f1 = f1_of(&total.scores[best]);
+		if (f1 > best_f1 || (f1 == best_f1 && width_error_of(&total.scores[k]) < width_error_of(&total.scores[best])))
+		{
+			best = k;
+		}
+	}
+	print_set("best", best, &total.scores[best]);
+	printf("{\"files\": %d, \"unreadable\": %lu, \"bytes\": %lu, \"sweeps\": %lu, \"sets\": %d, \"threads\": %ld, "
+		"\"seconds\": %.3f, \"first_set_reproduces_log\": %lu}\n",
+		file_count, total.failed, total.bytes, total.sweeps, set_count, threads, seconds, total.agree);
+	free(tallies);
+	return total.failed ? 1 : 0;
+}
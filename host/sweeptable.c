@@ -0,0 +1,98 @@
+/**
+ *	@file sweeptable.c
+ *	@brief turns the sweeps a rover sent in binary back into its text
+ *
+ *	Reads what the rover sent to the base station and copies it to standard
+ *	output, except that the blocks of each sweep sent in binary (the 'b'
+ *	key; see sweepblock.h) become the table sweep() prints in text: the
+ *	"Degrees" heading, then "degree, IR distance, sonar distance" rows.
+ *	Other frames of the link are left out. A sweep sent in binary thus
+ *	reads as if it had been sent in text, and works with the tools that
+ *	read text logs (sweepscan, telemetry.c).
+ *
+ *	usage: sweeptable [capture]	(standard input without one)
+ *
+ *	The rows of a block that was lost or damaged are missing. Once the
+ *	input is used up, a line "sweeptable: sweeps= blocks= lost= rows="
+ *	goes to stderr, and the status is 1 if a block was lost or any frame
+ *	was damaged.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "link.h"
+#include "sweepblock.h"
+
+/**
+ *	Print hundredths of a centimeter as %q would print them
+ */
+
+static void print_hundredths(int32_t h)
+{
+	long mag = labs((long) h);
+	printf("%s%ld.%02ld", h < 0 ? "-" : "", mag / 100, mag % 100);
+}
+
+int main(int argc, char **argv)
+{
+	FILE *in = stdin;
+	if (argc > 1 && !(in = fopen(argv[1], "rb")))
+	{
+		perror(argv[1]);
+		return 1;
+	}
+
+	struct link_parser parser = {0};
+	struct sweep_sample samples[SWEEP_BLOCK_SAMPLES];
+	unsigned char expect = 0;		// seq of the next block
+	unsigned long sweeps = 0, blocks = 0, lost = 0, rows = 0;
+	int c;
+
+	while ((c = getc(in)) != EOF)
+	{
+		int r = link_parse(&parser, c);
+		if (r == LINK_BYTE)
+		{
+			putchar(c);
+			continue;
+		}
+		if (r != LINK_FRAME || parser.frame.type != LINK_SWEEP)
+		{
+			continue;
+		}
+
+		const struct link_frame *f = &parser.frame;
+		if (f->seq == 0)
+		{
+			printf("Degrees\t\tIR Distance (cm)\t\tSonar Distance (cm)\n\r");
+			sweeps++;
+		}
+		else if (f->seq != expect)
+		{
+			lost += (unsigned char) (f->seq - expect);
+		}
+		expect = f->seq + 1;
+
+		char last;
+		int count = sweep_block_read(f->payload, f->length, samples, &last);
+		if (count < 0)
+		{
+			lost++;
+			continue;
+		}
+		blocks++;
+		for (int i = 0; i < count; i++)
+		{
+			printf("%d\t\t", samples[i].degree);
+			print_hundredths(samples[i].ir);
+			printf("\t\t\t\t");
+			print_hundredths(samples[i].sonar);
+			printf("\n\r");
+			rows++;
+		}
+	}
+	lost += parser.errors;
+	fprintf(stderr, "sweeptable: sweeps=%lu blocks=%lu lost=%lu rows=%lu\n", sweeps, blocks, lost, rows);
+	return lost ? 1 : 0;
+}
@@ -0,0 +1,347 @@
+/**
+ *	@file telemetry.c
+ *	@brief reads what the rover sends to the base station and keeps the
+ *	state it describes
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "telemetry.h"
+
+#define PI 3.14159265358979
+
+void telemetry_init(struct telemetry *t)
+{
+	memset(t, 0, sizeof(*t));
+	for (int i = 0; i < TELEMETRY_DEGREES; i++)
+	{
+		t->ir[i] = t->sonar[i] = -1;
+	}
+}
+
+/**
+ *	Where a point seen at a servo degree and distance from a pose is on the map
+ */
+
+static void place(const struct telemetry_pose *from, int degree, double cm, double *x, double *y)
+{
+	double a = (from->angle + degree - 90) * PI / 180;
+	*x = from->x + cm * 10 * cos(a);
+	*y = from->y + cm * 10 * sin(a);
+}
+
+static void hazard(struct telemetry *t, char kind, const char *line)
+{
+	struct telemetry_hazard *h = &t->hazards[t->hazard_count++ % TELEMETRY_HAZARDS];
+	h->x = t->pose.x;
+	h->y = t->pose.y;
+	h->kind = kind;
+	snprintf(t->status, sizeof(t->status), "%s", line);
+}
+
+/**
+ *	Fill in a field of the object being listed
+ */
+
+static int object_field(struct telemetry *t, const char *line)
+{
+	struct telemetry_object *o = t->object_count ? &t->objects[t->object_count - 1] : 0;
+	int i;
+	double d;
+
+	if (sscanf(line, "Index: %d", &i) == 1)
+	{
+		if (i == 0)
+		{
+			t->object_count = 0;	//the list of a new sweep
+		}
+		if (t->object_count == TELEMETRY_OBJECTS)
+		{
+			return TELEMETRY_OBJECT;
+		}
+		o = &t->objects[t->object_count++];
+		memset(o, 0, sizeof(*o));
+		o->index = i;
+		o->degree = 90;
+	}
+	else if (!o)
+	{
+		return TELEMETRY_OTHER;
+	}
+	else if (sscanf(line, "Degree: %d", &i) == 1)
+	{
+		o->degree = i;
+	}
+	else if (sscanf(line, "Width: %lf", &d) == 1)
+	{
+		o->width = d;
+	}
+	else if (sscanf(line, "Sonar Distance: %lf", &d) == 1)
+	{
+		o->sonar = d;
+		place(&t->sweep_pose, o->degree, d, &o->x, &o->y);
+	}
+	else if (sscanf(line, "IR distance: %lf", &d) == 1)
+	{
+		o->ir = d;
+	}
+	else
+	{
+		return TELEMETRY_OTHER;
+	}
+	t->changes++;
+	return TELEMETRY_OBJECT;
+}
+
+/**
+ *	Look at one line; see telemetry.h for the ones understood
+ */
+
+static int parse(struct telemetry *t, const char *line)
+{
+	int degree;
+	double ir, sonar;
+	struct telemetry_pose p;
+	int r;
+
+	if (t->sweeping && sscanf(line, "%d %lf %lf", &degree, &ir, &sonar) == 3 &&
+			degree >= 0 && degree < TELEMETRY_DEGREES)
+	{
+		t->ir[degree] = ir;
+		t->sonar[degree] = sonar;
+		t->changes++;
+		return TELEMETRY_SAMPLE;
+	}
+	t->sweeping = 0;
+
+	if (sscanf(line, "Location: X: %d Y: %d R: %d Angle: %d", &p.x, &p.y, &r, &p.angle) == 4)
+	{
+		t->pose = p;
+		t->trail[t->trail_count++ % TELEMETRY_TRAIL] = p;
+		t->changes++;
+		return TELEMETRY_LOCATION;
+	}
+	if (!strncmp(line, "Degrees", 7))
+	{
+		t->sweeping = 1;
+		t->sweep_pose = t->pose;
+		for (int i = 0; i < TELEMETRY_DEGREES; i++)
+		{
+			t->ir[i] = t->sonar[i] = -1;
+		}
+		t->changes++;
+		return TELEMETRY_SWEEP;
+	}
+
+	int kind = object_field(t, line);
+	if (kind != TELEMETRY_OTHER)
+	{
+		return kind;
+	}
+
+	if (strstr(line, "bumper!"))
+	{
+		hazard(t, 'b', line);
+	}
+	else if (strstr(line, "white tape!"))
+	{
+		hazard(t, 't', line);
+	}
+	else if (strstr(line, "cliff!"))
+	{
+		hazard(t, 'c', line);
+	}
+	else if (strstr(line, "Destination!") || strstr(line, "Arrived at destination!"))
+	{
+		hazard(t, 'd', line);
+	}
+	else if (!strncmp(line, "Detour", 6) || !strncmp(line, "Destination not found", 21) ||
+			!strncmp(line, "Stopped", 7))
+	{
+		snprintf(t->status, sizeof(t->status), "%s", line);
+	}
+	else
+	{
+		return TELEMETRY_OTHER;
+	}
+	t->changes++;
+	return TELEMETRY_EVENT;
+}
+
+int telemetry_line(struct telemetry *t, const char *line, size_t n)
+{
+	char text[TELEMETRY_LINE];
+	if (n >= sizeof(text))
+	{
+		n = sizeof(text) - 1;
+	}
+	memcpy(text, line, n);
+	text[n] = '\0';
+
+	memcpy(t->log[t->lines++ % TELEMETRY_LOG], text, n + 1);
+	int kind = parse(t, text);
+	if (kind != TELEMETRY_SAMPLE)
+	{
+		t->changes++;	//the log moved on
+	}
+	return kind;
+}
+
+/**
+ *	Read the values of a decoded frame; the offsets are those of packet group 6
+ */
+
+static void sensor_values(struct telemetry_sensors *s)
+{
+	s->bumper_right = s->raw[0] & 1;
+	s->bumper_left = s->raw[0] >> 1 & 1;
+	for (int i = 0; i < 4; i++)
+	{
+		s->cliff[i] = s->raw[2 + i];
+		s->cliff_signal[i] = s->raw[28 + 2 * i] << 8 | s->raw[29 + 2 * i];
+		if (s->frames == 1 || s->cliff_signal[i] < s->cliff_signal_min[i])
+		{
+			s->cliff_signal_min[i] = s->cliff_signal[i];
+		}
+	}
+}
+
+/**
+ *	Put the samples of a sweep block into the sweep; block 0 starts one
+ */
+
+static int sweep_block(struct telemetry *t, const struct link_frame *f)
+{
+	struct sweep_sample samples[SWEEP_BLOCK_SAMPLES];
+	char last;
+
+	if (f->seq == 0)
+	{
+		t->sweep_pose = t->pose;
+		for (int i = 0; i < TELEMETRY_DEGREES; i++)
+		{
+			t->ir[i] = t->sonar[i] = -1;
+		}
+	}
+	else if (f->seq != t->block_seq)
+	{
+		t->blocks_lost += (unsigned char) (f->seq - t->block_seq);
+	}
+	t->block_seq = f->seq + 1;
+
+	int count = sweep_block_read(f->payload, f->length, samples, &last);
+	if (count < 0)
+	{
+		t->blocks_lost++;
+		return 0;
+	}
+	for (int i = 0; i < count; i++)
+	{
+		if (samples[i].degree < TELEMETRY_DEGREES)
+		{
+			t->ir[samples[i].degree] = samples[i].ir / 100.0;
+			t->sonar[samples[i].degree] = samples[i].sonar / 100.0;
+		}
+	}
+	t->blocks++;
+	t->changes++;
+	return 1;
+}
+
+int telemetry_frame(struct telemetry *t, const struct link_frame *f)
+{
+	if (f->type == LINK_SWEEP)
+	{
+		return sweep_block(t, f);
+	}
+
+	struct telemetry_sensors *s = &t->sensors;
+	static const unsigned char zeros[REC_FRAME_BYTES];
+	unsigned char frame[REC_FRAME_BYTES];
+	size_t used = 0;
+	uint32_t ms = 0;
+
+	if (f->type != LINK_KEYFRAME && f->type != LINK_SENSORS)
+	{
+		return 0;
+	}
+	if (f->seq != s->seq && (s->frames || s->skipped))
+	{
+		s->lost += (unsigned char) (f->seq - s->seq);
+		s->valid = 0;
+	}
+	s->seq = f->seq + 1;
+	s->bytes += f->length;
+
+	if (f->type == LINK_KEYFRAME)
+	{
+		if (f->length < 5)
+		{
+			s->skipped++;
+			s->valid = 0;
+			return 0;
+		}
+		for (int i = 0; i < 4; i++)
+		{
+			ms |= (uint32_t) f->payload[i] << (i * 8);
+		}
+		used = 4;
+		memcpy(frame, zeros, sizeof(frame));
+	}
+	else
+	{
+		int shift = 0;
+		while (used < f->length && f->payload[used] & 0x80)
+		{
+			ms |= (uint32_t) (f->payload[used++] & 0x7F) << shift;
+			shift += 7;
+		}
+		if (!s->valid || used >= f->length)
+		{
+			s->skipped++;
+			s->valid = 0;
+			return 0;
+		}
+		ms = s->ms + (ms | (uint32_t) f->payload[used++] << shift);
+		memcpy(frame, s->raw, sizeof(frame));
+	}
+	if (used >= f->length || used + rec_decode_frame(frame, f->payload + used) != f->length)
+	{
+		s->skipped++;
+		s->valid = 0;
+		return 0;
+	}
+
+	memcpy(s->raw, frame, sizeof(frame));
+	s->valid = 1;
+	s->ms = ms;
+	s->frames++;
+	if (f->type == LINK_KEYFRAME && s->keyframes++ == 0)
+	{
+		s->first_ms = ms;
+	}
+	sensor_values(s);
+	t->changes++;
+	return 1;
+}
+
+void telemetry_feed(struct telemetry *t, const char *data, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		char c = data[i];
+		if (c == '\n' || c == '\r')
+		{
+			if (t->length)
+			{
+				telemetry_line(t, t->partial, t->length);
+				t->length = 0;
+			}
+		}
+		else if (t->length < sizeof(t->partial) - 1)
+		{
+			t->partial[t->length++] = c;
+		}
+	}
+}
@@ -0,0 +1,135 @@
+/**
+ *	@file telemetry.h
+ *	@brief reads what the rover sends to the base station and keeps the
+ *	state it describes: pose, last sweep, objects, and what it ran into
+ *
+ *	The text is taken as it arrives, any number of bytes at a time, and
+ *	each line is looked at once, when its end comes in. Lines the rover
+ *	ends with \n\r and with \r\n both work. The lines understood are
+ *
+ *	Location: X: <mm> Y: <mm> R: <mm> Angle: <degrees>	movement.c
+ *	Degrees ... / <degree> <IR cm> <sonar cm>		sweep() table
+ *	Index: / Degree: / Width: / Sonar Distance: / IR distance:
+ *								sweep() objects
+ *	... bumper! / ... cliff! / ... white tape! / ..._Destination!
+ *	Arrived at destination! / Destination not found / Detour: ...
+ *
+ *	and every other line only goes into the log. Map coordinates are the
+ *	rover's: millimeters, x ahead and y to the left of where it started,
+ *	angles counterclockwise.
+ *
+ *	The frames of the sensor feed (feed.h) and the blocks of binary sweeps
+ *	(sweepblock.h) are taken apart by whoever reads the link, and handed
+ *	over whole to telemetry_frame(). A feed frame missing by its seq, or
+ *	one that does not decode, leaves the sensors unknown until the next
+ *	keyframe; a lost block leaves its degrees of the sweep unknown.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "link.h"
+#include "recorder.h"
+#include "sweepblock.h"
+
+/// longest line kept; the rest of a longer line is dropped
+#define TELEMETRY_LINE		256
+/// sweep samples, one per degree
+#define TELEMETRY_DEGREES	181
+#define TELEMETRY_OBJECTS	16
+/// poses kept for the trail on the map
+#define TELEMETRY_TRAIL		256
+#define TELEMETRY_HAZARDS	64
+/// last lines kept for the log
+#define TELEMETRY_LOG		8
+
+/// what a line was
+#define TELEMETRY_OTHER		0
+#define TELEMETRY_LOCATION	1
+#define TELEMETRY_SWEEP		2	// the heading of a sweep table
+#define TELEMETRY_SAMPLE	3	// one row of it
+#define TELEMETRY_OBJECT	4	// one field of an object
+#define TELEMETRY_EVENT		5	// bump, cliff, tape, destination, detour
+
+struct telemetry_pose{
+	int x, y;		// mm
+	int angle;		// degrees
+};
+
+struct telemetry_object{
+	int index;
+	int degree;		// servo degree of its middle, 90 straight ahead
+	double width;		// cm
+	double sonar;		// cm
+	double ir;		// cm
+	double x, y;		// where it is on the map, mm
+};
+
+struct telemetry_hazard{
+	int x, y;		// mm
+	char kind;		// 'b' bumper, 'c' cliff, 't' tape, 'd' destination
+};
+
+/// what the sensor feed says
+struct telemetry_sensors{
+	unsigned char raw[REC_FRAME_BYTES];	// last frame, as the Create sent it
+	char valid;				// raw is the rover's last frame
+	unsigned char seq;			// of the frame expected next
+	uint32_t ms;				// rover time of the last frame
+	uint32_t first_ms;			// of the first keyframe
+	int bumper_left, bumper_right;
+	int cliff[4];				// left, front left, front right, right
+	int cliff_signal[4];
+	int cliff_signal_min[4];		// lowest since the first keyframe
+	unsigned long frames;			// decoded, keyframes included
+	unsigned long keyframes;
+	unsigned long lost;			// missing by their seq
+	unsigned long skipped;			// came while waiting for a keyframe, or did not decode
+	unsigned long bytes;			// of the payloads
+};
+
+struct telemetry{
+	struct telemetry_pose pose;
+	struct telemetry_pose trail[TELEMETRY_TRAIL];	// ring of the poses reported
+	unsigned long trail_count;
+
+	struct telemetry_pose sweep_pose;		// where the last sweep was taken
+	char sweeping;					// rows of a sweep table are coming
+	double ir[TELEMETRY_DEGREES];			// cm, negative if not received
+	double sonar[TELEMETRY_DEGREES];
+	unsigned char block_seq;			// of the sweep block expected next
+	unsigned long blocks;				// sweep blocks read
+	unsigned long blocks_lost;			// missing by their seq, or not read
+
+	struct telemetry_object objects[TELEMETRY_OBJECTS];	// of the last sweep
+	int object_count;
+
+	struct telemetry_hazard hazards[TELEMETRY_HAZARDS];	// ring
+	unsigned long hazard_count;
+
+	char status[TELEMETRY_LINE];			// last event
+	char log[TELEMETRY_LOG][TELEMETRY_LINE];	// ring of the last lines
+	unsigned long lines;				// lines read so far
+	unsigned long changes;				// counts every change to the state above
+
+	struct telemetry_sensors sensors;
+
+	char partial[TELEMETRY_LINE];			// line still coming in
+	size_t length;
+};
+
+/// Start with the rover where it starts, and nothing seen
+void telemetry_init(struct telemetry *t);
+
+/// Take bytes as they arrive
+void telemetry_feed(struct telemetry *t, const char *data, size_t n);
+
+/// Take one whole line, without its end; it need not end with a 0. Returns one of the TELEMETRY_ kinds.
+int telemetry_line(struct telemetry *t, const char *line, size_t n);
+
+/// Take a LINK_KEYFRAME, LINK_SENSORS or LINK_SWEEP frame. Returns 1 if it was decoded, 0 if not.
+int telemetry_frame(struct telemetry *t, const struct link_frame *f);
+
+#endif
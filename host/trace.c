@@ -0,0 +1,123 @@
+/**
+ *	@file trace.c
+ *	@brief timed trace of what went in and out of the rover, one event per line
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+static const char *const names[] = {
+	[TRACE_FRAME] = "frame",
+	[TRACE_WHEELS] = "wheels",
+	[TRACE_DRIVE] = "drive",
+	[TRACE_SWEEP] = "sweep",
+	[TRACE_KEY] = "key",
+	[TRACE_TEXT] = "text",
+};
+
+void trace_write(FILE *out, const struct trace_event *e)
+{
+	fprintf(out, "%lu %s", (unsigned long) e->ms, names[e->kind]);
+	switch (e->kind)
+	{
+	case TRACE_FRAME:
+		fputc(' ', out);
+		for (int i = 0; i < TRACE_FRAME_BYTES; i++)
+		{
+			fprintf(out, "%02x", e->frame[i]);
+		}
+		break;
+	case TRACE_WHEELS:
+	case TRACE_DRIVE:
+		fprintf(out, " %d %d", e->a, e->b);
+		break;
+	case TRACE_SWEEP:
+		fprintf(out, " %u %u %u", (uint16_t) e->a, (uint16_t) e->b, e->c);
+		break;
+	case TRACE_KEY:
+		fprintf(out, " %u", e->key);
+		break;
+	case TRACE_TEXT:
+		fprintf(out, " %s", e->text);
+		break;
+	}
+	fputc('\n', out);
+}
+
+int trace_parse(const char *line, struct trace_event *e)
+{
+	char name[8];
+	unsigned long ms;
+	int n;
+
+	line += strspn(line, " \t");
+	if (*line == '#' || *line == '\n' || *line == '\0')
+	{
+		return 0;
+	}
+	if (sscanf(line, "%lu %7s%n", &ms, name, &n) != 2)
+	{
+		return -1;
+	}
+	e->ms = ms;
+	e->kind = 0;
+	for (unsigned char k = 1; k < sizeof(names) / sizeof(names[0]); k++)
+	{
+		if (!strcmp(name, names[k]))
+		{
+			e->kind = k;
+		}
+	}
+
+	const char *rest = line + n;
+	int a, b;
+	unsigned int u[3];
+	switch (e->kind)
+	{
+	case TRACE_FRAME:
+		rest += strspn(rest, " ");
+		for (int i = 0; i < TRACE_FRAME_BYTES; i++, rest += 2)
+		{
+			if (sscanf(rest, "%2x", &u[0]) != 1)
+			{
+				return -1;
+			}
+			e->frame[i] = u[0];
+		}
+		return 1;
+	case TRACE_WHEELS:
+	case TRACE_DRIVE:
+		if (sscanf(rest, "%d %d", &a, &b) != 2)
+		{
+			return -1;
+		}
+		e->a = a;
+		e->b = b;
+		return 1;
+	case TRACE_SWEEP:
+		if (sscanf(rest, "%u %u %u", &u[0], &u[1], &u[2]) != 3)
+		{
+			return -1;
+		}
+		e->a = u[0];
+		e->b = u[1];
+		e->c = u[2];
+		return 1;
+	case TRACE_KEY:
+		if (sscanf(rest, "%u", &u[0]) != 1)
+		{
+			return -1;
+		}
+		e->key = u[0];
+		return 1;
+	case TRACE_TEXT:
+		rest += *rest == ' ';
+		strncpy(e->text, rest, TRACE_TEXT_MAX - 1);
+		e->text[TRACE_TEXT_MAX - 1] = '\0';
+		e->text[strcspn(e->text, "\n")] = '\0';
+		return 1;
+	default:
+		return -1;
+	}
+}
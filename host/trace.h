@@ -0,0 +1,55 @@
+/**
+ *	@file trace.h
+ *	@brief timed trace of what went in and out of the rover, one event per line
+ *
+ *	A trace is text, one event per line, in the order they happened:
+ *
+ *	<ms> frame <104 hex digits>	raw sensor bytes, as read from the Create
+ *	<ms> wheels <right> <left>	oi_set_wheels() in mm/s
+ *	<ms> drive <velocity> <radius>	oi_drive() in mm/s and mm
+ *	<ms> sweep <degree> <ir> <echo>	IR in 1/100 cm, sonar in Timer1 counts
+ *	<ms> key <byte>			byte from the base station, in decimal
+ *	<ms> text <line>		line sent to the base station
+ *
+ *	Times are milliseconds of the rover's clock. Lines starting with # are
+ *	comments. recdump writes traces from the flight recorder (recorder.h),
+ *	sim -r writes them from a simulated run, and replay runs the firmware
+ *	against one.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define TRACE_FRAME	1
+#define TRACE_WHEELS	2
+#define TRACE_DRIVE	3
+#define TRACE_SWEEP	4
+#define TRACE_KEY	5
+#define TRACE_TEXT	6
+
+/// bytes of a sensor frame (packet group 6)
+#define TRACE_FRAME_BYTES	52
+/// longest line of text kept
+#define TRACE_TEXT_MAX		256
+
+/// one line of a trace
+struct trace_event{
+	uint32_t ms;
+	unsigned char kind;			// one of the TRACE_ codes
+	int16_t a, b;				// wheels, drive; degree and IR of a sweep
+	uint16_t c;				// echo of a sweep
+	unsigned char key;
+	unsigned char frame[TRACE_FRAME_BYTES];
+	char text[TRACE_TEXT_MAX];
+};
+
+/// Write one event as a line
+void trace_write(FILE *out, const struct trace_event *e);
+
+/// Read one line; 1 for an event, 0 for a comment or a blank line, -1 if it cannot be read
+int trace_parse(const char *line, struct trace_event *e);
+
+#endif
@@ -0,0 +1,424 @@
+/**
+ *	@file tune.c
+ *	@brief searches the signal bands of thresholds.h by running the
+ *	simulator on a set of missions with every combination of candidates
+ *
+ *	usage: tune [-j jobs] [-x sim] [-t seconds] [-n seeds] [-m "world script"]... [-a] band=lo:hi[,lo:hi...]...
+ *
+ *	Each band argument names one band as sim -T does and lists candidate
+ *	ranges for it; bands not named keep their defaults. Every combination
+ *	is run on every mission (a world file and a sim script, e.g.
+ *	"worlds/reference.world ddd f") with seeds 1 to -n, each run a
+ *	separate sim process with -T set to the combination. -j runs (all
+ *	cores by default) are kept going at once; they share nothing, so the
+ *	search scales with the cores.
+ *
+ *	A combination is scored on the sum over its runs of
+ *
+ *	false_stops	reactions to tape, a cliff or the pad that was not there
+ *	missed		times a cliff sensor crossed tape or a hole unnoticed
+ *	time		seconds to reach the destination, or -t (120) if it was not
+ *
+ *	and the combinations no other one beats on all three at once (the
+ *	Pareto front) are printed as JSON, best time first; -a prints all of
+ *	them. Without -m the missions are seeks of the reference world after
+ *	turning different ways, most of which cross tape. The last line sums
+ *	up the search. Exits with 1 if a run failed.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define MAX_BANDS	9
+#define MAX_CANDIDATES	32
+#define MAX_MISSIONS	32
+#define MAX_JOBS	256
+#define MAX_ARGS	64
+#define SUMMARY_MAX	512
+
+/// a band being searched
+struct band{
+	const char *name;
+	int lo[MAX_CANDIDATES], hi[MAX_CANDIDATES];
+	int count;
+};
+
+/// what the runs of a combination added up to
+struct score{
+	unsigned long false_stops;
+	unsigned long missed;
+	double time;
+	int goals;			// runs that reached the destination
+	int failed;			// runs that did not print a summary
+};
+
+/// a sim process
+struct job{
+	pid_t pid;
+	int fd;
+	long combination;
+	char summary[SUMMARY_MAX];
+	size_t length;
+};
+
+static const char *default_missions[] = {
+	"worlds/reference.world f",
+	"worlds/reference.world aaa f",
+	"worlds/reference.world ddd f",
+	"worlds/reference.world dddddd f",
+	"worlds/reference.world x f",
+};
+
+static struct band bands[MAX_BANDS];
+static int band_count;
+static const char *missions[MAX_MISSIONS];
+static int mission_count;
+static const char *sim = "./sim";
+static double limit = 120;
+static int seeds = 1;
+
+/**
+ *	Read "name=lo:hi,lo:hi"; returns 0, or -1 after printing the problem
+ */
+
+static int parse_band(char *arg)
+{
+	char *eq = strchr(arg, '=');
+	if (band_count == MAX_BANDS || !eq || eq == arg)
+	{
+		fprintf(stderr, "tune: cannot use '%s'\n", arg);
+		return -1;
+	}
+	struct band *b = &bands[band_count++];
+	*eq = '\0';
+	b->name = arg;
+	for (char *c = strtok(eq + 1, ","); c; c = strtok(0, ","))
+	{
+		if (b->count == MAX_CANDIDATES || sscanf(c, "%d:%d", &b->lo[b->count], &b->hi[b->count]) != 2 ||
+				b->lo[b->count] >= b->hi[b->count])
+		{
+			fprintf(stderr, "tune: cannot use candidate '%s' of %s\n", c, arg);
+			return -1;
+		}
+		b->count++;
+	}
+	return b->count ? 0 : -1;
+}
+
+/**
+ *	The candidate of each band in a combination, the first band changing fastest
+ */
+
+static int candidate(long combination, int band)
+{
+	for (int i = 0; i < band; i++)
+	{
+		combination /= bands[i].count;
+	}
+	return combination % bands[band].count;
+}
+
+/**
+ *	Write a combination as sim -T wants it
+ */
+
+static void spec(long combination, char *out, size_t size)
+{
+	size_t n = 0;
+	out[0] = '\0';
+	for (int i = 0; i < band_count && n < size; i++)
+	{
+		int k = candidate(combination, i);
+		n += snprintf(out + n, size - n, "%s%s=%d:%d", i ? "," : "", bands[i].name, bands[i].lo[k], bands[i].hi[k]);
+	}
+}
+
+/**
+ *	Start sim on a run; returns 0, or -1
+ */
+
+static int start(struct job *job, long run)
+{
+	long combination = run / (mission_count * seeds);
+	int mission = run / seeds % mission_count;
+	int seed = run % seeds + 1;
+
+	char bands_arg[512], seed_arg[16], limit_arg[32], words[256];
+	char *argv[MAX_ARGS];
+	int argc = 0;
+	spec(combination, bands_arg, sizeof(bands_arg));
+	snprintf(seed_arg, sizeof(seed_arg), "%d", seed);
+	snprintf(limit_arg, sizeof(limit_arg), "%g", limit);
+	snprintf(words, sizeof(words), "%s", missions[mission]);
+
+	argv[argc++] = (char *) sim;
+	argv[argc++] = "-q";
+	argv[argc++] = "-s";
+	argv[argc++] = seed_arg;
+	argv[argc++] = "-t";
+	argv[argc++] = limit_arg;
+	if (band_count)
+	{
+		argv[argc++] = "-T";
+		argv[argc++] = bands_arg;
+	}
+	argv[argc++] = "-w";
+	for (char *w = strtok(words, " "); w && argc < MAX_ARGS - 1; w = strtok(0, " "))
+	{
+		argv[argc++] = w;
+	}
+	argv[argc] = 0;
+
+	int fd[2];
+	if (pipe(fd))
+	{
+		perror("pipe");
+		return -1;
+	}
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		//the summary comes on stderr
+		dup2(fd[1], 2);
+		close(fd[0]);
+		close(fd[1]);
+		execv(sim, argv);
+		_exit(127);
+	}
+	close(fd[1]);
+	if (pid < 0)
+	{
+		perror("fork");
+		close(fd[0]);
+		return -1;
+	}
+	job->pid = pid;
+	job->fd = fd[0];
+	job->combination = combination;
+	job->length = 0;
+	return 0;
+}
+
+/**
+ *	Add the summary line of a finished run to its combination
+ */
+
+static void finish(struct job *job, struct score *scores)
+{
+	struct score *s = &scores[job->combination];
+	job->summary[job->length] = '\0';
+	const char *line = strstr(job->summary, "sim: result=");
+	unsigned long false_stops, missed;
+	double goal;
+	const char *g = line ? strstr(line, " goal=") : 0;
+	const char *f = line ? strstr(line, " false_stops=") : 0;
+	if (!g || !f || sscanf(g, " goal=%lf", &goal) != 1 ||
+			sscanf(f, " false_stops=%lu missed=%lu", &false_stops, &missed) != 2)
+	{
+		s->failed++;
+		fprintf(stderr, "tune: a run gave no summary: %s\n", job->summary);
+		return;
+	}
+	s->false_stops += false_stops;
+	s->missed += missed;
+	s->time += goal > 0 ? goal : limit;
+	s->goals += goal > 0;
+}
+
+/**
+ *	Whether a is at least as good as b on everything and better on something
+ */
+
+static int dominates(const struct score *a, const struct score *b)
+{
+	return a->false_stops <= b->false_stops && a->missed <= b->missed && a->time <= b->time &&
+		(a->false_stops < b->false_stops || a->missed < b->missed || a->time < b->time);
+}
+
+static void print(long combination, const struct score *s, int front)
+{
+	printf("{\"bands\": {");
+	for (int i = 0; i < band_count; i++)
+	{
+		int k = candidate(combination, i);
+		printf("%s\"%s\": [%d, %d]", i ? ", " : "", bands[i].name, bands[i].lo[k], bands[i].hi[k]);
+	}
+	printf("}, \"false_stops\": %lu, \"missed\": %lu, \"time\": %.3f, \"goals\": %d, \"pareto\": %s}\n",
+		s->false_stops, s->missed, s->time, s->goals, front ? "true" : "false");
+}
+
+static struct score *sort_scores;
+
+static int by_time(const void *a, const void *b)
+{
+	double d = sort_scores[*(const long *) a].time - sort_scores[*(const long *) b].time;
+	return d < 0 ? -1 : d > 0;
+}
+
+int main(int argc, char **argv)
+{
+	long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	int all = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "j:x:t:n:m:a")) != -1)
+	{
+		switch (opt)
+		{
+		case 'j':
+			jobs = atol(optarg);
+			break;
+		case 'x':
+			sim = optarg;
+			break;
+		case 't':
+			limit = atof(optarg);
+			break;
+		case 'n':
+			seeds = atoi(optarg);
+			break;
+		case 'm':
+			if (mission_count < MAX_MISSIONS)
+			{
+				missions[mission_count++] = optarg;
+			}
+			break;
+		case 'a':
+			all = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-j jobs] [-x sim] [-t seconds] [-n seeds] [-m \"world script\"]... [-a] "
+				"band=lo:hi[,lo:hi...]...\n", argv[0]);
+			return 2;
+		}
+	}
+	for (int i = optind; i < argc; i++)
+	{
+		if (parse_band(argv[i]))
+		{
+			return 2;
+		}
+	}
+	if (mission_count == 0)
+	{
+		mission_count = sizeof(default_missions) / sizeof(default_missions[0]);
+		memcpy(missions, default_missions, sizeof(default_missions));
+	}
+	if (seeds < 1 || limit <= 0)
+	{
+		fprintf(stderr, "tune: -n and -t must be positive\n");
+		return 2;
+	}
+	jobs = jobs < 1 ? 1 : jobs > MAX_JOBS ? MAX_JOBS : jobs;
+
+	long combinations = 1;
+	for (int i = 0; i < band_count; i++)
+	{
+		combinations *= bands[i].count;
+	}
+	long runs = combinations * mission_count * seeds;
+	struct score *scores = calloc(combinations, sizeof(*scores));
+	struct job running[MAX_JOBS];
+	struct pollfd fds[MAX_JOBS];
+	long next = 0;
+	int active = 0;
+	int broken = 0;
+
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	while (next < runs || active)
+	{
+		while (active < jobs && next < runs && !broken)
+		{
+			if (start(&running[active], next++))
+			{
+				broken = 1;
+				break;
+			}
+			active++;
+		}
+		if (broken && !active)
+		{
+			break;
+		}
+		if (broken)
+		{
+			next = runs;
+		}
+
+		for (int i = 0; i < active; i++)
+		{
+			fds[i].fd = running[i].fd;
+			fds[i].events = POLLIN;
+		}
+		if (poll(fds, active, -1) < 0 && errno != EINTR)
+		{
+			perror("poll");
+			return 1;
+		}
+		for (int i = active - 1; i >= 0; i--)
+		{
+			if (!fds[i].revents)
+			{
+				continue;
+			}
+			struct job *job = &running[i];
+			ssize_t n = read(job->fd, job->summary + job->length, SUMMARY_MAX - 1 - job->length);
+			if (n > 0)
+			{
+				job->length += n;
+				if (job->length < SUMMARY_MAX - 1)
+				{
+					continue;
+				}
+			}
+			//the end of the run; keep only the summary if the line is full
+			close(job->fd);
+			waitpid(job->pid, 0, 0);
+			finish(job, scores);
+			running[i] = running[--active];
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+	//the Pareto front, best time first
+	long *order = malloc(combinations * sizeof(*order));
+	int failed = 0;
+	for (long c = 0; c < combinations; c++)
+	{
+		order[c] = c;
+		failed += scores[c].failed;
+	}
+	sort_scores = scores;
+	qsort(order, combinations, sizeof(*order), by_time);
+	long front = 0;
+	for (long i = 0; i < combinations; i++)
+	{
+		long c = order[i];
+		int dominated = scores[c].failed > 0;	//not scored, so not on the front
+		for (long d = 0; d < combinations && !dominated; d++)
+		{
+			dominated = !scores[d].failed && dominates(&scores[d], &scores[c]);
+		}
+		front += !dominated;
+		if (all || !dominated)
+		{
+			print(c, &scores[c], !dominated);
+		}
+	}
+	printf("{\"combinations\": %ld, \"missions\": %d, \"seeds\": %d, \"runs\": %ld, \"failed\": %d, \"pareto\": %ld, "
+		"\"jobs\": %ld, \"seconds\": %.3f, \"runs_per_second\": %.1f}\n",
+		combinations, mission_count, seeds, runs, failed, front, jobs, seconds, seconds > 0 ? runs / seconds : 0);
+	free(order);
+	free(scores);
+	return failed || broken ? 1 : 0;
+}
@@ -0,0 +1,201 @@
+/**
+ *	@file txbench.c
+ *	@brief cost of sending telemetry with stream_printf() against the old
+ *	sprintf-and-loop pattern
+ *
+ *	The old pattern formats the whole message into a buffer and then sends
+ *	it with for (i = 0; i < strlen(buf); i++) USART_Transmit(buf[i]), which
+ *	measures the string again for every byte. Both are run on the messages
+ *	the firmware sends most: the sensor report, the location line and one
+ *	line of a sweep. For each one the time per message is measured, in TSC
+ *	cycles where the machine has them, and the stack it needs is found by
+ *	running it once on a freshly painted thread stack.
+ *
+ *	The numbers are for the host C library; avr-libc's vfprintf needs less
+ *	stack than glibc's, but the message buffer of the old pattern, 250 or
+ *	500 bytes on a 4 KB part, comes on top of it either way.
+ *
+ *	usage: txbench
+ *
+ *	Results are printed one JSON object per line; bytes is the length of
+ *	the message, the same for both methods.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "fixmath.h"
+#include "stream.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#define REPEATS		20000
+#define STACK_SIZE	(64 * 1024)
+#define STACK_PAINT	0xA5
+
+/// stands in for USART_Transmit(); kept out of line like the real one
+static volatile unsigned long sent;
+
+static void __attribute__((noinline)) transmit(unsigned char data)
+{
+	sent++;
+}
+
+static int sensors[10] = {0, 1, 0, 0, 1, 0, 352, 1120, 480, 41};
+
+static void sensors_sprintf(void)
+{
+	char status[250];
+	sprintf(status, "Bump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensors[0], sensors[1], sensors[2], sensors[3], sensors[4], sensors[5], sensors[6], sensors[7], sensors[8], sensors[9]);
+	for (int i = 0; i < strlen(status); i++)
+	{
+		transmit(status[i]);
+	}
+}
+
+static void sensors_stream(void)
+{
+	stream_printf(transmit, "Bump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensors[0], sensors[1], sensors[2], sensors[3], sensors[4], sensors[5], sensors[6], sensors[7], sensors[8], sensors[9]);
+}
+
+static int x = 1065, y = -1179, r = 1588, movedangle = -63;
+
+static void location_sprintf(void)
+{
+	char status[250];
+	sprintf(status, "\n\rLocation: X: %d    Y: %d    R: %d    Angle: %d\n\r", x, y, r, movedangle);
+	for (int i = 0; i < strlen(status); i++)
+	{
+		transmit(status[i]);
+	}
+}
+
+static void location_stream(void)
+{
+	stream_printf(transmit, "\n\rLocation: X: %d    Y: %d    R: %d    Angle: %d\n\r", x, y, r, movedangle);
+}
+
+static int degree = 97;
+static double ir_cm = 88.5, sonar_cm = 300.06;
+static q16_t ir_q16 = Q16(88.5), sonar_q16 = Q16(300.06);
+
+static void sweep_sprintf(void)
+{
+	char output[30];
+	sprintf(output, "%d\t\t%.2f\t\t\t\t%.2f\n\r", degree, ir_cm, sonar_cm);
+	for (int j = 0; j < strlen(output); j++)
+	{
+		transmit(output[j]);
+	}
+}
+
+static void sweep_stream(void)
+{
+	stream_printf(transmit, "%d\t\t%q\t\t\t\t%q\n\r", degree, ir_q16, sonar_q16);
+}
+
+static void nothing(void)
+{
+}
+
+/// one way of sending one message
+struct pattern{
+	const char *message;
+	const char *method;
+	void (*send)(void);
+};
+
+static const struct pattern patterns[] = {
+	{"sensors", "sprintf", sensors_sprintf},
+	{"sensors", "stream", sensors_stream},
+	{"location", "sprintf", location_sprintf},
+	{"location", "stream", location_stream},
+	{"sweep", "sprintf", sweep_sprintf},
+	{"sweep", "stream", sweep_stream},
+};
+
+static void *run_once(void *arg)
+{
+	((void (*)(void)) arg)();
+	return 0;
+}
+
+/**
+ *	Run send once on a painted stack; returns the bytes of stack it touched
+ */
+
+static long stack_used(void (*send)(void))
+{
+	pthread_attr_t attr;
+	pthread_t thread;
+	void *memory;
+	if (posix_memalign(&memory, 4096, STACK_SIZE))
+	{
+		return -1;
+	}
+	unsigned char *stack = memory;
+	memset(stack, STACK_PAINT, STACK_SIZE);
+	pthread_attr_init(&attr);
+	pthread_attr_setstack(&attr, stack, STACK_SIZE);
+	if (pthread_create(&thread, &attr, run_once, (void *) send))
+	{
+		free(stack);
+		return -1;
+	}
+	pthread_join(thread, 0);
+	pthread_attr_destroy(&attr);
+
+	//the stack grows down, so the lowest byte changed marks the deepest point
+	long low = 0;
+	while (low < STACK_SIZE && stack[low] == STACK_PAINT)
+	{
+		low++;
+	}
+	free(stack);
+	return STACK_SIZE - low;
+}
+
+int main(void)
+{
+	long base = stack_used(nothing);
+
+	for (unsigned int p = 0; p < sizeof(patterns) / sizeof(patterns[0]); p++)
+	{
+		const struct pattern *k = &patterns[p];
+		struct timespec t0, t1;
+
+		sent = 0;
+		k->send();
+		unsigned long bytes = sent;
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+#ifdef HAVE_TSC
+		uint64_t c0 = __rdtsc();
+#endif
+		for (int i = 0; i < REPEATS; i++)
+		{
+			k->send();
+		}
+#ifdef HAVE_TSC
+		uint64_t c1 = __rdtsc();
+#endif
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+
+		double ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / REPEATS;
+		printf("{\"message\": \"%s\", \"method\": \"%s\", \"bytes\": %lu, \"ns\": %.0f",
+			k->message, k->method, bytes, ns);
+#ifdef HAVE_TSC
+		printf(", \"cycles\": %.0f", (double) (c1 - c0) / REPEATS);
+#endif
+		printf(", \"stack_bytes\": %ld}\n", stack_used(k->send) - base);
+	}
+	return 0;
+}
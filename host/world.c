@@ -0,0 +1,504 @@
+/**
+ *	@file world.c
+ *	@brief the course around the simulated rover
+ *
+ *	Cliff signals are given as the raw 16-bit values the Create sends. The
+ *	firmware decodes them with a sign-extended low byte, so some raw values
+ *	read lower than they are (the front left sensor on tape sends 960 and the
+ *	firmware sees 704). The table below is chosen so that what the firmware
+ *	sees falls in the bands checkSensors() and destination_edge() were tuned
+ *	for, with room for the noise on either side.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "hal.h"
+#include "create.h"
+#include "world.h"
+
+#define PI 3.14159265358979
+
+/// radius of the Create's body in millimeters
+#define ROBOT_RADIUS	170.0
+/// a bumper stays pressed while an obstacle is this close, in millimeters
+#define CONTACT_MARGIN	1.0
+/// bumps within this many degrees of straight ahead press both bumpers
+#define BUMP_CENTRE	20.0
+/// cliff sensors sit on this circle, in millimeters
+#define CLIFF_RADIUS	155.0
+/// a reaction counts for a floor a cliff sensor was over this recently, in microseconds
+#define WORLD_REACTION_US	100000
+/// the world is updated this often, in microseconds
+#define WORLD_STEP_US	1000
+
+/// half the width of the sonar beam in degrees, and the rays cast across it
+#define SONAR_BEAM	10
+#define SONAR_RAYS	11
+/// furthest the sonar and IR sensor report, in centimeters
+#define SONAR_MAX	300.0
+#define IR_MIN		10.0
+#define IR_MAX		90.0
+
+HAL_LOCAL struct world world;
+
+/// direction of each cliff sensor from the centre: left, front left, front right, right
+static const double cliff_angle[4] = {65, 20, -20, -65};
+
+/// raw cliff signal of each sensor over each kind of floor
+static const int cliff_signal[4][4] = {
+	// left, front left, front right, right
+	{  40,   40,   40,  40},	// floor
+	{ 320,  960,  480, 552},	// tape
+	{ 576, 1120,  352, 880},	// goal
+	{   4,    4,    4,   4},	// hole
+};
+
+static HAL_LOCAL uint64_t rng = 0x9E3779B97F4A7C15ULL;
+static HAL_LOCAL int last_floor[4];		// floor under each cliff sensor on the last step
+static HAL_LOCAL uint64_t last_on[4][4];		// [floor][sensor] last step the sensor was over that floor
+static HAL_LOCAL char pending[4];			// sensor went onto tape or a hole and nothing reacted yet
+static HAL_LOCAL uint64_t step_time;
+
+/**
+ *	Next number of the noise generator (xorshift64*)
+ */
+
+static uint64_t next_random(void)
+{
+	rng ^= rng >> 12;
+	rng ^= rng << 25;
+	rng ^= rng >> 27;
+	return rng * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ *	Uniform noise in [-a, a]
+ */
+
+static double uniform(double a)
+{
+	return a * ((next_random() >> 11) * (2.0 / 9007199254740992.0) - 1.0);
+}
+
+/**
+ *	Normal noise with standard deviation s
+ */
+
+static double normal(double s)
+{
+	double u = ((next_random() >> 11) + 1.0) / 9007199254740993.0;
+	double v = (next_random() >> 11) / 9007199254740992.0;
+	return s * sqrt(-2.0 * log(u)) * cos(2.0 * PI * v);
+}
+
+void world_seed(uint64_t seed)
+{
+	rng = seed * 0x9E3779B97F4A7C15ULL + 0x632BE59BD9B4E019ULL;
+	if (rng == 0)
+	{
+		rng = 1;
+	}
+}
+
+/**
+ *	Closest point to (px, py) on a segment
+ */
+
+static void closest_point(const struct world_segment *s, double px, double py, double *qx, double *qy)
+{
+	double dx = s->x2 - s->x1;
+	double dy = s->y2 - s->y1;
+	double len = dx * dx + dy * dy;
+	double t = len > 0 ? ((px - s->x1) * dx + (py - s->y1) * dy) / len : 0;
+	if (t < 0) t = 0;
+	if (t > 1) t = 1;
+	*qx = s->x1 + t * dx;
+	*qy = s->y1 + t * dy;
+}
+
+int world_floor(double x, double y)
+{
+	for (int i = 0; i < world.hole_count; i++)
+	{
+		if (hypot(x - world.holes[i].x, y - world.holes[i].y) < world.holes[i].r)
+		{
+			return WORLD_HOLE;
+		}
+	}
+	for (int i = 0; i < world.goal_count; i++)
+	{
+		if (hypot(x - world.goals[i].x, y - world.goals[i].y) < world.goals[i].r)
+		{
+			return WORLD_GOAL;
+		}
+	}
+	for (int i = 0; i < world.tape_count; i++)
+	{
+		double qx, qy;
+		closest_point(&world.tapes[i], x, y, &qx, &qy);
+		if (hypot(x - qx, y - qy) < world.tapes[i].width / 2)
+		{
+			return WORLD_TAPE;
+		}
+	}
+	return WORLD_FLOOR;
+}
+
+/**
+ *	Distance along a ray to a circle, or -1 if the ray misses it
+ */
+
+static double ray_circle(double sx, double sy, double dx, double dy, const struct world_circle *c)
+{
+	double ox = sx - c->x;
+	double oy = sy - c->y;
+	double b = ox * dx + oy * dy;
+	double disc = b * b - (ox * ox + oy * oy - c->r * c->r);
+	if (disc < 0)
+	{
+		return -1;
+	}
+	double t = -b - sqrt(disc);
+	if (t < 0)
+	{
+		t = -b + sqrt(disc);
+	}
+	return t;
+}
+
+/**
+ *	Distance along a ray to a segment, or -1 if the ray misses it
+ */
+
+static double ray_segment(double sx, double sy, double dx, double dy, const struct world_segment *s)
+{
+	double ex = s->x2 - s->x1;
+	double ey = s->y2 - s->y1;
+	double den = dx * ey - dy * ex;
+	if (fabs(den) < 1e-12)
+	{
+		return -1;
+	}
+	double wx = s->x1 - sx;
+	double wy = s->y1 - sy;
+	double t = (wx * ey - wy * ex) / den;
+	double u = (wx * dy - wy * dx) / den;
+	if (t < 0 || u < 0 || u > 1)
+	{
+		return -1;
+	}
+	return t;
+}
+
+/**
+ *	Distance in millimeters from the servo to the nearest obstacle along a
+ *	direction offset from the servo's, or -1 if nothing is in the way
+ */
+
+static double cast(double offset)
+{
+	double h = create.heading * PI / 180.0;
+	double sx = create.x + world.mount * cos(h);
+	double sy = create.y + world.mount * sin(h);
+	double a = h + (world_servo_angle() - 90 + offset) * PI / 180.0;
+	double dx = cos(a);
+	double dy = sin(a);
+	double best = -1;
+
+	for (int i = 0; i < world.post_count; i++)
+	{
+		double t = ray_circle(sx, sy, dx, dy, &world.posts[i]);
+		if (t >= 0 && (best < 0 || t < best))
+		{
+			best = t;
+		}
+	}
+	for (int i = 0; i < world.wall_count; i++)
+	{
+		double t = ray_segment(sx, sy, dx, dy, &world.walls[i]);
+		if (t >= 0 && (best < 0 || t < best))
+		{
+			best = t;
+		}
+	}
+	return best;
+}
+
+double world_servo_angle(void)
+{
+	//inverse of move_servo(): pulse + 1 = 4300 - (180 - degree) / 180 * 3250
+	return 180.0 - (4300.0 - (hal_linux_servo_pulse() + 1)) / 3250.0 * 180.0;
+}
+
+/**
+ *	Sonar reading in centimeters: the nearest echo across the beam
+ */
+
+static double sonar_sample(void)
+{
+	double best = SONAR_MAX;
+	for (int i = 0; i < SONAR_RAYS; i++)
+	{
+		double t = cast(-SONAR_BEAM + 2.0 * SONAR_BEAM * i / (SONAR_RAYS - 1));
+		if (t >= 0 && t / 10.0 < best)
+		{
+			best = t / 10.0;
+		}
+	}
+	best += normal(world.sonar_noise);
+	return best < 0 ? 0 : best;
+}
+
+/**
+ *	IR sensor ADC value: IR_read() turns it back into 34272 * adc^-1.376 cm
+ */
+
+static double ir_sample(void)
+{
+	double t = cast(0);
+	double cm = t < 0 ? IR_MAX : t / 10.0;
+	if (cm < IR_MIN) cm = IR_MIN;
+	if (cm > IR_MAX) cm = IR_MAX;
+	return pow(34272.0 / cm, 1 / 1.376) + normal(world.ir_noise);
+}
+
+/**
+ *	Push the body out of anything it drove into and work out which bumpers
+ *	are pressed
+ */
+
+static uint8_t resolve_contacts(void)
+{
+	uint8_t bumps = 0;
+	int n = world.post_count + world.wall_count;
+
+	for (int i = 0; i < n; i++)
+	{
+		double qx, qy, r;
+		if (i < world.post_count)
+		{
+			qx = world.posts[i].x;
+			qy = world.posts[i].y;
+			r = world.posts[i].r;
+		}
+		else
+		{
+			closest_point(&world.walls[i - world.post_count], create.x, create.y, &qx, &qy);
+			r = 0;
+		}
+
+		double dx = create.x - qx;
+		double dy = create.y - qy;
+		double d = hypot(dx, dy);
+		double overlap = ROBOT_RADIUS + r - d;
+		if (overlap <= -CONTACT_MARGIN || d == 0)
+		{
+			continue;
+		}
+		if (overlap > 0)
+		{
+			create.x += dx / d * overlap;
+			create.y += dy / d * overlap;
+		}
+
+		//bearing of the contact from straight ahead, counterclockwise positive
+		double rel = atan2(-dy, -dx) * 180.0 / PI - create.heading;
+		rel = fmod(rel + 540.0, 360.0) - 180.0;
+		if (fabs(rel) < 90)
+		{
+			if (rel > -BUMP_CENTRE)
+			{
+				bumps |= 0x02;	// left
+			}
+			if (rel < BUMP_CENTRE)
+			{
+				bumps |= 0x01;	// right
+			}
+		}
+	}
+	return bumps;
+}
+
+static void world_step(uint64_t now, void *arg)
+{
+	uint8_t bumps = resolve_contacts();
+	step_time = now;
+	if (bumps && !create.bumps)
+	{
+		world.bump_events++;
+		world.bump_time = now;
+	}
+	create.bumps = bumps;
+
+	double h = create.heading * PI / 180.0;
+	for (int i = 0; i < 4; i++)
+	{
+		double a = h + cliff_angle[i] * PI / 180.0;
+		int floor = world_floor(create.x + CLIFF_RADIUS * cos(a), create.y + CLIFF_RADIUS * sin(a));
+		int signal = cliff_signal[floor][i] + (int) lround(uniform(world.signal_noise));
+
+		if (floor != last_floor[i] && floor == WORLD_HOLE)
+		{
+			world.cliff_events++;
+		}
+		if (floor != last_floor[i] && floor == WORLD_TAPE)
+		{
+			world.tape_events++;
+		}
+		if (floor != last_floor[i] && (floor == WORLD_TAPE || floor == WORLD_HOLE))
+		{
+			pending[i] = 1;
+		}
+		else if (floor != last_floor[i] && pending[i])
+		{
+			world.missed_events++;	//off it again without the firmware noticing
+			pending[i] = 0;
+		}
+		last_on[floor][i] = now ? now : 1;
+		last_floor[i] = floor;
+		create.cliff[i] = floor == WORLD_HOLE;
+		create.cliff_signal[i] = signal < 0 ? 0 : signal;
+	}
+
+	if (!world.goal_time && world_floor(create.x, create.y) == WORLD_GOAL)
+	{
+		world.goal_time = now ? now : 1;
+	}
+
+	hal_linux_at(now + WORLD_STEP_US, world_step, 0);
+}
+
+void world_reaction(int floor)
+{
+	int seen = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		seen |= last_on[floor][i] && step_time - last_on[floor][i] <= WORLD_REACTION_US;
+		pending[i] = 0;
+	}
+	if (!seen)
+	{
+		world.false_stops++;
+	}
+}
+
+void world_attach(void)
+{
+	create_reset(world.start_x, world.start_y, world.start_heading);
+	memset(last_on, 0, sizeof(last_on));
+	memset(pending, 0, sizeof(pending));
+	hal_linux_sonar_source(sonar_sample);
+	hal_linux_adc_source(ir_sample);
+	hal_linux_at(hal_linux_now(), world_step, 0);
+}
+
+/**
+ *	Default noise, used when the world file does not give any
+ */
+
+static void world_defaults(void)
+{
+	memset(&world, 0, sizeof(world));
+	world.sonar_noise = 1.0;
+	world.ir_noise = 1.5;
+	world.signal_noise = 6;
+}
+
+int world_load(const char *path)
+{
+	char line[200];
+	int number = 0;
+
+	world_defaults();
+	if (!path)
+	{
+		return 0;
+	}
+
+	FILE *f = fopen(path, "r");
+	if (!f)
+	{
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f))
+	{
+		char word[16];
+		double v[5] = {0, 0, 0, 0, 50};
+		int n;
+
+		number++;
+		char *hash = strchr(line, '#');
+		if (hash)
+		{
+			*hash = 0;
+		}
+		n = sscanf(line, "%15s %lf %lf %lf %lf %lf", word, &v[0], &v[1], &v[2], &v[3], &v[4]);
+		if (n <= 0)
+		{
+			continue;
+		}
+		n--;
+
+		struct world_circle c = {v[0], v[1], v[2]};
+		struct world_segment s = {v[0], v[1], v[2], v[3], v[4]};
+		int ok = 1;
+
+		if (!strcmp(word, "start") && n == 3)
+		{
+			world.start_x = v[0];
+			world.start_y = v[1];
+			world.start_heading = v[2];
+		}
+		else if (!strcmp(word, "post") && n == 3 && world.post_count < WORLD_MAX_ITEMS)
+		{
+			world.posts[world.post_count++] = c;
+		}
+		else if (!strcmp(word, "goal") && n == 3 && world.goal_count < WORLD_MAX_ITEMS)
+		{
+			world.goals[world.goal_count++] = c;
+		}
+		else if (!strcmp(word, "hole") && n == 3 && world.hole_count < WORLD_MAX_ITEMS)
+		{
+			world.holes[world.hole_count++] = c;
+		}
+		else if (!strcmp(word, "wall") && n == 4 && world.wall_count < WORLD_MAX_ITEMS)
+		{
+			world.walls[world.wall_count++] = s;
+		}
+		else if (!strcmp(word, "tape") && (n == 4 || n == 5) && world.tape_count < WORLD_MAX_ITEMS)
+		{
+			world.tapes[world.tape_count++] = s;
+		}
+		else if (!strcmp(word, "noise") && n == 3)
+		{
+			world.sonar_noise = v[0];
+			world.ir_noise = v[1];
+			world.signal_noise = v[2];
+		}
+		else if (!strcmp(word, "odometry") && n == 2)
+		{
+			create.distance_scale = v[0];
+			create.angle_scale = v[1];
+		}
+		else if (!strcmp(word, "mount") && n == 1)
+		{
+			world.mount = v[0];
+		}
+		else
+		{
+			ok = 0;
+		}
+
+		if (!ok)
+		{
+			fprintf(stderr, "%s:%d: cannot use '%s' here\n", path, number, word);
+			fclose(f);
+			return -1;
+		}
+	}
+	fclose(f);
+	return 0;
+}
@@ -0,0 +1,97 @@
+/**
+ *	@file world.h
+ *	@brief the course around the simulated rover
+ *
+ *	The world holds the obstacles the sonar and IR sensor see and the bumper
+ *	runs into, and the floor the cliff sensors look at: plain floor, white
+ *	tape, the destination pad and holes. It keeps the Create model out of
+ *	obstacles and fills in its bumper and cliff fields on every step.
+ *
+ *	A world file has one item per line, in millimeters and degrees, with x
+ *	forward and y to the left of the starting pose at heading 0:
+ *
+ *	start X Y HEADING		where the rover starts
+ *	post X Y RADIUS			round obstacle
+ *	wall X1 Y1 X2 Y2		thin straight obstacle
+ *	tape X1 Y1 X2 Y2 [WIDTH]	white tape on the floor (default 50 mm wide)
+ *	goal X Y RADIUS			destination pad
+ *	hole X Y RADIUS			drop the cliff sensors detect
+ *	noise SONAR IR SIGNAL		sensor noise: sonar cm, IR ADC counts, cliff signal counts
+ *	mount OFFSET			servo distance ahead of the robot's centre
+ *	odometry DISTANCE ANGLE		what the Create reports per millimeter and per degree
+ *
+ *	Everything after a # is a comment.
+ */
+
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <stdint.h>
+#include "hal.h"
+
+#define WORLD_MAX_ITEMS	64
+
+/// what the floor is made of at a point
+#define WORLD_FLOOR	0
+#define WORLD_TAPE	1
+#define WORLD_GOAL	2
+#define WORLD_HOLE	3
+
+struct world_circle{
+	double x, y, r;
+};
+
+struct world_segment{
+	double x1, y1, x2, y2;
+	double width;
+};
+
+/// the course and what happened on it so far
+struct world{
+	double start_x, start_y, start_heading;
+	struct world_circle posts[WORLD_MAX_ITEMS];
+	int post_count;
+	struct world_segment walls[WORLD_MAX_ITEMS];
+	int wall_count;
+	struct world_segment tapes[WORLD_MAX_ITEMS];
+	int tape_count;
+	struct world_circle goals[WORLD_MAX_ITEMS];
+	int goal_count;
+	struct world_circle holes[WORLD_MAX_ITEMS];
+	int hole_count;
+
+	double sonar_noise;		//standard deviation in centimeters
+	double ir_noise;		//standard deviation in ADC counts
+	double signal_noise;		//largest cliff signal error in counts
+	double mount;			//servo distance ahead of the centre in millimeters
+
+	unsigned long bump_events;	//times a bumper was pressed
+	uint64_t bump_time;		//virtual time a bumper was last pressed
+	unsigned long cliff_events;	//times a cliff sensor went over a hole
+	unsigned long tape_events;	//times a cliff sensor went onto tape
+	uint64_t goal_time;		//virtual time the centre first reached a goal, 0 if never
+	unsigned long false_stops;	//reactions to a floor no cliff sensor was near
+	unsigned long missed_events;	//times a cliff sensor left tape or a hole with no reaction
+};
+
+extern HAL_LOCAL struct world world;
+
+/// Read a world file into world; returns 0, or -1 after printing the problem
+int world_load(const char *path);
+
+/// Seed the sensor noise
+void world_seed(uint64_t seed);
+
+/// Put the Create at the start and attach the world's sensors to the HAL
+void world_attach(void);
+
+/// What the floor is made of at a point (WORLD_FLOOR ... WORLD_HOLE)
+int world_floor(double x, double y);
+
+/// The firmware reacted to the floor kind (WORLD_TAPE, WORLD_GOAL, WORLD_HOLE): scores it and clears the pending hazards
+void world_reaction(int floor);
+
+/// Angle the servo is pointing at in degrees, 90 straight ahead
+double world_servo_angle(void);
+
+#endif
@@ -1,322 +1,444 @@
-/**
- * 	@file lcd.c
- * 	@brief functions for displaying content to the LCD screen
- *
- * 	@author ISU
- * 
- * 	@date 06/26/2012
- */
-
-#include <avr/io.h>
-#include <stdlib.h>
-#include <stdio.h>
-#include <string.h>
-#include "util.h"
-#include "lcd.h"
-
-
-#define HD_LCD_CLEAR 0x01
-#define HD_RETURN_HOME 0x02
-#define HD_CURSOR_SHIFT_DEC 0x05
-#define HD_CURSOR_SHIFT_INC 0x07
-#define HD_DISPLAY_CONTROL 3
-#define HD_DISPLAY_ON 2
-#define HD_CURSOR_ON 1
-#define HD_BLINK_ON 0
-#define HD_CURSOR_MOVE_LEFT 0x10
-#define HD_CURSOR_MOVE_RIGHT 0x14
-#define HD_DISPLAY_SHIFT_LEFT 0x18
-#define HD_DISPLAY_SHIFT_RIGHT 0x1C
-
-#define LCD_WIDTH 20
-#define LCD_HEIGHT 4
-#define LCD_TOTAL_CHARS (LCD_WIDTH*LCD_HEIGHT)
-
-void lcd_toggle_clear(char delay);
-void lcd_home_anyloc(unsigned char location);
-
-/**
- * 	Initializes PORTA to communicate with LCD controller
- * 	@authorISU
- * 
- * 	@date 06/26/2012
- */
- 
-void lcd_init(void) 
-{
-	const char enable=0x40; //PA6 is tied to Enable
-	const char rs=0x10;		//PA4 is tied to Register Select
-	//Assumes Port A is dedicated to the LCD
-	//Seven Pins needed, but will assume all 8 are used
-	DDRA=0xFF; //Setting Port A for OutPut
-	 //Preparing to put HD44780 into 4-bit Mod
-	PORTA=0x03;
-
-	PORTA|=enable;
-	wait_ms(1);
-	PORTA&=~enable;
-	wait_ms(5);
-	PORTA|=enable;
-	wait_ms(1);
-	PORTA&=~enable;
-	PORTA|=enable;
-	wait_ms(1);
-	PORTA&=~enable;
-
-	PORTA=0x02;	//setting controller to 4 bit mode
-				//Need to set for 2 lines
-	lcd_toggle_clear(1);
-
-	PORTA|=0x00;  //setting disp on, cursor on, blink off
-	lcd_toggle_clear(1);
-	PORTA|=0x0E;
-	lcd_toggle_clear(1);
-
-	PORTA|=0x00; //increment cursor, no display shift
-	lcd_toggle_clear(1);
-	PORTA|=0x06;
-	lcd_toggle_clear(1);
-	
-	PORTA|=0x00; //clear LCD
-	lcd_toggle_clear(1);
-	PORTA|=0x01;
-	lcd_toggle_clear(1);
-
-	PORTA|=rs;	//Setting Register select high to enable character mode
-	lcd_home_line1();
-}
-
-
-/**
- * 	Triggers loading of bits by LCD controller and clears bits after toggle
- * 	@authorISU
- * 
- * 	@date 06/26/2012
- */
-
-void lcd_toggle_clear(char delay) 
-{
-	const char enable=0x40; //PA6 is tied to Enable
-
-	PORTA|=enable;
-	wait_ms(delay);
-	PORTA&=~enable;
-	PORTA&=0xF0;	
-}
-
-/**
- * 	Submits command to LCD controller
- * 	@authorISU
- * 
- * 	@date 06/26/2012
- */
-
-void lcd_command(char data) 
-{
-	const char rs=0x10;		//PA4 is tied to Register Select
-	PORTA&=~rs;  //Setting register select low for command mode
-	PORTA|=(data>>4);
-	lcd_toggle_clear(2);
-	PORTA|=(data & 0x0F);
-	lcd_toggle_clear(2);
-	PORTA|=rs;	//Setting register select high for character mode
-}
-
-
-/**
- * 	Clears the LCD
- * 	@authorISU
- * 
- * 	@date 06/26/2012
- */
-
-void lcd_clear(void) 
-{
-	lcd_command(HD_LCD_CLEAR);
-	wait_ms(1);
-}
-
-
-/**
- * 	Sets character position to first line first position
- * 	@authorISU
- * 	
- * 	@date 06/26/2012
- */
-
-void lcd_home_line1(void)
-{
-	lcd_command(HD_RETURN_HOME);
-}
-
-
-/**
- * 	Sets character position to second line first position
- * 	@authorISU
- * 	
- * 	@date 06/26/2012
- */
-
-void lcd_home_line2(void)
-{
-	lcd_command(0xC0); //First bit relevant to the set DDRAM address instruction. The remaining bits designate address, which is 0x40.
-}
-
-
-/**
- * 	Sets character position to third line first position
- * 	@authorISU
- * 	
- * 	@date 06/26/2012
- */
-
-void lcd_home_line3(void)
-{
-	lcd_command(0x94);	//First bit relevant to the set DDRAM address instruction. The remaining bits designate address, which is 0x14.
-}
-
-
-/**
- * 	Sets character position to fourth line first position
- * 	@authorISU
- * 	
- * 	@date 06/26/2012
- */
-
-void lcd_home_line4(void)
-{ //First bit relevant to the set DDRAM address instruction. The remaining bits designate address, which is 0x54.
-	lcd_command(0xD4); 
-}
-
-
-/**
- * 	Sets character position to any valid location
- * 	@authorISU
- * 	
- * 	@date 06/26/2012
- */
-
-void lcd_home_anyloc(unsigned char location) 
-{
-	if (location < 0x68) { //Addresses are limitted to 0x00 - 0x67
-		location |= 0x80; //Setting the first bit to one, thus forming a DDRAM set address instruction
-		lcd_command(location);
-	} 
-}
-
-
-/**
- * 	Shift display content left
- * 	@authorISU
- * 	
- * 	@date 06/26/2012
- */
-
-void lcd_display_shift_left(void) 
-{
-	lcd_command(HD_DISPLAY_SHIFT_LEFT);
-}
-
-
-/**
- *	Prints string to lcd, starting at the current cursor position
- * 	@authorISU
- * 	
- * 	@date 06/26/2012
- */
-
-void lcd_puts(char * string) 
-{
-	int size=strlen(string);
-	int i;
-
-	for (i=0;i<size;i++) {		
-		lcd_putc(string[i]);
-	}
-}
-
-
-/**
- *	Prints one character at the current cursor position
- * 	@authorISU
- * 	
- * 	@date 06/26/2012
- */
-
-void lcd_putc(char data) 
-{
-	PORTA|=(data>>4);
-	lcd_toggle_clear(1);
-	PORTA|=(data & 0x0F);
-	lcd_toggle_clear(1);
-}
-
-
-/**
- * 	Print a formatted string to the LCD screen.
- *	Mimics the C library function printf for writing to the LCD screen.  
- *	The function is buffered; i.e. if you call
- * 	lprintf twice with the same string, it will only update the LCD the first time.
- *	
- * 	Google "printf" for documentation on the formatter string.
- *
- *	 Code from this site was also used: 
- *	 http://www.ozzu.com/cpp-tutorials/tutorial-writing-custom-printf-wrapper-function-t89166.html
- *
- *	@param format	format of the string to be printed
- *	@author Kerrick Staley & Chad Nelson
- *	@date 05/16/2012
- */
-void lprintf(const char *format, ...) 
-{
-	static char lastbuffer[LCD_TOTAL_CHARS + 1];
-
-	char buffer[LCD_TOTAL_CHARS + 1];
-	va_list arglist;
-	va_start(arglist, format);
-	vsnprintf(buffer, LCD_TOTAL_CHARS + 1, format, arglist);
-	
-	if (!strcmp(lastbuffer, buffer))
-		return;
-	
-	strcpy(lastbuffer, buffer);
-	lcd_clear();
-	char *str = buffer;
-	int charnum = 0;
-	while (*str && charnum < LCD_TOTAL_CHARS) {
-		if (*str == '\n') {
-			/* fill remainder of line with spaces */
-			charnum += LCD_WIDTH - charnum % LCD_WIDTH;
-		} else {
-			lcd_putc(*str);
-			charnum++;
-		}
-
-		str++;
-		
-		/*
-		 * The LCD's lines are not sequential; for future reference, the address are like
-		 * 0x00...0x13 : line 1
-		 * 0x14...0x27 : line 3
-		 * 0x28...0x3F : random junk
-		 * 0x40...0x53 : line 2
-		 * 0x54...0x68 : line 4
-		 * 
-		 * The cursor position must be reset at the end of every line, otherwise, after writing line 1, it writes line 3 and then nothingness
-		 */
-		
-		if (charnum % LCD_WIDTH == 0) { 
-			switch (charnum / LCD_WIDTH) {
-			case 1:
-				lcd_home_line2();
-				break;
-			case 2:
-				lcd_home_line3();
-				break;
-			case 3:
-				lcd_home_line4();
-			}
-		}
-	}
-	va_end(arglist);
-}
+/**
+ * 	@file lcd.c
+ * 	@brief functions for displaying content to the LCD screen
+ *
+ *	Nothing here waits for the display. Text goes into a frame buffer of
+ *	the 4 x 20 cells, and the Timer0 interrupt copies the cells that differ
+ *	from what the controller shows, one byte every 50 us; a write takes the
+ *	HD44780 37 us, so it is always ready for the next one. Timer0 only runs
+ *	while something is left to copy. Lines that have not changed are not
+ *	looked at.
+ *
+ * 	@author ISU
+ *
+ * 	@date 06/26/2012
+ */
+
+#include "hal.h"
+#include <stdarg.h>
+#include "util.h"
+#include "stream.h"
+#include "lcd.h"
+#include "timebase.h"
+#include "profile.h"
+
+
+#define HD_LCD_CLEAR 0x01
+#define HD_RETURN_HOME 0x02
+#define HD_CURSOR_SHIFT_DEC 0x05
+#define HD_CURSOR_SHIFT_INC 0x07
+#define HD_DISPLAY_CONTROL 3
+#define HD_DISPLAY_ON 2
+#define HD_CURSOR_ON 1
+#define HD_BLINK_ON 0
+#define HD_CURSOR_MOVE_LEFT 0x10
+#define HD_CURSOR_MOVE_RIGHT 0x14
+#define HD_DISPLAY_SHIFT_LEFT 0x18
+#define HD_DISPLAY_SHIFT_RIGHT 0x1C
+#define HD_SET_ADDRESS 0x80
+
+#define LCD_WIDTH 20
+#define LCD_HEIGHT 4
+#define LCD_TOTAL_CHARS (LCD_WIDTH*LCD_HEIGHT)
+
+#define LCD_ENABLE 0x40		//PA6 is tied to Enable
+#define LCD_RS 0x10		//PA4 is tied to Register Select
+
+/// Timer0 compare value for one byte every 50 us (100 counts of 0.5 us)
+#define LCD_STEP 99
+
+/// execution time of a write, in microseconds
+#define LCD_EXEC_US 37
+
+/// execution time of clear and return home (1.52 ms), in whole milliseconds
+#define LCD_SLOW_MS 2
+
+/*
+ * The LCD's lines are not sequential; the display RAM addresses are
+ * 0x00...0x13 : line 1
+ * 0x14...0x27 : line 3
+ * 0x40...0x53 : line 2
+ * 0x54...0x67 : line 4
+ * and after 0x27 the controller's address moves on to 0x40, after 0x67 to 0x00.
+ */
+static const unsigned char line_address[LCD_HEIGHT] = {0x00, 0x40, 0x14, 0x54};
+
+static HAL_LOCAL volatile char frame[LCD_TOTAL_CHARS];	// what the screen should show
+static HAL_LOCAL char shown[LCD_TOTAL_CHARS];		// what the controller shows
+static HAL_LOCAL volatile unsigned char dirty;		// bit n set: line n may differ from shown
+static HAL_LOCAL volatile char refreshing;		// Timer0 is copying the frame
+static HAL_LOCAL unsigned char address;			// the controller's display RAM address
+static HAL_LOCAL unsigned char cursor;			// frame cell lcd_putc() writes next
+static HAL_LOCAL unsigned char render;			// frame cell lprintf() writes next
+static HAL_LOCAL struct timer settle;			// runs lcd_resume() after a command
+
+/**
+ * 	Clocks one nibble into the controller
+ */
+
+static void lcd_nibble(unsigned char nibble)
+{
+	hal_lcd_port_and(0xF0);
+	hal_lcd_port_or(nibble & 0x0F);
+	hal_lcd_port_or(LCD_ENABLE);
+	hal_delay_1us();		//E must be high for 450 ns
+	hal_lcd_port_and(~LCD_ENABLE);
+	hal_delay_1us();
+}
+
+/**
+ * 	Sends one byte to the controller, as a command or as a character
+ */
+
+static void lcd_write(unsigned char data, char character)
+{
+	if (character)
+	{
+		hal_lcd_port_or(LCD_RS);
+	}
+	else
+	{
+		hal_lcd_port_and(~LCD_RS);
+	}
+	lcd_nibble(data >> 4);
+	lcd_nibble(data);
+}
+
+/**
+ * 	Puts a character into a frame cell and marks its line if it changed
+ */
+
+static void lcd_set(unsigned char cell, char data)
+{
+	if (frame[cell] != data)
+	{
+		frame[cell] = data;
+		dirty |= 1 << (cell / LCD_WIDTH);
+	}
+}
+
+/**
+ * 	Starts the background refresh if the frame has changed. It is called
+ * 	from lcd_resume() inside the Timer2 interrupt too, so it leaves the
+ * 	interrupt flag as it found it; lcd_init() turns interrupts on.
+ */
+
+static void lcd_kick(void)
+{
+	unsigned char state = hal_interrupts_disable();
+	if (dirty && !refreshing)
+	{
+		refreshing = 1;
+		hal_timer0_start(LCD_STEP);
+	}
+	hal_interrupts_restore(state);
+}
+
+/**
+ * 	Initializes PORTA to communicate with LCD controller
+ * 	@authorISU
+ *
+ * 	@date 06/26/2012
+ */
+
+void lcd_init(void)
+{
+	hal_timer0_stop();
+	timer_stop(&settle);
+	refreshing = 0;
+	hal_lcd_port_init(); //Setting Port A for OutPut
+	hal_lcd_port_write(0x00);
+
+	//Preparing to put HD44780 into 4-bit mode; until then each nibble is a whole command
+	lcd_nibble(0x03);
+	wait_ms(5);
+	lcd_nibble(0x03);
+	wait_ms(1);
+	lcd_nibble(0x03);
+	wait_ms(1);
+	lcd_nibble(0x02);	//setting controller to 4 bit mode
+	wait_ms(1);
+
+	lcd_write(0x28, 0);	//4 bit, 2 lines
+	wait_ms(1);
+	lcd_write(0x0C, 0);	//setting disp on, cursor off, blink off
+	wait_ms(1);
+	lcd_write(0x06, 0);	//increment cursor, no display shift
+	wait_ms(1);
+	lcd_write(HD_LCD_CLEAR, 0);
+	wait_ms(2);
+
+	for (unsigned char i = 0; i < LCD_TOTAL_CHARS; i++)
+	{
+		frame[i] = ' ';
+		shown[i] = ' ';
+	}
+	dirty = 0;
+	address = 0;
+	cursor = 0;
+	hal_interrupts_enable();	//the refresh runs from Timer0
+}
+
+
+/**
+ * 	Copies one changed cell of the frame to the controller, or moves the
+ * 	controller's address to it. Stops Timer0 once the screen is up to date.
+ */
+
+ISR (TIMER0_COMP_vect)
+{
+	for (unsigned char line = 0; line < LCD_HEIGHT; line++)
+	{
+		if (!(dirty & (1 << line)))
+		{
+			continue;
+		}
+		for (unsigned char column = 0; column < LCD_WIDTH; column++)
+		{
+			unsigned char cell = line * LCD_WIDTH + column;
+			char data = frame[cell];
+			if (data == shown[cell])
+			{
+				continue;
+			}
+			unsigned char want = line_address[line] + column;
+			if (address != want)
+			{
+				lcd_write(HD_SET_ADDRESS | want, 0);
+				address = want;
+			}
+			else
+			{
+				lcd_write(data, 1);
+				shown[cell] = data;
+				address = address == 0x27 ? 0x40 : address == 0x67 ? 0x00 : address + 1;
+			}
+			return;		//one byte per interrupt
+		}
+		dirty &= ~(1 << line);
+	}
+	hal_timer0_stop();
+	refreshing = 0;
+}
+
+/**
+ * 	Restarts the refresh once a command has had its execution time
+ */
+
+static void lcd_resume(void *arg)
+{
+	refreshing = 0;
+	lcd_kick();
+}
+
+/**
+ * 	Submits command to LCD controller. It returns at once; the refresh
+ * 	waits out the command's execution time on a timer and then writes the
+ * 	whole screen again, since the command may have changed what the
+ * 	controller shows.
+ * 	@authorISU
+ *
+ * 	@date 06/26/2012
+ */
+
+void lcd_command(char data)
+{
+	hal_timer0_stop();
+	refreshing = 1;		//keeps lcd_kick() from restarting the refresh too early
+	wait_us(LCD_EXEC_US);	//let a byte the refresh just sent finish
+	lcd_write(data, 0);
+	for (unsigned char i = 0; i < LCD_TOTAL_CHARS; i++)
+	{
+		shown[i] = 0;
+	}
+	address = 0xFF;
+	dirty = (1 << LCD_HEIGHT) - 1;
+	timer_start(&settle, LCD_SLOW_MS, 0, lcd_resume, 0);
+}
+
+
+/**
+ * 	Clears the LCD
+ * 	@authorISU
+ *
+ * 	@date 06/26/2012
+ */
+
+void lcd_clear(void)
+{
+	for (unsigned char i = 0; i < LCD_TOTAL_CHARS; i++)
+	{
+		lcd_set(i, ' ');
+	}
+	cursor = 0;
+	lcd_kick();
+}
+
+
+/**
+ * 	Sets character position to first line first position
+ * 	@authorISU
+ *
+ * 	@date 06/26/2012
+ */
+
+void lcd_home_line1(void)
+{
+	cursor = 0;
+}
+
+
+/**
+ * 	Sets character position to second line first position
+ * 	@authorISU
+ *
+ * 	@date 06/26/2012
+ */
+
+void lcd_home_line2(void)
+{
+	cursor = LCD_WIDTH;
+}
+
+
+/**
+ * 	Sets character position to third line first position
+ * 	@authorISU
+ *
+ * 	@date 06/26/2012
+ */
+
+void lcd_home_line3(void)
+{
+	cursor = 2 * LCD_WIDTH;
+}
+
+
+/**
+ * 	Sets character position to fourth line first position
+ * 	@authorISU
+ *
+ * 	@date 06/26/2012
+ */
+
+void lcd_home_line4(void)
+{
+	cursor = 3 * LCD_WIDTH;
+}
+
+
+/**
+ * 	Sets character position to any valid location, given as a display RAM address
+ * 	@authorISU
+ *
+ * 	@date 06/26/2012
+ */
+
+void lcd_home_anyloc(unsigned char location)
+{
+	for (unsigned char line = 0; line < LCD_HEIGHT; line++)
+	{
+		if (location >= line_address[line] && location < line_address[line] + LCD_WIDTH)
+		{
+			cursor = line * LCD_WIDTH + location - line_address[line];
+		}
+	}
+}
+
+
+/**
+ * 	Shift display content left
+ * 	@authorISU
+ *
+ * 	@date 06/26/2012
+ */
+
+void lcd_display_shift_left(void)
+{
+	lcd_command(HD_DISPLAY_SHIFT_LEFT);
+}
+
+
+/**
+ *	Prints string to lcd, starting at the current cursor position
+ * 	@authorISU
+ *
+ * 	@date 06/26/2012
+ */
+
+void lcd_puts(char * string)
+{
+	while (*string) {
+		lcd_putc(*string++);
+	}
+}
+
+
+/**
+ *	Prints one character at the current cursor position; after the end of a
+ *	line the cursor moves on to the start of the next one
+ * 	@authorISU
+ *
+ * 	@date 06/26/2012
+ */
+
+void lcd_putc(char data)
+{
+	if (cursor < LCD_TOTAL_CHARS)
+	{
+		lcd_set(cursor++, data);
+		lcd_kick();
+	}
+}
+
+
+/**
+ * 	Puts one character of lprintf() output into the frame
+ */
+
+static void lcd_render(unsigned char data)
+{
+	if (data == '\n')
+	{
+		/* fill remainder of line with spaces */
+		while (render < LCD_TOTAL_CHARS) {
+			lcd_set(render++, ' ');
+			if (render % LCD_WIDTH == 0)
+				break;
+		}
+	}
+	else if (render < LCD_TOTAL_CHARS)
+	{
+		lcd_set(render++, data);
+	}
+}
+
+
+/**
+ * 	Print a formatted string to the LCD screen.
+ *	Mimics the C library function printf for writing to the LCD screen.
+ *	Only the cells that differ from the screen are sent to the controller,
+ *	so calling lprintf twice with the same string updates nothing the
+ *	second time.
+ *
+ * 	See stream.h for the conversions in the formatter string.
+ *
+ *	@param format	format of the string to be printed
+ *	@author Kerrick Staley & Chad Nelson
+ *	@date 05/16/2012
+ */
+void lprintf(const char *format, ...)
+{
+	va_list arglist;
+	prof_enter(PROF_LPRINTF);
+	va_start(arglist, format);
+	render = 0;
+	stream_vprintf(lcd_render, format, arglist);
+	va_end(arglist);
+
+	while (render < LCD_TOTAL_CHARS) {
+		lcd_set(render++, ' ');
+	}
+	lcd_kick();
+	prof_exit();
+}
@@ -0,0 +1,133 @@
+/**
+ *	@file link.c
+ *	@brief frames with a sequence number and a CRC on the base-station
+ *	link; see link.h
+ */
+
+#include "link.h"
+
+// what link_parse() expects next
+#define WAIT_START	0
+#define WAIT_TYPE	1
+#define WAIT_SEQ	2
+#define WAIT_LENGTH	3
+#define WAIT_PAYLOAD	4
+#define WAIT_CRC_HIGH	5
+#define WAIT_CRC_LOW	6
+
+/**
+ *	This function adds a byte to a CRC-16/CCITT, bit by bit, which takes
+ *	no table in flash
+ */
+
+uint16_t link_crc(uint16_t crc, unsigned char data)
+{
+	crc ^= (uint16_t) data << 8;
+	for (char i = 0; i < 8; i++)
+	{
+		crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+/**
+ *	This function sends a frame into a sink
+ */
+
+void link_send(stream_sink put, unsigned char type, unsigned char seq, const unsigned char *payload, unsigned char length)
+{
+	uint16_t crc = 0xFFFF;
+	crc = link_crc(crc, type);
+	crc = link_crc(crc, seq);
+	crc = link_crc(crc, length);
+	put(LINK_START);
+	put(type);
+	put(seq);
+	put(length);
+	for (unsigned char i = 0; i < length; i++)
+	{
+		crc = link_crc(crc, payload[i]);
+		put(payload[i]);
+	}
+	put(crc >> 8);
+	put(crc & 0xFF);
+}
+
+/**
+ *	This function takes the next byte received
+ */
+
+int link_parse(struct link_parser *p, unsigned char data)
+{
+	switch (p->state)
+	{
+	case WAIT_START:
+		if (data != LINK_START)
+		{
+			return LINK_BYTE;
+		}
+		p->crc = 0xFFFF;
+		p->state = WAIT_TYPE;
+		return LINK_MORE;
+
+	case WAIT_TYPE:
+		p->frame.type = data;
+		p->state = WAIT_SEQ;
+		break;
+
+	case WAIT_SEQ:
+		p->frame.seq = data;
+		p->state = WAIT_LENGTH;
+		break;
+
+	case WAIT_LENGTH:
+		if (data > LINK_PAYLOAD)
+		{
+			p->errors++;
+			p->state = WAIT_START;
+			return LINK_MORE;
+		}
+		p->frame.length = data;
+		p->got = 0;
+		p->state = data ? WAIT_PAYLOAD : WAIT_CRC_HIGH;
+		break;
+
+	case WAIT_PAYLOAD:
+		p->frame.payload[p->got++] = data;
+		if (p->got == p->frame.length)
+		{
+			p->state = WAIT_CRC_HIGH;
+		}
+		break;
+
+	case WAIT_CRC_HIGH:
+		p->crc ^= (uint16_t) data << 8;
+		p->state = WAIT_CRC_LOW;
+		return LINK_MORE;
+
+	default:
+		p->crc ^= data;
+		p->state = WAIT_START;
+		if (p->crc)
+		{
+			p->errors++;
+			return LINK_MORE;
+		}
+		return LINK_FRAME;
+	}
+	p->crc = link_crc(p->crc, data);
+	return LINK_MORE;
+}
+
+/**
+ *	This function drops the frame being taken in, if any, as an error
+ */
+
+void link_drop(struct link_parser *p)
+{
+	if (p->state != WAIT_START)
+	{
+		p->errors++;
+		p->state = WAIT_START;
+	}
+}
@@ -0,0 +1,125 @@
+/**
+ *	@file link.h
+ *	@brief frames with a sequence number and a CRC on the base-station link
+ *
+ *	Bare keys still work as before; a frame is told apart from them by
+ *	its first byte, which no key uses:
+ *
+ *	LINK_START	1 byte
+ *	type		1 byte, one of the LINK_ types below
+ *	seq		1 byte, counts frames of the type modulo 256
+ *	length		1 byte, of the payload, at most LINK_PAYLOAD
+ *	payload		length bytes
+ *	crc		2 bytes, CRC-16/CCITT of type to payload, high first
+ *
+ *	A frame with a bad CRC or a length out of range is dropped whole. The
+ *	rover also drops a frame whose bytes stop coming for LINK_GAP_MS, so
+ *	that a corrupted length cannot swallow the keys sent after it.
+ *
+ *	Commands go to the rover as LINK_COMMAND frames, whose payload is the
+ *	keys of one command. The rover takes them in order only: a frame is
+ *	queued, all its keys or none, if its seq is the one after the last it
+ *	took and the receive buffer has room for it. Every good frame, taken
+ *	or not, is answered with a LINK_ACK carrying the seq of the last frame
+ *	taken, and the room left in the buffer as its one byte of payload. The
+ *	base station can so have up to LINK_WINDOW commands on their way, and
+ *	sends them all again, from the oldest not yet acknowledged, when no
+ *	acknowledgement comes (go-back-N). LINK_SYNC, with no payload, makes
+ *	its seq the last one taken; the base station starts with one, and
+ *	sends one again when the rover acknowledges a seq it never sent, e.g.
+ *	after a reset.
+ *
+ *	Once the rover has had a good frame, it takes no bare key but the
+ *	stop key until it is reset: a bare byte is then most likely the rest
+ *	of a frame whose LINK_START was lost. The stop key is best sent bare,
+ *	so that it works at once, even while frames before it are being sent
+ *	again.
+ *
+ *	The rover sends its acknowledgements, the LINK_KEYFRAME and
+ *	LINK_SENSORS frames of the sensor feed (feed.h) and the LINK_SWEEP
+ *	frames of sweeps (sweepblock.h) from the main loop, between two of the
+ *	bytes of its text if need be. It never sends LINK_START in its text,
+ *	so the base station can take the frames out of what it reads.
+ */
+
+#ifndef LINK_H
+#define LINK_H
+
+#include <stdint.h>
+#include "stream.h"
+
+/// first byte of every frame
+#define LINK_START	0x02
+/// longest payload; a sensor keyframe (feed.h) is the longest sent
+#define LINK_PAYLOAD	80
+/// commands the base station may have sent and not yet seen acknowledged
+#define LINK_WINDOW	8
+/// longest pause between two bytes of a frame, milliseconds; frames are
+/// sent whole, so a longer one means the rest of it was lost
+#define LINK_GAP_MS	10
+
+#define LINK_COMMAND	'C'
+#define LINK_SYNC	'S'
+#define LINK_ACK	'A'
+#define LINK_KEYFRAME	'K'
+#define LINK_SENSORS	'F'
+#define LINK_SWEEP	'W'
+
+/// what link_parse() made of a byte
+#define LINK_BYTE	-1	// not part of a frame
+#define LINK_MORE	0	// part of a frame still coming in, or of one that was dropped
+#define LINK_FRAME	1	// the last byte of a good frame
+
+struct link_frame{
+	unsigned char type;
+	unsigned char seq;
+	unsigned char length;
+	unsigned char payload[LINK_PAYLOAD];
+};
+
+/// takes frames apart, one byte at a time; zero it to start
+struct link_parser{
+	unsigned char state;		// next field expected, 0 between frames
+	unsigned char got;		// payload bytes so far
+	uint16_t crc;
+	struct link_frame frame;	// the frame, once link_parse() returns LINK_FRAME
+	unsigned int errors;		// frames dropped
+};
+
+/**
+ *	This function adds a byte to a CRC-16/CCITT
+ *	@param crc	CRC so far, 0xFFFF to start
+ *	@param data	the byte
+ *	@return the CRC with the byte
+ */
+
+uint16_t link_crc(uint16_t crc, unsigned char data);
+
+/**
+ *	This function sends a frame into a sink
+ *	@param put	function that takes each byte
+ *	@param type	LINK_ type
+ *	@param seq	sequence number
+ *	@param payload	payload bytes
+ *	@param length	their number, at most LINK_PAYLOAD
+ */
+
+void link_send(stream_sink put, unsigned char type, unsigned char seq, const unsigned char *payload, unsigned char length);
+
+/**
+ *	This function takes the next byte received
+ *	@param p	the parser
+ *	@param data	the byte
+ *	@return LINK_BYTE, LINK_MORE or LINK_FRAME (the frame is then in p->frame)
+ */
+
+int link_parse(struct link_parser *p, unsigned char data);
+
+/**
+ *	This function drops the frame being taken in, if any, as an error
+ *	@param p	the parser
+ */
+
+void link_drop(struct link_parser *p);
+
+#endif
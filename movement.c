@@ -1,383 +1,328 @@
-
-/**
- *	@file movement.c
- *	@brief this file contains all functions related to the movement of the robot
- *
- *	@author Yuixiang Chen
- *
- *	@date 4/12/2015
- */
-
-
-
-#include "open_interface.h"
-#include "util.h"
-
-
-///location variables
-
-int movedangle =0;	/// direction robot is pointing relative to its initial direction 
-int x=0;		/// X coordinate position
-int y=0;		/// Y coordinate position
-double r;		/// Radial distance from initial starting point 
-
-char status[250];	///array used to transmitt the status data of the sensors 
-
-/**
- *	This function turns the robot clockwise a by a defined number of degrees
- *	@author Yuixiang Chen 
- *	@date 4/12/2015
- *	@param sensor	sensor is a struct that contains all sensor data 
- *	@param degrees	number of degrees the robot will turn 
- */
-
-void turn_clockwise(oi_t *sensor, int degrees) { 
-	movedangle -= degrees%360;
-	if (degrees != 180)
-	{
-		degrees = (int) round((double) degrees / 10 * 6);
-	}
-    int sum = degrees;
-    oi_set_wheels(-100, 100); // turn left
-    while (sum > 0) {
-        oi_update(sensor);
-        sum += sensor->angle;
-    }
-    oi_set_wheels(0, 0); // stop
-	sprintf(status, "\n\rLocation: X: %d    Y: %d    R: %.2f    Angle: %d\n\r", x, y, r, movedangle);
-
-	/// transmit the position data
-	for (int i = 0; i < strlen(status); i++)
-	{
-		USART_Transmit(status[i]);
-	}
-	
-}
-
-/**
- *	This function turns the robot counterclockwise a by a defined number of degrees
- *	@author Yuixiang Chen 
- *	@date 4/12/2015
- *	@param sensor	sensor is a struct that contains all sensor data 
- *	@param degrees	number of degrees the robot will turn 
- */
-
-void turn_counterclockwise(oi_t *sensor, int degrees) { 
-	movedangle += degrees;
-	if (degrees != 180)
-	{
-		degrees = (int) round((double) degrees / 10 * 6);
-	}
-    int sum = 0;
-    oi_set_wheels(100, -100); 		// turn right
-    while (sum < degrees) {
-        oi_update(sensor);
-        sum += sensor->angle;
-    }
-    oi_set_wheels(0, 0); 		// stop	
-	
-	sprintf(status, "\n\rLocation: X: %d    Y: %d    R: %.2f    Angle: %d\n\r", x, y, r, movedangle);
-	///transmit position data
-	for (int i = 0; i < strlen(status); i++)
-	{
-		USART_Transmit(status[i]);
-	}
-	
-}
-
-/**
- *	This function moves the robot forward a defined distance. 
- *	@author Yuixiang Chen 
- *	@date 4/12/2015
- *	@param sensor	sensor is a struct that contains all sensor data. 
- *	@param dist	distance the robot will travel in centimeters.
- *	@return 1 if detected a cliff, tape, or bumper; 0 if detected nothing 
- */
-
-int move_forward(oi_t *sensor, int dist) { 
-	dist = dist / 50 * 45 / 2;
-    int sum = 0;
-	int condition = 0;
-    oi_set_wheels(100, 100); 				// move forward; full speed
-    while (sum < dist) {
-        oi_update(sensor);
-        sum += sensor->distance;
-		x+=2 * (int)sensor->distance*cos(movedangle);
-		y+=2 * (int)sensor->distance*sin(movedangle);
-		r=sqrt(pow(x,2)+pow(y,2));
-		condition = checkCondition(sensor);	//check for cliff,tape,bumper	
-		if (condition)	
-		{
-			break;
-		}
-    }
-    oi_set_wheels(0, 0); // stop
-	
-	
-	
-
-	
-	sprintf(status, "\n\rLocation: X: %d    Y: %d    R: %.2f    Angle: %d\n\r", x, y, r, movedangle);
-	///transmit location data
-	for (int i = 0; i < strlen(status); i++)
-	{
-		USART_Transmit(status[i]);			
-	}
-	
-	return condition;
-	
-}
-
-/**
- *	This function moves the robot backward a defined distance. 
- *	@author Yuixiang Chen 
- *	@date 4/12/2015
- *	@param sensor	sensor is a struct that contains all sensor data. 
- *	@param dist	distance the robot will travel in centimeters.
- *	@return 1 if detected a cliff, tape, or bumper; 0 if detected nothing 
- */
-
-void move_backward(oi_t *sensor, int dist) {
-	dist = dist / 50 * 45 / 2;
-	int sum = dist;
-	oi_set_wheels(-100, -100); // move forward; full speed
-	while (sum > 0) {
-		oi_update(sensor);
-		sum += sensor->distance;
-		x+=(int)sensor->distance*cos(movedangle);
-		y+=(int)sensor->distance*sin(movedangle);
-		r=sqrt(pow(x,2)+pow(y,2));
-	}
-	oi_set_wheels(0, 0); // stop
-	
-	sprintf(status, "\n\rLocation: X: %d    Y: %d    R: %.2f    Angle: %d\n\r", x, y, r, movedangle);
-	///transmit location data
-	for (int i = 0; i < strlen(status); i++)
-	{
-		USART_Transmit(status[i]);
-	}	
-}
-
-/**
- *	This function checks all the sensors to detect a cliff, tape, or a bumper 
- *	@author Yuixiang Chen 
- *	@date 4/12/2015
- *	@param sensor	structure that contains all the sensor data
- *	@return  returns 1 if any of the check condition are met or 0 if none. 
- */
-
-int checkCondition(oi_t *sensor){
-	char status[500];
-	int result = 0;
-	
-	oi_update(sensor);
-
-	// hit bumper left
-	if(sensor->bumper_left)
-	{
-		
-		
-	
-		
-		sprintf(status, "\n\rleft bumper!\n\r");
-		for (int i = 0; i < strlen(status); i++)
-		{
-			USART_Transmit(status[i]);
-		}
-		move_backward(sensor, 50);
-		sensor->bumper_left = 0;
-		result = 1;
-	}
-	
-		
-		
-	// hit bumper right	
-	else if(sensor->bumper_right)
-	{
-
-		sprintf(status, "\n\rright bumper!\n\r");
-		for (int i = 0; i < strlen(status); i++)
-		{
-			USART_Transmit(status[i]);
-		}
-		move_backward(sensor, 50);
-		result = 1;
-	}
-		
-		
-		
-		
-	// left side went into cliff
-	else if(sensor->cliff_left)
-	{
-		sprintf(status, "\n\rleft cliff!\n\r");
-		for (int i = 0; i < strlen(status); i++)
-		{
-			USART_Transmit(status[i]);
-		}
-		move_backward(sensor, 50);
-		result = 1;
-	}
-		
-		
-	// right side went into cliff	
-	else if(sensor->cliff_right)
-	{
-		sprintf(status, "\n\rright cliff!\n\r");
-		for (int i = 0; i < strlen(status); i++)
-		{
-			USART_Transmit(status[i]);
-		}
-		move_backward(sensor, 50);
-		result = 1;
-	}
-		
-
-	// front left side went into cliff
-	else if(sensor->cliff_frontleft)
-	{
-		sprintf(status, "\n\rfront left cliff!\n\r");
-		for (int i = 0; i < strlen(status); i++)
-		{
-			USART_Transmit(status[i]);
-		}
-		move_backward(sensor, 50);
-		result = 1;
-	}
-		
-		
-	// front right side went into cliff	
-	else if(sensor->cliff_frontright)
-	{
-		sprintf(status, "\n\rfront right cliff!\n\r");
-		for (int i = 0; i < strlen(status); i++)
-		{
-			USART_Transmit(status[i]);
-		}
-		move_backward(sensor, 50);
-		result = 1;
-	}
-		
-		
-	// left side run over white tape
-	else if(sensor->cliff_left_signal > 280 && sensor->cliff_left_signal < 370)
-	{
-		sprintf(status, "\n\rleft cliff: white tape!\n\rBump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor->bumper_left, sensor->bumper_right, sensor->cliff_left, sensor->cliff_frontleft, sensor->cliff_frontright, sensor->cliff_right, sensor->cliff_left_signal, sensor->cliff_frontleft_signal, sensor->cliff_frontright_signal, sensor->cliff_right_signal);
-
-		for (int i = 0; i < strlen(status); i++)
-		{
-			USART_Transmit(status[i]);
-		}
-		move_backward(sensor, 50);
-		result = 1;
-	}
-		
-		
-	// right side run over white tape	
-	else if(sensor->cliff_right_signal > 500 && sensor->cliff_right_signal < 600)
-	{
-		sprintf(status, "\n\tright cliff: white tape!\n\rBump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor->bumper_left, sensor->bumper_right, sensor->cliff_left, sensor->cliff_frontleft, sensor->cliff_frontright, sensor->cliff_right, sensor->cliff_left_signal, sensor->cliff_frontleft_signal, sensor->cliff_frontright_signal, sensor->cliff_right_signal);
-
-		for (int i = 0; i < strlen(status); i++)
-		{
-			USART_Transmit(status[i]);
-		}
-		move_backward(sensor, 50);
-		result = 1;
-	}
-		
-		
-	// front left side run over white tape
-	else if(sensor->cliff_frontleft_signal > 650 && sensor->cliff_frontleft_signal < 780)
-	{
-
-		sprintf(status, "\n\rfront left cliff: white tape!\n\rBump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor->bumper_left, sensor->bumper_right, sensor->cliff_left, sensor->cliff_frontleft, sensor->cliff_frontright, sensor->cliff_right, sensor->cliff_left_signal, sensor->cliff_frontleft_signal, sensor->cliff_frontright_signal, sensor->cliff_right_signal);
-
-		for (int i = 0; i < strlen(status); i++)
-		{
-			USART_Transmit(status[i]);
-		}
-		move_backward(sensor, 50);
-		result = 1;
-	}
-		
-		
-	// front right side run over white tape	
-	else if(sensor->cliff_frontright_signal > 200 && sensor->cliff_frontright_signal < 250)
-	{
-		sprintf(status, "\n\rfront right cliff: white tape!\n\rBump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor->bumper_left, sensor->bumper_right, sensor->cliff_left, sensor->cliff_frontleft, sensor->cliff_frontright, sensor->cliff_right, sensor->cliff_left_signal, sensor->cliff_frontleft_signal, sensor->cliff_frontright_signal, sensor->cliff_right_signal);
-
-		for (int i = 0; i < strlen(status); i++)
-		{
-			USART_Transmit(status[i]);
-		}
-		move_backward(sensor, 50);
-		result = 1;
-	}
-		
-		
-		
-		
-		
-		
-	// At Destination		
-	else if(sensor->cliff_left_signal > 500 && sensor->cliff_left_signal < 650)
-	{
-		sprintf(status, "\n\rL_Destination!\n\rBump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor->bumper_left, sensor->bumper_right, sensor->cliff_left, sensor->cliff_frontleft, sensor->cliff_frontright, sensor->cliff_right, sensor->cliff_left_signal, sensor->cliff_frontleft_signal, sensor->cliff_frontright_signal, sensor->cliff_right_signal);
-
-		for (int i = 0; i < strlen(status); i++)
-		{
-			USART_Transmit(status[i]);
-		}
-		oi_set_wheels(0, 0); // stop
-		result = 1;
-	}
-		
-		
-		
-		
-		
-	// At Destination
-	else if(sensor->cliff_right_signal > 800 && sensor->cliff_right_signal < 950)
-	{
-		sprintf(status, "\n\rR_Destination!\n\rBump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor->bumper_left, sensor->bumper_right, sensor->cliff_left, sensor->cliff_frontleft, sensor->cliff_frontright, sensor->cliff_right, sensor->cliff_left_signal, sensor->cliff_frontleft_signal, sensor->cliff_frontright_signal, sensor->cliff_right_signal);
-
-		for (int i = 0; i < strlen(status); i++)
-		{
-			USART_Transmit(status[i]);
-		}
-		oi_set_wheels(0, 0); // stop
-		result = 1;
-	}
-		
-		
-	// At Destination		
-	else if(sensor->cliff_frontleft_signal > 1000 && sensor->cliff_frontleft_signal < 1420)
-	{
-		sprintf(status, "\n\rFL_Destination!\n\rBump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor->bumper_left, sensor->bumper_right, sensor->cliff_left, sensor->cliff_frontleft, sensor->cliff_frontright, sensor->cliff_right, sensor->cliff_left_signal, sensor->cliff_frontleft_signal, sensor->cliff_frontright_signal, sensor->cliff_right_signal);
-
-		for (int i = 0; i < strlen(status); i++)
-		{
-			USART_Transmit(status[i]);
-		}
-		oi_set_wheels(0, 0); // stop
-		result = 1;
-	}
-		
-		
-	// At Destination
-	else if(sensor->cliff_frontright_signal > 300 && sensor->cliff_frontleft_signal < 400)
-	{
-		sprintf(status, "\n\rFR_Destination!\n\rBump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor->bumper_left, sensor->bumper_right, sensor->cliff_left, sensor->cliff_frontleft, sensor->cliff_frontright, sensor->cliff_right, sensor->cliff_left_signal, sensor->cliff_frontleft_signal, sensor->cliff_frontright_signal, sensor->cliff_right_signal);
-
-		for (int i = 0; i < strlen(status); i++)
-		{
-			USART_Transmit(status[i]);
-		}
-		oi_set_wheels(0, 0); // stop
-		result = 1;
-	}
-
-
-	return result;
-}
+
+/**
+ *	@file movement.c
+ *	@brief this file contains all functions related to the movement of the robot
+ *
+ *	@author Yuixiang Chen
+ *
+ *	@date 4/12/2015
+ */
+
+
+
+#include "open_interface.h"
+#include "fixmath.h"
+#include "util.h"
+#include "movement.h"
+#include "calibrate.h"
+#include "thresholds.h"
+#include "params.h"
+#include "profile.h"
+
+
+///location variables
+
+HAL_LOCAL int movedangle =0;	/// direction robot is pointing relative to its initial direction 
+HAL_LOCAL int x=0;		/// X coordinate position in millimeters
+HAL_LOCAL int y=0;		/// Y coordinate position in millimeters
+HAL_LOCAL int r;			/// Radial distance from initial starting point 
+
+/**
+ *	This function adds the distance of the last sensor update to the robot's position
+ *	@param sensor	sensor is a struct that contains all sensor data
+ */
+
+void update_position(oi_t *sensor) {
+	x+=(int) q16_to_int((int32_t) sensor->distance * q16_cos(q16_from_int(movedangle)));
+	y+=(int) q16_to_int((int32_t) sensor->distance * q16_sin(q16_from_int(movedangle)));
+	r=isqrt32((int32_t) x*x + (int32_t) y*y);
+}
+
+/**
+ *	This function turns the robot clockwise a by a defined number of degrees
+ *	@author Yuixiang Chen 
+ *	@date 4/12/2015
+ *	@param sensor	sensor is a struct that contains all sensor data 
+ *	@param degrees	number of degrees the robot will turn 
+ */
+
+void turn_clockwise(oi_t *sensor, int degrees) { 
+	int target = motion_target(CAL_CLOCKWISE, params.turn_speed, degrees);
+    int sum = target;
+    oi_set_wheels(-params.turn_speed, params.turn_speed); // turn left
+    while (sum > 0 && !abort_requested()) {
+        oi_update(sensor);
+        sum += sensor->angle;
+    }
+    oi_set_wheels(0, 0); // stop
+	if (sum > 0 && target > 0)
+	{
+		degrees = (int) ((long) degrees * (target - sum) / target);	//stopped early
+	}
+	movedangle -= degrees%360;
+	uprintf("\n\rLocation: X: %d    Y: %d    R: %d    Angle: %d\n\r", x, y, r, movedangle);
+	
+}
+
+/**
+ *	This function turns the robot counterclockwise a by a defined number of degrees
+ *	@author Yuixiang Chen 
+ *	@date 4/12/2015
+ *	@param sensor	sensor is a struct that contains all sensor data 
+ *	@param degrees	number of degrees the robot will turn 
+ */
+
+void turn_counterclockwise(oi_t *sensor, int degrees) { 
+	int target = motion_target(CAL_COUNTERCLOCKWISE, params.turn_speed, degrees);
+    int sum = 0;
+    oi_set_wheels(params.turn_speed, -params.turn_speed); 		// turn right
+    while (sum < target && !abort_requested()) {
+        oi_update(sensor);
+        sum += sensor->angle;
+    }
+    oi_set_wheels(0, 0); 		// stop	
+	if (sum < target)
+	{
+		degrees = (int) ((long) degrees * sum / target);	//stopped early
+	}
+	movedangle += degrees;
+	
+	uprintf("\n\rLocation: X: %d    Y: %d    R: %d    Angle: %d\n\r", x, y, r, movedangle);
+	
+}
+
+/**
+ *	This function moves the robot forward a defined distance. 
+ *	@author Yuixiang Chen 
+ *	@date 4/12/2015
+ *	@param sensor	sensor is a struct that contains all sensor data. 
+ *	@param dist	distance the robot will travel in millimeters.
+ *	@return CONDITION_LEFT or CONDITION_RIGHT if detected a cliff, tape, or bumper; CONDITION_ABORT if stopped by the operator; 0 if detected nothing 
+ */
+
+int move_forward(oi_t *sensor, int dist) { 
+	dist = motion_target(CAL_FORWARD, params.drive_speed, dist);
+    int sum = 0;
+	int condition = 0;
+    oi_set_wheels(params.drive_speed, params.drive_speed); 	// move forward
+    while (sum < dist) {
+		if (abort_requested())
+		{
+			condition = CONDITION_ABORT;
+			break;
+		}
+        oi_update(sensor);
+        sum += sensor->distance;
+		update_position(sensor);
+		condition = checkSensors(sensor);	//check for cliff,tape,bumper	
+		if (condition)	
+		{
+			break;
+		}
+    }
+    oi_set_wheels(0, 0); // stop
+	
+	
+	
+
+	
+	uprintf("\n\rLocation: X: %d    Y: %d    R: %d    Angle: %d\n\r", x, y, r, movedangle);
+	
+	return condition;
+	
+}
+
+/**
+ *	This function moves the robot backward a defined distance. 
+ *	@author Yuixiang Chen 
+ *	@date 4/12/2015
+ *	@param sensor	sensor is a struct that contains all sensor data. 
+ *	@param dist	distance the robot will travel in millimeters.
+ *	@return 1 if detected a cliff, tape, or bumper; 0 if detected nothing 
+ */
+
+void move_backward(oi_t *sensor, int dist) {
+	dist = motion_target(CAL_BACKWARD, params.drive_speed, dist);
+	int sum = dist;
+	oi_set_wheels(-params.drive_speed, -params.drive_speed); // move backward
+	while (sum > 0 && !abort_requested()) {
+		oi_update(sensor);
+		sum += sensor->distance;
+		update_position(sensor);
+	}
+	oi_set_wheels(0, 0); // stop
+	
+	uprintf("\n\rLocation: X: %d    Y: %d    R: %d    Angle: %d\n\r", x, y, r, movedangle);	
+}
+
+/**
+ *	This function checks all the sensors to detect a cliff, tape, or a bumper 
+ *	@author Yuixiang Chen 
+ *	@date 4/12/2015
+ *	@param sensor	structure that contains all the sensor data
+ *	@return  returns CONDITION_LEFT or CONDITION_RIGHT if any of the check condition are met or 0 if none. 
+ */
+
+int checkCondition(oi_t *sensor){
+	prof_enter(PROF_CHECK_CONDITION);
+	oi_update(sensor);
+	int result = checkSensors(sensor);
+	prof_exit();
+	return result;
+}
+
+/**
+ *	This function checks the last sensor update for a cliff, tape, a bumper or the destination
+ *	without polling the robot again
+ *	@param sensor	structure that contains all the sensor data
+ *	@return CONDITION_LEFT or CONDITION_RIGHT for the side that detected something, or 0 if none.
+ */
+
+int checkSensors(oi_t *sensor){
+	int result = 0;
+
+	// hit bumper left
+	if(sensor->bumper_left)
+	{
+		
+		
+	
+		
+		uprintf("\n\rleft bumper!\n\r");
+		move_backward(sensor, 50);
+		sensor->bumper_left = 0;
+		result = CONDITION_LEFT;
+	}
+	
+		
+		
+	// hit bumper right	
+	else if(sensor->bumper_right)
+	{
+
+		uprintf("\n\rright bumper!\n\r");
+		move_backward(sensor, 50);
+		result = CONDITION_RIGHT;
+	}
+		
+		
+		
+		
+	// left side went into cliff
+	else if(sensor->cliff_left)
+	{
+		uprintf("\n\rleft cliff!\n\r");
+		move_backward(sensor, 50);
+		result = CONDITION_LEFT;
+	}
+		
+		
+	// right side went into cliff	
+	else if(sensor->cliff_right)
+	{
+		uprintf("\n\rright cliff!\n\r");
+		move_backward(sensor, 50);
+		result = CONDITION_RIGHT;
+	}
+		
+
+	// front left side went into cliff
+	else if(sensor->cliff_frontleft)
+	{
+		uprintf("\n\rfront left cliff!\n\r");
+		move_backward(sensor, 50);
+		result = CONDITION_LEFT;
+	}
+		
+		
+	// front right side went into cliff	
+	else if(sensor->cliff_frontright)
+	{
+		uprintf("\n\rfront right cliff!\n\r");
+		move_backward(sensor, 50);
+		result = CONDITION_RIGHT;
+	}
+		
+		
+	// left side run over white tape
+	else if(in_band(&thresholds.tape[SENSE_LEFT], sensor->cliff_left_signal))
+	{
+		uprintf("\n\rleft cliff: white tape!\n\rBump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor->bumper_left, sensor->bumper_right, sensor->cliff_left, sensor->cliff_frontleft, sensor->cliff_frontright, sensor->cliff_right, sensor->cliff_left_signal, sensor->cliff_frontleft_signal, sensor->cliff_frontright_signal, sensor->cliff_right_signal);
+		move_backward(sensor, 50);
+		result = CONDITION_LEFT;
+	}
+		
+		
+	// right side run over white tape	
+	else if(in_band(&thresholds.tape[SENSE_RIGHT], sensor->cliff_right_signal))
+	{
+		uprintf("\n\tright cliff: white tape!\n\rBump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor->bumper_left, sensor->bumper_right, sensor->cliff_left, sensor->cliff_frontleft, sensor->cliff_frontright, sensor->cliff_right, sensor->cliff_left_signal, sensor->cliff_frontleft_signal, sensor->cliff_frontright_signal, sensor->cliff_right_signal);
+		move_backward(sensor, 50);
+		result = CONDITION_RIGHT;
+	}
+		
+		
+	// front left side run over white tape
+	else if(in_band(&thresholds.tape[SENSE_FRONTLEFT], sensor->cliff_frontleft_signal))
+	{
+
+		uprintf("\n\rfront left cliff: white tape!\n\rBump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor->bumper_left, sensor->bumper_right, sensor->cliff_left, sensor->cliff_frontleft, sensor->cliff_frontright, sensor->cliff_right, sensor->cliff_left_signal, sensor->cliff_frontleft_signal, sensor->cliff_frontright_signal, sensor->cliff_right_signal);
+		move_backward(sensor, 50);
+		result = CONDITION_LEFT;
+	}
+		
+		
+	// front right side run over white tape	
+	else if(in_band(&thresholds.tape[SENSE_FRONTRIGHT], sensor->cliff_frontright_signal))
+	{
+		uprintf("\n\rfront right cliff: white tape!\n\rBump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor->bumper_left, sensor->bumper_right, sensor->cliff_left, sensor->cliff_frontleft, sensor->cliff_frontright, sensor->cliff_right, sensor->cliff_left_signal, sensor->cliff_frontleft_signal, sensor->cliff_frontright_signal, sensor->cliff_right_signal);
+		move_backward(sensor, 50);
+		result = CONDITION_RIGHT;
+	}
+		
+		
+		
+		
+		
+		
+	// At Destination		
+	else if(in_band(&thresholds.dest[SENSE_LEFT], sensor->cliff_left_signal))
+	{
+		uprintf("\n\rL_Destination!\n\rBump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor->bumper_left, sensor->bumper_right, sensor->cliff_left, sensor->cliff_frontleft, sensor->cliff_frontright, sensor->cliff_right, sensor->cliff_left_signal, sensor->cliff_frontleft_signal, sensor->cliff_frontright_signal, sensor->cliff_right_signal);
+		oi_set_wheels(0, 0); // stop
+		result = CONDITION_LEFT;
+	}
+		
+		
+		
+		
+		
+	// At Destination
+	else if(in_band(&thresholds.dest[SENSE_RIGHT], sensor->cliff_right_signal))
+	{
+		uprintf("\n\rR_Destination!\n\rBump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor->bumper_left, sensor->bumper_right, sensor->cliff_left, sensor->cliff_frontleft, sensor->cliff_frontright, sensor->cliff_right, sensor->cliff_left_signal, sensor->cliff_frontleft_signal, sensor->cliff_frontright_signal, sensor->cliff_right_signal);
+		oi_set_wheels(0, 0); // stop
+		result = CONDITION_RIGHT;
+	}
+		
+		
+	// At Destination		
+	else if(in_band(&thresholds.dest[SENSE_FRONTLEFT], sensor->cliff_frontleft_signal))
+	{
+		uprintf("\n\rFL_Destination!\n\rBump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor->bumper_left, sensor->bumper_right, sensor->cliff_left, sensor->cliff_frontleft, sensor->cliff_frontright, sensor->cliff_right, sensor->cliff_left_signal, sensor->cliff_frontleft_signal, sensor->cliff_frontright_signal, sensor->cliff_right_signal);
+		oi_set_wheels(0, 0); // stop
+		result = CONDITION_LEFT;
+	}
+		
+		
+	// At Destination
+	else if(in_band(&thresholds.dest[SENSE_FRONTRIGHT], sensor->cliff_frontright_signal))
+	{
+		uprintf("\n\rFR_Destination!\n\rBump Sensor( Left: %d   Right: %d)\n\rCliff Sensors(Left: %d   Front left: %d   Front right: %d   Right: %d)\n\rCliff Sensor Signals(Left: %d   Left Front: %d   Right Front: %d   Right: %d\n\r", sensor->bumper_left, sensor->bumper_right, sensor->cliff_left, sensor->cliff_frontleft, sensor->cliff_frontright, sensor->cliff_right, sensor->cliff_left_signal, sensor->cliff_frontleft_signal, sensor->cliff_frontright_signal, sensor->cliff_right_signal);
+		oi_set_wheels(0, 0); // stop
+		result = CONDITION_RIGHT;
+	}
+
+
+	return result;
+}
@@ -1,64 +1,102 @@
-
-/**
- *	@file movement.h
- *	@brief this is the header file that contains the functions 
- *	related to the movement of the robot
- *
- *	@author Yuixiang Chen
- *
- *	@date 4/12/2015
- */
-
-#include "open_interface.h"
-
-/**
- *	This function turns the robot clockwise a by a defined number of degrees
- *	@author Yuixiang Chen 
- *	@date 4/12/2015
- *	@param sensor	sensor is a struct that contains all sensor data 
- *	@param degrees	number of degrees the robot will turn 
- */
-
-void turn_clockwise(oi_t *sensor, int degrees);
-
-/**
- *	This function turns the robot counterclockwise a by a defined number of degrees
- *	@author Yuixiang Chen 
- *	@date 4/12/2015
- *	@param sensor	sensor is a struct that contains all sensor data 
- *	@param degrees	number of degrees the robot will turn 
- */
-
-void turn_counterclockwise(oi_t *sensor, int degrees);
-
-/**
- *	This function moves the robot forward a defined distance. 
- *	@author Yuixiang Chen 
- *	@date 4/12/2015
- *	@param sensor	sensor is a struct that contains all sensor data. 
- *	@param dist	distance the robot will travel in centimeters.
- *	@return 1 if detected a cliff, tape, or bumper; 0 if detected nothing 
- */
-
-int move_forward(oi_t *sensor, int dist);
-
-/**
- *	This function moves the robot backward a defined distance. 
- *	@author Yuixiang Chen 
- *	@date 4/12/2015
- *	@param sensor	sensor is a struct that contains all sensor data. 
- *	@param dist	distance the robot will travel in centimeters.
- *	@return 1 if detected a cliff, tape, or bumper; 0 if detected nothing 
- */
-
-void move_backward(oi_t *sensor, int dist);
-
-/**
- *	This function checks all the sensors to detect a cliff, tape, or a bumper 
- *	@author Yuixiang Chen 
- *	@date 4/12/2015
- *	@param sensor	structure that contains all the sensor data
- *	@return  returns 1 if any of the check condition are met or 0 if none. 
- */
-
-int checkCondition(oi_t *sensor);
+
+/**
+ *	@file movement.h
+ *	@brief this is the header file that contains the functions 
+ *	related to the movement of the robot
+ *
+ *	@author Yuixiang Chen
+ *
+ *	@date 4/12/2015
+ */
+
+#ifndef MOVEMENT_H
+#define MOVEMENT_H
+
+#include "hal.h"
+#include "open_interface.h"
+
+/// direction robot is pointing relative to its initial direction, in degrees (counterclockwise positive)
+extern HAL_LOCAL int movedangle;
+/// X coordinate position in millimeters along the initial direction
+extern HAL_LOCAL int x;
+/// Y coordinate position in millimeters to the left of the initial direction
+extern HAL_LOCAL int y;
+/// distance from the starting point in millimeters
+extern HAL_LOCAL int r;
+
+/// checkCondition() result when the left or front left sensors detected something
+#define CONDITION_LEFT	1
+/// checkCondition() result when the right or front right sensors detected something
+#define CONDITION_RIGHT	2
+/// move_forward() result when the operator pressed the stop key
+#define CONDITION_ABORT	3
+
+/**
+ *	This function turns the robot clockwise a by a defined number of degrees
+ *	@author Yuixiang Chen 
+ *	@date 4/12/2015
+ *	@param sensor	sensor is a struct that contains all sensor data 
+ *	@param degrees	number of degrees the robot will turn 
+ */
+
+void turn_clockwise(oi_t *sensor, int degrees);
+
+/**
+ *	This function turns the robot counterclockwise a by a defined number of degrees
+ *	@author Yuixiang Chen 
+ *	@date 4/12/2015
+ *	@param sensor	sensor is a struct that contains all sensor data 
+ *	@param degrees	number of degrees the robot will turn 
+ */
+
+void turn_counterclockwise(oi_t *sensor, int degrees);
+
+/**
+ *	This function moves the robot forward a defined distance. 
+ *	@author Yuixiang Chen 
+ *	@date 4/12/2015
+ *	@param sensor	sensor is a struct that contains all sensor data. 
+ *	@param dist	distance the robot will travel in millimeters.
+ *	@return CONDITION_LEFT or CONDITION_RIGHT if detected a cliff, tape, or bumper; CONDITION_ABORT if stopped by the operator; 0 if detected nothing 
+ */
+
+int move_forward(oi_t *sensor, int dist);
+
+/**
+ *	This function moves the robot backward a defined distance. 
+ *	@author Yuixiang Chen 
+ *	@date 4/12/2015
+ *	@param sensor	sensor is a struct that contains all sensor data. 
+ *	@param dist	distance the robot will travel in millimeters.
+ *	@return 1 if detected a cliff, tape, or bumper; 0 if detected nothing 
+ */
+
+void move_backward(oi_t *sensor, int dist);
+
+/**
+ *	This function checks all the sensors to detect a cliff, tape, or a bumper 
+ *	@author Yuixiang Chen 
+ *	@date 4/12/2015
+ *	@param sensor	structure that contains all the sensor data
+ *	@return  returns CONDITION_LEFT or CONDITION_RIGHT if any of the check condition are met or 0 if none. 
+ */
+
+int checkCondition(oi_t *sensor);
+
+/**
+ *	This function checks the last sensor update for a cliff, tape, a bumper or the destination
+ *	without polling the robot again
+ *	@param sensor	structure that contains all the sensor data
+ *	@return CONDITION_LEFT or CONDITION_RIGHT for the side that detected something, or 0 if none.
+ */
+
+int checkSensors(oi_t *sensor);
+
+/**
+ *	This function adds the distance of the last sensor update to the robot's position
+ *	@param sensor	sensor is a struct that contains all sensor data
+ */
+
+void update_position(oi_t *sensor);
+
+#endif
@@ -1,58 +1,301 @@
-
-/**
- * 	@file music.c
- *	@brief this file contains the functions that flash the LEDs 
- *	and play music from the robot
- *
- *	@author	Cheng Song
- *
- *	@date 4/12/2015
- */
-
-#include "open_interface.h"
-
-/**
- * 	this function flashes the LEDs on the robot 
- * 	@author Cheng Song
- * 	@date 4/12/2015
- */
-
-void flashLED(){
-
-	for(int i=0;i<5;i++){
-		for (int j = 0; j<256; j++)
-		{
-			oi_set_leds(0,0,256-j,j);
-			wait_ms(5);
-		}
-		for (int j = 255; j>=0; j--)
-		{
-			oi_set_leds(0,0,256-j,j);
-			wait_ms(5);
-		}
-	}
-}
-
-/**
- * 	This function plays the music from the robot
- * 	@author Cheng Song 
- * 	@date 4/12/2015
- */
-
-
-void play_song(){
-	// Notes: oi_load_song takes four arguments
-	// Integer from 0 to 16 identifying this song
-	// Integer that indicates the number of notes in the song (if greater than 16, it will consume the next song index's storage space)
-	// For a note sheet, see page 12 of the iRobot Creat Open Interface datasheet
-	
-	unsigned char mario1NumNotes = 0;
-	unsigned char musicalnote[]    = {48, 60, 45, 57, 46, 58,  0, 48, 60, 45, 57, 46, 58,  0, 41, 53, 38, 50, 39, 51,  0, 41, 53, 38, 50, 39, 51,  0, 51, 50, 49, 48, 51, 50, 44, 43, 49, 48, 54, 53, 52, 58, 57, 56, 51, 47, 46, 45, 44 };
-	unsigned char period[] = {12, 12, 12, 12, 12, 12, 62, 12, 12, 12, 12, 12, 12, 62, 12, 12, 12, 12, 12, 12, 62, 12, 12, 12, 12, 12, 12, 48,  8,  8,  8, 24, 24, 24, 24, 24, 24,  8,  8,  8,  8,  8,  8, 16, 16, 16, 16, 16, 16 };
-
-	oi_load_song(0, 49, musicalnote, period);
-	
-	oi_play_song(0);
-	flashLED();
-}
-
+/**
+ * 	@file music.c
+ *	@brief this file contains the functions that flash the LEDs
+ *	and play music from the robot
+ *
+ *	Two timers drive the Create: one steps the LED effect every
+ *	LED_STEP_MS, the other asks for the next 16-note part of a song when
+ *	the part before it has finished. They run in the Timer2 interrupt, where the
+ *	Create's serial line may be in the middle of another command, so they
+ *	only leave the command to send; music_poll() sends it from the main
+ *	program. An LED command goes out only when the LEDs change.
+ *
+ *	@author	Cheng Song
+ *
+ *	@date 4/12/2015
+ */
+
+#include "hal.h"
+#include "open_interface.h"
+#include "timebase.h"
+#include "music.h"
+
+/// how often the LED effect moves on, in milliseconds
+#define LED_STEP_MS 50
+
+/// most notes the Create keeps in one song slot
+#define SLOT_NOTES 16
+
+// what the timers left for music_poll() to send
+#define PENDING_LEDS	1
+#define PENDING_PLAY	2
+
+/// one song and the slots it is kept in
+struct song{
+	unsigned char slot;		// first song slot
+	unsigned char length;		// notes
+	const unsigned char *notes;
+	const unsigned char *durations;	// in 1/64 s
+};
+
+// For a note sheet, see page 12 of the iRobot Creat Open Interface datasheet
+static const unsigned char mario_notes[]     = {48, 60, 45, 57, 46, 58,  0, 48, 60, 45, 57, 46, 58,  0, 41, 53, 38, 50, 39, 51,  0, 41, 53, 38, 50, 39, 51,  0, 51, 50, 49, 48, 51, 50, 44, 43, 49, 48, 54, 53, 52, 58, 57, 56, 51, 47, 46, 45, 44 };
+static const unsigned char mario_durations[] = {12, 12, 12, 12, 12, 12, 62, 12, 12, 12, 12, 12, 12, 62, 12, 12, 12, 12, 12, 12, 62, 12, 12, 12, 12, 12, 12, 48,  8,  8,  8, 24, 24, 24, 24, 24, 24,  8,  8,  8,  8,  8,  8, 16, 16, 16, 16, 16, 16 };
+
+static const struct song songs[] = {
+	{MARIO_UNDERWORLD, sizeof(mario_notes), mario_notes, mario_durations},
+};
+
+static const struct led_key celebrate_keys[] = {
+	{0, 255, 0}, {1280, 0, 255}, {2560, 255, 0},
+};
+const struct led_effect led_celebrate = {celebrate_keys, 3, 5};
+
+static const struct led_key searching_keys[] = {
+	{0, 128, 32}, {1000, 128, 255}, {2000, 128, 32},
+};
+const struct led_effect led_searching = {searching_keys, 3, 0};
+
+static HAL_LOCAL char loaded;				// songs are on the Create
+static HAL_LOCAL struct timer led_timer;
+static HAL_LOCAL struct timer song_timer;
+static HAL_LOCAL const struct led_effect *volatile effect;	// effect playing, 0 if none
+static HAL_LOCAL unsigned int effect_time;		// milliseconds into the current pass
+static HAL_LOCAL unsigned char effect_pass;
+static HAL_LOCAL const struct song *volatile song;	// song playing, 0 if none
+static HAL_LOCAL unsigned char song_part;			// part of it started last
+
+static HAL_LOCAL volatile unsigned char pending;		// PENDING_ bits
+static HAL_LOCAL volatile unsigned char pending_lights;	// play and advance LEDs on
+static HAL_LOCAL volatile unsigned char pending_color;
+static HAL_LOCAL volatile unsigned char pending_intensity;
+static HAL_LOCAL volatile unsigned char pending_slot;
+static HAL_LOCAL unsigned char sent_lights = 0xFF, sent_color, sent_intensity;
+
+/**
+ * 	Leaves an LEDs command for music_poll()
+ */
+
+static void post_leds(unsigned char lights, unsigned char color, unsigned char intensity)
+{
+	unsigned char state = hal_interrupts_disable();
+	pending_lights = lights;
+	pending_color = color;
+	pending_intensity = intensity;
+	pending |= PENDING_LEDS;
+	hal_interrupts_restore(state);
+}
+
+/**
+ * 	Moves the LED effect on by one step; runs from the Timer2 interrupt
+ */
+
+static void led_step(void *arg)
+{
+	const struct led_key *keys = effect->keys;
+	unsigned char last = effect->count - 1;
+
+	effect_time += LED_STEP_MS;
+	if (effect_time >= keys[last].at)
+	{
+		effect_time -= keys[last].at;
+		effect_pass++;
+		if (effect->passes && effect_pass >= effect->passes)
+		{
+			post_leds(0, keys[last].color, keys[last].intensity);
+			timer_stop(&led_timer);
+			effect = 0;
+			return;
+		}
+	}
+
+	unsigned char k = 0;
+	while (k + 1 < last && effect_time >= keys[k + 1].at)
+	{
+		k++;
+	}
+	long span = keys[k + 1].at - keys[k].at;
+	long into = effect_time - keys[k].at;
+	post_leds(0, keys[k].color + (keys[k + 1].color - keys[k].color) * into / span,
+		keys[k].intensity + (keys[k + 1].intensity - keys[k].intensity) * into / span);
+}
+
+/**
+ * 	Length of one part of a song in milliseconds
+ */
+
+static unsigned int part_ms(const struct song *s, unsigned char part)
+{
+	unsigned int ticks = 0;
+	for (unsigned char i = part * SLOT_NOTES; i < s->length && i < (part + 1) * SLOT_NOTES; i++)
+	{
+		ticks += s->durations[i];
+	}
+	return (ticks * 1000UL + 63) / 64;
+}
+
+/**
+ * 	Asks for the next part of the song once the last one has finished;
+ * 	runs from the Timer2 interrupt
+ */
+
+static void song_step(void *arg)
+{
+	song_part++;
+	if (song_part * SLOT_NOTES >= song->length)
+	{
+		song = 0;
+		return;
+	}
+	pending_slot = song->slot + song_part;
+	pending |= PENDING_PLAY;
+}
+
+/**
+ * 	Uploads the songs, each in as many 16-note slots as it needs
+ */
+
+void music_init(void)
+{
+	if (loaded)
+	{
+		return;
+	}
+	for (unsigned char i = 0; i < sizeof(songs) / sizeof(songs[0]); i++)
+	{
+		for (unsigned char first = 0; first < songs[i].length; first += SLOT_NOTES)
+		{
+			unsigned char notes = songs[i].length - first;
+			if (notes > SLOT_NOTES)
+			{
+				notes = SLOT_NOTES;
+			}
+			oi_load_song(songs[i].slot + first / SLOT_NOTES, notes,
+				(unsigned char *) songs[i].notes + first, (unsigned char *) songs[i].durations + first);
+		}
+	}
+	loaded = 1;
+}
+
+/**
+ * 	Uploads the songs again
+ */
+
+void music_reload(void)
+{
+	loaded = 0;
+	music_init();
+}
+
+/**
+ * 	Starts a song in the background
+ */
+
+void music_play(unsigned char number)
+{
+	for (unsigned char i = 0; i < sizeof(songs) / sizeof(songs[0]); i++)
+	{
+		if (songs[i].slot == number)
+		{
+			music_init();
+			timer_stop(&song_timer);
+			unsigned char state = hal_interrupts_disable();
+			song = &songs[i];
+			song_part = 0;
+			pending_slot = number;
+			pending |= PENDING_PLAY;
+			hal_interrupts_restore(state);
+		}
+	}
+}
+
+/**
+ * 	Starts an LED effect in the background
+ */
+
+void led_play(const struct led_effect *next)
+{
+	timer_stop(&led_timer);
+	effect = next;
+	effect_time = 0;
+	effect_pass = 0;
+	post_leds(0, next->keys[0].color, next->keys[0].intensity);
+	timer_start(&led_timer, LED_STEP_MS, LED_STEP_MS, led_step, 0);
+}
+
+/**
+ * 	Stops the LED effect
+ */
+
+void led_stop(void)
+{
+	timer_stop(&led_timer);
+	effect = 0;
+	post_leds(1, 7, 255);
+}
+
+/**
+ * 	Sends what the timers left since the last call
+ */
+
+void music_poll(void)
+{
+	unsigned char state = hal_interrupts_disable();
+	unsigned char todo = pending;
+	unsigned char lights = pending_lights;
+	unsigned char color = pending_color;
+	unsigned char intensity = pending_intensity;
+	unsigned char slot = pending_slot;
+	pending = 0;
+	hal_interrupts_restore(state);
+
+	if (todo & PENDING_PLAY)
+	{
+		//the Create ignores a song started before the last has finished, so
+		//time the part from now, and a millisecond more for the clock's steps
+		oi_play_song(slot);
+		timer_start(&song_timer, part_ms(song, song_part) + 1, 0, song_step, 0);
+	}
+	if ((todo & PENDING_LEDS) &&
+			(lights != sent_lights || color != sent_color || intensity != sent_intensity))
+	{
+		oi_set_leds(lights, lights, color, intensity);
+		sent_lights = lights;
+		sent_color = color;
+		sent_intensity = intensity;
+	}
+}
+
+/**
+ * 	Tells whether a song or an LED effect with a set number of passes is playing
+ */
+
+char music_busy(void)
+{
+	return song || (effect && effect->passes);
+}
+
+/**
+ * 	Sends the LED and song commands until everything has finished
+ */
+
+void music_wait(void)
+{
+	while (music_busy())
+	{
+		music_poll();
+		hal_idle();
+	}
+	music_poll();		//the last step of an effect
+}
+
+/**
+ * 	This function plays the music from the robot and flashes its LEDs
+ * 	@author Cheng Song
+ * 	@date 4/12/2015
+ */
+
+void play_song(){
+	music_play(MARIO_UNDERWORLD);
+	led_play(&led_celebrate);
+}
@@ -1,29 +1,112 @@
-/**
- * 	@file music.h
- *	@brief this is the header that file contains the functions 
- *	that flash the LEDs and play music from the robot
- *
- *	@author	Cheng Song
- *
- *	@date 4/12/2015
- */
-
-
-#define RICK_ROLL		0
-#define IMERPIAL_MARCH 		1
-#define MARIO_UNDERWORLD	3
-#define MARIO_UNDERWATER	7
-
-
-
-#warning "Make sure the open interface has been initialized before calling load_songs()."
-/// you may delete this warning
-/// Loads some songs over the open interface
-
-/**
- * 	This function plays the music from the robot
- * 	@author Cheng Song 
- * 	@date 4/12/2015
- */
-
-void play_song();
+/**
+ * 	@file music.h
+ *	@brief this is the header that file contains the functions
+ *	that flash the LEDs and play music from the robot
+ *
+ *	Songs are uploaded into the Create's song slots once, by music_init(),
+ *	and LED effects are lists of keyframes the power LED fades between.
+ *	Both run in the background: a timer works out what the Create should be
+ *	doing next, and music_poll() sends it. oi_update() calls music_poll()
+ *	before every sensor query, so effects keep going while the robot drives
+ *	and senses.
+ *
+ *	@author	Cheng Song
+ *
+ *	@date 4/12/2015
+ */
+
+#ifndef MUSIC_H
+#define MUSIC_H
+
+/// first song slot of each song; a song longer than 16 notes takes the slots after it
+#define RICK_ROLL		0
+#define IMERPIAL_MARCH 		1
+#define MARIO_UNDERWORLD	3
+#define MARIO_UNDERWATER	7
+
+/// one keyframe of an LED effect
+struct led_key{
+	unsigned int at;		// milliseconds from the start of a pass
+	unsigned char color;		// power LED color, 0 green to 255 red
+	unsigned char intensity;	// power LED intensity, 0 off to 255 full
+};
+
+/// an LED effect; the power LED fades from key to key, and the time of the last key is the length of one pass
+struct led_effect{
+	const struct led_key *keys;
+	unsigned char count;
+	unsigned char passes;		// passes to play, 0 to play until led_stop()
+};
+
+/// red and green sweeps in and out, 12.8 seconds
+extern const struct led_effect led_celebrate;
+/// slow amber breathing, until stopped
+extern const struct led_effect led_searching;
+
+/**
+ * 	This function uploads the songs to the Create. Only the first call
+ * 	sends anything; the open interface must be initialized before it.
+ */
+
+void music_init(void);
+
+/**
+ * 	This function uploads the songs again, after the Create lost them in a
+ * 	reset
+ */
+
+void music_reload(void);
+
+/**
+ * 	This function starts a song in the background
+ * 	@param song	one of the song numbers above
+ */
+
+void music_play(unsigned char song);
+
+/**
+ * 	This function starts an LED effect in the background, in place of
+ * 	the one playing
+ * 	@param effect	the effect
+ */
+
+void led_play(const struct led_effect *effect);
+
+/**
+ * 	This function stops the LED effect and puts the LEDs back the way
+ * 	oi_init() sets them
+ */
+
+void led_stop(void);
+
+/**
+ * 	This function sends the LED and song commands that have come due
+ */
+
+void music_poll(void);
+
+/**
+ * 	This function tells whether a song or an LED effect with a set number
+ * 	of passes is still playing
+ * 	@return 1 while something is playing, otherwise 0
+ */
+
+char music_busy(void);
+
+/**
+ * 	This function keeps sending the LED and song commands until the song
+ * 	and the LED effect have finished
+ */
+
+void music_wait(void);
+
+/**
+ * 	This function plays the music from the robot and flashes its LEDs.
+ * 	It returns at once.
+ * 	@author Cheng Song
+ * 	@date 4/12/2015
+ */
+
+void play_song();
+
+#endif
@@ -1,232 +1,404 @@
-
-/**
- *	@file open_interface.c
- *	@brief this file contains functions that communicate with
- *	the robot's sensors
- *
- *	@author ISU
- *
- * 	@date 6/22/2012
- */
-
-#include <stdlib.h>
-#include "util.h"
-#include "open_interface.h"
-
-
-/**
- *	Allocate memory for a the sensor data
- *	@author	ISU
- *	@date 6/22/2012
- *	@return allocates memory space for the oi_t sensor data structure 
- */	
-
-oi_t* oi_alloc()
-{
-	return calloc(1, sizeof(oi_t));
-}
-
-/**
- *	Free memory from a pointer to the sensor data struct
- *	@author	ISU
- *	@date 6/22/2012
- *	@param self io_t struct that contains sensor data 
- */	
-
-void oi_free(oi_t *self)
-{
-	free(self);
-}
-
-/**
- *	Initialize the Create
- *	@author	ISU
- *	@date 6/22/2012
- *	@param self io_t struct that contains sensor data 
- */	
-
-void oi_init(oi_t *self) 
-{
-	// Setup USART1 to communicate to the iRobot Create using serial (baud = 57600)
-	UBRR1L = 16; // UBRR = (FOSC/16/BAUD-1);
-	UCSR1B = (1 << RXEN) | (1 << TXEN);
-	UCSR1C = (3 << UCSZ10);
-
-	// Starts the SCI. Must be sent first
-	oi_byte_tx(OI_OPCODE_START);
-	oi_byte_tx(OI_OPCODE_BAUD);
-
-	oi_byte_tx(8); // baud code for 28800
-	wait_ms(100);
-	
-	// Set the baud rate on the Cerebot II to match the Create's baud
-	UBRR1L = 33; // UBRR = (FOSC/16/BAUD-1);
-
-	// Use Full mode, unrestricted control
-	oi_byte_tx(OI_OPCODE_FULL);
-	oi_set_leds(1, 1, 7, 255);
-	
-	oi_update(self);
-	oi_update(self); // call twice to clear distance/angle
-}
-
-
-/**
- *	Update the Create. This will update all the sensor data and 
- *	store it in the oi_t struct.
- *	@author	ISU
- *	@date 6/22/2012
- *	@param self io_t struct that contains sensor data 
- */	
-
-void oi_update(oi_t *self) 
-{
-	int i;
-
-	// Clear the receive buffer
-	while (UCSR1A & (1 << RXC)) 
-		i = UDR1;
-
-	// Query a list of sensor values
-	oi_byte_tx(OI_OPCODE_SENSORS);
-	// Send the sensor packet ID
-	oi_byte_tx(OI_SENSOR_PACKET_GROUP6); 
-
-	// Read all the sensor data
-	char *sensor = (char *) self;
-	for (i = 0; i < 52; i++) {
-		// read each sensor byte
-		*(sensor++) = oi_byte_rx();
-	}
-	
-	sensor = (char *) self;
-	
-	// Fix byte ordering for multi-byte members of the struct
-	self->distance                 = (sensor[12] << 8) + sensor[13];
-	self->angle                    = (sensor[14] << 8) + sensor[15];
-	self->voltage                  = (sensor[17] << 8) + sensor[18];
-	self->current                  = (sensor[19] << 8) + sensor[20];
-	self->charge                   = (sensor[22] << 8) + sensor[23];
-	self->capacity                 = (sensor[24] << 8) + sensor[25];
-	self->wall_signal              = (sensor[26] << 8) + sensor[27];
-	self->cliff_left_signal        = (sensor[28] << 8) + sensor[29];
-	self->cliff_frontleft_signal   = (sensor[30] << 8) + sensor[31]; 
-	self->cliff_frontright_signal  = (sensor[32] << 8) + sensor[33];
-	self->cliff_right_signal       = (sensor[34] << 8) + sensor[35];
-	self->cargo_bay_voltage        = (sensor[41] << 8) + sensor[42];
-	self->requested_velocity       = (sensor[48] << 8) + sensor[42];
-	self->requested_radius         = (sensor[50] << 8) + sensor[51];
-	self->requested_right_velocity = (sensor[52] << 8) + sensor[53];
-	self->requested_left_velocity  = (sensor[54] << 8) + sensor[55];
-	
-	wait_ms(35); // reduces USART errors that occur when continuously transmitting/receiving
-}
-
-
-
-
-/**
-* 	Set the state of the three LEDs on the iRobot (Power, Play, Advance).
-* 	@author ISU
-* 	@date 6/22/2012
-* 	@param play_led        uint8_t either 0 (off) or 1 (on)
-* 	@param advance_led     uint8_t either 0 (off) or 1 (on)
-* 	@param power_color     uint8_t the color of the power LED; 0 = green, 255 = red
-* 	@param power_intensity uint8_t the intensity of the power LED; 0 = off, 255 = full intensity
-*/
-
-void oi_set_leds(uint8_t play_led, uint8_t advance_led, uint8_t power_color, uint8_t power_intensity) 
-{
-	// LED Opcode
-	oi_byte_tx(OI_OPCODE_LEDS);
-
-	// Set the Play and Advance LEDs
-	oi_byte_tx(advance_led << 3 && play_led << 2);
-
-	// Set the power led color
-	oi_byte_tx(power_color);
-
-	// Set the power led intensity
-	oi_byte_tx(power_intensity);
-}
-
-
-/**
- *	Drive wheels directly; speeds are in mm / sec
- *	@author	ISU
- *	@date 6/22/2012
- *	@param right_wheel sets speed of the right wheel
- *	@param left_wheel sets speed of the left wheel 
- */	
-
-void oi_set_wheels(int16_t right_wheel, int16_t left_wheel) {
-	oi_byte_tx(OI_OPCODE_DRIVE_WHEELS);
-	oi_byte_tx(right_wheel>>8);
-	oi_byte_tx(right_wheel & 0xff);
-	oi_byte_tx(left_wheel>>8);
-	oi_byte_tx(left_wheel& 0xff);
-}
-
-
-/**
- *	Loads a song onto the iRobot Create
- *	@author	ISU
- *	@date 6/22/2012
- *	@param song_index 	the index of the song
- *	@param num_notes 	the number of notes in the song 
- *	@param notes		array of notes in the song 
- *	@param duration 	how long each note is played in the song 
- */	
-
-void oi_load_song(int song_index, int num_notes, unsigned char *notes, unsigned char *duration) {
-	int i;
-	oi_byte_tx(OI_OPCODE_SONG);
-	oi_byte_tx(song_index);
-	oi_byte_tx(num_notes);
-	for (i=0;i<num_notes;i++) {
-		oi_byte_tx(notes[i]);
-		oi_byte_tx(duration[i]);
-	}
-}
-
-/**
- *	Plays a given song; use oi_load_song(...) first
- *	@author	ISU
- *	@date 6/22/2012
- *	@param song_index 	the index of the song
- */	
-
-void oi_play_song(int index){
-	oi_byte_tx(OI_OPCODE_PLAY);
-	oi_byte_tx(index);
-}
-
-
-/**
- *	Transmit a byte of data over the serial connection to the Create
- *	@author	ISU
- *	@date 6/22/2012
- *	@param value	data byte transmitted
- */	
-
-void oi_byte_tx(unsigned char value) {
-	// Wait until the transmit buffer is empty
-	while (!(UCSR1A & (1 << UDRE)));
-
-	UDR1 = value;
-}
-
-
-/**
- *	Receive a byte of data from the Create serial connection. Blocks until a byte is received.
- *	@author	ISU
- *	@date 6/22/2012
- *	@return data byte received 
- */	
-
-unsigned char oi_byte_rx(void) {
-	// wait until a byte is received (Receive Complete flag, RXC, is set)
-	while (!(UCSR1A & (1 << RXC)));
-
-	return UDR1;
-}
+
+/**
+ *	@file open_interface.c
+ *	@brief this file contains functions that communicate with
+ *	the robot's sensors
+ *
+ *	@author ISU
+ *
+ * 	@date 6/22/2012
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hal.h"
+#include "util.h"
+#include "open_interface.h"
+#include "timebase.h"
+#include "music.h"
+#include "recorder.h"
+#include "feed.h"
+#include "params.h"
+#include "profile.h"
+
+static HAL_LOCAL uint32_t next_query;	// timebase_ms() from which the next sensor query may start
+static HAL_LOCAL uint32_t last_answer;	// timebase_ms() of the last answer to a sensor query
+static HAL_LOCAL char link_down;		// the last query went unanswered
+static HAL_LOCAL unsigned char last_drive[5];	// the last drive command, opcode first, for oi_resync()
+
+/**
+ *	Allocate memory for a the sensor data
+ *	@author	ISU
+ *	@date 6/22/2012
+ *	@return allocates memory space for the oi_t sensor data structure 
+ */	
+
+oi_t* oi_alloc()
+{
+	return calloc(1, sizeof(oi_t));
+}
+
+/**
+ *	Free memory from a pointer to the sensor data struct
+ *	@author	ISU
+ *	@date 6/22/2012
+ *	@param self io_t struct that contains sensor data 
+ */	
+
+void oi_free(oi_t *self)
+{
+	free(self);
+}
+
+/**
+ *	Starts the Open Interface at 57600 baud, the rate of a Create that
+ *	was just switched on, then moves both ends to 28800 and full mode
+ *	@author	ISU
+ *	@date 6/22/2012
+ */
+
+static void oi_start(void)
+{
+	// Setup USART1 to communicate to the iRobot Create using serial (baud = 57600)
+	hal_uart1_init(16); // UBRR = (FOSC/16/BAUD-1);
+
+	// Starts the SCI. Must be sent first
+	oi_byte_tx(OI_OPCODE_START);
+	oi_byte_tx(OI_OPCODE_BAUD);
+
+	oi_byte_tx(8); // baud code for 28800
+	wait_ms(100);
+	
+	// Set the baud rate on the Cerebot II to match the Create's baud
+	hal_uart1_baud(33); // UBRR = (FOSC/16/BAUD-1);
+
+	// Use Full mode, unrestricted control
+	oi_byte_tx(OI_OPCODE_FULL);
+	oi_set_leds(1, 1, 7, 255);
+}
+
+/**
+ *	Initialize the Create
+ *	@author	ISU
+ *	@date 6/22/2012
+ *	@param self io_t struct that contains sensor data 
+ */	
+
+void oi_init(oi_t *self) 
+{
+	oi_start();
+	
+	oi_update(self);
+	oi_update(self); // call twice to clear distance/angle
+}
+
+/**
+ *	Asks the Create for packet group 6 and reads the answer, giving up
+ *	params.oi_timeout_ms after asking
+ *	@param raw	takes the 52 bytes as they come
+ *	@return 1 if the whole answer came, 0 if not
+ */
+
+static char oi_query(unsigned char *raw)
+{
+	// Clear the receive buffer
+	while (hal_uart1_ready()) 
+		hal_uart1_read();
+
+	// Query a list of sensor values
+	oi_byte_tx(OI_OPCODE_SENSORS);
+	// Send the sensor packet ID
+	oi_byte_tx(OI_SENSOR_PACKET_GROUP6); 
+
+	uint32_t deadline = timebase_ms() + params.oi_timeout_ms;
+	for (unsigned char i = 0; i < OI_GROUP6_BYTES; i++)
+	{
+		int data = oi_byte_rx_until(deadline);
+		if (data == OI_TIMEOUT)
+		{
+			return 0;
+		}
+		raw[i] = data;
+	}
+	return 1;
+}
+
+/**
+ *	Puts an answer of the Create into the struct
+ *	@author	ISU
+ *	@date 6/22/2012
+ */
+
+static void oi_take(oi_t *self, const unsigned char *raw)
+{
+	memcpy(self, raw, OI_GROUP6_BYTES);
+	rec_frame(raw);	// the raw bytes, before they are put in order
+	feed_frame(raw);
+	last_answer = timebase_ms();
+
+	// Fix byte ordering for multi-byte members of the struct; the low
+	// byte is unsigned, or a negative distance of -5 would read as -261
+	self->distance                 = (int16_t) (raw[12] << 8 | raw[13]);
+	self->angle                    = (int16_t) (raw[14] << 8 | raw[15]);
+	self->voltage                  = raw[17] << 8 | raw[18];
+	self->current                  = (int16_t) (raw[19] << 8 | raw[20]);
+	self->charge                   = raw[22] << 8 | raw[23];
+	self->capacity                 = raw[24] << 8 | raw[25];
+	self->wall_signal              = raw[26] << 8 | raw[27];
+	self->cliff_left_signal        = raw[28] << 8 | raw[29];
+	self->cliff_frontleft_signal   = raw[30] << 8 | raw[31];
+	self->cliff_frontright_signal  = raw[32] << 8 | raw[33];
+	self->cliff_right_signal       = raw[34] << 8 | raw[35];
+	self->cargo_bay_voltage        = raw[37] << 8 | raw[38];
+	self->requested_velocity       = (int16_t) (raw[44] << 8 | raw[45]);
+	self->requested_radius         = (int16_t) (raw[46] << 8 | raw[47]);
+	self->requested_right_velocity = (int16_t) (raw[48] << 8 | raw[49]);
+	self->requested_left_velocity  = (int16_t) (raw[50] << 8 | raw[51]);
+}
+
+/**
+ *	Update the Create. This will update all the sensor data and 
+ *	store it in the oi_t struct. If the Create does not answer, the
+ *	link is resynchronised (see oi_resync()); if that fails too, the
+ *	sensor data stays as it was, but with no distance or angle moved.
+ *	@author	ISU
+ *	@date 6/22/2012
+ *	@param self io_t struct that contains sensor data 
+ */	
+
+void oi_update(oi_t *self) 
+{
+	static HAL_LOCAL unsigned char raw[OI_GROUP6_BYTES];
+	prof_enter(PROF_OI_UPDATE);
+
+	// Keep the gap after the last query; whatever the caller did since counts toward it
+	while ((int32_t) (timebase_ms() - next_query) < 0)
+		hal_idle();
+
+	// LED and song commands that came due ride along with the query
+	music_poll();
+
+	if (oi_query(raw))
+	{
+		oi_take(self, raw);
+	}
+	else if (!oi_resync(self))
+	{
+		self->distance = 0;	// the odometry of the last answer is already counted
+		self->angle = 0;
+	}
+	
+	next_query = timebase_ms() + params.oi_query_gap_ms; // reduces USART errors that occur when continuously transmitting/receiving
+	prof_exit();
+}
+
+/**
+ *	Gets the Create answering again. A byte lost on the way leaves it
+ *	waiting for the rest of a command, which the starts make up; a Create
+ *	that was switched off and on again listens at 57600 baud and has lost
+ *	its songs. If the command made up was a drive, the starts made it one
+ *	at 0x8080 mm/s, so the wheels are stopped at once; the last drive
+ *	command is sent again once the Create answers, so a motion carries on.
+ */
+
+char oi_resync(oi_t *self)
+{
+	static HAL_LOCAL unsigned char raw[OI_GROUP6_BYTES];
+	if (!link_down)
+	{
+		link_down = 1;
+		uprintf("Create not answering\n\r");
+	}
+
+	for (unsigned char i = 0; i < OI_RESYNC_STARTS; i++)
+	{
+		oi_byte_tx(OI_OPCODE_START);
+	}
+	oi_byte_tx(OI_OPCODE_FULL);
+	oi_byte_tx(OI_OPCODE_DRIVE_WHEELS);	// both wheels at 0 mm/s
+	for (unsigned char i = 0; i < 4; i++)
+	{
+		oi_byte_tx(0);
+	}
+	char reset = 0;
+	if (!oi_query(raw))
+	{
+		oi_start();
+		if (!oi_query(raw))
+		{
+			return 0;
+		}
+		reset = 1;
+	}
+
+	uint32_t down = timebase_ms() - last_answer;
+	oi_take(self, raw);
+	if (last_drive[0])
+	{
+		for (unsigned char i = 0; i < sizeof(last_drive); i++)
+		{
+			oi_byte_tx(last_drive[i]);
+		}
+	}
+	if (reset)
+	{
+		music_reload();
+	}
+	link_down = 0;
+	uprintf("Create back, %lu ms after its last answer%s\n\r", (unsigned long) down, reset ? ", reset" : "");
+	return 1;
+}
+
+
+/**
+* 	Set the state of the three LEDs on the iRobot (Power, Play, Advance).
+* 	@author ISU
+* 	@date 6/22/2012
+* 	@param play_led        uint8_t either 0 (off) or 1 (on)
+* 	@param advance_led     uint8_t either 0 (off) or 1 (on)
+* 	@param power_color     uint8_t the color of the power LED; 0 = green, 255 = red
+* 	@param power_intensity uint8_t the intensity of the power LED; 0 = off, 255 = full intensity
+*/
+
+void oi_set_leds(uint8_t play_led, uint8_t advance_led, uint8_t power_color, uint8_t power_intensity) 
+{
+	// LED Opcode
+	oi_byte_tx(OI_OPCODE_LEDS);
+
+	// Set the Play and Advance LEDs
+	oi_byte_tx((advance_led << 3) | (play_led << 1));
+
+	// Set the power led color
+	oi_byte_tx(power_color);
+
+	// Set the power led intensity
+	oi_byte_tx(power_intensity);
+}
+
+
+/**
+ *	Sends a drive command and keeps it for oi_resync()
+ */
+
+static void oi_drive_tx(unsigned char opcode, int16_t a, int16_t b)
+{
+	last_drive[0] = opcode;
+	last_drive[1] = a >> 8;
+	last_drive[2] = a & 0xff;
+	last_drive[3] = b >> 8;
+	last_drive[4] = b & 0xff;
+	for (unsigned char i = 0; i < sizeof(last_drive); i++)
+	{
+		oi_byte_tx(last_drive[i]);
+	}
+}
+
+/**
+ *	Drive wheels directly; speeds are in mm / sec
+ *	@author	ISU
+ *	@date 6/22/2012
+ *	@param right_wheel sets speed of the right wheel
+ *	@param left_wheel sets speed of the left wheel 
+ */	
+
+void oi_set_wheels(int16_t right_wheel, int16_t left_wheel) {
+	rec_wheels(right_wheel, left_wheel);
+	oi_drive_tx(OI_OPCODE_DRIVE_WHEELS, right_wheel, left_wheel);
+	if (right_wheel == 0 && left_wheel == 0)
+	{
+		abort_wheels_stopped();
+	}
+}
+
+
+/**
+ *	Drive along an arc; positive radii turn left (counterclockwise)
+ *	@param velocity average speed of the wheels in mm / sec, -500 to 500
+ *	@param radius radius of the arc in mm, -2000 to 2000, or one of
+ *	OI_RADIUS_STRAIGHT, OI_RADIUS_SPIN_CW and OI_RADIUS_SPIN_CCW
+ */
+
+void oi_drive(int16_t velocity, int16_t radius) {
+	rec_drive(velocity, radius);
+	oi_drive_tx(OI_OPCODE_DRIVE, velocity, radius);
+}
+
+
+/**
+ *	Loads a song onto the iRobot Create
+ *	@author	ISU
+ *	@date 6/22/2012
+ *	@param song_index 	the index of the song
+ *	@param num_notes 	the number of notes in the song 
+ *	@param notes		array of notes in the song 
+ *	@param duration 	how long each note is played in the song 
+ */	
+
+void oi_load_song(int song_index, int num_notes, unsigned char *notes, unsigned char *duration) {
+	int i;
+	oi_byte_tx(OI_OPCODE_SONG);
+	oi_byte_tx(song_index);
+	oi_byte_tx(num_notes);
+	for (i=0;i<num_notes;i++) {
+		oi_byte_tx(notes[i]);
+		oi_byte_tx(duration[i]);
+	}
+}
+
+/**
+ *	Plays a given song; use oi_load_song(...) first
+ *	@author	ISU
+ *	@date 6/22/2012
+ *	@param song_index 	the index of the song
+ */	
+
+void oi_play_song(int index){
+	oi_byte_tx(OI_OPCODE_PLAY);
+	oi_byte_tx(index);
+}
+
+
+/**
+ *	Transmit a byte of data over the serial connection to the Create
+ *	@author	ISU
+ *	@date 6/22/2012
+ *	@param value	data byte transmitted
+ */	
+
+void oi_byte_tx(unsigned char value) {
+	// Wait until the transmit buffer is empty
+	hal_uart1_write(value);
+}
+
+
+/**
+ *	Receive a byte of data from the Create serial connection. Blocks until a
+ *	byte is received, or for params.oi_timeout_ms at most.
+ *	@author	ISU
+ *	@date 6/22/2012
+ *	@return data byte received, 0 if none came
+ */	
+
+unsigned char oi_byte_rx(void) {
+	int data = oi_byte_rx_until(timebase_ms() + params.oi_timeout_ms);
+	return data == OI_TIMEOUT ? 0 : data;
+}
+
+/**
+ *	Receive a byte of data from the Create serial connection, waiting until
+ *	a deadline at most
+ */
+
+int oi_byte_rx_until(uint32_t deadline)
+{
+	// wait until a byte is received (Receive Complete flag, RXC, is set)
+	while (!hal_uart1_ready())
+	{
+		if ((int32_t) (timebase_ms() - deadline) >= 0)
+		{
+			return OI_TIMEOUT;
+		}
+		hal_idle();
+	}
+	return hal_uart1_read();
+}
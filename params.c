@@ -0,0 +1,339 @@
+/**
+ *	@file params.c
+ *	@brief this file contains the tunable parameters, their table and the
+ *	'#' command; see params.h
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hal.h"
+#include "util.h"
+#include "link.h"
+#include "timebase.h"
+#include "thresholds.h"
+#include "params.h"
+
+/// marks parameters kept in EEPROM; change it when the table changes
+#define PARAM_MAGIC	0x9A4B
+/// longest '#' command, without the '#'
+#define PARAM_LINE	32
+/// a '#' command is dropped when its next key takes longer than this to come
+#define PARAM_KEY_MS	10000
+
+/// the values the robot has always used
+#define PARAMS_DEFAULT {			\
+	.drive_speed = 100,			\
+	.turn_speed = 100,			\
+	.seek_speed = 100,			\
+	.detour_speed = 100,			\
+	.servo_settle_ms = 20,			\
+	.oi_query_gap_ms = 35,			\
+	.oi_timeout_ms = 50,			\
+	.sonar_timeout_ms = 40,			\
+	.sonar_offset = Q16(30),		\
+	.ir_log2_k = Q16(15.064743),		\
+	.ir_exponent = Q16(1.376),		\
+}
+
+HAL_LOCAL struct params params = PARAMS_DEFAULT;
+static const struct params params_default HAL_FLASH = PARAMS_DEFAULT;
+
+/// one entry of the table
+struct param_info{
+	char name[PARAM_NAME];
+	unsigned char type;		// PARAM_
+	unsigned char offset;		// in params, or in thresholds for PARAM_BAND
+	int32_t min, max;		// PARAM_Q16 ones as q16_t
+};
+
+#define INT(field, lo, hi)	{#field, PARAM_INT, offsetof(struct params, field), lo, hi}
+#define FIXED(field, lo, hi)	{#field, PARAM_Q16, offsetof(struct params, field), Q16(lo), Q16(hi)}
+#define BAND(name, band, end, max) {name, PARAM_BAND, offsetof(struct thresholds, band.end), 0, max}
+
+static const struct param_info table[] HAL_FLASH = {
+	INT(drive_speed, 10, 500),
+	INT(turn_speed, 10, 500),
+	INT(seek_speed, 10, 500),
+	INT(detour_speed, 10, 500),
+	INT(servo_settle_ms, 0, 500),
+	INT(oi_query_gap_ms, 15, 500),
+	INT(oi_timeout_ms, 25, 1000),
+	INT(sonar_timeout_ms, 1, 200),
+	FIXED(sonar_offset, -100, 100),
+	FIXED(ir_log2_k, 0, 30),
+	FIXED(ir_exponent, 0.1, 8),
+	BAND("tape_left_lo", tape[SENSE_LEFT], lo, 4095),
+	BAND("tape_left_hi", tape[SENSE_LEFT], hi, 4095),
+	BAND("tape_fleft_lo", tape[SENSE_FRONTLEFT], lo, 4095),
+	BAND("tape_fleft_hi", tape[SENSE_FRONTLEFT], hi, 4095),
+	BAND("tape_fright_lo", tape[SENSE_FRONTRIGHT], lo, 4095),
+	BAND("tape_fright_hi", tape[SENSE_FRONTRIGHT], hi, 4095),
+	BAND("tape_right_lo", tape[SENSE_RIGHT], lo, 4095),
+	BAND("tape_right_hi", tape[SENSE_RIGHT], hi, 4095),
+	BAND("dest_left_lo", dest[SENSE_LEFT], lo, 4095),
+	BAND("dest_left_hi", dest[SENSE_LEFT], hi, 4095),
+	BAND("dest_fleft_lo", dest[SENSE_FRONTLEFT], lo, 4095),
+	BAND("dest_fleft_hi", dest[SENSE_FRONTLEFT], hi, 4095),
+	BAND("dest_fright_lo", dest[SENSE_FRONTRIGHT], lo, 4095),
+	BAND("dest_fright_hi", dest[SENSE_FRONTRIGHT], hi, 4095),
+	BAND("dest_right_lo", dest[SENSE_RIGHT], lo, 4095),
+	BAND("dest_right_hi", dest[SENSE_RIGHT], hi, 4095),
+	BAND("ir_lo", ir, lo, 1000),
+	BAND("ir_hi", ir, hi, 1000),
+};
+
+#define PARAM_COUNT	(sizeof(table) / sizeof(table[0]))
+
+/// the parameters as kept in EEPROM
+struct param_saved{
+	uint16_t magic;
+	int32_t value[PARAM_COUNT];
+	uint16_t crc;		// link_crc() of the values
+};
+
+static HAL_LOCAL struct param_saved EEMEM param_eeprom;
+
+/**
+ *	Where a parameter is
+ */
+
+static void *value_of(const struct param_info *p)
+{
+	return (p->type == PARAM_BAND ? (char *) &thresholds : (char *) &params) + p->offset;
+}
+
+/**
+ *	Reads a parameter
+ */
+
+static int32_t get(const struct param_info *p)
+{
+	return p->type == PARAM_Q16 ? *(q16_t *) value_of(p) : *(int *) value_of(p);
+}
+
+/**
+ *	Sets a parameter. Interrupts are off meanwhile, so an interrupt handler
+ *	never reads half of a new value.
+ */
+
+static void put(const struct param_info *p, int32_t value)
+{
+	unsigned char state = hal_interrupts_disable();
+	if (p->type == PARAM_Q16)
+	{
+		*(q16_t *) value_of(p) = value;
+	}
+	else
+	{
+		*(int *) value_of(p) = value;
+	}
+	hal_interrupts_restore(state);
+}
+
+/**
+ *	Computes the CRC of the values of a saved copy
+ */
+
+static uint16_t saved_crc(const struct param_saved *saved)
+{
+	uint16_t crc = 0xFFFF;
+	const unsigned char *p = (const unsigned char *) saved->value;
+	for (unsigned int i = 0; i < sizeof(saved->value); i++)
+	{
+		crc = link_crc(crc, p[i]);
+	}
+	return crc;
+}
+
+/**
+ *	Puts back the parameters kept in EEPROM
+ */
+
+void params_load(void)
+{
+	struct param_saved saved;
+	hal_eeprom_read_block(&saved, &param_eeprom, sizeof(saved));
+	if (saved.magic != PARAM_MAGIC || saved.crc != saved_crc(&saved))
+	{
+		return;
+	}
+	for (unsigned char i = 0; i < PARAM_COUNT; i++)
+	{
+		struct param_info p;
+		hal_flash_read_block(&p, &table[i], sizeof(p));
+		if (saved.value[i] >= p.min && saved.value[i] <= p.max)
+		{
+			put(&p, saved.value[i]);
+		}
+	}
+}
+
+/**
+ *	Keeps every parameter in EEPROM; only the bytes that changed are written
+ */
+
+static void save(void)
+{
+	struct param_saved saved;
+	saved.magic = PARAM_MAGIC;
+	for (unsigned char i = 0; i < PARAM_COUNT; i++)
+	{
+		struct param_info p;
+		hal_flash_read_block(&p, &table[i], sizeof(p));
+		saved.value[i] = get(&p);
+	}
+	saved.crc = saved_crc(&saved);
+	hal_eeprom_update_block(&saved, &param_eeprom, sizeof(saved));
+}
+
+/**
+ *	Sends a parameter as "name = value"; q16 values with 4 decimals
+ */
+
+static void show(const struct param_info *p)
+{
+	int32_t value = get(p);
+	if (p->type != PARAM_Q16)
+	{
+		uprintf("%s = %ld\n\r", p->name, (long) value);
+		return;
+	}
+	uint32_t mag = value >= 0 ? (uint32_t) value : -(uint32_t) value;
+	uint32_t whole = mag >> 16;
+	uint32_t fraction = ((mag & 0xFFFF) * 10000UL + 0x8000) >> 16;
+	if (fraction == 10000)
+	{
+		whole++;
+		fraction = 0;
+	}
+	uprintf("%s = %s%lu.%04lu\n\r", p->name, value < 0 ? "-" : "", (unsigned long) whole, (unsigned long) fraction);
+}
+
+/**
+ *	Reads a value written as show() writes it
+ *	@return 1 if all of text was a value, 0 if not
+ */
+
+static char parse(const struct param_info *p, const char *text, int32_t *value)
+{
+	char *end;
+	long whole = strtol(text, &end, 10);
+	if (end == text || (*end && (p->type != PARAM_Q16 || *end != '.')))
+	{
+		return 0;
+	}
+	if (p->type != PARAM_Q16)
+	{
+		*value = whole;
+		return 1;
+	}
+	if (whole > 32767 || whole < -32767)
+	{
+		return 0;
+	}
+
+	uint32_t fraction = 0;		//ten thousandths
+	uint32_t scale = 1000;
+	if (*end == '.')
+	{
+		for (end++; *end >= '0' && *end <= '9'; end++, scale /= 10)
+		{
+			fraction += (*end - '0') * scale;	//digits past the fourth add nothing
+		}
+		if (*end)
+		{
+			return 0;
+		}
+	}
+	int32_t mag = ((int32_t) labs(whole) << 16) + (int32_t) ((fraction * 65536UL + 5000) / 10000);
+	*value = text[0] == '-' ? -mag : mag;
+	return 1;
+}
+
+/**
+ *	Reads the rest of a '#' command and carries it out
+ */
+
+void params_command(void)
+{
+	char line[PARAM_LINE + 1];
+	unsigned char n = 0;
+	for (;;)
+	{
+		int c = USART_Receive_Until(timebase_ms() + PARAM_KEY_MS);
+		if (c == USART_TIMEOUT)
+		{
+			uprintf("Parameter command timed out\n\r");
+			return;
+		}
+		if (c == '\r' || c == '\n' || c == ';')
+		{
+			break;
+		}
+		if (n < PARAM_LINE)
+		{
+			line[n++] = c;
+		}
+	}
+	line[n] = 0;
+
+	if (!strcmp(line, "!"))
+	{
+		unsigned char state = hal_interrupts_disable();
+		hal_flash_read_block(&params, &params_default, sizeof(params));
+		hal_flash_read_block(&thresholds, &thresholds_default, sizeof(thresholds));
+		hal_interrupts_restore(state);
+		hal_eeprom_update_word(&param_eeprom.magic, 0xFFFF);
+		uprintf("Parameters back to the defaults\n\r");
+		return;
+	}
+
+	char *value = strchr(line, '=');
+	if (value)
+	{
+		*value++ = 0;
+		if (!line[0])
+		{
+			uprintf("No parameter given\n\r");
+			return;
+		}
+	}
+	for (unsigned char i = 0; i < PARAM_COUNT; i++)
+	{
+		struct param_info p;
+		hal_flash_read_block(&p, &table[i], sizeof(p));
+		if (line[0] && strcmp(line, p.name))
+		{
+			continue;
+		}
+		if (value)
+		{
+			int32_t v;
+			if (!parse(&p, value, &v) || v < p.min || v > p.max)
+			{
+				uprintf("%s takes ", p.name);
+				if (p.type == PARAM_Q16)
+				{
+					uprintf("%q to %q\n\r", p.min, p.max);
+				}
+				else
+				{
+					uprintf("%ld to %ld\n\r", (long) p.min, (long) p.max);
+				}
+				return;
+			}
+			put(&p, v);
+			save();
+		}
+		show(&p);
+		if (line[0])
+		{
+			return;
+		}
+	}
+	if (line[0])
+	{
+		uprintf("No parameter %s\n\r", line);
+	}
+}
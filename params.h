@@ -0,0 +1,70 @@
+/**
+ *	@file params.h
+ *	@brief this is the header file of the tunable parameters of the robot,
+ *	which the base station can read, set and keep in EEPROM
+ *
+ *	Each parameter is a field of params below, or one end of a band of
+ *	thresholds (thresholds.h). The code reads them as the plain variables
+ *	they are, so a hot path pays nothing for a value being tunable, and
+ *	their initializers are the compile-time defaults. A table in flash
+ *	gives each a name, a type and the range it may be set to. The base
+ *	station reaches them with the '#' command, ended with a carriage
+ *	return, a newline or a ';' (the last so a sim script can send it):
+ *
+ *	#		list every parameter
+ *	#name		show one
+ *	#name=value	set one, and keep every parameter in EEPROM
+ *	#!		go back to the defaults, and forget what EEPROM keeps
+ *
+ *	Every answer is "name = value" lines, or a line saying what was wrong.
+ *	A command whose next key does not come within 10 s is dropped, so a
+ *	base station that stops in the middle of one does not hang the robot.
+ *	PARAM_Q16 values are written and read with 4 decimals. params_load(),
+ *	which main() calls first, puts the values kept in EEPROM back.
+ */
+
+#ifndef PARAMS_H
+#define PARAMS_H
+
+#include "hal.h"
+#include "fixmath.h"
+
+/// types of parameters
+#define PARAM_INT	0	// an int of params
+#define PARAM_Q16	1	// a q16_t of params
+#define PARAM_BAND	2	// an int of thresholds, one end of a band
+
+/// longest name
+#define PARAM_NAME	16
+
+struct params{
+	int drive_speed;		///< wheel speed of moves forward and backward, mm/s
+	int turn_speed;			///< wheel speed of turns, mm/s
+	int seek_speed;			///< while looking for the destination, mm/s
+	int detour_speed;		///< while driving around an obstacle, mm/s
+	int servo_settle_ms;		///< the servo takes to settle after a step
+	int oi_query_gap_ms;		///< least time from one sensor query to the next
+	int oi_timeout_ms;		///< longest wait for a whole sensor answer before the link is resynchronised
+	int sonar_timeout_ms;		///< longest wait for a sonar echo
+	q16_t sonar_offset;		///< taken off every sonar distance, cm
+	q16_t ir_log2_k;		///< IR distance in cm is 2^ir_log2_k * reading^-ir_exponent
+	q16_t ir_exponent;
+};
+
+/// the parameters in use
+extern HAL_LOCAL struct params params;
+
+/**
+ *	This function puts back the parameters kept in EEPROM, if there are any
+ */
+
+void params_load(void);
+
+/**
+ *	This function reads the rest of a '#' command from the base station
+ *	and carries it out
+ */
+
+void params_command(void);
+
+#endif
@@ -0,0 +1,179 @@
+/**
+ *	@file profile.c
+ *	@brief the profiler; see profile.h
+ */
+
+#include <stdint.h>
+#include "hal.h"
+#include "util.h"
+#include "timebase.h"
+#include "profile.h"
+
+/// longest name of a timed function, with its end
+#define PROF_NAME	16
+
+static const char names[PROF_COUNT][PROF_NAME] HAL_FLASH = {
+	"oi_update",
+	"checkCondition",
+	"IR_read",
+	"sonar_echo",
+	"move_servo",
+	"servo_wait",
+	"wait_ms",
+	"uprintf",
+	"lprintf",
+};
+
+/// totals of a timed function over the command running
+struct prof_total{
+	unsigned int calls;
+	uint32_t inclusive;
+	uint32_t exclusive;
+	uint32_t longest;	// inclusive time of the longest call
+};
+
+/// a call being timed
+struct prof_call{
+	unsigned char function;
+	uint32_t start;		// timebase_us() at entry
+	uint32_t inner;		// time spent in the timed calls it made
+};
+
+static HAL_LOCAL char on;
+static HAL_LOCAL char running;			// a command is being timed
+static HAL_LOCAL unsigned char key;		// of the command
+static HAL_LOCAL uint32_t command_start;		// timebase_us() when it started
+static HAL_LOCAL uint32_t timed;			// time in calls made outside any other timed call
+static HAL_LOCAL struct prof_total totals[PROF_COUNT];
+static HAL_LOCAL struct prof_call calls[PROF_DEPTH];
+static HAL_LOCAL unsigned char depth;		// calls entered and not yet left, PROF_DEPTH or more included
+
+/**
+ *	Turns the profiler on or off
+ */
+
+void prof_toggle(void)
+{
+	on = !on;
+	running = 0;	//the key that turns it off is not reported
+}
+
+/**
+ *	Tells whether the profiler is on
+ */
+
+char prof_on(void)
+{
+	return on;
+}
+
+/**
+ *	Starts timing a call. Interrupts are off meanwhile, so that a timed
+ *	call from an interrupt handler cannot come between the depth and the
+ *	call it counts.
+ */
+
+void prof_enter(unsigned char function)
+{
+	if (!running)
+	{
+		return;
+	}
+	unsigned char state = hal_interrupts_disable();
+	if (depth < PROF_DEPTH)
+	{
+		calls[depth].function = function;
+		calls[depth].inner = 0;
+		calls[depth].start = timebase_us();
+	}
+	depth++;
+	hal_interrupts_restore(state);
+}
+
+/**
+ *	Stops timing a call and adds it to the totals of its function
+ */
+
+void prof_exit(void)
+{
+	if (!running || !depth)
+	{
+		return;
+	}
+	unsigned char state = hal_interrupts_disable();
+	uint32_t now = timebase_us();
+	if (--depth < PROF_DEPTH)
+	{
+		struct prof_call *c = &calls[depth];
+		struct prof_total *t = &totals[c->function];
+		uint32_t inclusive = now - c->start;
+		t->calls++;
+		t->inclusive += inclusive;
+		t->exclusive += inclusive - c->inner;
+		if (inclusive > t->longest)
+		{
+			t->longest = inclusive;
+		}
+		if (depth)
+		{
+			calls[depth - 1].inner += inclusive;
+		}
+		else
+		{
+			timed += inclusive;
+		}
+	}
+	hal_interrupts_restore(state);
+}
+
+/**
+ *	Starts timing a command from zero
+ */
+
+void prof_command_begin(unsigned char command)
+{
+	if (!on)
+	{
+		return;
+	}
+	for (unsigned char i = 0; i < PROF_COUNT; i++)
+	{
+		totals[i].calls = 0;
+		totals[i].inclusive = 0;
+		totals[i].exclusive = 0;
+		totals[i].longest = 0;
+	}
+	key = command;
+	timed = 0;
+	depth = 0;
+	command_start = timebase_us();
+	running = 1;
+}
+
+/**
+ *	Stops timing the command and sends its totals. Timing stops first, so
+ *	sending them is not counted.
+ */
+
+void prof_command_end(void)
+{
+	if (!running)
+	{
+		return;
+	}
+	uint32_t total = timebase_us() - command_start;
+	running = 0;
+
+	uprintf("PROF %c %lu %lu\n\r", key, (unsigned long) total, (unsigned long) (total - timed));
+	for (unsigned char i = 0; i < PROF_COUNT; i++)
+	{
+		struct prof_total *t = &totals[i];
+		if (t->calls)
+		{
+			char name[PROF_NAME];
+			hal_flash_read_block(name, names[i], PROF_NAME);
+			uprintf("%s %u %lu %lu %lu\n\r", name, t->calls, (unsigned long) t->inclusive, (unsigned long) t->exclusive, (unsigned long) t->longest);
+		}
+	}
+	uprintf("END\n\r");
+}
@@ -0,0 +1,85 @@
+/**
+ *	@file profile.h
+ *	@brief the profiler, which times the calls that block the firmware and
+ *	tells the base station where each command spent its time
+ *
+ *	The timed functions call prof_enter() first thing and prof_exit() on
+ *	their way out. While the profiler is on, every call adds to its
+ *	function's totals for the command running:
+ *
+ *	inclusive	from entry to exit
+ *	exclusive	the same less the time spent in timed functions it called
+ *
+ *	Times are taken from timebase_us(), so they are in steps of 4 us (64
+ *	cycles at 16 MHz); the calls that matter for a command's latency wait
+ *	for milliseconds. When a command is done the totals go to the base
+ *	station as text, and start again from zero:
+ *
+ *	PROF key total untimed	the command's key, its time in us, and the
+ *				part of it spent outside any timed function
+ *	name calls inclusive exclusive longest	one line per timed function
+ *				called, times in us
+ *	END
+ *
+ *	host/profile.c adds the blocks of a run up into a table per command.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+/// the timed functions; their names are in profile.c
+#define PROF_OI_UPDATE		0
+#define PROF_CHECK_CONDITION	1
+#define PROF_IR_READ		2
+#define PROF_SONAR_ECHO		3	// sweep() waiting for an echo
+#define PROF_MOVE_SERVO		4
+#define PROF_SERVO_WAIT		5
+#define PROF_WAIT_MS		6
+#define PROF_UPRINTF		7
+#define PROF_LPRINTF		8
+#define PROF_COUNT		9
+
+/// timed calls that can be inside one another; deeper ones are not timed
+#define PROF_DEPTH	6
+
+/**
+ *	This function turns the profiler on or off
+ */
+
+void prof_toggle(void);
+
+/**
+ *	This function tells whether the profiler is on
+ *	@return 1 if it is on, 0 if not
+ */
+
+char prof_on(void);
+
+/**
+ *	This function starts timing a call
+ *	@param function	PROF_ constant of the function called
+ */
+
+void prof_enter(unsigned char function);
+
+/**
+ *	This function stops timing the call of the last prof_enter()
+ */
+
+void prof_exit(void);
+
+/**
+ *	This function starts timing a command
+ *	@param key	the key of the command
+ */
+
+void prof_command_begin(unsigned char key);
+
+/**
+ *	This function stops timing the command and, if the profiler is on,
+ *	sends its totals to the base station
+ */
+
+void prof_command_end(void);
+
+#endif
@@ -0,0 +1,384 @@
+/**
+ *	@file recorder.c
+ *	@brief this file contains the flight recorder, a ring buffer of the
+ *	last sensor frames, sweep samples, motion commands and keys
+ *
+ *	A sensor frame takes 52 bytes as it comes from the Create, but from one
+ *	frame to the next only the odometry and the noise on the cliff signals
+ *	change, by a few counts each. Coded as changes, a frame usually takes
+ *	about 10 bytes. Most frames tell nothing new but how far the robot
+ *	went, so a frame is held back while only its distance, its angle and
+ *	the noise of bands[] differ from the last one recorded; the frames held
+ *	back then go in as one REC_RUN of 8 bytes or so, for up to 255 frames.
+ *	That is what makes the ring last minutes instead of seconds.
+ */
+
+#include <string.h>
+#include "hal.h"
+#include "util.h"
+#include "timebase.h"
+#include "recorder.h"
+
+/// marks a saved ring in EEPROM; change it when the record layout changes
+#define REC_MAGIC	0x4EC2
+
+/// what is known of a saved ring, read and written without its data
+struct rec_saved_header{
+	uint16_t magic;
+	uint16_t used;
+	uint32_t time;		//timebase_ms() when it was saved
+};
+
+/// the ring as saved in EEPROM
+struct rec_saved{
+	struct rec_saved_header header;
+	unsigned char data[REC_SIZE];
+};
+
+static HAL_LOCAL struct rec_saved EEMEM rec_eeprom;
+
+static HAL_LOCAL unsigned char ring[REC_SIZE];
+static HAL_LOCAL volatile unsigned int head;		// where the next record goes
+static HAL_LOCAL volatile unsigned int tail;		// oldest record
+static HAL_LOCAL volatile unsigned int used;		// bytes between them
+static HAL_LOCAL uint32_t last_time;			// timebase_ms() of the last record
+static HAL_LOCAL uint32_t total;				// bytes recorded since the start
+static HAL_LOCAL volatile char paused;			// set while the ring is being sent
+static HAL_LOCAL unsigned char last_frame[REC_FRAME_BYTES];
+static HAL_LOCAL uint32_t keyframe_total;		// total when the last keyframe was recorded
+static HAL_LOCAL char have_frame;				// last_frame holds a frame
+static HAL_LOCAL unsigned char held;			// frames like last_frame not recorded yet
+static HAL_LOCAL int16_t held_distance;			// their distances added up
+static HAL_LOCAL int16_t held_angle;			// and their angles
+static HAL_LOCAL uint32_t held_time;			// timebase_ms() of the last of them
+
+/// a noisy sensor value, and how far it moves before it counts as a change
+struct rec_band{
+	unsigned char offset;		// of its high byte in the frame
+	unsigned char band;
+};
+
+/// the noisy values of packet group 6, in frame order; all are 2 bytes
+static const struct rec_band bands[] = {
+	{17, 100},	// voltage, mV
+	{19, 100},	// current, mA
+	{22, 10},	// charge, mAh
+	{26, 16},	// wall signal
+	{28, 16},	// cliff signals
+	{30, 16},
+	{32, 16},
+	{34, 16},
+	{37, 8},	// cargo bay analog input
+};
+
+static int16_t rec_get16(const unsigned char *p)
+{
+	return (int16_t) (p[0] << 8 | p[1]);
+}
+
+static void rec_put16(unsigned char *p, uint16_t value)
+{
+	p[0] = value >> 8;
+	p[1] = value;
+}
+
+/**
+ *	Whether a frame tells nothing last_frame does not, but for its
+ *	distance and angle and the noise on the values of bands[]
+ */
+
+static char rec_unchanged(const unsigned char *frame)
+{
+	unsigned char b = 0;
+	for (unsigned char i = 0; i < REC_FRAME_BYTES; i++)
+	{
+		if (i == REC_DISTANCE || i == REC_ANGLE)
+		{
+			i++;
+		}
+		else if (b < sizeof(bands) / sizeof(bands[0]) && i == bands[b].offset)
+		{
+			int change = rec_get16(frame + i) - rec_get16(last_frame + i);
+			if (change > bands[b].band || change < -bands[b].band)
+			{
+				return 0;
+			}
+			b++;
+			i++;
+		}
+		else if (frame[i] != last_frame[i])
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ *	Puts a record into the ring with its time, dropping the oldest records
+ *	to make room. A keyframe's body starts with 4 bytes left for the time.
+ *	Interrupts have to be off.
+ */
+
+static void rec_put(unsigned char kind, unsigned char *body, unsigned char length, uint32_t now)
+{
+	unsigned char header[7];
+	uint32_t dt = now - last_time;
+	last_time = now;
+
+	unsigned char n = 1;
+	header[n++] = kind;
+	while (dt >= 0x80)
+	{
+		header[n++] = (dt & 0x7F) | 0x80;
+		dt >>= 7;
+	}
+	header[n++] = dt;
+	header[0] = n + length;
+	if (kind == REC_KEYFRAME)
+	{
+		for (unsigned char i = 0; i < 4; i++)
+		{
+			body[i] = now >> (i * 8);	//low byte first
+		}
+	}
+
+	while (REC_SIZE - used < header[0])
+	{
+		unsigned char dropped = ring[tail];
+		tail = (tail + dropped) % REC_SIZE;
+		used -= dropped;
+	}
+	for (unsigned char i = 0; i < header[0]; i++)
+	{
+		ring[head] = i < n ? header[i] : body[i - n];
+		head = (head + 1) % REC_SIZE;
+	}
+	used += header[0];
+	total += header[0];
+}
+
+/**
+ *	Records the frames held back, if there are any, at the time of the
+ *	last of them. Interrupts have to be off.
+ */
+
+static void rec_flush(void)
+{
+	if (held)
+	{
+		unsigned char body[5];
+		body[0] = held;
+		rec_put16(body + 1, held_distance);
+		rec_put16(body + 3, held_angle);
+		rec_put(REC_RUN, body, sizeof(body), held_time);
+		held = 0;
+		held_distance = held_angle = 0;
+	}
+}
+
+/**
+ *	Records something at the current time, after the frames held back. The
+ *	time is taken with interrupts off, so a key recorded from an interrupt
+ *	cannot come between the time and the place of a record.
+ */
+
+static void rec_end(unsigned char kind, unsigned char *body, unsigned char length)
+{
+	unsigned char state = hal_interrupts_disable();
+	if (!paused)
+	{
+		rec_flush();
+		rec_put(kind, body, length, timebase_ms());
+	}
+	hal_interrupts_restore(state);
+}
+
+/**
+ *	Records a sensor frame, or holds it back if it is like the last one
+ */
+
+void rec_frame(const unsigned char *frame)
+{
+	static HAL_LOCAL unsigned char body[4 + REC_CODED_MAX];	//4 for a keyframe's time
+	static const unsigned char zeros[REC_FRAME_BYTES];
+	unsigned char kind, length;
+
+	char key = !have_frame || total - keyframe_total >= REC_KEY_BYTES;
+	if (!key && rec_unchanged(frame))
+	{
+		unsigned char state = hal_interrupts_disable();
+		if (!paused)
+		{
+			held_distance += rec_get16(frame + REC_DISTANCE);
+			held_angle += rec_get16(frame + REC_ANGLE);
+			held_time = timebase_ms();
+			if (++held == 255)
+			{
+				rec_flush();
+			}
+		}
+		hal_interrupts_restore(state);
+		return;
+	}
+
+	if (key)
+	{
+		kind = REC_KEYFRAME;
+		length = 4 + rec_encode_frame(zeros, frame, body + 4);
+		keyframe_total = total;
+		have_frame = 1;
+	}
+	else
+	{
+		kind = REC_FRAME;
+		length = rec_encode_frame(last_frame, frame, body);
+	}
+	memcpy(last_frame, frame, REC_FRAME_BYTES);
+	rec_end(kind, body, length);
+}
+
+/**
+ *	Records an oi_set_wheels() command
+ */
+
+void rec_wheels(int16_t right, int16_t left)
+{
+	unsigned char body[4];
+	rec_put16(body, right);
+	rec_put16(body + 2, left);
+	rec_end(REC_WHEELS, body, sizeof(body));
+}
+
+/**
+ *	Records an oi_drive() command
+ */
+
+void rec_drive(int16_t velocity, int16_t radius)
+{
+	unsigned char body[4];
+	rec_put16(body, velocity);
+	rec_put16(body + 2, radius);
+	rec_end(REC_DRIVE, body, sizeof(body));
+}
+
+/**
+ *	Records one sample of a sweep in every REC_SWEEP_STEP
+ */
+
+void rec_sweep(unsigned char degree, uint16_t ir, uint16_t echo)
+{
+	if (degree % REC_SWEEP_STEP)
+	{
+		return;
+	}
+	unsigned char body[5];
+	body[0] = degree;
+	rec_put16(body + 1, ir);
+	rec_put16(body + 3, echo);
+	rec_end(REC_SWEEP, body, sizeof(body));
+}
+
+/**
+ *	Records a byte from the base station; the record is a few bytes, as
+ *	this runs in the receive interrupt
+ */
+
+void rec_key(unsigned char key)
+{
+	rec_end(REC_KEY, &key, 1);
+}
+
+/**
+ *	Sends bytes as hex, 32 to a line
+ */
+
+static void rec_hex(unsigned char data, unsigned int i, unsigned int count)
+{
+	uprintf("%02x", data);
+	if (i % 32 == 31 || i == count - 1)
+	{
+		uprintf("\n\r");
+	}
+}
+
+/**
+ *	Records the frames held back, so the ring can be sent or saved
+ */
+
+static void rec_settle(void)
+{
+	unsigned char state = hal_interrupts_disable();
+	rec_flush();
+	hal_interrupts_restore(state);
+}
+
+/**
+ *	Sends the ring to the base station
+ */
+
+void rec_dump(void)
+{
+	rec_settle();
+	paused = 1;		//records made meanwhile would overwrite what is being sent
+	uprintf("REC %u %lu\n\r", used, (unsigned long) timebase_ms());
+	for (unsigned int i = 0; i < used; i++)
+	{
+		rec_hex(ring[(tail + i) % REC_SIZE], i, used);
+	}
+	uprintf("END\n\r");
+	paused = 0;
+}
+
+/**
+ *	Copies the ring to EEPROM
+ */
+
+void rec_save(void)
+{
+	rec_settle();
+	paused = 1;
+	unsigned int first = REC_SIZE - tail < used ? REC_SIZE - tail : used;
+	hal_eeprom_update_block(ring + tail, rec_eeprom.data, first);
+	hal_eeprom_update_block(ring, rec_eeprom.data + first, used - first);
+
+	struct rec_saved_header header;
+	header.magic = REC_MAGIC;
+	header.used = used;
+	header.time = timebase_ms();
+	hal_eeprom_update_block(&header, &rec_eeprom.header, sizeof(header));
+	paused = 0;
+	uprintf("Saved %u bytes of the recorder\n\r", header.used);
+}
+
+/**
+ *	Sends the copy in EEPROM to the base station
+ */
+
+void rec_dump_saved(void)
+{
+	struct rec_saved_header header;
+	hal_eeprom_read_block(&header, &rec_eeprom.header, sizeof(header));
+	if (header.magic != REC_MAGIC || header.used > REC_SIZE)
+	{
+		uprintf("No recording saved\n\r");
+		return;
+	}
+	uprintf("REC %u %lu\n\r", header.used, (unsigned long) header.time);
+	for (unsigned int i = 0; i < header.used; i++)
+	{
+		unsigned char data;
+		hal_eeprom_read_block(&data, rec_eeprom.data + i, 1);
+		rec_hex(data, i, header.used);
+	}
+	uprintf("END\n\r");
+}
+
+/**
+ *	Returns how many bytes have been recorded since the start
+ */
+
+uint32_t rec_total(void)
+{
+	return total;
+}
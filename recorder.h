@@ -0,0 +1,160 @@
+/**
+ *	@file recorder.h
+ *	@brief this is the header file of the flight recorder, which keeps the
+ *	last sensor frames, sweep samples, motion commands and keys in a ring
+ *	buffer so a mission can be looked at after it went wrong
+ *
+ *	Every record is
+ *
+ *	length	1 byte, the whole record included
+ *	kind	1 byte, one of the REC_ codes below
+ *	time	milliseconds since the record before, 7 bits per byte, low
+ *		bits first, the top bit set on every byte but the last
+ *	body	depends on the kind
+ *
+ *	REC_KEYFRAME	absolute time in ms (4 bytes, low first), then the
+ *			sensor frame coded against a frame of zeros
+ *	REC_FRAME	the 52 raw bytes of a sensor frame, coded against the
+ *			frame before (see rec_encode_frame())
+ *	REC_RUN		count (1 byte), distance and angle added up (2 bytes
+ *			each, high first) of frames the same as the frame
+ *			before but for those two and a little noise; timed
+ *			at the last of them
+ *	REC_WHEELS	right and left wheel speeds, 2 bytes each, high first
+ *	REC_DRIVE	velocity and radius, 2 bytes each, high first
+ *	REC_SWEEP	degree, IR distance in 1/100 cm (2 bytes), sonar echo
+ *			in Timer1 counts (2 bytes), high first; one every
+ *			REC_SWEEP_STEP degrees
+ *	REC_KEY		byte received from the base station
+ *
+ *	When the ring is full the oldest records are dropped. The first sensor
+ *	frame after REC_KEY_BYTES have been recorded is a keyframe, so the
+ *	frames can be decoded again from the first keyframe left in the ring.
+ *	Driving on open floor takes a few bytes a second and a sweep about 280
+ *	bytes, so the ring holds about 3 minutes of the reference world's
+ *	mission.
+ */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdint.h>
+
+/// bytes of SRAM the ring takes
+#define REC_SIZE	1024
+/// bytes of a sensor frame (packet group 6)
+#define REC_FRAME_BYTES	52
+/// longest frame rec_encode_frame() codes, every value changed by a lot
+#define REC_CODED_MAX	76
+/// a keyframe after this many bytes of records, a quarter of the ring
+#define REC_KEY_BYTES	256
+/// degrees between the sweep samples recorded
+#define REC_SWEEP_STEP	6
+/// where distance and angle are in a sensor frame
+#define REC_DISTANCE	12
+#define REC_ANGLE	14
+
+#define REC_KEYFRAME	1
+#define REC_FRAME	2
+#define REC_WHEELS	3
+#define REC_DRIVE	4
+#define REC_SWEEP	5
+#define REC_KEY		6
+#define REC_RUN		7
+
+/**
+ *	This function records a sensor frame as it came from the Create, or
+ *	holds it back for a REC_RUN if it is like the one before
+ *	@param frame	the 52 bytes of packet group 6
+ */
+
+void rec_frame(const unsigned char *frame);
+
+/**
+ *	This function records an oi_set_wheels() command
+ *	@param right	right wheel speed in mm/s
+ *	@param left	left wheel speed in mm/s
+ */
+
+void rec_wheels(int16_t right, int16_t left);
+
+/**
+ *	This function records an oi_drive() command
+ *	@param velocity	speed in mm/s
+ *	@param radius	radius in mm
+ */
+
+void rec_drive(int16_t velocity, int16_t radius);
+
+/**
+ *	This function records one sample of a sweep, if its degree is a
+ *	multiple of REC_SWEEP_STEP
+ *	@param degree	servo position
+ *	@param ir	IR distance in 1/100 cm
+ *	@param echo	sonar echo length in Timer1 counts, 0 if no echo came back
+ */
+
+void rec_sweep(unsigned char degree, uint16_t ir, uint16_t echo);
+
+/**
+ *	This function records a byte from the base station; it may be called
+ *	from an interrupt handler
+ *	@param key	the byte
+ */
+
+void rec_key(unsigned char key);
+
+/**
+ *	This function sends the ring to the base station as hex, between a
+ *	"REC <bytes> <time>" line and an "END" line
+ */
+
+void rec_dump(void);
+
+/**
+ *	This function copies the ring to EEPROM, where it outlives a reset.
+ *	It takes about 8.5 ms per byte that changed.
+ */
+
+void rec_save(void);
+
+/**
+ *	This function sends the copy in EEPROM to the base station, as rec_dump() does
+ */
+
+void rec_dump_saved(void);
+
+/**
+ *	This function returns how many bytes have been recorded since the start
+ *	@return bytes recorded, the dropped ones included
+ */
+
+uint32_t rec_total(void);
+
+/**
+ *	This function codes a sensor frame as the changes from the frame before.
+ *	The frame is split into its 36 sensor values. A group byte has bit g
+ *	set for each group of 8 values with a change, and a change byte for
+ *	each such group has bit i set for each value i that changed. Then, in
+ *	4-bit steps, each change: the difference from the old value, zigzag
+ *	coded (0, -1, 1, -2 ... as 0, 1, 2, 3 ...), if that is 1 to 14, or 15
+ *	and the new value in 2 or 4 steps. The coding is in framecode.c,
+ *	which needs nothing else, so host tools can link it alone.
+ *	@param prev	the frame before
+ *	@param frame	the new frame
+ *	@param out	room for REC_CODED_MAX bytes
+ *	@return bytes written to out
+ */
+
+unsigned char rec_encode_frame(const unsigned char *prev, const unsigned char *frame, unsigned char *out);
+
+/**
+ *	This function undoes rec_encode_frame()
+ *	@param frame	the frame before, replaced by the decoded one
+ *	@param in	the coded frame
+ *	@return bytes read from in
+ */
+
+unsigned char rec_decode_frame(unsigned char *frame, const unsigned char *in);
+
+#endif
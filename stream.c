@@ -0,0 +1,161 @@
+/**
+ *	@file stream.c
+ *	@brief printf that writes straight into a byte sink
+ *
+ *	Each field is converted right to left into a small buffer and then
+ *	padded and written out; the literal text between fields goes to the
+ *	sink as it is read.
+ */
+
+#include <stdint.h>
+#include "fixmath.h"
+#include "stream.h"
+
+/// large enough for "-2147483648" and for q16_format()
+#define FIELD_SIZE	12
+
+/**
+ *	This function writes a number in front of end, most significant digit first
+ *	@return the first digit
+ */
+
+static char *digits(char *end, unsigned long value, uint8_t base)
+{
+	*end = 0;
+	do
+	{
+		uint8_t d = (uint8_t) (value % base);
+		*--end = (char) (d < 10 ? '0' + d : 'a' + d - 10);
+		value /= base;
+	} while (value);
+	return end;
+}
+
+/**
+ *	This function writes one converted field, padded to its width
+ */
+
+static void emit(stream_sink put, const char *text, uint8_t width, char left, char pad)
+{
+	uint8_t length = 0;
+	while (text[length])
+	{
+		length++;
+	}
+
+	//zeros go between the sign and the digits
+	if (pad == '0' && !left && text[0] == '-')
+	{
+		put('-');
+		text++;
+		length--;
+		if (width)
+		{
+			width--;
+		}
+	}
+	for (; !left && width > length; width--)
+	{
+		put(pad);
+	}
+	while (*text)
+	{
+		put(*text++);
+	}
+	for (; left && width > length; width--)
+	{
+		put(' ');
+	}
+}
+
+void stream_vprintf(stream_sink put, const char *format, va_list args)
+{
+	char field[FIELD_SIZE];
+	char *end = field + FIELD_SIZE - 1;
+
+	for (; *format; format++)
+	{
+		if (*format != '%')
+		{
+			put(*format);
+			continue;
+		}
+
+		//%[-][0][width][l]type
+		char left = 0;
+		char pad = ' ';
+		char is_long = 0;
+		uint8_t width = 0;
+		const char *text = field;
+
+		format++;
+		if (*format == '-')
+		{
+			left = 1;
+			format++;
+		}
+		if (*format == '0')
+		{
+			pad = '0';
+			format++;
+		}
+		while (*format >= '0' && *format <= '9')
+		{
+			width = width * 10 + (*format++ - '0');
+		}
+		if (*format == 'l')
+		{
+			is_long = 1;
+			format++;
+		}
+
+		switch (*format)
+		{
+		case 'd':
+		case 'i':
+		{
+			long value = is_long ? va_arg(args, long) : va_arg(args, int);
+			char *first = digits(end, value < 0 ? -(unsigned long) value : (unsigned long) value, 10);
+			if (value < 0)
+			{
+				*--first = '-';
+			}
+			text = first;
+			break;
+		}
+		case 'u':
+		case 'x':
+		{
+			unsigned long value = is_long ? va_arg(args, unsigned long) : va_arg(args, unsigned int);
+			text = digits(end, value, *format == 'x' ? 16 : 10);
+			break;
+		}
+		case 'q':
+			q16_format(field, va_arg(args, q16_t));
+			break;
+		case 's':
+			text = va_arg(args, const char *);
+			break;
+		case 'c':
+			field[0] = (char) va_arg(args, int);
+			field[1] = 0;
+			break;
+		case 0:
+			return;		// the format ended inside a conversion
+		default:
+			//%% and anything unknown print themselves
+			field[0] = *format;
+			field[1] = 0;
+			break;
+		}
+		emit(put, text, width, left, pad);
+	}
+}
+
+void stream_printf(stream_sink put, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	stream_vprintf(put, format, args);
+	va_end(args);
+}
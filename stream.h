@@ -0,0 +1,40 @@
+/**
+ *	@file stream.h
+ *	@brief printf that writes straight into a byte sink
+ *
+ *	stream_printf() hands every character to a sink function as soon as it
+ *	is formatted, so a message never has to fit into a buffer first. Only
+ *	the field being converted is held, in 12 bytes on the stack.
+ *
+ *	Conversions are %[-][0][width][l]type with type one of:
+ *
+ *	d, i	signed integer (long with l)
+ *	u, x	unsigned integer in decimal or hexadecimal (long with l)
+ *	q	q16_t with two decimals, as "%.2f" would print the number
+ *	c, s	character and string
+ *	%	a percent sign
+ *
+ *	There is no floating point support; numbers with a fraction are printed
+ *	from fixed point with %q.
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdarg.h>
+
+/// takes one byte of formatted output
+typedef void (*stream_sink)(unsigned char data);
+
+/**
+ *	This function formats a message into a sink, character by character
+ *	@param put	function that takes each character
+ *	@param format	format of the message, see above
+ */
+
+void stream_printf(stream_sink put, const char *format, ...);
+
+/// stream_printf() with the arguments already collected
+void stream_vprintf(stream_sink put, const char *format, va_list args);
+
+#endif
@@ -0,0 +1,138 @@
+/**
+ *	@file sweepblock.c
+ *	@brief sweep samples sent as link frames; see sweepblock.h
+ */
+
+#include "sweepblock.h"
+
+/// bytes the longest sample takes, two 32-bit differences of 5 bytes each
+#define SAMPLE_MAX	10
+
+/**
+ *	Puts the difference of a value from the one before
+ */
+
+static void put_difference(struct sweep_block *b, int32_t value, int32_t before)
+{
+	int32_t d = (int32_t) ((uint32_t) value - (uint32_t) before);
+	uint32_t zigzag = ((uint32_t) d << 1) ^ (uint32_t) (d >> 31);
+	while (zigzag >= 0x80)
+	{
+		b->data[b->length++] = (zigzag & 0x7F) | 0x80;
+		zigzag >>= 7;
+	}
+	b->data[b->length++] = zigzag;
+}
+
+/**
+ *	Sends the block and starts the next
+ */
+
+static void send_block(struct sweep_block *b, char last)
+{
+	b->data[1] = last;
+	link_send(b->put, LINK_SWEEP, b->seq++, b->data, b->length);
+	b->length = 0;
+}
+
+/**
+ *	Starts the blocks of a sweep
+ */
+
+void sweep_block_begin(struct sweep_block *b, stream_sink put)
+{
+	b->put = put;
+	b->seq = 0;
+	b->data[0] = 0;
+	b->length = 2;
+	send_block(b, 0);	//block 0, with no samples, says a sweep started
+	b->count = 0;
+}
+
+/**
+ *	Adds a sample
+ */
+
+void sweep_block_add(struct sweep_block *b, unsigned char degree, int32_t ir, int32_t sonar)
+{
+	if (b->length + SAMPLE_MAX > LINK_PAYLOAD || b->count == SWEEP_BLOCK_SAMPLES)
+	{
+		send_block(b, 0);
+	}
+	if (b->length == 0)
+	{
+		b->data[0] = degree;
+		b->length = 2;
+		b->count = 0;
+		b->ir = 0;
+		b->sonar = 0;
+	}
+	b->count++;
+	put_difference(b, ir, b->ir);
+	put_difference(b, sonar, b->sonar);
+	b->ir = ir;
+	b->sonar = sonar;
+}
+
+/**
+ *	Sends the last block
+ */
+
+void sweep_block_end(struct sweep_block *b)
+{
+	if (b->length == 0)
+	{
+		b->data[0] = 0;		//no samples, only to say the sweep ended
+		b->length = 2;
+	}
+	send_block(b, 1);
+}
+
+/**
+ *	Reads a difference; returns the bytes it took, or 0 if it runs past the end
+ */
+
+static unsigned char get_difference(const unsigned char *in, unsigned char left, int32_t *value)
+{
+	uint32_t zigzag = 0;
+	unsigned char n = 0;
+	do
+	{
+		if (n == left || n == 5)
+		{
+			return 0;
+		}
+		zigzag |= (uint32_t) (in[n] & 0x7F) << (7 * n);
+	} while (in[n++] & 0x80);
+	*value = (int32_t) ((uint32_t) *value + ((zigzag >> 1) ^ -(zigzag & 1)));
+	return n;
+}
+
+/**
+ *	Reads the samples of a block
+ */
+
+int sweep_block_read(const unsigned char *payload, unsigned char length, struct sweep_sample *out, char *last)
+{
+	if (length < 2 || payload[1] > 1)
+	{
+		return -1;
+	}
+	*last = payload[1];
+	int32_t ir = 0, sonar = 0;
+	int count = 0;
+	for (unsigned char at = 2; at < length; count++)
+	{
+		unsigned char n = get_difference(payload + at, length - at, &ir);
+		unsigned char m = n ? get_difference(payload + at + n, length - at - n, &sonar) : 0;
+		if (!m || count == SWEEP_BLOCK_SAMPLES)
+		{
+			return -1;
+		}
+		at += n + m;
+		out[count].degree = payload[0] + count;
+		out[count].ir = ir;
+		out[count].sonar = sonar;
+	}
+	return count;
+}
@@ -0,0 +1,92 @@
+/**
+ *	@file sweepblock.h
+ *	@brief sweep samples sent as link frames (link.h) instead of text
+ *
+ *	A sweep in text takes about 30 bytes a degree. In blocks, the samples
+ *	go out as LINK_SWEEP frames while the sweep goes on, each once it has
+ *	SWEEP_BLOCK_SAMPLES samples or the next might not fit. The seq of the
+ *	frames counts the blocks of a sweep from 0; block 0 has no samples and
+ *	goes out when the sweep starts, as the heading of the text table does.
+ *	The payload is
+ *
+ *	degree		1 byte, of the first sample
+ *	last		1 byte, 1 on the last block of the sweep, else 0
+ *	samples	for each degree from the first on, the IR and then the
+ *		sonar distance, in hundredths of a centimeter rounded as %q
+ *		prints them (a sonar distance of 0 is no echo), each as its difference from the sample before
+ *		(from 0 for the first of the block), zigzag coded and sent 7
+ *		bits per byte, low bits first, the top bit set on every byte
+ *		but the last
+ *
+ *	so a block can be read without the ones before it, and a lost block
+ *	loses only its own samples. Samples that change little take 2 or 3
+ *	bytes.
+ *
+ *	The coding needs nothing but link.c, so host tools can read blocks
+ *	too.
+ */
+
+#ifndef SWEEPBLOCK_H
+#define SWEEPBLOCK_H
+
+#include <stdint.h>
+#include "stream.h"
+#include "link.h"
+
+/// most samples a block holds, so the base station sees a sweep come in as it goes
+#define SWEEP_BLOCK_SAMPLES	16
+
+/// one sample, in hundredths of a centimeter
+struct sweep_sample{
+	unsigned char degree;
+	int32_t ir;
+	int32_t sonar;
+};
+
+/// a block being filled
+struct sweep_block{
+	stream_sink put;		// where the frames go
+	unsigned char seq;		// of the block being filled
+	unsigned char length;		// bytes of data, 0 before its first sample
+	unsigned char count;		// samples in it
+	int32_t ir, sonar;		// last sample, which the next is coded against
+	unsigned char data[LINK_PAYLOAD];
+};
+
+/**
+ *	This function starts the blocks of a sweep and sends block 0
+ *	@param b	the block
+ *	@param put	function that takes each byte of the frames
+ */
+
+void sweep_block_begin(struct sweep_block *b, stream_sink put);
+
+/**
+ *	This function adds a sample, sending the block first if it might not fit
+ *	@param b	the block
+ *	@param degree	servo degree; one more than the sample before
+ *	@param ir	IR distance in hundredths of a centimeter
+ *	@param sonar	sonar distance in hundredths of a centimeter
+ */
+
+void sweep_block_add(struct sweep_block *b, unsigned char degree, int32_t ir, int32_t sonar);
+
+/**
+ *	This function sends the last block of a sweep
+ *	@param b	the block
+ */
+
+void sweep_block_end(struct sweep_block *b);
+
+/**
+ *	This function reads the samples of a LINK_SWEEP payload
+ *	@param payload	the payload
+ *	@param length	its bytes
+ *	@param out	room for SWEEP_BLOCK_SAMPLES samples
+ *	@param last	set to 1 if it is the last block of a sweep, else 0
+ *	@return the number of samples, or -1 if the payload is not a block
+ */
+
+int sweep_block_read(const unsigned char *payload, unsigned char length, struct sweep_sample *out, char *last);
+
+#endif
@@ -0,0 +1,17 @@
+/**
+ *	@file thresholds.c
+ *	@brief this file contains the default signal bands, as measured on the
+ *	lab Creates
+ */
+
+#include "thresholds.h"
+
+//left, front left, front right, right
+#define THRESHOLDS_DEFAULT {						\
+	.tape = {{280, 370}, {650, 780}, {200, 250}, {500, 600}},	\
+	.dest = {{500, 650}, {1000, 1420}, {300, 400}, {800, 950}},	\
+	.ir = {5, 50},							\
+}
+
+HAL_LOCAL struct thresholds thresholds = THRESHOLDS_DEFAULT;
+const struct thresholds thresholds_default HAL_FLASH = THRESHOLDS_DEFAULT;
@@ -0,0 +1,53 @@
+/**
+ *	@file thresholds.h
+ *	@brief this is the header file that contains the signal bands the robot
+ *	tells tape, the destination pad and objects apart with
+ *
+ *	The bands used to be written into the checks themselves. They are kept
+ *	here instead so the host tools can try other values against the same
+ *	firmware, and the base station can tune them on the robot as
+ *	parameters (params.h).
+ */
+
+#ifndef THRESHOLDS_H
+#define THRESHOLDS_H
+
+#include "hal.h"
+
+/// cliff sensors, in the order of the bands below
+#define SENSE_LEFT		0
+#define SENSE_FRONTLEFT		1
+#define SENSE_FRONTRIGHT	2
+#define SENSE_RIGHT		3
+#define SENSE_CLIFFS		4
+
+/// a range of readings, both ends excluded
+struct band{
+	int lo;
+	int hi;
+};
+
+struct thresholds{
+	struct band tape[SENSE_CLIFFS];		///< cliff signal over white tape
+	struct band dest[SENSE_CLIFFS];		///< cliff signal over the destination pad
+	struct band ir;				///< IR distance of an object in a sweep, cm
+};
+
+/// the bands in use
+extern HAL_LOCAL struct thresholds thresholds;
+/// the bands measured on the lab Creates, in flash (hal_flash_read_block())
+extern const struct thresholds thresholds_default HAL_FLASH;
+
+/**
+ *	This function checks whether a reading is inside a band
+ *	@param b	band to check against
+ *	@param value	reading
+ *	@return 1 if lo < value < hi, 0 otherwise
+ */
+
+static inline int in_band(const struct band *b, int value)
+{
+	return value > b->lo && value < b->hi;
+}
+
+#endif
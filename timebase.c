@@ -0,0 +1,160 @@
+/**
+ *	@file timebase.c
+ *	@brief monotonic clock and software timers on Timer2
+ */
+
+#include "hal.h"
+#include "timebase.h"
+
+static HAL_LOCAL volatile char running;			// Timer2 has been started
+static HAL_LOCAL volatile uint32_t ticks;			// milliseconds since it was
+static HAL_LOCAL struct timer *wheel[TIMER_SLOTS];	// pending timers by due & (TIMER_SLOTS - 1)
+
+/**
+ * 	Starts the 1 ms Timer2 interrupt the first time the clock is used
+ */
+
+void timebase_init(void)
+{
+	if (!running)
+	{
+		running = 1;
+		hal_timer2_start(0, 249);	//Clock is 16 MHz. At a prescaler of 64, 250 timer ticks = 1ms.
+		hal_interrupts_enable();
+	}
+}
+
+/**
+ * 	Returns the milliseconds since the clock started
+ */
+
+uint32_t timebase_ms(void)
+{
+	uint32_t ms;
+	timebase_init();
+	do
+	{
+		ms = ticks;
+	} while (ms != ticks);		//read again if the interrupt changed it halfway
+	return ms;
+}
+
+/**
+ * 	Returns the microseconds since the clock started
+ */
+
+uint32_t timebase_us(void)
+{
+	uint32_t ms;
+	unsigned char count;
+	timebase_init();
+	do
+	{
+		ms = ticks;
+		count = hal_timer2_count();
+	} while (ms != ticks);		//the count went back to 0 in between
+	return ms * 1000 + count * 4;
+}
+
+/**
+ * 	Puts a timer into the wheel slot of its due time; interrupts must be off
+ */
+
+static void timer_insert(struct timer *timer)
+{
+	struct timer **slot = &wheel[timer->due & (TIMER_SLOTS - 1)];
+	timer->next = *slot;
+	*slot = timer;
+	timer->pending = 1;
+}
+
+/**
+ * 	Takes a pending timer off the wheel; interrupts must be off
+ */
+
+static void timer_remove(struct timer *timer)
+{
+	struct timer **link = &wheel[timer->due & (TIMER_SLOTS - 1)];
+	while (*link && *link != timer)
+	{
+		link = &(*link)->next;
+	}
+	if (*link)
+	{
+		*link = timer->next;
+	}
+	timer->pending = 0;
+}
+
+/**
+ * 	(Re)starts a timer
+ */
+
+void timer_start(struct timer *timer, unsigned int delay, unsigned int period, timer_fn fn, void *arg)
+{
+	timebase_init();
+	unsigned char state = hal_interrupts_disable();
+	if (timer->pending)
+	{
+		timer_remove(timer);
+	}
+	timer->due = ticks + (delay ? delay : 1);
+	timer->period = period;
+	timer->fn = fn;
+	timer->arg = arg;
+	timer_insert(timer);
+	hal_interrupts_restore(state);
+}
+
+/**
+ * 	Stops a timer
+ */
+
+void timer_stop(struct timer *timer)
+{
+	unsigned char state = hal_interrupts_disable();
+	if (timer->pending)
+	{
+		timer_remove(timer);
+	}
+	hal_interrupts_restore(state);
+}
+
+/**
+ * 	Counts one millisecond and runs the timers that are due. They are taken
+ * 	off their slot first, so a timer function may start or stop any timer,
+ * 	itself included.
+ */
+
+ISR (TIMER2_COMP_vect)
+{
+	uint32_t now = ++ticks;
+	struct timer *due = 0;
+	struct timer **link = &wheel[now & (TIMER_SLOTS - 1)];
+	while (*link)
+	{
+		struct timer *timer = *link;
+		if (timer->due == now)
+		{
+			*link = timer->next;
+			timer->pending = 0;
+			timer->next = due;
+			due = timer;
+		}
+		else
+		{
+			link = &timer->next;	//due on a later turn of the wheel
+		}
+	}
+	while (due)
+	{
+		struct timer *timer = due;
+		due = timer->next;
+		if (timer->period)
+		{
+			timer->due = now + timer->period;
+			timer_insert(timer);
+		}
+		timer->fn(timer->arg);
+	}
+}
@@ -0,0 +1,80 @@
+/**
+ *	@file timebase.h
+ *	@brief monotonic clock and software timers on Timer2
+ *
+ *	Timer2 interrupts once a millisecond from the first time the clock is
+ *	used and never stops. timebase_ms() counts those interrupts, and
+ *	timebase_us() adds the Timer2 count in between, so it moves in steps of
+ *	4 us. Both wrap around (after 49 days and 71 minutes); compare times by
+ *	subtracting them, never with < or >.
+ *
+ *	A timer calls a function once a given number of milliseconds from now,
+ *	and after that every period milliseconds if it has one. The timers sit
+ *	on a wheel of TIMER_SLOTS lists indexed by the millisecond they are due,
+ *	so each tick only looks at the timers due around then. Timer functions
+ *	run inside the Timer2 interrupt: they must be short and must not wait.
+ */
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <stdint.h>
+
+/// number of lists on the timer wheel; must be a power of two
+#define TIMER_SLOTS 16
+
+/// function a timer calls when it is due
+typedef void (*timer_fn)(void *arg);
+
+/// one software timer; the caller owns the memory, which must outlive the timer
+struct timer{
+	struct timer *next;	// next timer in the same slot
+	uint32_t due;		// timebase_ms() at which it runs next
+	unsigned int period;	// milliseconds between runs, 0 to run once
+	char pending;		// on the wheel
+	timer_fn fn;
+	void *arg;
+};
+
+/**
+ *	This function starts the clock if it is not running yet. Every other
+ *	function here calls it, so it only needs calling to start counting early.
+ */
+
+void timebase_init(void);
+
+/**
+ *	This function returns the time since the clock started
+ *	@return milliseconds since the clock started
+ */
+
+uint32_t timebase_ms(void);
+
+/**
+ *	This function returns the time since the clock started, to 4 us. Called
+ *	from an interrupt handler it may be up to a millisecond behind.
+ *	@return microseconds since the clock started
+ */
+
+uint32_t timebase_us(void);
+
+/**
+ *	This function (re)starts a timer. If it was already pending it is
+ *	moved to the new time.
+ *	@param timer	the timer
+ *	@param delay	milliseconds until fn runs the first time, at least 1
+ *	@param period	milliseconds between later runs, or 0 to run once
+ *	@param fn	function to run, from the Timer2 interrupt
+ *	@param arg	passed to fn
+ */
+
+void timer_start(struct timer *timer, unsigned int delay, unsigned int period, timer_fn fn, void *arg);
+
+/**
+ *	This function stops a timer; it does nothing if the timer is not pending
+ *	@param timer	the timer
+ */
+
+void timer_stop(struct timer *timer);
+
+#endif
@@ -0,0 +1,119 @@
+/**
+ *	@file trajectory.c
+ *	@brief this file contains the functions that drive a chain of lines,
+ *	arcs and turns as one continuous motion
+ *
+ *	Every segment is a single OI drive command (velocity and radius), so a
+ *	trajectory costs one five byte command per segment and the wheels never
+ *	stop between segments. Progress is measured with the same odometry
+ *	targets as the turn and move primitives, so the calibration applies here too.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "open_interface.h"
+#include "util.h"
+#include "movement.h"
+#include "calibrate.h"
+#include "trajectory.h"
+
+/**
+ *	This function starts the wheels on one segment
+ *	@param seg	segment to drive
+ *	@param speed	speed of the robot's centre in mm/s
+ */
+
+static void start_segment(const struct segment *seg, int speed)
+{
+	if (seg->radius == 0)
+	{
+		oi_drive(seg->amount < 0 ? -speed : speed, OI_RADIUS_STRAIGHT);
+	}
+	else if (seg->radius == TRAJ_SPIN)
+	{
+		oi_drive(speed, seg->amount < 0 ? OI_RADIUS_SPIN_CW : OI_RADIUS_SPIN_CCW);
+	}
+	else
+	{
+		oi_drive(speed, seg->amount < 0 ? -abs(seg->radius) : abs(seg->radius));
+	}
+}
+
+/**
+ *	This function returns the odometry target of a segment
+ *	@param seg	segment to drive
+ *	@param speed	speed of the robot's centre in mm/s
+ *	@return millimeters for a line, degrees for an arc or a turn
+ */
+
+static int segment_target(const struct segment *seg, int speed)
+{
+	if (seg->radius == 0)
+	{
+		return motion_target(seg->amount < 0 ? CAL_BACKWARD : CAL_FORWARD, speed, abs(seg->amount));
+	}
+	return motion_target(seg->amount < 0 ? CAL_CLOCKWISE : CAL_COUNTERCLOCKWISE, speed, abs(seg->amount));
+}
+
+/**
+ *	This function drives a list of segments without stopping in between.
+ *	@param sensor	structure that contains all the sensor data
+ *	@param path	segments to drive
+ *	@param count	number of segments in path
+ *	@param speed	speed of the robot's centre in mm/s
+ *	@return CONDITION_LEFT or CONDITION_RIGHT if a cliff, tape, or bumper
+ *	stopped the robot; CONDITION_ABORT if the operator stopped it; 0 if the
+ *	whole trajectory was driven
+ */
+
+int follow_trajectory(oi_t *sensor, const struct segment *path, int count, int speed)
+{
+	int condition = 0;
+
+	for (int i = 0; i < count && !condition; i++)
+	{
+		const struct segment *seg = &path[i];
+		int target = segment_target(seg, speed);
+		int start_angle = movedangle;
+		int dir = seg->amount < 0 ? -1 : 1;	//sign of the odometry that counts as progress
+		int sum = 0;
+
+		start_segment(seg, speed);
+		while (sum < target) {
+			if (abort_requested())
+			{
+				condition = CONDITION_ABORT;
+				break;
+			}
+			oi_update(sensor);
+
+			//progress is the distance along a line, the heading change otherwise,
+			//both in the segment's direction so a wobble the other way takes it back
+			if (seg->radius == 0)
+			{
+				sum += dir * sensor->distance;
+			}
+			else
+			{
+				sum += dir * sensor->angle;
+				movedangle = start_angle + (int) ((long) seg->amount * MAX(MIN(sum, target), 0) / (target ? target : 1));
+			}
+			update_position(sensor);
+
+			condition = checkSensors(sensor);	//check for cliff,tape,bumper
+			if (condition)
+			{
+				break;
+			}
+		}
+		if (seg->radius != 0 && !condition)
+		{
+			movedangle = start_angle + seg->amount;
+		}
+	}
+	oi_set_wheels(0, 0); // stop
+
+	uprintf("\n\rLocation: X: %d    Y: %d    R: %d    Angle: %d\n\r", x, y, r, movedangle);
+
+	return condition;
+}
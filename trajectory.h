@@ -0,0 +1,43 @@
+/**
+ *	@file trajectory.h
+ *	@brief this is the header file that contains the functions that drive
+ *	a chain of lines, arcs and turns as one continuous motion
+ */
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include "open_interface.h"
+
+/// radius of a segment that turns in place
+#define TRAJ_SPIN	1
+
+///one piece of a trajectory
+struct segment{
+	int radius;		//0 for a straight line, TRAJ_SPIN to turn in place, otherwise the arc radius in mm
+	int amount;		//length of a line in mm, or degrees turned (counterclockwise positive)
+};
+
+/// straight line of a given length in millimeters
+#define SEG_LINE(mm)		{0, (mm)}
+/// arc of a given radius in millimeters turning a number of degrees, counterclockwise positive
+#define SEG_ARC(radius, deg)	{(radius), (deg)}
+/// turn in place by a number of degrees, counterclockwise positive
+#define SEG_TURN(deg)		{TRAJ_SPIN, (deg)}
+
+/**
+ *	This function drives a list of segments without stopping in between.
+ *	Each segment is started with one drive command as soon as the odometry
+ *	says the one before is done, and the sensors are checked on every update.
+ *	@param sensor	structure that contains all the sensor data
+ *	@param path	segments to drive
+ *	@param count	number of segments in path
+ *	@param speed	speed of the robot's centre in mm/s
+ *	@return CONDITION_LEFT or CONDITION_RIGHT if a cliff, tape, or bumper
+ *	stopped the robot; CONDITION_ABORT if the operator stopped it; 0 if the
+ *	whole trajectory was driven
+ */
+
+int follow_trajectory(oi_t *sensor, const struct segment *path, int count, int speed);
+
+#endif
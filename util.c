@@ -1,232 +1,448 @@
-/**
- *	@file util.c
- *	@brief utility functions for the Atmel platform
- * 
- * 	For an overview of how timer based interrupts work, see
- * 	page 111 and 133-137 of the Atmel Mega128 User Guide
- *
- *	 @author Zhao Zhang & Chad Nelson
- *	 @date 06/26/2012
- */
-
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <stdio.h>
-#include "lcd.h"
-#include <math.h>
-
-/// period of the fast PWM for sonar sensor
-#define  pulse_period  43000
-
-// Global used for interrupt driven delay functions
-volatile unsigned int timer2_tick;
-void timer2_start(char unit);
-void timer2_stop();
-
-/**
- * 	Blocks for a specified number of milliseconds
- * 	@author Zhao Zhang & Chad Nelson
- * 	@date 06/26/2012
- * 	@param time_val	number of milliseconds to wait
- */
-
-void wait_ms(unsigned int time_val) 
-{
-	//Seting OC value for time requested
-	OCR2=250; 				//Clock is 16 MHz. At a prescaler of 64, 250 timer ticks = 1ms.
-	timer2_tick=0;
-	timer2_start(0);
-
-	//Waiting for time
-	while(timer2_tick < time_val);
-
-	timer2_stop();
-}
-
-/**
- * 	Start timer2
- * 	@author Zhao Zhang & Chad Nelson
- * 	@date 06/26/2012
- * 	@param unit	determines fast or slow 
- */
-
-void timer2_start(char unit) 
-{
-	timer2_tick=0;
-	if ( unit == 0 ) { 		//unit = 0 is for slow 
-        TCCR2=0b00001011;	//WGM:CTC, COM:OC2 disconnected,pre_scaler = 64
-        TIMSK|=0b10000000;	//Enabling O.C. Interrupt for Timer2
-	}
-	if (unit == 1) { 		//unit = 1 is for fast
-        TCCR2=0b00001001;	//WGM:CTC, COM:OC2 disconnected,pre_scaler = 1
-        TIMSK|=0b10000000;	//Enabling O.C. Interrupt for Timer2
-	}
-	sei();
-}
-
-/**
- * 	Stop timer2
- * 	@author Zhao Zhang & Chad Nelson
- * 	@date 06/26/2012
- */
-
-void timer2_stop() 
-{
-	TIMSK&=~0b10000000;		//Disabling O.C. Interrupt for Timer2
-	TCCR2&=0b01111111;		//Clearing O.C. settings
-}
-
-
-// Interrupt handler (runs every 1 ms)
-ISR (TIMER2_COMP_vect) 
-{
-	timer2_tick++;
-}
-
-/**
- * 	This function moves the servo to a fixed degree. 
- * 	@author Yuixiang Chen 
- * 	@date 4/12/2015
- * 	@param degree 	fixed degree that servo moves to 
- */
-
-void move_servo(double degree)
-{
-	degree = 180 - degree;
-	unsigned int pulse_width = round(-(degree / 180.0) * 3250 + 4300);
-	OCR3B = pulse_width - 1;
-	wait_ms(20);
-}
-
-/**
- * 	This function initializes fast PWM registers to control the servo. 
- * 	@author Yuixiang Chen 
- * 	@date 4/12/2015
- */
-
-void servo_init(void)
-{
-	TCCR3A = 0x23;
-	TCCR3B = 0x1A;
-	OCR3A = pulse_period - 1;
-	OCR3B = 2700;
-	DDRE = 0x10;
-}
-
-/**
- * 	This function sends the sonar pulse  
- * 	@author Yuixiang Chen 
- * 	@date 4/12/2015
- */
-
-void send_pulse()
-{
-	//Disable IC Interrupt
-	TIMSK &= 0;
-	//Config PD4 to output
-	DDRD |= 0x10;
-	//Set signal to high
-	PORTD |= 0x10;
-	wait_ms(1);
-	//Set signal to low
-	PORTD &= 0XEF;
-	//Config PD4 to input
-	DDRD &= 0XEF;
-	//Clear IC Flag
-	TIFR &= 0xDF;
-	//Enable IC Interrupt
-	TIMSK |= 0x24;
-}
-
-/**
- * 	This function initializes the input capture registers for sonar. 
- * 	@author Yuixiang Chen 
- * 	@date 4/12/2015
- */
-
-void sonar_init(void)
-{
-		TCCR1A = 0;
-		TCCR1B = 0xC2;
-		TCCR1C = 0;
-		TIMSK = 0x24;
-}
-
-/**
- * 	This function initializes the ADC registers for reading the IR sensor. 
- * 	@author Yuixiang Chen 
- * 	@date 4/12/2015
- */
- 
-void IR_init()
-{
-	ADMUX |= (0b01000010);
-}
-
-/**
- * 	This function reads the average of 5 ADC values. 
- * 	@author Yuixiang Chen 
- * 	@date 4/12/2015
- * 	@return returns the average ADC value over 5 reads 
- */
-double IR_read()
-{
-	int sum = 0;
-	int avg = 0;
-	ADCSRA |= 0xC7;
-	for (int i = 0; i < 5; i++)
-	{
-		while((ADCSRA & 0b01000000) == 0b01000000)
-		;
-		sum += ADC;
-	}
-	avg = sum/5;
-	double dist = 34272.0 * pow(avg, -1.376);
-	return dist;
-}
-
-/**
- * 	This function initializes the USART registers for transmitting 
- * 	and receiving information through serial communication.
- *
- * 	@author Yuixiang Chen 
- * 	@date 4/12/2015
- * 	@param ubrr	The calculated baud rate 
- */
-
-void USART_Init(unsigned int ubrr)
-{
-	UBRR0H = (unsigned char) (ubrr>>8);
-	UBRR0L = (unsigned char) ubrr;
-	UCSR0B = (1<<RXEN0) | (1 << TXEN0);
-	UCSR0C = (1<<USBS0)|(3 << UCSZ00);
-	UCSR0A = (1 << U2X0);
-}
-
-/**
- * 	This function receives one byte of data.  
- * 	@author Yuixiang Chen 
- * 	@date 4/12/2015
- * 	@return the received byte of data
- */
-
-unsigned char USART_Receive(void)
-{
-	while(!(UCSR0A & (1 << RXC0)));
-	return UDR0;
-}
-
-/**
- * 	This function transmitts one byte of data 
- * 	@author Yuixiang Chen 
- * 	@date 4/12/2015
- * 	@param data	The byte of data being transmitted
- */
-
-void USART_Transmit(unsigned char data)
-{
-	while(!(UCSR0A & (1 << UDRE0)))
-	;
-	UDR0 = data;
-}
-
+/**
+ *	@file util.c
+ *	@brief utility functions for the Atmel platform
+ * 
+ * 	For an overview of how timer based interrupts work, see
+ * 	page 111 and 133-137 of the Atmel Mega128 User Guide
+ *
+ *	 @author Zhao Zhang & Chad Nelson
+ *	 @date 06/26/2012
+ */
+
+#include "hal.h"
+#include <stdarg.h>
+#include "lcd.h"
+#include "util.h"
+#include "fixmath.h"
+#include "stream.h"
+#include "timebase.h"
+#include "recorder.h"
+#include "link.h"
+#include "params.h"
+#include "profile.h"
+
+/// period of the fast PWM for sonar sensor
+#define  pulse_period  43000
+
+/// width of the sonar trigger pulse, in microseconds
+#define SONAR_TRIGGER_US 10
+
+/// size of the USART0 receive buffer; must be a power of two
+#define USART_BUFFER_SIZE 32
+
+// Globals used by the interrupt driven USART0 receiver
+static HAL_LOCAL volatile unsigned char rx_buffer[USART_BUFFER_SIZE];
+static HAL_LOCAL volatile unsigned char rx_head;		// next free slot, written by the ISR
+static HAL_LOCAL volatile unsigned char rx_tail;		// next byte to hand out
+static HAL_LOCAL volatile unsigned char rx_stops[USART_BUFFER_SIZE];	// abort_keys when each byte was queued
+static HAL_LOCAL volatile char abort_flag;		// set by the ISR when the stop key arrives
+static HAL_LOCAL volatile unsigned char abort_keys;	// stop keys taken so far, wrapping
+static HAL_LOCAL volatile char abort_stopped;		// set once the wheels have been stopped for it
+static HAL_LOCAL volatile uint32_t abort_time;		// timebase_ms() when the stop key arrived
+static HAL_LOCAL volatile uint32_t abort_stop_time;	// timebase_ms() when the wheels stopped for it
+static HAL_LOCAL struct link_parser rx_link;		// frames from the base station
+static HAL_LOCAL volatile unsigned char rx_seq = 0xFF;	// seq of the last command frame taken
+static HAL_LOCAL volatile char ack_due;			// a frame came in; USART_Poll() answers it
+static HAL_LOCAL char framed;				// a good frame came in; bare keys but the stop key are noise
+static HAL_LOCAL uint32_t rx_last;			// timebase_ms() of the last byte received
+
+static HAL_LOCAL uint32_t servo_settled;			// timebase_ms() when the servo reaches its last position
+
+/**
+ * 	Blocks for a specified number of milliseconds
+ * 	@author Zhao Zhang & Chad Nelson
+ * 	@date 06/26/2012
+ * 	@param time_val	number of milliseconds to wait
+ */
+
+void wait_ms(unsigned int time_val) 
+{
+	prof_enter(PROF_WAIT_MS);
+	uint32_t start = timebase_us();
+
+	//Waiting for time, answering command frames meanwhile
+	while(timebase_us() - start < time_val * 1000UL)
+	{
+		USART_Poll();
+		hal_idle();
+	}
+	prof_exit();
+}
+
+/**
+ * 	Blocks for a few microseconds, for delays below the 4 us steps of the clock
+ * 	@param time_val	number of microseconds to wait
+ */
+
+void wait_us(unsigned char time_val)
+{
+	while (time_val--)
+		hal_delay_1us();
+}
+
+/**
+ * 	This function moves the servo to a fixed degree. It returns at once;
+ * 	servo_wait() waits until the servo is there.
+ * 	@author Yuixiang Chen 
+ * 	@date 4/12/2015
+ * 	@param degree 	fixed degree that servo moves to 
+ */
+
+void move_servo(int degree)
+{
+	//4300 counts at 180 degrees down to 1050 at 0, halves rounded up
+	prof_enter(PROF_MOVE_SERVO);
+	unsigned int pulse_width = 4300 - ((180 - degree) * 3250L + 89) / 180;
+	hal_servo_set(pulse_width - 1);
+	servo_settled = timebase_ms() + params.servo_settle_ms;
+	prof_exit();
+}
+
+/**
+ * 	This function waits until the servo has reached the position of the
+ * 	last move_servo()
+ */
+
+void servo_wait(void)
+{
+	prof_enter(PROF_SERVO_WAIT);
+	while ((int32_t) (timebase_ms() - servo_settled) < 0)
+		hal_idle();
+	prof_exit();
+}
+
+/**
+ * 	This function initializes fast PWM registers to control the servo. 
+ * 	@author Yuixiang Chen 
+ * 	@date 4/12/2015
+ */
+
+void servo_init(void)
+{
+	hal_servo_init(pulse_period, 2700);
+}
+
+/**
+ * 	This function sends the sonar pulse  
+ * 	@author Yuixiang Chen 
+ * 	@date 4/12/2015
+ */
+
+void send_pulse()
+{
+	//Disable IC Interrupt and set PD4 high
+	hal_sonar_pulse_start();
+	wait_us(SONAR_TRIGGER_US);
+	//Set PD4 low, back to input, and enable IC Interrupt
+	hal_sonar_pulse_end();
+}
+
+/**
+ * 	This function initializes the input capture registers for sonar. 
+ * 	@author Yuixiang Chen 
+ * 	@date 4/12/2015
+ */
+
+void sonar_init(void)
+{
+		hal_sonar_init();
+}
+
+/**
+ * 	This function initializes the ADC registers for reading the IR sensor. 
+ * 	@author Yuixiang Chen 
+ * 	@date 4/12/2015
+ */
+ 
+void IR_init()
+{
+	hal_adc_init();
+}
+
+/**
+ * 	This function reads the average of 5 ADC values. 
+ * 	@author Yuixiang Chen 
+ * 	@date 4/12/2015
+ * 	@return distance in centimeters from the average ADC value over 5 reads 
+ */
+q16_t IR_read()
+{
+	int sum = 0;
+	int avg = 0;
+	prof_enter(PROF_IR_READ);
+	hal_adc_start();
+	for (int i = 0; i < 5; i++)
+	{
+		while(hal_adc_busy())
+			hal_idle();
+		sum += hal_adc_read();
+	}
+	avg = sum/5;
+	if (avg < 1)
+	{
+		avg = 1;
+	}
+	//34272 * avg^-1.376, as 2^(log2(34272) - 1.376 * log2(avg)), by default
+	q16_t cm = q16_exp2(params.ir_log2_k - q16_mul(params.ir_exponent, q16_log2(q16_from_int(avg))));
+	prof_exit();
+	return cm;
+}
+
+/**
+ * 	This function initializes the USART registers for transmitting 
+ * 	and receiving information through serial communication.
+ *
+ * 	@author Yuixiang Chen 
+ * 	@date 4/12/2015
+ * 	@param ubrr	The calculated baud rate 
+ */
+
+void USART_Init(unsigned int ubrr)
+{
+	hal_uart0_init(ubrr);
+	timebase_init();	// the stop key is timed from the receive interrupt
+	hal_interrupts_enable();
+}
+
+/**
+ * 	Takes a key from the base station: the stop key only raises the abort
+ * 	flag; every other key is queued for USART_Receive() along with the
+ * 	count of stop keys so far, so that it can tell the stops sent before
+ * 	it from those sent after
+ */
+
+static void take_key(unsigned char data)
+{
+	if (data == USART_ABORT)
+	{
+		abort_keys++;
+		if (!abort_flag)
+		{
+			abort_time = timebase_ms();
+			abort_stopped = 0;
+			abort_flag = 1;
+		}
+		return;
+	}
+
+	unsigned char next = (rx_head + 1) & (USART_BUFFER_SIZE - 1);
+	if (next != rx_tail)	// drop the byte if the buffer is full
+	{
+		rx_buffer[rx_head] = data;
+		rx_stops[rx_head] = abort_keys;
+		rx_head = next;
+	}
+}
+
+/**
+ * 	Takes a frame from the base station (see link.h): a command is queued
+ * 	if it is the next in order and all of it fits, and the frame is
+ * 	answered from USART_Poll()
+ */
+
+static void take_frame(const struct link_frame *frame)
+{
+	framed = 1;
+	if (frame->type == LINK_SYNC)
+	{
+		rx_seq = frame->seq;
+	}
+	else if (frame->type != LINK_COMMAND)
+	{
+		return;
+	}
+	else if (frame->seq == (unsigned char) (rx_seq + 1) &&
+			frame->length <= USART_BUFFER_SIZE - 1 - USART_Available())
+	{
+		for (unsigned char i = 0; i < frame->length; i++)
+		{
+			take_key(frame->payload[i]);
+		}
+		rx_seq = frame->seq;
+	}
+	ack_due = 1;
+}
+
+/**
+ * 	Interrupt handler for a byte received on USART0. Bytes of a frame go
+ * 	to take_frame() once it is whole; any other byte is a key. Once frames
+ * 	come in, a bare byte is most likely what is left of a frame whose
+ * 	start was lost, so from then on only the stop key is taken bare. A
+ * 	frame that stops coming in for LINK_GAP_MS is dropped first, so a
+ * 	corrupted length swallows no more than the bytes sent right after it.
+ */
+
+ISR (USART0_RX_vect)
+{
+	unsigned char data = hal_uart0_read();
+	uint32_t now = timebase_ms();
+	rec_key(data);
+	if (now - rx_last > LINK_GAP_MS)
+	{
+		link_drop(&rx_link);
+	}
+	rx_last = now;
+	switch (link_parse(&rx_link, data))
+	{
+	case LINK_FRAME:
+		take_frame(&rx_link.frame);
+		break;
+	case LINK_BYTE:
+		if (!framed || data == USART_ABORT)
+		{
+			take_key(data);
+		}
+		break;
+	}
+}
+
+/**
+ * 	This function receives one byte of data.  
+ * 	@author Yuixiang Chen 
+ * 	@date 4/12/2015
+ * 	@return the received byte of data
+ */
+
+unsigned char USART_Receive(void)
+{
+	while(rx_head == rx_tail)
+	{
+		USART_Poll();
+		hal_idle();
+	}
+	unsigned char state = hal_interrupts_disable();
+	unsigned char data = rx_buffer[rx_tail];
+	if (rx_stops[rx_tail] == abort_keys)
+	{
+		abort_flag = 0;		// any stop key came before this command, so it is stale
+	}
+	else
+	{
+		abort_flag = 1;		// one came after it was queued, so it starts stopped
+	}
+	rx_tail = (rx_tail + 1) & (USART_BUFFER_SIZE - 1);
+	hal_interrupts_restore(state);
+	return data;
+}
+
+/**
+ * 	This function receives one byte of data, waiting until a deadline at most
+ */
+
+int USART_Receive_Until(uint32_t deadline)
+{
+	while(rx_head == rx_tail)
+	{
+		if ((int32_t) (timebase_ms() - deadline) >= 0)
+		{
+			return USART_TIMEOUT;
+		}
+		USART_Poll();
+		hal_idle();
+	}
+	return USART_Receive();
+}
+
+/**
+ * 	This function returns the number of received bytes waiting to be read
+ * 	@return number of bytes in the receive buffer
+ */
+
+unsigned char USART_Available(void)
+{
+	return (rx_head - rx_tail) & (USART_BUFFER_SIZE - 1);
+}
+
+/**
+ * 	This function answers the last command frame, if one came in since it
+ * 	was last called, with the seq of the last frame taken and the room left
+ * 	in the receive buffer
+ */
+
+void USART_Poll(void)
+{
+	if (!ack_due)
+	{
+		return;
+	}
+	unsigned char state = hal_interrupts_disable();
+	unsigned char seq = rx_seq;
+	unsigned char room = USART_BUFFER_SIZE - 1 - USART_Available();
+	ack_due = 0;
+	hal_interrupts_restore(state);
+	link_send(USART_Transmit, LINK_ACK, seq, &room, 1);
+}
+
+/**
+ * 	This function tells a motion or sweep loop whether the operator pressed the
+ * 	stop key. Loops call it once per control frame.
+ * 	@return 1 if the current motion must stop, otherwise 0
+ */
+
+char abort_requested(void)
+{
+	USART_Poll();
+	return abort_flag;
+}
+
+/**
+ * 	This function records that the wheels have been stopped. It is called by
+ * 	oi_set_wheels() whenever both wheels are set to zero.
+ */
+
+void abort_wheels_stopped(void)
+{
+	if (abort_flag && !abort_stopped)
+	{
+		abort_stop_time = timebase_ms();
+		abort_stopped = 1;
+	}
+}
+
+/**
+ * 	This function ends an abort once control is back at the command loop and
+ * 	reports how many milliseconds it took to stop the wheels.
+ */
+
+void abort_clear(void)
+{
+	if (!abort_flag)
+	{
+		return;
+	}
+	if (abort_stopped)
+	{
+		uprintf("\n\rStopped %lu ms after the stop key\n\r", (unsigned long) (abort_stop_time - abort_time));
+	}
+	abort_stopped = 0;
+	abort_flag = 0;
+}
+
+/**
+ * 	This function transmitts one byte of data 
+ * 	@author Yuixiang Chen 
+ * 	@date 4/12/2015
+ * 	@param data	The byte of data being transmitted
+ */
+
+void USART_Transmit(unsigned char data)
+{
+	hal_uart0_write(data);
+}
+
+/**
+ * 	This function formats a message straight onto USART0, without building
+ * 	it in a buffer first
+ * 	@param format	format of the message, as for stream_printf()
+ */
+
+void uprintf(const char *format, ...)
+{
+	va_list args;
+	prof_enter(PROF_UPRINTF);
+	va_start(args, format);
+	stream_vprintf(USART_Transmit, format, args);
+	va_end(args);
+	prof_exit();
+}
+
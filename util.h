@@ -1,95 +1,166 @@
-/**
- *	@file util.c
- *	@brief utility functions for the Atmel platform
- * 
- * 	For an overview of how timer based interrupts work, see
- * 	page 111 and 133-137 of the Atmel Mega128 User Guide
- *
- *	 @author Zhao Zhang & Chad Nelson
- *	 @date 06/26/2012
- */
-
-
-
-/// Blocks for a specified number of milliseconds
-void wait_ms(unsigned int time_val);
-
-/**
- * 	This function moves the servo to a fixed degree. 
- * 	@author Yuixiang Chen 
- * 	@date 4/12/2015
- * 	@param degree 	fixed degree that servo moves to 
- */
-
-void move_servo(double degree);
-
-/**
- * 	This function initializes fast PWM registers to control the servo. 
- * 	@author Yuixiang Chen 
- * 	@date 4/12/2015
- */
-
-void servo_init(void);
-
-/**
- * 	This function sends the sonar pulse  
- * 	@author Yuixiang Chen 
- * 	@date 4/12/2015
- */
-
-void send_pulse(void);
-
-
-/**
- * 	This function initializes the ADC registers for reading the IR sensor. 
- * 	@author Yuixiang Chen 
- * 	@date 4/12/2015
- */
-
-void IR_init();
-
-/**
- * 	This function reads the average of 5 ADC values. 
- * 	@author Yuixiang Chen 
- * 	@date 4/12/2015
- * 	@return returns the average ADC value over 5 reads 
- */
-
-double IR_read();
-
-/**
- * 	This function initializes the input capture registers for sonar. 
- * 	@author Yuixiang Chen 
- * 	@date 4/12/2015
- */
-
-void sonar_init(void);
-
-/**
- * 	This function receives one byte of data.  
- * 	@author Yuixiang Chen 
- * 	@date 4/12/2015
- * 	@return the received byte of data
- */
-
-unsigned char USART_Receive(void);
-
-/**
- * 	This function initializes the USART registers for transmitting 
- * 	and receiving information through serial communication.
- *
- * 	@author Yuixiang Chen 
- * 	@date 4/12/2015
- * 	@param ubrr	The calculated baud rate 
- */
-
-void USART_Init(unsigned int ubrr);
-
-/**
- * 	This function transmitts one byte of data 
- * 	@author Yuixiang Chen 
- * 	@date 4/12/2015
- * 	@param data	The byte of data being transmitted
- */
-
-void USART_Transmit(unsigned char data);
+/**
+ *	@file util.c
+ *	@brief utility functions for the Atmel platform
+ * 
+ * 	For an overview of how timer based interrupts work, see
+ * 	page 111 and 133-137 of the Atmel Mega128 User Guide
+ *
+ *	 @author Zhao Zhang & Chad Nelson
+ *	 @date 06/26/2012
+ */
+
+#include "fixmath.h"
+
+/// key that stops the current motion or sweep as soon as it is received
+#define USART_ABORT ' '
+
+/// what USART_Receive_Until() returns when the deadline passes first
+#define USART_TIMEOUT -1
+
+/// Blocks for a specified number of milliseconds
+void wait_ms(unsigned int time_val);
+
+/// Blocks for a few microseconds
+void wait_us(unsigned char time_val);
+
+/**
+ * 	This function moves the servo to a fixed degree. It returns at once;
+ * 	servo_wait() waits until the servo is there.
+ * 	@author Yuixiang Chen 
+ * 	@date 4/12/2015
+ * 	@param degree 	fixed degree that servo moves to 
+ */
+
+void move_servo(int degree);
+
+/**
+ * 	This function waits until the servo has reached the position of the
+ * 	last move_servo()
+ */
+
+void servo_wait(void);
+
+/**
+ * 	This function initializes fast PWM registers to control the servo. 
+ * 	@author Yuixiang Chen 
+ * 	@date 4/12/2015
+ */
+
+void servo_init(void);
+
+/**
+ * 	This function sends the sonar pulse  
+ * 	@author Yuixiang Chen 
+ * 	@date 4/12/2015
+ */
+
+void send_pulse(void);
+
+
+/**
+ * 	This function initializes the ADC registers for reading the IR sensor. 
+ * 	@author Yuixiang Chen 
+ * 	@date 4/12/2015
+ */
+
+void IR_init();
+
+/**
+ * 	This function reads the average of 5 ADC values. 
+ * 	@author Yuixiang Chen 
+ * 	@date 4/12/2015
+ * 	@return distance in centimeters from the average ADC value over 5 reads 
+ */
+
+q16_t IR_read();
+
+/**
+ * 	This function initializes the input capture registers for sonar. 
+ * 	@author Yuixiang Chen 
+ * 	@date 4/12/2015
+ */
+
+void sonar_init(void);
+
+/**
+ * 	This function receives one byte of data.  
+ * 	@author Yuixiang Chen 
+ * 	@date 4/12/2015
+ * 	@return the received byte of data
+ */
+
+unsigned char USART_Receive(void);
+
+/**
+ * 	This function receives one byte of data, waiting until a deadline at most
+ * 	@param deadline	timebase_ms() at which to give up
+ * 	@return the received byte of data, or USART_TIMEOUT
+ */
+
+int USART_Receive_Until(uint32_t deadline);
+
+/**
+ * 	This function returns the number of received bytes waiting to be read
+ * 	@return number of bytes in the receive buffer
+ */
+
+unsigned char USART_Available(void);
+
+/**
+ * 	This function answers the last command frame from the base station
+ * 	(see link.h), if one came in since it was last called. The receive
+ * 	interrupt only leaves the answer; USART_Receive() and abort_requested()
+ * 	send it, so it goes out within a control frame even while a command runs.
+ */
+
+void USART_Poll(void);
+
+/**
+ * 	This function tells a motion or sweep loop whether the operator pressed the
+ * 	stop key. Loops call it once per control frame.
+ * 	@return 1 if the current motion must stop, otherwise 0
+ */
+
+char abort_requested(void);
+
+/**
+ * 	This function records that the wheels have been stopped. It is called by
+ * 	oi_set_wheels() whenever both wheels are set to zero.
+ */
+
+void abort_wheels_stopped(void);
+
+/**
+ * 	This function ends an abort once control is back at the command loop and
+ * 	reports how many milliseconds it took to stop the wheels.
+ */
+
+void abort_clear(void);
+
+/**
+ * 	This function initializes the USART registers for transmitting 
+ * 	and receiving information through serial communication.
+ *
+ * 	@author Yuixiang Chen 
+ * 	@date 4/12/2015
+ * 	@param ubrr	The calculated baud rate 
+ */
+
+void USART_Init(unsigned int ubrr);
+
+/**
+ * 	This function transmitts one byte of data 
+ * 	@author Yuixiang Chen 
+ * 	@date 4/12/2015
+ * 	@param data	The byte of data being transmitted
+ */
+
+void USART_Transmit(unsigned char data);
+
+/**
+ * 	This function formats a message straight onto USART0, without building
+ * 	it in a buffer first
+ * 	@param format	format of the message, as for stream_printf()
+ */
+
+void uprintf(const char *format, ...);